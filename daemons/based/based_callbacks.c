@@ -200,6 +200,10 @@ cib_common_callback_worker(uint32_t id, uint32_t flags, xmlNode * op_request,
             crm_ipcs_send_ack(cib_client, id, flags, "ack", __FUNCTION__, __LINE__);
         }
         return;
+
+    } else if (crm_str_eq(op, CIB_OP_QUERY, TRUE)) {
+        // The client may have found the published CIB snapshot stale
+        cib_snapshot_check();
     }
 
     cib_process_request(op_request, FALSE, privileged, cib_client);
@@ -332,7 +336,11 @@ process_ping_reply(xmlNode *reply)
 
         if(ping_digest == NULL) {
             crm_trace("Calculating new digest");
-            ping_digest = calculate_xml_versioned_digest(the_cib, FALSE, TRUE, version);
+            if ((the_cib != NULL) && safe_str_eq(version, CRM_FEATURE_SET)) {
+                ping_digest = strdup(cib_current_digest());
+            } else {
+                ping_digest = calculate_xml_versioned_digest(the_cib, FALSE, TRUE, version);
+            }
         }
 
         crm_trace("Processing ping reply %s from %s (%s)", seq_s, host, digest);
@@ -1228,6 +1236,14 @@ cib_process_command(xmlNode * request, xmlNode ** reply, xmlNode ** cib_diff, gb
                             section, request, input, manage_counters, &config_changed,
                             current_cib, &result_cib, cib_diff, &output);
 
+        if (is_set(call_options, cib_zero_copy)) {
+            /* the_cib was updated in place, so its digest and any published
+             * snapshot are now stale
+             */
+            cib_forget_digest();
+            cib_snapshot_changed();
+        }
+
         if (manage_counters == FALSE) {
             int format = 1;
             /* Legacy code
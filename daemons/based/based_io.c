@@ -34,6 +34,7 @@
 crm_trigger_t *cib_writer = NULL;
 
 int write_cib_contents(gpointer p);
+static void cib_snapshot_remove(void);
 
 static void
 cib_rename(const char *old)
@@ -313,6 +314,159 @@ readCibXmlFile(const char *dir, const char *file, gboolean discard_status)
     return root;
 }
 
+/* Publishing CIB snapshots for local readers (see PCMK__CIB_SNAPSHOT) */
+
+/* Minimum time between publishing snapshots (ms). A snapshot is published
+ * only when a local reader asks for one, but writing it takes longer the
+ * larger the CIB is, so the interval grows with the time the last one took,
+ * keeping publishing to a small fraction of the CIB manager's time even while
+ * readers keep asking and the status section churns.
+ */
+#define CIB_SNAPSHOT_DELAY      200
+#define CIB_SNAPSHOT_MAX_DELAY  10000
+#define CIB_SNAPSHOT_COST       10      // Delay as multiple of publish time
+
+static struct pcmk__cib_version_s *snapshot_version = NULL;
+static guint snapshot_timer = 0;
+static guint snapshot_delay = CIB_SNAPSHOT_DELAY;
+static gint64 snapshot_published = 0;   // When last publish finished (us)
+static gboolean snapshots_disabled = FALSE;
+
+/*!
+ * \internal
+ * \brief Create and map the CIB snapshot version file
+ *
+ * \return TRUE if snapshots can be published, otherwise FALSE
+ */
+static gboolean
+cib_snapshot_init(void)
+{
+    if (snapshot_version != NULL) {
+        return TRUE;
+    } else if (snapshots_disabled) {
+        return FALSE;
+    }
+
+    snapshot_version = pcmk__cib_snapshot_init(PCMK__CIB_SNAPSHOT_DIR);
+    if (snapshot_version == NULL) {
+        crm_info("Not publishing CIB snapshots for local readers: "
+                 "Could not map %s/%s: %s", PCMK__CIB_SNAPSHOT_DIR,
+                 PCMK__CIB_SNAPSHOT_VERSION, pcmk_strerror(errno));
+        snapshots_disabled = TRUE;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*!
+ * \internal
+ * \brief Write the current CIB to a new snapshot and rename it into place
+ *
+ * \param[in] data  Ignored
+ *
+ * \return FALSE (so the timer is not repeated)
+ */
+static gboolean
+cib_snapshot_publish(gpointer data)
+{
+    gint64 start = g_get_monotonic_time();
+    gint64 elapsed_ms = 0;
+    int rc = pcmk_ok;
+
+    snapshot_timer = 0;
+    if ((the_cib == NULL) || (snapshot_version == NULL)) {
+        return FALSE;
+    }
+
+    // Readers who find this one stale before it is in place will ask again
+    pcmk__cib_snapshot_wanted(snapshot_version);
+    rc = pcmk__cib_snapshot_publish(PCMK__CIB_SNAPSHOT_DIR, snapshot_version,
+                                    the_cib);
+    if (rc != pcmk_ok) {
+        crm_warn("Could not publish CIB snapshot for local readers: %s "
+                 CRM_XS " rc=%d", pcmk_strerror(rc), rc);
+    }
+
+    snapshot_published = g_get_monotonic_time();
+    elapsed_ms = (snapshot_published - start) / 1000;
+    snapshot_delay = QB_MIN(QB_MAX(CIB_SNAPSHOT_COST * elapsed_ms,
+                                   CIB_SNAPSHOT_DELAY),
+                            CIB_SNAPSHOT_MAX_DELAY);
+    return FALSE;
+}
+
+/*!
+ * \internal
+ * \brief Tell local readers the CIB changed
+ *
+ * This must be called whenever the_cib is replaced or modified in place. No
+ * new snapshot is published until a reader asks for one (see
+ * cib_snapshot_check()).
+ */
+void
+cib_snapshot_changed(void)
+{
+    if (cib_legacy_mode()) {
+        /* Queries may need to go to the master instance, so readers must not
+         * answer them locally
+         */
+        if (snapshot_version != NULL) {
+            crm_info("No longer publishing CIB snapshots (legacy mode)");
+            cib_snapshot_remove();
+        }
+        snapshots_disabled = TRUE;
+        return;
+    }
+
+    if ((the_cib == NULL) || !cib_snapshot_init()) {
+        return;
+    }
+
+    // Until a new snapshot is published, readers will ask us instead
+    pcmk__cib_snapshot_changed(snapshot_version, the_cib);
+}
+
+/*!
+ * \internal
+ * \brief Schedule a new snapshot if a local reader asked for one
+ *
+ * A reader that finds no current snapshot asks for one before querying over
+ * IPC, so this should be called for each query received.
+ */
+void
+cib_snapshot_check(void)
+{
+    gint64 since_ms = 0;
+
+    if ((snapshot_version == NULL) || (snapshot_timer != 0)
+        || !pcmk__cib_snapshot_wanted(snapshot_version)) {
+        return;
+    }
+
+    // Publish right away, unless the last snapshot was published too recently
+    since_ms = (g_get_monotonic_time() - snapshot_published) / 1000;
+    snapshot_timer = g_timeout_add((since_ms < snapshot_delay)?
+                                   (snapshot_delay - since_ms) : 0,
+                                   cib_snapshot_publish, NULL);
+}
+
+/*!
+ * \internal
+ * \brief Stop publishing CIB snapshots, and remove any published
+ */
+static void
+cib_snapshot_remove(void)
+{
+    if (snapshot_timer != 0) {
+        g_source_remove(snapshot_timer);
+        snapshot_timer = 0;
+    }
+    if (snapshot_version != NULL) {
+        pcmk__cib_snapshot_unpublish(PCMK__CIB_SNAPSHOT_DIR, snapshot_version);
+        snapshot_version = NULL;
+    }
+}
+
 gboolean
 uninitializeCib(void)
 {
@@ -324,6 +478,8 @@ uninitializeCib(void)
     }
 
     the_cib = NULL;
+    cib_forget_digest();
+    cib_snapshot_remove();
 
     crm_debug("Deallocating the CIB.");
 
@@ -346,6 +502,8 @@ activateCibXml(xmlNode * new_cib, gboolean to_disk, const char *op)
 
         CRM_ASSERT(new_cib != saved_cib);
         the_cib = new_cib;
+        cib_forget_digest();
+        cib_snapshot_changed();
         free_xml(saved_cib);
         if (cib_writes_enabled && cib_status == pcmk_ok && to_disk) {
             crm_debug("Triggering CIB write for %s op", op);
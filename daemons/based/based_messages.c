@@ -33,6 +33,10 @@
 gboolean cib_is_master = FALSE;
 
 xmlNode *the_cib = NULL;
+
+/* Digest of the_cib, kept until the_cib next changes */
+static char *the_cib_digest = NULL;
+
 int revision_check(xmlNode * cib_update, xmlNode * cib_copy, int flags);
 int get_revision(xmlNode * xml_obj, int cur_revision);
 
@@ -45,6 +49,37 @@ int cib_update_counter(xmlNode * xml_obj, const char *field, gboolean reset);
 
 int sync_our_cib(xmlNode * request, gboolean all);
 
+/*!
+ * \internal
+ * \brief Get the digest of the active CIB, calculating it only if needed
+ *
+ * \return Digest of the_cib for the current feature set (owned by this file)
+ * \note Peers exchange these digests, so the result must remain identical to
+ *       calculate_xml_versioned_digest(); only its recalculation is avoided.
+ */
+const char *
+cib_current_digest(void)
+{
+    if ((the_cib_digest == NULL) && (the_cib != NULL)) {
+        the_cib_digest = calculate_xml_versioned_digest(the_cib, FALSE, TRUE,
+                                                        CRM_FEATURE_SET);
+    }
+    return the_cib_digest;
+}
+
+/*!
+ * \internal
+ * \brief Discard the cached digest of the active CIB
+ *
+ * \note This must be called whenever the_cib is replaced or modified in place.
+ */
+void
+cib_forget_digest(void)
+{
+    free(the_cib_digest);
+    the_cib_digest = NULL;
+}
+
 int
 cib_process_shutdown_req(const char *op, int options, const char *section, xmlNode * req,
                          xmlNode * input, xmlNode * existing_cib, xmlNode ** result_cib,
@@ -154,7 +189,7 @@ cib_process_ping(const char *op, int options, const char *section, xmlNode * req
 {
     const char *host = crm_element_value(req, F_ORIG);
     const char *seq = crm_element_value(req, F_CIB_PING_ID);
-    char *digest = calculate_xml_versioned_digest(the_cib, FALSE, TRUE, CRM_FEATURE_SET);
+    const char *digest = cib_current_digest();
 
     static struct qb_log_callsite *cs = NULL;
 
@@ -190,8 +225,6 @@ cib_process_ping(const char *op, int options, const char *section, xmlNode * req
              existing_cib,
              cs && cs->targets);
 
-    free(digest);
-
     return pcmk_ok;
 }
 
@@ -222,7 +255,7 @@ cib_process_upgrade_server(const char *op, int options, const char *section, xml
     } else {
         int new_version = 0;
         int current_version = 0;
-        xmlNode *scratch = copy_xml(existing_cib);
+        xmlNode *scratch = NULL;
         const char *host = crm_element_value(req, F_ORIG);
         const char *value = crm_element_value(existing_cib, XML_ATTR_VALIDATION);
         const char *client_id = crm_element_value(req, F_CIB_CLIENTID);
@@ -234,7 +267,14 @@ cib_process_upgrade_server(const char *op, int options, const char *section, xml
             current_version = get_schema_version(value);
         }
 
-        rc = update_validation(&scratch, &new_version, 0, TRUE, TRUE);
+        if (current_version >= get_schema_version(xml_latest_schema())) {
+            // Nothing to upgrade, so don't bother copying the CIB
+            rc = -pcmk_err_schema_unchanged;
+
+        } else {
+            scratch = copy_xml(existing_cib);
+            rc = update_validation(&scratch, &new_version, 0, TRUE, TRUE);
+        }
         if (new_version > current_version) {
             xmlNode *up = create_xml_node(NULL, __FUNCTION__);
 
@@ -486,7 +526,6 @@ int
 sync_our_cib(xmlNode * request, gboolean all)
 {
     int result = pcmk_ok;
-    char *digest = NULL;
     const char *host = crm_element_value(request, F_ORIG);
     const char *op = crm_element_value(request, F_CIB_OPERATION);
 
@@ -519,8 +558,7 @@ sync_our_cib(xmlNode * request, gboolean all)
     crm_xml_add(replace_request, F_CIB_GLOBAL_UPDATE, XML_BOOLEAN_TRUE);
 
     crm_xml_add(replace_request, XML_ATTR_CRM_VERSION, CRM_FEATURE_SET);
-    digest = calculate_xml_versioned_digest(the_cib, FALSE, TRUE, CRM_FEATURE_SET);
-    crm_xml_add(replace_request, XML_ATTR_DIGEST, digest);
+    crm_xml_add(replace_request, XML_ATTR_DIGEST, cib_current_digest());
 
     add_message_xml(replace_request, F_CIB_CALLDATA, the_cib);
 
@@ -529,6 +567,5 @@ sync_our_cib(xmlNode * request, gboolean all)
         result = -ENOTCONN;
     }
     free_xml(replace_request);
-    free(digest);
     return result;
 }
@@ -23,6 +23,7 @@
 #include <crm/msg_xml.h>
 
 #include <crm/common/xml.h>
+#include <crm/common/ipc_internal.h>
 #include <crm/common/remote_internal.h>
 #include <pacemaker-based.h>
 
@@ -32,6 +33,8 @@ struct cib_notification_s {
     xmlNode *msg;
     struct iovec *iov;
     int32_t iov_size;
+    struct iovec *iov_peer;     // encoded per peer_flags, prepared on demand
+    uint32_t peer_flags;        // crm_ipc_*_ok flags iov_peer was prepared for
 };
 
 void attach_cib_generation(xmlNode * msg, const char *field, xmlNode * a_cib);
@@ -78,9 +81,32 @@ cib_notify_send_one(gpointer key, gpointer value, gpointer user_data)
     }
 
     if (do_send) {
+        struct iovec *iov = update->iov;
+        uint32_t accepts = pcmk__ipc_client_accepts(client);
+
+        /* Clients built from the same version accept the same encodings, so
+         * one alternative to the plain version is enough in practice
+         */
+        if (accepts != 0) {
+            if (update->iov_peer == NULL) {
+                // On failure, this leaves iov_peer NULL, so text is sent
+                pcmk__ipc_prepare(0, update->msg, &(update->iov_peer), 0,
+                                  accepts);
+                update->peer_flags = accepts;
+            }
+            if ((update->iov_peer != NULL) && (update->peer_flags == accepts)) {
+                iov = update->iov_peer;
+            }
+        }
+
         switch (client->kind) {
             case CRM_CLIENT_IPC:
-                if (crm_ipcs_sendv(client, update->iov, crm_ipc_server_event) < 0) {
+                if (iov == NULL) {
+                    // Too big for the IPC buffer, and client can't reassemble
+                    crm_warn("Could not notify client %s/%s: %s",
+                             client->name, client->id, pcmk_strerror(-EMSGSIZE));
+
+                } else if (crm_ipcs_sendv(client, iov, crm_ipc_server_event) < 0) {
                     crm_warn("Notification of client %s/%s failed", client->name, client->id);
                 }
                 break;
@@ -107,11 +133,17 @@ cib_notify_send(xmlNode * xml)
     ssize_t rc = crm_ipc_prepare(0, xml, &iov, 0);
 
     crm_trace("Notifying clients");
-    if (rc > 0) {
+    if ((rc > 0) || (rc == -EMSGSIZE)) {
+        /* If the notification is too big for the IPC buffer, clients that can
+         * reassemble fragments still get the one prepared for them
+         */
         update.msg = xml;
         update.iov = iov;
         update.iov_size = rc;
+        update.iov_peer = NULL;
+        update.peer_flags = 0;
         g_hash_table_foreach_remove(client_connections, cib_notify_send_one, &update);
+        pcmk_free_ipc_event(update.iov_peer);
 
     } else {
         crm_notice("Could not notify clients: %s " CRM_XS " rc=%lld",
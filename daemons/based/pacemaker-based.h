@@ -92,6 +92,10 @@ xmlNode *readCibXml(char *buffer);
 xmlNode *readCibXmlFile(const char *dir, const char *file,
                         gboolean discard_status);
 int activateCibXml(xmlNode *doc, gboolean to_disk, const char *op);
+const char *cib_current_digest(void);
+void cib_forget_digest(void);
+void cib_snapshot_changed(void);
+void cib_snapshot_check(void);
 
 xmlNode *createCibRequest(gboolean isLocal, const char *operation,
                           const char *section, const char *verbose,
@@ -180,7 +180,7 @@ do_te_invoke(long long action,
                   return);
 
         destroy_graph(transition_graph);
-        transition_graph = unpack_graph(graph_data, graph_input);
+        transition_graph = pcmk__consume_graph(graph_data, graph_input);
         if (transition_graph == NULL) {
             CRM_CHECK(transition_graph != NULL,);
             transition_graph = create_blank_graph();
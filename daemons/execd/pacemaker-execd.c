@@ -124,13 +124,14 @@ lrmd_ipc_dispatch(qb_ipcs_connection_t * c, void *data, size_t size)
     CRM_CHECK(client->id != NULL, crm_err("Invalid client: %p", client);
               return FALSE);
 
-    CRM_CHECK(flags & crm_ipc_client_response, crm_err("Invalid client request: %p", client);
-              return FALSE);
-
     if (!request) {
+        // Includes all but the last fragment of a multipart request
         return 0;
     }
 
+    CRM_CHECK(flags & crm_ipc_client_response, crm_err("Invalid client request: %p", client);
+              free_xml(request); return FALSE);
+
     if (!client->name) {
         const char *value = crm_element_value(request, F_LRMD_CLIENTNAME);
 
@@ -23,6 +23,7 @@
 
 #include <crm/common/ipcs.h>
 #include <crm/common/mainloop.h>
+#include <crm/common/xml_internal.h>
 #include <crm/pengine/internal.h>
 #include <pacemaker-internal.h>
 #include <crm/msg_xml.h>
@@ -39,6 +40,8 @@ typedef struct series_s {
     const char *name;
     const char *param;
     int wrap;
+
+    pcmk__series_state_t state;
 } series_t;
 
 series_t series[] = {
@@ -50,6 +53,45 @@ series_t series[] = {
 
 void pengine_shutdown(int nsig);
 
+static crm_trigger_t *release_trigger = NULL;
+
+/*!
+ * \internal
+ * \brief Prepare the inputs that the next saves will overwrite
+ *
+ * Saving an input may require rewriting the oldest remaining one in full
+ * (see pcmk__series_release()), so that is done while idle after each save,
+ * rather than before the next one.
+ *
+ * \param[in] user_data  Ignored
+ *
+ * \return TRUE (so the trigger is kept)
+ */
+static int
+release_series_inputs(gpointer user_data)
+{
+    for (int lpc = 0; lpc < DIMOF(series); lpc++) {
+        pcmk__series_release_pending(&(series[lpc].state));
+    }
+    return TRUE;
+}
+
+/*!
+ * \internal
+ * \brief Move a transition graph into a reply, without copying it
+ *
+ * \param[in,out] reply  Reply to add graph to
+ * \param[in]     graph  Transition graph (top-level element of its document)
+ *
+ * \note A graph can be large, and create_reply() would hold a copy of it in
+ *       addition to the original. Afterward, \p graph belongs to \p reply.
+ */
+static void
+add_graph_to_reply(xmlNode *reply, xmlNode *graph)
+{
+    pcmk__xml_move(create_xml_node(reply, F_CRM_DATA), graph);
+}
+
 static gboolean
 process_pe_message(xmlNode * msg, xmlNode * xml_data, crm_client_t * sender)
 {
@@ -80,9 +122,11 @@ process_pe_message(xmlNode * msg, xmlNode * xml_data, crm_client_t * sender)
         int seq = -1;
         int series_id = 0;
         int series_wrap = 0;
+        int snapshot_interval = 0;
         char *digest = NULL;
         const char *value = NULL;
         xmlNode *converted = NULL;
+        xmlNode *graph = NULL;
         xmlNode *reply = NULL;
         gboolean is_repoke = FALSE;
         gboolean process = TRUE;
@@ -136,14 +180,22 @@ process_pe_message(xmlNode * msg, xmlNode * xml_data, crm_client_t * sender)
                             " preference: %s", series[series_id].param);
         }
 
+        value = pe_pref(sched_data_set->config_hash,
+                        "pe-series-snapshot-interval");
+        snapshot_interval = crm_parse_int(value, "0");
+
         seq = get_last_sequence(PE_STATE_DIR, series[series_id].name);
-        crm_trace("Series %s: wrap=%d, seq=%d, pref=%s",
-                  series[series_id].name, series_wrap, seq, value);
+        crm_trace("Series %s: wrap=%d, seq=%d, snapshot-interval=%d",
+                  series[series_id].name, series_wrap, seq, snapshot_interval);
 
         sched_data_set->input = NULL;
-        reply = create_reply(msg, sched_data_set->graph);
+        reply = create_reply(msg, NULL);
         CRM_ASSERT(reply != NULL);
 
+        graph = sched_data_set->graph;
+        sched_data_set->graph = NULL;
+        add_graph_to_reply(reply, graph);
+
         if (is_repoke == FALSE) {
             free(filename);
             filename = generate_series_filename(PE_STATE_DIR,
@@ -170,7 +222,7 @@ process_pe_message(xmlNode * msg, xmlNode * xml_data, crm_client_t * sender)
                     graph_file);
 
             crm_xml_add(reply, F_CRM_TGRAPH, graph_file);
-            write_xml_fd(sched_data_set->graph, graph_file, graph_file_fd, FALSE);
+            write_xml_fd(graph, graph_file, graph_file_fd, FALSE);
 
             free(graph_file);
             free_xml(first_named_child(reply, F_CRM_DATA));
@@ -182,10 +234,12 @@ process_pe_message(xmlNode * msg, xmlNode * xml_data, crm_client_t * sender)
         pcmk__log_transition_summary(filename);
 
         if (is_repoke == FALSE && series_wrap != 0) {
-            unlink(filename);
             crm_xml_add_int(xml_data, "execution-date", execution_date);
-            write_xml_file(xml_data, filename, TRUE);
+            pcmk__series_save(&(series[series_id].state), PE_STATE_DIR,
+                              series[series_id].name, seq, series_wrap,
+                              xml_data, snapshot_interval);
             write_last_sequence(PE_STATE_DIR, series[series_id].name, seq + 1, series_wrap);
+            mainloop_set_trigger(release_trigger);
         } else {
             crm_trace("Not writing out %s: %d & %d", filename, is_repoke, series_wrap);
         }
@@ -332,6 +386,10 @@ main(int argc, char **argv)
         crm_exit(CRM_EX_FATAL);
     }
 
+    // Below IPC, so that requests are answered first
+    release_trigger = mainloop_add_trigger(G_PRIORITY_LOW,
+                                           release_series_inputs, NULL);
+
     /* Create the mainloop and run it... */
     mainloop = g_main_loop_new(NULL, FALSE);
     crm_notice("Pacemaker scheduler successfully started and accepting connections");
@@ -70,6 +70,54 @@
 #  define CIB_CHANNEL_RW		"cib_rw"
 #  define CIB_CHANNEL_SHM		"cib_shm"
 
+/* The CIB manager publishes snapshots of the CIB for local readers, who can
+ * then query it without a round trip over IPC. The version file is updated in
+ * place (and mapped by readers) whenever the CIB changes. A reader that finds
+ * no current snapshot flags the version file and queries over IPC instead,
+ * and the CIB manager publishes a new snapshot only when flagged, so it
+ * writes none while nobody reads them. A snapshot is renamed into place, and
+ * is never modified once there, so readers can map it without locking and
+ * compare it with the version file to tell whether it is current.
+ */
+#  define PCMK__CIB_SNAPSHOT_DIR        CRM_STATE_DIR
+#  define PCMK__CIB_SNAPSHOT            "cib-snapshot"
+#  define PCMK__CIB_SNAPSHOT_VERSION    "cib-snapshot-version"
+#  define PCMK__CIB_SNAPSHOT_MAGIC      0x43494253  /* "CIBS" */
+
+/* Contents of CIB snapshot version file */
+struct pcmk__cib_version_s {
+    uint32_t magic;         /* PCMK__CIB_SNAPSHOT_MAGIC */
+    uint32_t seq;           /* Odd while the rest is being updated */
+    uint32_t pid;           /* CIB manager that owns the file */
+    uint32_t serial;        /* Incremented whenever the CIB changes */
+    int32_t admin_epoch;    /* Current CIB version */
+    int32_t epoch;
+    int32_t num_updates;
+    uint32_t wanted;        /* Set by readers that found no current snapshot */
+};
+
+/* Header of CIB snapshot, followed by the CIB as XML text */
+struct pcmk__cib_snapshot_s {
+    uint32_t magic;         /* PCMK__CIB_SNAPSHOT_MAGIC */
+    uint32_t pid;           /* CIB manager that published the snapshot */
+    uint32_t serial;        /* Version file serial when snapshot was taken */
+    int32_t admin_epoch;    /* CIB version in snapshot */
+    int32_t epoch;
+    int32_t num_updates;
+    uint32_t size;          /* Bytes of XML text, including terminator */
+};
+
+struct pcmk__cib_version_s *pcmk__cib_snapshot_init(const char *directory);
+void pcmk__cib_snapshot_changed(struct pcmk__cib_version_s *version,
+                                xmlNode *cib);
+gboolean pcmk__cib_snapshot_wanted(struct pcmk__cib_version_s *version);
+int pcmk__cib_snapshot_publish(const char *directory,
+                               const struct pcmk__cib_version_s *version,
+                               xmlNode *cib);
+void pcmk__cib_snapshot_unpublish(const char *directory,
+                                  struct pcmk__cib_version_s *version);
+int pcmk__cib_snapshot_read(const char *directory, xmlNode **cib);
+
 gboolean cib_diff_version_details(xmlNode * diff, int *admin_epoch, int *epoch, int *updates,
                                   int *_admin_epoch, int *_epoch, int *_updates);
 
@@ -24,6 +24,28 @@ char *generate_series_filename(const char *directory, const char *series, int se
 int get_last_sequence(const char *directory, const char *series);
 void write_last_sequence(const char *directory, const char *series, int sequence, int max);
 int crm_chown_last_sequence(const char *directory, const char *series, uid_t uid, gid_t gid);
+xmlNode *pcmk__series_delta(xmlNode *base, const char *base_file, xmlNode *xml);
+xmlNode *pcmk__series_file2xml(const char *filename);
+int pcmk__series_release(const char *filename, const char *next_file,
+                         xmlNode **base);
+
+/* State of a file series whose members may be saved as deltas */
+typedef struct pcmk__series_state_s {
+    xmlNode *last_input;    // Copy of most recently saved member
+    char *last_file;        // Where most recently saved member was saved
+    int deltas;             // Deltas saved since last full member
+    xmlNode *base;          // Full copy of release_file (or release_next
+                            // once released), if known
+    char *release_file;     // Member the next save will overwrite
+    char *release_next;     // Member saved after release_file
+    bool released;          // Whether release_file is ready to overwrite
+} pcmk__series_state_t;
+
+int pcmk__series_save(pcmk__series_state_t *state, const char *directory,
+                      const char *series, int sequence, int max,
+                      xmlNode *input, int interval);
+void pcmk__series_release_pending(pcmk__series_state_t *state);
+void pcmk__series_reset(pcmk__series_state_t *state);
 
 bool pcmk__daemon_can_write(const char *dir, const char *file);
 void crm_sync_directory(const char *name);
@@ -41,6 +63,12 @@ int crm_procfs_pid_of(const char *name);
 unsigned int crm_procfs_num_cores(void);
 
 
+/* internal ACL functions (from acl.c) */
+
+bool pcmk__acl_filtered_view(const char *user, xmlNode *acl_source,
+                             xmlNode *xml, xmlNode **result);
+
+
 /* internal XML schema functions (from xml.c) */
 
 void crm_schema_init(void);
@@ -102,6 +130,21 @@ gboolean crm_ends_with_ext(const char *s, const char *match);
 char *add_list_element(char *list, const char *value);
 bool crm_compress_string(const char *data, int length, int max, char **result,
                          unsigned int *result_len);
+
+enum pcmk__codec {
+    pcmk__codec_bzip2,
+    pcmk__codec_lz4,
+    pcmk__codec_zstd,
+};
+
+const char *pcmk__codec_text(enum pcmk__codec codec);
+bool pcmk__codec_supported(enum pcmk__codec codec);
+int pcmk__compress(enum pcmk__codec codec, const char *data,
+                   unsigned int length, unsigned int max, char **result,
+                   unsigned int *result_len);
+int pcmk__decompress(enum pcmk__codec codec, const char *data,
+                     unsigned int length, char *result,
+                     unsigned int *result_len);
 gint crm_alpha_sort(gconstpointer a, gconstpointer b);
 
 static inline char *
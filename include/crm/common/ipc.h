@@ -41,9 +41,21 @@ enum crm_ipc_flags
     crm_ipc_flags_none      = 0x00000000,
 
     crm_ipc_compressed      = 0x00000001, /* Message has been compressed */
+    crm_ipc_binary          = 0x00000002, /* Message uses binary XML encoding */
+    crm_ipc_binary_ok       = 0x00000004, /* Sender can receive binary XML */
+    crm_ipc_lz4             = 0x00000008, /* Compressed with LZ4, not bzip2 */
+    crm_ipc_zstd            = 0x00000010, /* Compressed with zstd, not bzip2 */
+    crm_ipc_lz4_ok          = 0x00000020, /* Sender can decompress LZ4 */
+    crm_ipc_zstd_ok         = 0x00000040, /* Sender can decompress zstd */
 
     crm_ipc_proxied         = 0x00000100, /* _ALL_ replies to proxied connections need to be sent as events */
     crm_ipc_client_response = 0x00000200, /* A Response is expected in reply */
+    crm_ipc_multipart       = 0x00000400, /* Message is one fragment of many */
+    crm_ipc_multipart_ok    = 0x00000800, /* Sender can reassemble fragments */
+    crm_ipc_batch           = 0x00001000, /* Message contains several events */
+    crm_ipc_batch_ok        = 0x00002000, /* Sender can receive batched events */
+    crm_ipc_async           = 0x00004000, /* Reply is wanted (or sent) as an event */
+    crm_ipc_async_ok        = 0x00008000, /* Sender can reply to requests as events */
 
     /* These options are just options for crm_ipcs_sendv() */
     crm_ipc_server_event    = 0x00010000, /* Send an Event instead of a Response */
@@ -10,9 +10,18 @@
 #ifndef PCMK__IPC_INTERNAL_H
 #define PCMK__IPC_INTERNAL_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+
+#include <libxml/tree.h>
+#include <qb/qbipc_common.h>
 
 #include <crm_config.h>  /* US_AUTH_GETPEEREID */
+#include <crm/common/ipc.h>
+#include <crm/common/ipcs.h>
+#include <crm/common/mainloop.h>
 
 
 /* denotes "non yieldable PID" on FreeBSD, or actual PID1 in scenarios that
@@ -66,4 +75,104 @@
 int pcmk__ipc_is_authentic_process_active(const char *name, uid_t refuid,
                                           gid_t refgid, pid_t *gotpid);
 
+/* Header that starts every IPC message (see pcmk__ipc_prepare()) */
+struct crm_ipc_response_header {
+    struct qb_ipc_response_header qb;
+    uint32_t size_uncompressed;
+    uint32_t size_compressed;
+    uint32_t flags;
+    uint8_t  version; /* Protect against version changes for anyone that might bother to statically link us */
+};
+
+/* A message too big for the IPC buffer may be sent to a peer that advertises
+ * crm_ipc_multipart_ok as a series of fragments. Each fragment starts with a
+ * copy of the whole message's header (so the size and encoding fields describe
+ * the whole message), with crm_ipc_multipart set and qb.size giving the size
+ * of the fragment itself. That is followed by this fragment header, then the
+ * next chunk of the message payload. Every chunk but the last is the same size.
+ */
+struct crm_ipc_fragment_header {
+    uint32_t id;        /* Identifies the message (unique per sender) */
+    uint32_t index;     /* Position of this fragment in the message */
+    uint32_t count;     /* Total number of fragments in the message */
+};
+
+/* A peer may send a multipart message with at most this many times the
+ * recipient's IPC buffer size of payload
+ */
+#define PCMK__IPC_MULTIPART_MAX 256
+
+bool pcmk__connect_ipc(crm_ipc_t *client, uid_t server_uid, gid_t server_gid);
+ssize_t pcmk__ipc_prepare(uint32_t request, xmlNode *message,
+                          struct iovec **result, uint32_t max_send_size,
+                          uint32_t peer_flags);
+uint32_t pcmk__ipc_client_accepts(crm_client_t *c);
+xmlNode *pcmk__ipc_buffer_xml(crm_ipc_t *client);
+void pcmk__ipc_accept_binary(crm_ipc_t *client);
+void pcmk__ipc_accept_batch(crm_ipc_t *client);
+bool pcmk__ipc_batch_pending(crm_ipc_t *client);
+
+/*!
+ * \internal
+ * \brief Handle the outcome of an asynchronous IPC request
+ *
+ * \param[in] client      Connection request was sent on
+ * \param[in] request_id  ID set by pcmk__ipc_send_async()
+ * \param[in] rc          pcmk_ok if a reply was received, otherwise -errno
+ *                        (-ETIMEDOUT if none arrived in time, -ENOTCONN if
+ *                        the connection was closed first)
+ * \param[in] reply       Reply received (or NULL if none), freed by caller
+ * \param[in] user_data   Pointer passed to pcmk__ipc_send_async()
+ *
+ * \note The callback must not destroy \p client.
+ */
+typedef void (*pcmk__ipc_reply_fn)(crm_ipc_t *client, uint32_t request_id,
+                                   int rc, xmlNode *reply, void *user_data);
+
+int pcmk__ipc_send_async(crm_ipc_t *client, xmlNode *message,
+                         enum crm_ipc_flags flags, int32_t ms_timeout,
+                         pcmk__ipc_reply_fn callback, void *user_data,
+                         uint32_t *request_id);
+bool pcmk__ipc_dispatch_reply(crm_ipc_t *client);
+int pcmk__ipc_wait_async(crm_ipc_t *client, int32_t ms_timeout);
+guint pcmk__ipc_async_pending(crm_ipc_t *client);
+
+/* Number of buckets in an IPC event latency histogram (see below) */
+#define PCMK__IPC_LATENCY_BUCKETS 5
+
+/* Statistics for a server-side IPC client connection */
+struct pcmk__ipc_stats_s {
+    time_t connected;                   // When the client connected
+    unsigned long long requests;        // Requests received
+    unsigned long long responses;       // Responses sent (other than as events)
+    unsigned long long bytes_in;        // Bytes received, as sent by client
+    unsigned long long bytes_out;       // Bytes of responses and events queued or sent
+    unsigned long long raw_bytes_out;   // Same, before any compression
+    unsigned long long events_queued;   // Events added to the queue
+    unsigned long long events_sent;     // Events delivered to the client
+    unsigned long long batches_sent;    // Messages that combined several events
+    unsigned long long send_blocked;    // Flushes stopped by a full channel
+    unsigned int max_depth;             // Largest queue length seen
+    long long total_latency_ms;         // Sum of time events spent queued
+    long long max_latency_ms;           // Longest time an event spent queued
+
+    // Events sent by time spent queued: <1ms, <10ms, <100ms, <1s, longer
+    unsigned long long latency[PCMK__IPC_LATENCY_BUCKETS];
+};
+
+/* Request that any IPC server answers with statistics for its clients */
+#define PCMK__XE_IPC_STATS "pcmk-ipc-stats"
+
+/* Set in a statistics reply that was refused, as a negative errno */
+#define PCMK__XA_IPC_STATS_RC "rc"
+
+xmlNode *pcmk__ipc_stats_xml(void);
+
+mainloop_io_t *pcmk__add_mainloop_ipc(crm_ipc_t *ipc, int priority,
+                                      void *userdata,
+                                      struct ipc_client_callbacks *callbacks);
+void pcmk__mainloop_ipc_xml_dispatch(mainloop_io_t *client,
+                                     int (*dispatch)(xmlNode *msg,
+                                                     gpointer userdata));
+
 #endif
@@ -58,6 +58,11 @@ enum crm_client_flags
 {
     crm_client_flag_ipc_proxied    = 0x00001, /* ipc_proxy code only */
     crm_client_flag_ipc_privileged = 0x00002, /* root or cluster user */
+    crm_client_flag_ipc_binary     = 0x00004, /* client can receive binary XML */
+    crm_client_flag_ipc_lz4        = 0x00008, /* client can decompress LZ4 */
+    crm_client_flag_ipc_zstd       = 0x00010, /* client can decompress zstd */
+    crm_client_flag_ipc_multipart  = 0x00020, /* client can reassemble fragments */
+    crm_client_flag_ipc_batch      = 0x00040, /* client can receive batched events */
 };
 
 struct crm_client_s {
@@ -92,6 +97,16 @@ struct crm_client_s {
 
     unsigned int queue_backlog; /* IPC queue length after last flush */
     unsigned int queue_max;     /* Evict client whose queue grows this big */
+
+    struct crm_ipc_parts_s *ipc_parts;  /* Multipart request being received */
+
+    guint flush_delay;          /* Current delay before retrying a blocked flush (ms) */
+    time_t backlog_since;       /* When IPC queue last shrank while over queue_max */
+    struct pcmk__ipc_stats_s *ipc_stats;  /* IPC traffic statistics */
+
+    GQueue *response_queue;     /* Response fragments waiting for room */
+    guint response_timer;       /* Retries sending queued response fragments */
+    GHashTable *async_requests; /* IDs of requests to answer with events */
 };
 
 extern GHashTable *client_connections;
@@ -30,6 +30,8 @@
 
 #  include <crm/crm.h>  /* transitively imports qblog.h */
 
+#  include <libxml/xpath.h>  /* xmlXPathObjectPtr */
+
 
 /*!
  * \brief Base for directing lib{xml2,xslt} log into standard libqb backend
@@ -133,4 +135,14 @@ do {
     }                                                                           \
 } while (0)
 
+xmlXPathObjectPtr pcmk__xpath_search_with(xmlNode *xml_top, const char *path,
+                                          ...) G_GNUC_NULL_TERMINATED;
+void pcmk__xpath_cache_stats(unsigned int *hits, unsigned int *misses);
+
+xmlNode *pcmk__xml_find_id(xmlNode *xml, const char *id);
+void pcmk__xml_move(xmlNode *parent, xmlNode *child);
+
+char *pcmk__xml2binary(xmlNode *xml, unsigned int *len);
+xmlNode *pcmk__binary2xml(const char *buffer, unsigned int len);
+
 #endif
@@ -306,6 +306,7 @@ pe_base_name_eq(resource_t *rsc, const char *id)
 }
 
 int pe__target_rc_from_xml(xmlNode *xml_op);
+xmlNode *pe__cib_section(xmlNode *cib, const char *name);
 
 gint sort_node_uname(gconstpointer a, gconstpointer b);
 bool is_set_recursive(resource_t * rsc, long long flag, bool any);
@@ -26,6 +26,7 @@
 
 #include <crm/msg_xml.h>
 #include <crm/common/mainloop.h>
+#include <crm/common/ipc_internal.h>
 
 typedef struct cib_native_opaque_s {
     char *token;
@@ -86,10 +87,9 @@ cib_native_signon(cib_t * cib, const char *name, enum cib_conn_type type)
 }
 
 static int
-cib_native_dispatch_internal(const char *buffer, ssize_t length, gpointer userdata)
+cib_native_dispatch_xml(xmlNode *msg, gpointer userdata)
 {
     const char *type = NULL;
-    xmlNode *msg = NULL;
 
     cib_t *cib = userdata;
 
@@ -100,8 +100,6 @@ cib_native_dispatch_internal(const char *buffer, ssize_t length, gpointer userda
         return 0;
     }
 
-    msg = string2xml(buffer);
-
     if (msg == NULL) {
         crm_warn("Received a NULL message from the CIB manager");
         return 0;
@@ -121,7 +119,15 @@ cib_native_dispatch_internal(const char *buffer, ssize_t length, gpointer userda
     } else {
         crm_err("Unknown message type: %s", type);
     }
+    return 0;
+}
+
+static int
+cib_native_dispatch_internal(const char *buffer, ssize_t length, gpointer userdata)
+{
+    xmlNode *msg = string2xml(buffer);
 
+    cib_native_dispatch_xml(msg, userdata);
     free_xml(msg);
     return 0;
 }
@@ -142,9 +148,10 @@ cib_native_dispatch(cib_t * cib)
     while (crm_ipc_ready(native->ipc)) {
 
         if (crm_ipc_read(native->ipc) > 0) {
-            const char *msg = crm_ipc_buffer(native->ipc);
+            xmlNode *msg = pcmk__ipc_buffer_xml(native->ipc);
 
-            cib_native_dispatch_internal(msg, strlen(msg), cib);
+            cib_native_dispatch_xml(msg, cib);
+            free_xml(msg);
         }
 
         if (crm_ipc_connected(native->ipc) == FALSE) {
@@ -209,6 +216,7 @@ cib_native_signon_raw(cib_t * cib, const char *name, enum cib_conn_type type, in
 
         if (native->ipc && crm_ipc_connect(native->ipc)) {
             *async_fd = crm_ipc_get_fd(native->ipc);
+            pcmk__ipc_accept_binary(native->ipc);
 
         } else if (native->ipc) {
             crm_perror(LOG_ERR, "Connection to cluster information base failed");
@@ -220,6 +228,10 @@ cib_native_signon_raw(cib_t * cib, const char *name, enum cib_conn_type type, in
             mainloop_add_ipc_client(channel, G_PRIORITY_HIGH, 512 * 1024 /* 512k */ , cib,
                                     &cib_callbacks);
         native->ipc = mainloop_get_ipc_client(native->source);
+        if (native->source != NULL) {
+            pcmk__mainloop_ipc_xml_dispatch(native->source,
+                                            cib_native_dispatch_xml);
+        }
     }
 
     if (rc != pcmk_ok || native->ipc == NULL || crm_ipc_connected(native->ipc) == FALSE) {
@@ -328,6 +340,65 @@ cib_native_perform_op(cib_t * cib, const char *op, const char *host, const char
                                           data, output_data, call_options, NULL);
 }
 
+/*!
+ * \internal
+ * \brief Answer a synchronous query from the published CIB snapshot
+ *
+ * \param[in]  cib           CIB connection query was made on
+ * \param[in]  section       Section of CIB to query (or NULL for all)
+ * \param[in]  call_options  Bitmask of cib_call_options for query
+ * \param[out] output_data   If not NULL, where to store query result
+ * \param[out] rc            Where to store query result code
+ *
+ * \return TRUE if the query was answered (successfully or not), FALSE if the
+ *         snapshot could not be used (so the CIB manager must be asked)
+ */
+static gboolean
+cib_native_query_snapshot(cib_t *cib, const char *section, int call_options,
+                          xmlNode **output_data, int *rc)
+{
+    cib_native_opaque_t *native = cib->variant_opaque;
+    xmlNode *request = NULL;
+    xmlNode *snapshot = NULL;
+    xmlNode *output = NULL;
+    xmlNode *result_cib = NULL;
+    gboolean changed = FALSE;
+    int snapshot_rc = pcmk__cib_snapshot_read(PCMK__CIB_SNAPSHOT_DIR,
+                                              &snapshot);
+
+    if (snapshot_rc != pcmk_ok) {
+        crm_trace("Querying the CIB manager instead of CIB snapshot: %s",
+                  pcmk_strerror(snapshot_rc));
+        return FALSE;
+    }
+
+    request = cib_create_op(cib->call_id, native->token, CIB_OP_QUERY, NULL,
+                            section, NULL, call_options, NULL);
+    if (request == NULL) {
+        free_xml(snapshot);
+        return FALSE;
+    }
+    *rc = cib_perform_op(CIB_OP_QUERY, call_options, cib_process_query, TRUE,
+                         section, request, NULL, FALSE, &changed, snapshot,
+                         &result_cib, NULL, &output);
+    free_xml(request);
+    free_xml(result_cib);
+    crm_trace("Answered query from CIB snapshot: %s", pcmk_strerror(*rc));
+
+    if ((output_data != NULL) && (output != NULL)
+        && is_not_set(call_options, cib_discard_reply)) {
+        *output_data = output;
+        if (output == snapshot) {
+            snapshot = NULL;
+        }
+
+    } else if (output != snapshot) {
+        free_xml(output);
+    }
+    free_xml(snapshot);
+    return TRUE;
+}
+
 int
 cib_native_perform_op_delegate(cib_t * cib, const char *op, const char *host, const char *section,
                                xmlNode * data, xmlNode ** output_data, int call_options,
@@ -355,6 +426,17 @@ cib_native_perform_op_delegate(cib_t * cib, const char *op, const char *host, co
         return -EINVAL;
     }
 
+    /* Local readers can skip the round trip. Queries for another node, or on
+     * behalf of another user (whose ACLs would apply), still need the CIB
+     * manager.
+     */
+    if (safe_str_eq(op, CIB_OP_QUERY) && (host == NULL) && (user_name == NULL)
+        && is_set(call_options, cib_sync_call)
+        && cib_native_query_snapshot(cib, section, call_options, output_data,
+                                     &rc)) {
+        return rc;
+    }
+
     if (call_options & cib_sync_call) {
         ipc_flags |= crm_ipc_client_response;
     }
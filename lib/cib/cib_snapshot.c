@@ -0,0 +1,401 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/cib/internal.h>
+
+/* CIB snapshots for local readers (see PCMK__CIB_SNAPSHOT) */
+
+/*!
+ * \internal
+ * \brief Create and map a CIB snapshot version file, for publishing
+ *
+ * \param[in] directory  Directory to publish snapshots in
+ *
+ * \return Mapped version file (or NULL with errno set on error)
+ * \note Any snapshot previously published in \p directory is removed. The
+ *       caller should release the result with pcmk__cib_snapshot_unpublish().
+ */
+struct pcmk__cib_version_s *
+pcmk__cib_snapshot_init(const char *directory)
+{
+    char *path = crm_strdup_printf("%s/%s", directory,
+                                   PCMK__CIB_SNAPSHOT_VERSION);
+    struct pcmk__cib_version_s *version = NULL;
+    void *map = MAP_FAILED;
+    int fd = open(path, O_RDWR|O_CREAT, S_IRUSR|S_IWUSR);
+    int rc = 0;
+
+    if ((fd < 0)
+        || (ftruncate(fd, sizeof(struct pcmk__cib_version_s)) < 0)
+        || ((map = mmap(NULL, sizeof(struct pcmk__cib_version_s),
+                        PROT_READ|PROT_WRITE, MAP_SHARED, fd,
+                        0)) == MAP_FAILED)) {
+        rc = errno;
+        if (fd >= 0) {
+            close(fd);
+            unlink(path);
+        }
+        free(path);
+        errno = rc;
+        return NULL;
+    }
+    close(fd);
+    free(path);
+
+    // Anything left by a previous instance is stale
+    path = crm_strdup_printf("%s/%s", directory, PCMK__CIB_SNAPSHOT);
+    unlink(path);
+    free(path);
+
+    version = map;
+    version->seq = 0;
+    version->serial = 0;
+    version->pid = (uint32_t) getpid();
+    version->wanted = 0;
+    __sync_synchronize();
+    version->magic = PCMK__CIB_SNAPSHOT_MAGIC;
+    return version;
+}
+
+/*!
+ * \internal
+ * \brief Tell local readers that the CIB changed since the last snapshot
+ *
+ * \param[in,out] version  Mapped version file
+ * \param[in]     cib      CIB as it is now
+ */
+void
+pcmk__cib_snapshot_changed(struct pcmk__cib_version_s *version, xmlNode *cib)
+{
+    int admin_epoch = 0;
+    int epoch = 0;
+    int num_updates = 0;
+
+    crm_element_value_int(cib, XML_ATTR_GENERATION_ADMIN, &admin_epoch);
+    crm_element_value_int(cib, XML_ATTR_GENERATION, &epoch);
+    crm_element_value_int(cib, XML_ATTR_NUMUPDATES, &num_updates);
+
+    // Readers retry if seq is odd or changes while they read
+    version->seq++;
+    __sync_synchronize();
+    version->serial++;
+    version->admin_epoch = admin_epoch;
+    version->epoch = epoch;
+    version->num_updates = num_updates;
+    __sync_synchronize();
+    version->seq++;
+}
+
+/*!
+ * \internal
+ * \brief Check whether a local reader asked for a new snapshot, and reset
+ *
+ * \param[in,out] version  Mapped version file
+ *
+ * \return TRUE if a reader found no current snapshot since the last check,
+ *         otherwise FALSE
+ */
+gboolean
+pcmk__cib_snapshot_wanted(struct pcmk__cib_version_s *version)
+{
+    return __sync_fetch_and_and(&(version->wanted), 0) != 0;
+}
+
+/*!
+ * \internal
+ * \brief Write a buffer to a file descriptor in full
+ *
+ * \param[in] fd      File descriptor to write to
+ * \param[in] buffer  Data to write
+ * \param[in] len     Number of bytes to write
+ *
+ * \return pcmk_ok on success, otherwise -errno
+ */
+static int
+write_all(int fd, const char *buffer, size_t len)
+{
+    while (len > 0) {
+        ssize_t rc = write(fd, buffer, len);
+
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        buffer += rc;
+        len -= rc;
+    }
+    return pcmk_ok;
+}
+
+/*!
+ * \internal
+ * \brief Write the CIB to a new snapshot and rename it into place
+ *
+ * \param[in] directory  Directory to publish snapshot in
+ * \param[in] version    Mapped version file
+ * \param[in] cib        CIB to publish
+ *
+ * \return pcmk_ok on success, otherwise -errno
+ */
+int
+pcmk__cib_snapshot_publish(const char *directory,
+                           const struct pcmk__cib_version_s *version,
+                           xmlNode *cib)
+{
+    struct pcmk__cib_snapshot_s header;
+    char *path = crm_strdup_printf("%s/%s", directory, PCMK__CIB_SNAPSHOT);
+    char *tmp = crm_strdup_printf("%s.XXXXXX", path);
+    char *text = NULL;
+    int fd = -1;
+    int rc = pcmk_ok;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = PCMK__CIB_SNAPSHOT_MAGIC;
+    header.pid = version->pid;
+    header.serial = version->serial;
+    header.admin_epoch = version->admin_epoch;
+    header.epoch = version->epoch;
+    header.num_updates = version->num_updates;
+
+    text = dump_xml_unformatted(cib);
+    header.size = strlen(text) + 1;
+
+    // mkstemp() creates the file readable only by us (and root)
+    fd = mkstemp(tmp);
+    if (fd < 0) {
+        rc = -errno;
+    } else {
+        rc = write_all(fd, (const char *) &header, sizeof(header));
+        if (rc == pcmk_ok) {
+            rc = write_all(fd, text, header.size);
+        }
+        close(fd);
+        if ((rc == pcmk_ok) && (rename(tmp, path) < 0)) {
+            rc = -errno;
+        }
+        if (rc != pcmk_ok) {
+            unlink(tmp);
+        }
+    }
+
+    if (rc == pcmk_ok) {
+        crm_trace("Published snapshot of CIB %d.%d.%d (%u bytes)",
+                  header.admin_epoch, header.epoch, header.num_updates,
+                  header.size);
+    }
+    free(text);
+    free(tmp);
+    free(path);
+    return rc;
+}
+
+/*!
+ * \internal
+ * \brief Stop publishing CIB snapshots, and remove any published
+ *
+ * \param[in] directory  Directory snapshots were published in
+ * \param[in] version    Mapped version file (which will be unmapped)
+ */
+void
+pcmk__cib_snapshot_unpublish(const char *directory,
+                             struct pcmk__cib_version_s *version)
+{
+    char *path = crm_strdup_printf("%s/%s", directory, PCMK__CIB_SNAPSHOT);
+
+    unlink(path);
+    free(path);
+    path = crm_strdup_printf("%s/%s", directory, PCMK__CIB_SNAPSHOT_VERSION);
+    unlink(path);
+    free(path);
+    munmap(version, sizeof(struct pcmk__cib_version_s));
+}
+
+/*!
+ * \internal
+ * \brief Read a CIB snapshot version file
+ *
+ * \param[in]  directory  Directory snapshots are published in
+ * \param[out] version    Where to store the current version details
+ *
+ * \return pcmk_ok on success, otherwise -errno
+ */
+static int
+read_version(const char *directory, struct pcmk__cib_version_s *version)
+{
+    volatile struct pcmk__cib_version_s *map = NULL;
+    struct stat sb;
+    char *path = crm_strdup_printf("%s/%s", directory,
+                                   PCMK__CIB_SNAPSHOT_VERSION);
+    int fd = open(path, O_RDONLY);
+    int rc = -EAGAIN;
+
+    free(path);
+    if (fd < 0) {
+        return -errno;
+    }
+    if ((fstat(fd, &sb) < 0) || (sb.st_size < sizeof(*version))) {
+        // The CIB manager might be creating it
+        close(fd);
+        return -ENODATA;
+    }
+    map = mmap(NULL, sizeof(*version), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -errno;
+    }
+
+    // The CIB manager makes seq odd while it updates the rest
+    for (int lpc = 0; (rc == -EAGAIN) && (lpc < 100); lpc++) {
+        uint32_t seq = map->seq;
+
+        __sync_synchronize();
+        memcpy(version, (const void *) map, sizeof(*version));
+        __sync_synchronize();
+        if (((seq % 2) == 0) && (seq == map->seq)) {
+            rc = pcmk_ok;
+        }
+    }
+    munmap((void *) map, sizeof(*version));
+
+    if ((rc == pcmk_ok) && (version->magic != PCMK__CIB_SNAPSHOT_MAGIC)) {
+        rc = -EPROTO;
+    }
+    return rc;
+}
+
+/*!
+ * \internal
+ * \brief Ask the CIB manager to publish a new snapshot
+ *
+ * \param[in] directory  Directory snapshots are published in
+ */
+static void
+request_snapshot(const char *directory)
+{
+    struct pcmk__cib_version_s *map = NULL;
+    char *path = crm_strdup_printf("%s/%s", directory,
+                                   PCMK__CIB_SNAPSHOT_VERSION);
+    int fd = open(path, O_RDWR);
+
+    free(path);
+    if (fd < 0) {
+        return;
+    }
+    map = mmap(NULL, sizeof(*map), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return;
+    }
+    if (map->magic == PCMK__CIB_SNAPSHOT_MAGIC) {
+        __sync_fetch_and_or(&(map->wanted), 1);
+    }
+    munmap(map, sizeof(*map));
+}
+
+/*!
+ * \internal
+ * \brief Parse the CIB snapshot published by the CIB manager, if current
+ *
+ * \param[in]  directory  Directory snapshots are published in
+ * \param[out] cib        Where to store parsed snapshot (caller must free)
+ *
+ * \return pcmk_ok on success, -ESTALE if the CIB has changed since the
+ *         snapshot was published, otherwise another -errno
+ * \note If the CIB manager is publishing snapshots but none is current, this
+ *       asks it for one, which it will publish when the caller's query
+ *       reaches it.
+ */
+int
+pcmk__cib_snapshot_read(const char *directory, xmlNode **cib)
+{
+    struct pcmk__cib_version_s current;
+    const struct pcmk__cib_snapshot_s *header = NULL;
+    const char *text = NULL;
+    char *path = NULL;
+    struct stat sb;
+    void *map = MAP_FAILED;
+    int fd = -1;
+    int rc = read_version(directory, &current);
+
+    *cib = NULL;
+    if (rc != pcmk_ok) {
+        return rc;
+
+    } else if (crm_pid_active(current.pid, NULL) != 1) {
+        // Left behind by a CIB manager that did not exit cleanly
+        return -ESRCH;
+    }
+
+    path = crm_strdup_printf("%s/%s", directory, PCMK__CIB_SNAPSHOT);
+    fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0) {
+        rc = -errno;
+        if (rc == -ENOENT) {
+            // Nothing has been published since the CIB manager started
+            request_snapshot(directory);
+        }
+        return rc;
+    }
+    if (fstat(fd, &sb) < 0) {
+        rc = -errno;
+        close(fd);
+        return rc;
+    } else if (sb.st_size <= sizeof(*header)) {
+        close(fd);
+        return -EPROTO;
+    }
+
+    // Published snapshots are never modified, so no locking is needed
+    map = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -errno;
+    }
+    header = map;
+    text = (const char *) map + sizeof(*header);
+
+    if ((header->magic != PCMK__CIB_SNAPSHOT_MAGIC) || (header->size == 0)
+        || (header->size > (sb.st_size - sizeof(*header)))
+        || (text[header->size - 1] != '\0')) {
+        rc = -EPROTO;
+
+    } else if ((header->pid != current.pid)
+               || (header->serial != current.serial)) {
+        crm_trace("CIB snapshot %d.%d.%d is stale (CIB is now %d.%d.%d)",
+                  header->admin_epoch, header->epoch, header->num_updates,
+                  current.admin_epoch, current.epoch, current.num_updates);
+        request_snapshot(directory);
+        rc = -ESTALE;
+
+    } else {
+        *cib = string2xml(text);
+        rc = (*cib == NULL)? -EPROTO : pcmk_ok;
+    }
+    munmap(map, sb.st_size);
+    return rc;
+}
@@ -240,7 +240,8 @@ cib_perform_op(const char *op, int call_options, cib_op_t * fn, gboolean is_quer
         xmlNode *cib_filtered = NULL;
 
         if(cib_acl_enabled(cib_ro, user)) {
-            if(xml_acl_filtered_copy(user, current_cib, current_cib, &cib_filtered)) {
+            if (pcmk__acl_filtered_view(user, current_cib, current_cib,
+                                        &cib_filtered)) {
                 if (cib_filtered == NULL) {
                     crm_debug("Pre-filtered the entire cib");
                     return -EACCES;
@@ -255,14 +256,11 @@ cib_perform_op(const char *op, int call_options, cib_op_t * fn, gboolean is_quer
         if(output == NULL || *output == NULL) {
             /* nothing */
 
-        } else if(cib_filtered == *output) {
-            cib_filtered = NULL; /* Let them have this copy */
-
         } else if(*output == current_cib) {
             /* They already know not to free it */
 
         } else if(cib_filtered && (*output)->doc == cib_filtered->doc) {
-            /* We're about to free the document of which *output is a part */
+            /* The filtered view is cached for reuse, so give them a copy */
             *output = copy_xml(*output);
 
         } else if((*output)->doc == current_cib->doc) {
@@ -270,7 +268,6 @@ cib_perform_op(const char *op, int call_options, cib_op_t * fn, gboolean is_quer
             *output = copy_xml(*output);
         }
 
-        free_xml(cib_filtered);
         return rc;
     }
 
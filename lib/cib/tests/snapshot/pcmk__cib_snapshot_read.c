@@ -0,0 +1,208 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/cib/internal.h>
+
+#define TEST_ATTR "test-value"
+
+static char *
+make_directory(void)
+{
+    char *directory = crm_strdup_printf("%s/pcmk-snapshot-XXXXXX",
+                                        (getenv("TMPDIR")? getenv("TMPDIR") : "/tmp"));
+
+    g_assert(mkdtemp(directory) != NULL);
+    return directory;
+}
+
+static void
+remove_directory(char *directory)
+{
+    g_assert_cmpint(rmdir(directory), ==, 0);
+    free(directory);
+}
+
+static xmlNode *
+make_cib(void)
+{
+    xmlNode *cib = create_xml_node(NULL, XML_TAG_CIB);
+    xmlNode *node_state = NULL;
+
+    crm_xml_add_int(cib, XML_ATTR_GENERATION_ADMIN, 0);
+    crm_xml_add_int(cib, XML_ATTR_GENERATION, 1);
+    crm_xml_add_int(cib, XML_ATTR_NUMUPDATES, 1);
+    create_xml_node(create_xml_node(cib, XML_CIB_TAG_CONFIGURATION),
+                    XML_CIB_TAG_NODES);
+    node_state = create_xml_node(create_xml_node(cib, XML_CIB_TAG_STATUS),
+                                 XML_CIB_TAG_STATE);
+    crm_xml_add(node_state, XML_ATTR_ID, "1");
+    crm_xml_add_int(node_state, TEST_ATTR, 1);
+    return cib;
+}
+
+// Update the status section in place, as the CIB manager does (zero-copy)
+static void
+update_status(xmlNode *cib, int value)
+{
+    xmlNode *node_state = get_xpath_object("//" XML_CIB_TAG_STATE, cib,
+                                           LOG_DEBUG);
+    int num_updates = 0;
+
+    g_assert(node_state != NULL);
+    crm_xml_add_int(node_state, TEST_ATTR, value);
+    crm_element_value_int(cib, XML_ATTR_NUMUPDATES, &num_updates);
+    crm_xml_add_int(cib, XML_ATTR_NUMUPDATES, num_updates + 1);
+}
+
+// Query the published snapshot, as a local reader would
+static int
+query_value(const char *directory, int *value)
+{
+    xmlNode *cib = NULL;
+    xmlNode *node_state = NULL;
+    int rc = pcmk__cib_snapshot_read(directory, &cib);
+
+    *value = -1;
+    if (rc == pcmk_ok) {
+        g_assert(cib != NULL);
+        node_state = get_xpath_object("//" XML_CIB_TAG_STATE, cib, LOG_DEBUG);
+        g_assert(node_state != NULL);
+        crm_element_value_int(node_state, TEST_ATTR, value);
+        free_xml(cib);
+    } else {
+        g_assert(cib == NULL);
+    }
+    return rc;
+}
+
+static void
+publish_and_read(void)
+{
+    char *directory = make_directory();
+    struct pcmk__cib_version_s *version = pcmk__cib_snapshot_init(directory);
+    xmlNode *cib = make_cib();
+    int value = 0;
+
+    g_assert(version != NULL);
+
+    // Nothing is published until the first snapshot is written
+    g_assert_cmpint(query_value(directory, &value), ==, -ENOENT);
+
+    pcmk__cib_snapshot_changed(version, cib);
+    g_assert_cmpint(pcmk__cib_snapshot_publish(directory, version, cib),
+                    ==, pcmk_ok);
+    g_assert_cmpint(query_value(directory, &value), ==, pcmk_ok);
+    g_assert_cmpint(value, ==, 1);
+
+    pcmk__cib_snapshot_unpublish(directory, version);
+    g_assert_cmpint(query_value(directory, &value), ==, -ENOENT);
+    free_xml(cib);
+    remove_directory(directory);
+}
+
+static void
+status_update(void)
+{
+    char *directory = make_directory();
+    struct pcmk__cib_version_s *version = pcmk__cib_snapshot_init(directory);
+    xmlNode *cib = make_cib();
+    int value = 0;
+
+    g_assert(version != NULL);
+    pcmk__cib_snapshot_changed(version, cib);
+    g_assert_cmpint(pcmk__cib_snapshot_publish(directory, version, cib),
+                    ==, pcmk_ok);
+
+    /* Right after a status update, the old snapshot must not be used, so
+     * that the reader asks the CIB manager (and gets the new value) instead
+     */
+    update_status(cib, 2);
+    pcmk__cib_snapshot_changed(version, cib);
+    g_assert_cmpint(query_value(directory, &value), ==, -ESTALE);
+
+    // Once the next snapshot is published, the reader gets the new value
+    g_assert_cmpint(pcmk__cib_snapshot_publish(directory, version, cib),
+                    ==, pcmk_ok);
+    g_assert_cmpint(query_value(directory, &value), ==, pcmk_ok);
+    g_assert_cmpint(value, ==, 2);
+
+    // Several updates before a publish are coalesced into one snapshot
+    update_status(cib, 3);
+    pcmk__cib_snapshot_changed(version, cib);
+    update_status(cib, 4);
+    pcmk__cib_snapshot_changed(version, cib);
+    g_assert_cmpint(query_value(directory, &value), ==, -ESTALE);
+    g_assert_cmpint(pcmk__cib_snapshot_publish(directory, version, cib),
+                    ==, pcmk_ok);
+    g_assert_cmpint(query_value(directory, &value), ==, pcmk_ok);
+    g_assert_cmpint(value, ==, 4);
+
+    pcmk__cib_snapshot_unpublish(directory, version);
+    free_xml(cib);
+    remove_directory(directory);
+}
+
+static void
+on_demand(void)
+{
+    char *directory = make_directory();
+    struct pcmk__cib_version_s *version = pcmk__cib_snapshot_init(directory);
+    xmlNode *cib = make_cib();
+    int value = 0;
+
+    g_assert(version != NULL);
+    pcmk__cib_snapshot_changed(version, cib);
+    g_assert(!pcmk__cib_snapshot_wanted(version));
+
+    // A reader that finds nothing published asks for a snapshot
+    g_assert_cmpint(query_value(directory, &value), ==, -ENOENT);
+    g_assert(pcmk__cib_snapshot_wanted(version));
+    g_assert(!pcmk__cib_snapshot_wanted(version));
+
+    // A reader that finds a current snapshot does not
+    g_assert_cmpint(pcmk__cib_snapshot_publish(directory, version, cib),
+                    ==, pcmk_ok);
+    g_assert_cmpint(query_value(directory, &value), ==, pcmk_ok);
+    g_assert(!pcmk__cib_snapshot_wanted(version));
+
+    // Changes alone ask for nothing, until a reader finds the snapshot stale
+    update_status(cib, 2);
+    pcmk__cib_snapshot_changed(version, cib);
+    g_assert(!pcmk__cib_snapshot_wanted(version));
+    g_assert_cmpint(query_value(directory, &value), ==, -ESTALE);
+    g_assert_cmpint(query_value(directory, &value), ==, -ESTALE);
+    g_assert(pcmk__cib_snapshot_wanted(version));
+    g_assert(!pcmk__cib_snapshot_wanted(version));
+
+    pcmk__cib_snapshot_unpublish(directory, version);
+    free_xml(cib);
+    remove_directory(directory);
+}
+
+int
+main(int argc, char **argv)
+{
+    crm_xml_init();
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/cib/snapshot/publish_and_read", publish_and_read);
+    g_test_add_func("/cib/snapshot/status_update", status_update);
+    g_test_add_func("/cib/snapshot/on_demand", on_demand);
+    return g_test_run();
+}
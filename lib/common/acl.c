@@ -15,12 +15,14 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <time.h>
 
 #include <libxml/tree.h>
 
 #include <crm/crm.h>
 #include <crm/msg_xml.h>
 #include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
 #include "crmcommon_private.h"
 
 #define MAX_XPATH_LEN	4096
@@ -47,6 +49,87 @@ pcmk__free_acls(GList *acls)
     g_list_free_full(acls, __xml_acl_free);
 }
 
+/* ACL-filtered views of XML, indexed by user name
+ *
+ * Filtering means copying the XML and evaluating every ACL rule against it,
+ * which is expensive for a large CIB. ACL-restricted users (for example,
+ * monitoring accounts running crm_mon) tend to repeatedly query a CIB that
+ * has not changed in the meantime, so each user's most recent view is kept
+ * and reused for as long as both the XML and the ACLs it was filtered with
+ * are unchanged.
+ *
+ * That is checked cheaply, without a digest: the XML must have the same CIB
+ * version (if any), and be in the same document, with no nodes created in or
+ * freed from it since. The document check catches updates made in place
+ * without bumping the version (such as with cib_inhibit_bcast). Views are kept
+ * for at most ACL_VIEWS_MAX users, and dropped once unused for
+ * ACL_VIEW_MAX_IDLE.
+ */
+#define ACL_VIEWS_MAX       32
+#define ACL_VIEW_MAX_IDLE   300     // seconds
+
+// State of a document, as of when a view was filtered
+typedef struct acl_view_doc_s {
+    unsigned long long serial;      // Document (0 if unknown)
+    unsigned long long changes;     // Nodes created or freed in document
+} acl_view_doc_t;
+
+typedef struct acl_view_s {
+    acl_view_doc_t doc;         // Document of XML that view was filtered from
+    acl_view_doc_t acl_doc;     // Document of separate ACL source (if any)
+    int admin_epoch;            // CIB version of XML that view was filtered
+    int epoch;                  //  from (if any)
+    int num_updates;
+    xmlNode *filtered;  // Filtered copy of XML (NULL if entirely denied)
+    time_t last_used;   // When view was last returned
+} acl_view_t;
+
+static GHashTable *acl_views = NULL;
+
+static void
+free_acl_view(gpointer data)
+{
+    acl_view_t *view = data;
+
+    free_xml(view->filtered);
+    free(view);
+}
+
+/*!
+ * \internal
+ * \brief Free all cached ACL-filtered views
+ */
+void
+pcmk__free_acl_views(void)
+{
+    if (acl_views != NULL) {
+        g_hash_table_destroy(acl_views);
+        acl_views = NULL;
+    }
+}
+
+/*!
+ * \internal
+ * \brief Find the ACLs section of XML
+ *
+ * \param[in] source  XML with ACL definitions
+ *
+ * \return ACLs section of \p source if found, otherwise NULL
+ */
+static xmlNode *
+find_acls(xmlNode *source)
+{
+    if ((source != NULL)
+        && crm_str_eq(crm_element_name(source), XML_TAG_CIB, TRUE)) {
+
+        // ACLs may only be configured here, so don't search the whole CIB
+        return first_named_child(first_named_child(source,
+                                                   XML_CIB_TAG_CONFIGURATION),
+                                 XML_CIB_TAG_ACLS);
+    }
+    return get_xpath_object("//" XML_CIB_TAG_ACLS, source, LOG_TRACE);
+}
+
 static GList *
 __xml_acl_create(xmlNode *xml, GList *acls, enum xml_private_flags mode)
 {
@@ -242,35 +325,38 @@ void
 pcmk__apply_acl(xmlNode *xml)
 {
     GListPtr aIter = NULL;
-    xml_private_t *p = xml->doc->_private;
+    xml_private_t *p = NULL;
+    xml_doc_private_t *docp = xml->doc->_private;
     xmlXPathObjectPtr xpathObj = NULL;
 
     if (xml_acl_enabled(xml) == FALSE) {
         crm_trace("Skipping ACLs for user '%s' because not enabled for this XML",
-                  p->user);
+                  docp->user);
         return;
     }
 
-    for (aIter = p->acls; aIter != NULL; aIter = aIter->next) {
+    for (aIter = docp->acls; aIter != NULL; aIter = aIter->next) {
         int max = 0, lpc = 0;
         xml_acl_t *acl = aIter->data;
 
-        xpathObj = xpath_search(xml, acl->xpath);
+        xpathObj = pcmk__xpath_search_with(xml, acl->xpath, NULL);
         max = numXpathResults(xpathObj);
 
         for (lpc = 0; lpc < max; lpc++) {
             xmlNode *match = getXpathResult(xpathObj, lpc);
-            char *path = xml_get_path(match);
 
             p = match->_private;
-            crm_trace("Applying %s ACL to %s matched by %s",
-                      __xml_acl_to_text(acl->mode), path, acl->xpath);
+            crm_trace("Applying %s ACL to <%s id=%s> matched by %s",
+                      __xml_acl_to_text(acl->mode), crm_element_name(match),
+                      crm_str(ID(match)), acl->xpath);
 
 #ifdef SUSE_ACL_COMPAT
             if (is_not_set(p->flags, acl->mode)
                 && (is_set(p->flags, xpf_acl_read)
                     || is_set(p->flags, xpf_acl_write)
                     || is_set(p->flags, xpf_acl_deny))) {
+                char *path = xml_get_path(match);
+
                 crm_config_warn("Configuration element %s is matched by "
                                 "multiple ACL rules, only the first applies "
                                 "('%s' wins over '%s')",
@@ -281,7 +367,6 @@ pcmk__apply_acl(xmlNode *xml)
             }
 #endif
             p->flags |= acl->mode;
-            free(path);
         }
         crm_trace("Applied %s ACL %s (%d match%s)",
                   __xml_acl_to_text(acl->mode), acl->xpath, max,
@@ -294,9 +379,8 @@ pcmk__apply_acl(xmlNode *xml)
         && is_not_set(p->flags, xpf_acl_write)) {
 
         p->flags |= xpf_acl_deny;
-        p = xml->doc->_private;
         crm_info("Applied default deny ACL for user '%s' to <%s>",
-                 p->user, crm_element_name(xml));
+                 docp->user, crm_element_name(xml));
     }
 
 }
@@ -313,7 +397,7 @@ void
 pcmk__unpack_acl(xmlNode *source, xmlNode *target, const char *user)
 {
 #if ENABLE_ACL
-    xml_private_t *p = NULL;
+    xml_doc_private_t *p = NULL;
 
     if ((target == NULL) || (target->doc == NULL)
         || (target->doc->_private == NULL)) {
@@ -326,8 +410,7 @@ pcmk__unpack_acl(xmlNode *source, xmlNode *target, const char *user)
                   user);
 
     } else if (p->acls == NULL) {
-        xmlNode *acls = get_xpath_object("//" XML_CIB_TAG_ACLS,
-                                         source, LOG_TRACE);
+        xmlNode *acls = find_acls(source);
 
         free(p->user);
         p->user = strdup(user);
@@ -440,7 +523,7 @@ xml_acl_filtered_copy(const char *user, xmlNode *acl_source, xmlNode *xml,
     GListPtr aIter = NULL;
     xmlNode *target = NULL;
     xml_private_t *p = NULL;
-    xml_private_t *doc = NULL;
+    xml_doc_private_t *doc = NULL;
 
     *result = NULL;
     if (xml == NULL || pcmk_acl_required(user) == FALSE) {
@@ -469,7 +552,9 @@ xml_acl_filtered_copy(const char *user, xmlNode *acl_source, xmlNode *xml,
 
         } else if (acl->xpath) {
             int lpc = 0;
-            xmlXPathObjectPtr xpathObj = xpath_search(target, acl->xpath);
+            xmlXPathObjectPtr xpathObj = pcmk__xpath_search_with(target,
+                                                                acl->xpath,
+                                                                NULL);
 
             max = numXpathResults(xpathObj);
             for(lpc = 0; lpc < max; lpc++) {
@@ -513,6 +598,161 @@ xml_acl_filtered_copy(const char *user, xmlNode *acl_source, xmlNode *xml,
     return TRUE;
 }
 
+/*!
+ * \internal
+ * \brief Get the current state of an XML node's document, for ACL views
+ *
+ * \param[in]  xml    XML node to check
+ * \param[out] state  Where to store document state
+ */
+static void
+acl_view_doc(xmlNode *xml, acl_view_doc_t *state)
+{
+    xmlDoc *doc = xml->doc;
+    xml_doc_private_t *docp = doc->_private;
+
+    // XSLT result tree fragments carry their own data in _private
+    if ((docp != NULL) && ((doc->name == NULL) || (doc->name[0] != ' '))) {
+        state->serial = docp->serial;
+        state->changes = docp->changes;
+    }
+}
+
+/*!
+ * \internal
+ * \brief Check whether a cached ACL view was filtered from the same XML
+ *
+ * \param[in] view  Cached view
+ * \param[in] key   Description of XML (and ACLs) to be filtered
+ *
+ * \return TRUE if \p view can be reused for \p key, otherwise FALSE
+ */
+static bool
+same_acl_view(const acl_view_t *view, const acl_view_t *key)
+{
+    return (key->doc.serial != 0)
+           && (key->doc.serial == view->doc.serial)
+           && (key->doc.changes == view->doc.changes)
+           && (key->acl_doc.serial == view->acl_doc.serial)
+           && (key->acl_doc.changes == view->acl_doc.changes)
+           && (key->admin_epoch == view->admin_epoch)
+           && (key->epoch == view->epoch)
+           && (key->num_updates == view->num_updates);
+}
+
+/*!
+ * \internal
+ * \brief Make room in the ACL view cache for another user
+ *
+ * Drop views that have been unused for ACL_VIEW_MAX_IDLE, and if the cache is
+ * still full, the least recently used view.
+ */
+static void
+prune_acl_views(void)
+{
+    GHashTableIter iter;
+    acl_view_t *view = NULL;
+    const char *oldest_user = NULL;
+    time_t oldest = 0;
+    time_t now = time(NULL);
+
+    g_hash_table_iter_init(&iter, acl_views);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &view)) {
+        if ((now - view->last_used) >= ACL_VIEW_MAX_IDLE) {
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+
+    if (g_hash_table_size(acl_views) < ACL_VIEWS_MAX) {
+        return;
+    }
+    g_hash_table_iter_init(&iter, acl_views);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &oldest_user,
+                                  (gpointer *) &view)) {
+        if ((oldest == 0) || (view->last_used < oldest)) {
+            oldest = view->last_used;
+        }
+    }
+    g_hash_table_iter_init(&iter, acl_views);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &oldest_user,
+                                  (gpointer *) &view)) {
+        if (view->last_used == oldest) {
+            crm_trace("Dropping ACL-filtered view of XML for user '%s'",
+                      oldest_user);
+            g_hash_table_iter_remove(&iter);
+            break;
+        }
+    }
+}
+
+/*!
+ * \internal
+ * \brief Get a read-only view of the ACL-allowed portions of XML
+ *
+ * This is like xml_acl_filtered_copy(), except that the result is owned by
+ * an internal cache, and reused by subsequent calls for the same user as long
+ * as \p xml and the ACLs are unchanged. If \p xml has a CIB version, it must
+ * be bumped whenever \p xml is modified in place.
+ *
+ * \param[in]  user        Username whose ACLs should be used
+ * \param[in]  acl_source  XML containing ACLs
+ * \param[in]  xml         XML to be filtered
+ * \param[out] result      Where to store view of XML portions readable via
+ *                         ACLs (or NULL if none)
+ *
+ * \return TRUE if xml exists and ACLs are required for user, otherwise FALSE
+ * \note The caller must not modify or free \p *result, which is only valid
+ *       until the next call for the same user (or pcmk__free_acl_views()).
+ */
+bool
+pcmk__acl_filtered_view(const char *user, xmlNode *acl_source, xmlNode *xml,
+                        xmlNode **result)
+{
+    acl_view_t key = { { 0, }, };
+    acl_view_t *view = NULL;
+
+    *result = NULL;
+    if ((xml == NULL) || (pcmk_acl_required(user) == FALSE)) {
+        crm_trace("Not filtering XML because ACLs not required for user '%s'",
+                  user);
+        return FALSE;
+    }
+
+    acl_view_doc(xml, &key.doc);
+    if ((acl_source != NULL) && (acl_source->doc != xml->doc)) {
+        acl_view_doc(acl_source, &key.acl_doc);
+    }
+    crm_element_value_int(xml, XML_ATTR_GENERATION_ADMIN, &key.admin_epoch);
+    crm_element_value_int(xml, XML_ATTR_GENERATION, &key.epoch);
+    crm_element_value_int(xml, XML_ATTR_NUMUPDATES, &key.num_updates);
+
+    if (acl_views == NULL) {
+        acl_views = g_hash_table_new_full(crm_str_hash, g_str_equal, free,
+                                          free_acl_view);
+    }
+
+    view = g_hash_table_lookup(acl_views, user);
+    if ((view != NULL) && same_acl_view(view, &key)) {
+        crm_trace("Reusing ACL-filtered view of XML for user '%s'", user);
+        view->last_used = time(NULL);
+        *result = view->filtered;
+        return TRUE;
+    }
+
+    if (view == NULL) {
+        prune_acl_views();
+    }
+    view = calloc(1, sizeof(acl_view_t));
+    CRM_ASSERT(view != NULL);
+    *view = key;
+    view->last_used = time(NULL);
+    xml_acl_filtered_copy(user, acl_source, xml, &(view->filtered));
+    g_hash_table_replace(acl_views, strdup(user), view);
+
+    *result = view->filtered;
+    return TRUE;
+}
+
 /*!
  * \internal
  * \brief Check whether creation of an XML element is implicitly allowed
@@ -643,7 +883,7 @@ pcmk__check_acl(xmlNode *xml, const char *name, enum xml_private_flags mode)
         int offset = 0;
         xmlNode *parent = xml;
         char buffer[MAX_XPATH_LEN];
-        xml_private_t *docp = xml->doc->_private;
+        xml_doc_private_t *docp = xml->doc->_private;
 
         offset = pcmk__element_xpath(NULL, xml, buffer, offset,
                                      sizeof(buffer));
@@ -36,13 +36,28 @@ enum xml_private_flags {
      xpf_lazy        = 0x4000,
 };
 
+/* Every element, attribute and comment has one of these, so keep it small;
+ * documents have the larger xml_doc_private_t, which starts with one
+ */
 typedef struct xml_private_s {
         long check;
         uint32_t flags;
+        struct xml_doc_private_s *id_doc;   // Elements only: document whose ID
+                                            //  index has (or will have) element
+} xml_private_t;
+
+typedef struct xml_doc_private_s {
+        xml_private_t node;
         char *user;
         GListPtr acls;
         GListPtr deleted_objs;
-} xml_private_t;
+        GHashTable *id_index;       // ID => element (if known)
+        GHashTable *id_elements;    // Element => ID it is indexed under
+        GHashTable *id_pending;     // Elements not yet indexed
+        GHashTable *id_dups;        // ID => elements sharing it
+        unsigned long long serial;  // Unique per document
+        unsigned long long changes; // Nodes created or freed
+} xml_doc_private_t;
 
 G_GNUC_INTERNAL
 void pcmk__set_xml_flag(xmlNode *xml, enum xml_private_flags flag);
@@ -50,6 +65,15 @@ void pcmk__set_xml_flag(xmlNode *xml, enum xml_private_flags flag);
 G_GNUC_INTERNAL
 bool pcmk__tracking_xml_changes(xmlNode *xml, bool lazy);
 
+G_GNUC_INTERNAL
+void pcmk__xpath_cleanup(void);
+
+G_GNUC_INTERNAL
+const char *pcmk__xml_escape_char(char c, char *octal);
+
+G_GNUC_INTERNAL
+bool pcmk__xml_attr_filtered(const char *name);
+
 G_GNUC_INTERNAL
 int pcmk__element_xpath(const char *prefix, xmlNode *xml, char *buffer,
                         int offset, size_t buffer_size);
@@ -57,6 +81,9 @@ int pcmk__element_xpath(const char *prefix, xmlNode *xml, char *buffer,
 G_GNUC_INTERNAL
 void pcmk__free_acls(GList *acls);
 
+G_GNUC_INTERNAL
+void pcmk__free_acl_views(void);
+
 G_GNUC_INTERNAL
 void pcmk__unpack_acl(xmlNode *source, xmlNode *target, const char *user);
 
@@ -23,31 +23,251 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include <md5.h>
+
 #include <crm/crm.h>
 #include <crm/msg_xml.h>
 #include <crm/common/xml.h>
+#include "crmcommon_private.h"
 
 #define BEST_EFFORT_STATUS 0
 
+/* The digests below are calculated by feeding the exact bytes crm_xml_dump()
+ * would produce (after sorted_xml(), for sorted digests) into the MD5 context
+ * while walking the tree, so neither the serialized string nor the sorted copy
+ * is ever created. The results must stay identical to those of older versions,
+ * which did create them, so that mixed-version clusters agree.
+ */
+
+static inline void
+digest_add(struct md5_ctx *ctx, const char *data, size_t len)
+{
+    md5_process_bytes(data, len, ctx);
+}
+
+static inline void
+digest_add_str(struct md5_ctx *ctx, const char *text)
+{
+    if (text != NULL) {
+        md5_process_bytes(text, strlen(text), ctx);
+    }
+}
+
 /*!
- * \brief Dump XML in a format used with v1 digests
+ * \internal
+ * \brief Add text to a digest, escaped as crm_xml_escape() would
  *
- * \param[in] an_xml_node Root of XML to dump
+ * \param[in,out] ctx   Digest context
+ * \param[in]     text  Text to add
+ */
+static void
+digest_add_escaped(struct md5_ctx *ctx, const char *text)
+{
+    char octal[16];
+    const char *start = text;
+    const char *c = text;
+
+    for (; *c != '\0'; c++) {
+        const char *replace = pcmk__xml_escape_char(*c, octal);
+
+        if (replace != NULL) {
+            digest_add(ctx, start, c - start);
+            digest_add_str(ctx, replace);
+            start = c + 1;
+        }
+    }
+    digest_add(ctx, start, c - start);
+}
+
+/*!
+ * \internal
+ * \brief Add an attribute to a digest, formatted as crm_xml_dump() would
  *
- * \return Newly allocated buffer containing dumped XML
+ * \param[in,out] ctx    Digest context
+ * \param[in]     name   Attribute name
+ * \param[in]     value  Attribute value
  */
-static char *
-dump_xml_for_digest(xmlNode * an_xml_node)
+static void
+digest_add_attr(struct md5_ctx *ctx, const char *name, const char *value)
 {
-    char *buffer = NULL;
-    int offset = 0, max = 0;
+    digest_add(ctx, " ", 1);
+    digest_add_str(ctx, name);
+    digest_add(ctx, "=\"", 2);
+    digest_add_escaped(ctx, value);
+    digest_add(ctx, "\"", 1);
+}
 
-    /* for compatibility with the old result which is used for v1 digests */
-    crm_buffer_add_char(&buffer, &offset, &max, ' ');
-    crm_xml_dump(an_xml_node, 0, &buffer, &offset, &max, 0);
-    crm_buffer_add_char(&buffer, &offset, &max, '\n');
+/*!
+ * \internal
+ * \brief Add XML to a digest, formatted as crm_xml_dump() would
+ *
+ * \param[in,out] ctx       Digest context
+ * \param[in]     xml       XML to add
+ * \param[in]     filtered  Whether to skip attributes that
+ *                          xml_log_option_filtered would skip
+ */
+static void
+digest_add_xml(struct md5_ctx *ctx, xmlNode *xml, bool filtered)
+{
+    switch (xml->type) {
+        case XML_ELEMENT_NODE:
+            {
+                const char *name = crm_element_name(xml);
+
+                CRM_ASSERT(name != NULL);
+                digest_add(ctx, "<", 1);
+                digest_add_str(ctx, name);
+
+                for (xmlAttr *attr = xml->properties; attr != NULL;
+                     attr = attr->next) {
+
+                    xml_private_t *p = attr->_private;
+
+                    if ((attr->children == NULL)
+                        || (p && is_set(p->flags, xpf_deleted))
+                        || (filtered && pcmk__xml_attr_filtered((const char *)
+                                                                attr->name))) {
+                        continue;
+                    }
+                    digest_add_attr(ctx, (const char *) attr->name,
+                                    (const char *) attr->children->content);
+                }
+
+                if (xml->children == NULL) {
+                    digest_add(ctx, "/>", 2);
 
-    return buffer;
+                } else {
+                    digest_add(ctx, ">", 1);
+                    for (xmlNode *child = xml->children; child != NULL;
+                         child = child->next) {
+                        digest_add_xml(ctx, child, filtered);
+                    }
+                    digest_add(ctx, "</", 2);
+                    digest_add_str(ctx, name);
+                    digest_add(ctx, ">", 1);
+                }
+            }
+            break;
+
+        case XML_COMMENT_NODE:
+            digest_add(ctx, "<!--", 4);
+            digest_add_str(ctx, (const char *) xml->content);
+            digest_add(ctx, "-->", 3);
+            break;
+
+        case XML_CDATA_SECTION_NODE:
+            digest_add(ctx, "<![CDATA[", 9);
+            digest_add_str(ctx, (const char *) xml->content);
+            digest_add(ctx, "]]>", 3);
+            break;
+
+        default:
+            // Text is not dumped, and crm_xml_dump() skips anything else
+            break;
+    }
+}
+
+static int
+compare_attr_names(const void *a, const void *b)
+{
+    const xmlAttr *attr_a = *(const xmlAttr **) a;
+    const xmlAttr *attr_b = *(const xmlAttr **) b;
+
+    return strcmp((const char *) attr_a->name, (const char *) attr_b->name);
+}
+
+/*!
+ * \internal
+ * \brief Add XML to a digest, formatted as crm_xml_dump() of sorted_xml() would
+ *
+ * sorted_xml() turns every named non-text node into an element with the same
+ * name, copying only attributes that have a value (regardless of whether they
+ * are marked deleted), in name order. Nodes without a name are dropped.
+ *
+ * \param[in,out] ctx  Digest context
+ * \param[in]     xml  XML to add (must have a name)
+ */
+static void
+digest_add_sorted_xml(struct md5_ctx *ctx, xmlNode *xml)
+{
+    int lpc = 0;
+    int count = 0;
+    bool has_children = FALSE;
+    xmlAttr **attrs = NULL;
+    const char *name = crm_element_name(xml);
+
+    digest_add(ctx, "<", 1);
+    digest_add_str(ctx, name);
+
+    for (xmlAttr *attr = xml->properties; attr != NULL; attr = attr->next) {
+        if ((attr->children != NULL) && (attr->children->content != NULL)) {
+            count++;
+        }
+    }
+    if (count > 0) {
+        attrs = calloc(count, sizeof(xmlAttr *));
+        CRM_ASSERT(attrs != NULL);
+
+        for (xmlAttr *attr = xml->properties; attr != NULL; attr = attr->next) {
+            if ((attr->children != NULL) && (attr->children->content != NULL)) {
+                attrs[lpc++] = attr;
+            }
+        }
+        qsort(attrs, count, sizeof(xmlAttr *), compare_attr_names);
+
+        for (lpc = 0; lpc < count; lpc++) {
+            digest_add_attr(ctx, (const char *) attrs[lpc]->name,
+                            (const char *) attrs[lpc]->children->content);
+        }
+        free(attrs);
+    }
+
+    for (xmlNode *child = __xml_first_child(xml); child != NULL;
+         child = __xml_next(child)) {
+        if (child->name != NULL) {
+            has_children = TRUE;
+            break;
+        }
+    }
+
+    if (has_children == FALSE) {
+        digest_add(ctx, "/>", 2);
+        return;
+    }
+
+    digest_add(ctx, ">", 1);
+    for (xmlNode *child = __xml_first_child(xml); child != NULL;
+         child = __xml_next(child)) {
+        if (child->name != NULL) {
+            digest_add_sorted_xml(ctx, child);
+        }
+    }
+    digest_add(ctx, "</", 2);
+    digest_add_str(ctx, name);
+    digest_add(ctx, ">", 1);
+}
+
+/*!
+ * \internal
+ * \brief Finish a digest and format it as a hex string
+ *
+ * \param[in,out] ctx  Digest context
+ *
+ * \return Newly allocated string containing digest
+ */
+static char *
+digest_finish(struct md5_ctx *ctx)
+{
+    unsigned char raw_digest[MD5_DIGEST_SIZE];
+    char *digest = malloc(2 * MD5_DIGEST_SIZE + 1);
+
+    CRM_ASSERT(digest != NULL);
+    md5_finish_ctx(ctx, raw_digest);
+    for (int lpc = 0; lpc < MD5_DIGEST_SIZE; lpc++) {
+        sprintf(digest + (2 * lpc), "%02x", raw_digest[lpc]);
+    }
+    digest[(2 * MD5_DIGEST_SIZE)] = 0;
+    return digest;
 }
 
 /*!
@@ -64,26 +284,29 @@ static char *
 calculate_xml_digest_v1(xmlNode * input, gboolean sort, gboolean ignored)
 {
     char *digest = NULL;
-    char *buffer = NULL;
-    xmlNode *copy = NULL;
+    struct md5_ctx ctx;
 
-    if (sort) {
-        crm_trace("Sorting xml...");
-        copy = sorted_xml(input, NULL, TRUE);
-        crm_trace("Done");
-        input = copy;
-    }
+    md5_init_ctx(&ctx);
 
-    buffer = dump_xml_for_digest(input);
-    CRM_CHECK(buffer != NULL && strlen(buffer) > 0, free_xml(copy);
-              free(buffer);
-              return NULL);
+    /* for compatibility with the old result which is used for v1 digests */
+    digest_add(&ctx, " ", 1);
 
-    digest = crm_md5sum(buffer);
-    crm_log_xml_trace(input, "digest:source");
+    if ((input == NULL) || (sort && (input->name == NULL))) {
+        /* Older versions reset the buffer when there was nothing to dump,
+         * dropping the leading space
+         */
+        md5_init_ctx(&ctx);
 
-    free(buffer);
-    free_xml(copy);
+    } else if (sort) {
+        digest_add_sorted_xml(&ctx, input);
+
+    } else {
+        digest_add_xml(&ctx, input, FALSE);
+    }
+    digest_add(&ctx, "\n", 1);
+
+    digest = digest_finish(&ctx);
+    crm_log_xml_trace(input, "digest:source");
     return digest;
 }
 
@@ -99,12 +322,12 @@ static char *
 calculate_xml_digest_v2(xmlNode * source, gboolean do_filter)
 {
     char *digest = NULL;
-    char *buffer = NULL;
-    int offset, max;
+    struct md5_ctx ctx;
 
     static struct qb_log_callsite *digest_cs = NULL;
 
     crm_trace("Begin digest %s", do_filter?"filtered":"");
+    md5_init_ctx(&ctx);
     if (do_filter && BEST_EFFORT_STATUS) {
         /* Exclude the status calculation from the digest
          *
@@ -119,11 +342,11 @@ calculate_xml_digest_v2(xmlNode * source, gboolean do_filter)
          */
 
     } else {
-        crm_xml_dump(source, do_filter ? xml_log_option_filtered : 0, &buffer, &offset, &max, 0);
+        CRM_ASSERT(source != NULL);
+        digest_add_xml(&ctx, source, do_filter);
     }
 
-    CRM_ASSERT(buffer != NULL);
-    digest = crm_md5sum(buffer);
+    digest = digest_finish(&ctx);
 
     if (digest_cs == NULL) {
         digest_cs = qb_log_callsite_get(__func__, __FILE__, "cib-digest", LOG_TRACE, __LINE__,
@@ -141,7 +364,6 @@ calculate_xml_digest_v2(xmlNode * source, gboolean do_filter)
         free(trace_file);
     }
 
-    free(buffer);
     crm_trace("End digest");
     return digest;
 }
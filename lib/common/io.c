@@ -27,6 +27,7 @@
 #include <grp.h>
 
 #include <crm/crm.h>
+#include <crm/msg_xml.h>
 #include <crm/common/util.h>
 
 /*!
@@ -227,6 +228,440 @@ crm_chown_last_sequence(const char *directory, const char *series, uid_t uid, gi
     return rc;
 }
 
+#define SERIES_DELTA_TAG        "series_delta"
+#define SERIES_DELTA_BASE       "base"
+#define SERIES_DELTA_BASE_SUM   "base-digest"
+
+/*!
+ * \internal
+ * \brief Create a delta between two consecutive members of a file series
+ *
+ * The delta records the name of the file the previous member was saved as,
+ * a v2 patchset transforming the previous member into the new one, and
+ * on-disk digests of both so that reconstruction can be verified.
+ *
+ * \param[in] base       XML of the previous member of the series
+ * \param[in] base_file  Path the previous member was saved as
+ * \param[in] xml        XML of the new member of the series
+ *
+ * \return Newly allocated delta XML, or NULL if no usable delta could be
+ *         created (in which case \p xml should be saved in full)
+ * \note The caller is responsible for freeing the result with free_xml().
+ */
+xmlNode *
+pcmk__series_delta(xmlNode *base, const char *base_file, xmlNode *xml)
+{
+    int rc = pcmk_ok;
+    char *digest = NULL;
+    char *check = NULL;
+    const char *base_name = NULL;
+    xmlNode *target = NULL;
+    xmlNode *patchset = NULL;
+    xmlNode *delta = NULL;
+
+    CRM_CHECK((base != NULL) && (base_file != NULL) && (xml != NULL),
+              return NULL);
+
+    if (safe_str_neq(crm_element_name(base), crm_element_name(xml))
+        || safe_str_neq(ID(base), ID(xml))) {
+        return NULL;
+    }
+
+    target = copy_xml(xml);
+    xml_calculate_changes(base, target);
+    patchset = xml_create_patchset(2, base, target, NULL, FALSE);
+    free_xml(target);
+    if (patchset == NULL) {
+        return NULL;
+    }
+
+    /* Make sure the delta reproduces the input exactly before relying on it,
+     * since the full input will not be available anywhere else
+     */
+    digest = calculate_on_disk_digest(xml);
+    target = copy_xml(base);
+    rc = xml_apply_patchset(target, patchset, FALSE);
+    if (rc == pcmk_ok) {
+        check = calculate_on_disk_digest(target);
+    }
+    free_xml(target);
+
+    if (safe_str_neq(digest, check)) {
+        crm_info("Not saving delta against %s: patchset does not reproduce "
+                 "input " CRM_XS " rc=%d", base_file, rc);
+        free_xml(patchset);
+        free(digest);
+        free(check);
+        return NULL;
+    }
+    free(check);
+
+    base_name = strrchr(base_file, '/');
+    base_name = (base_name == NULL)? base_file : (base_name + 1);
+
+    delta = create_xml_node(NULL, SERIES_DELTA_TAG);
+    crm_xml_add(delta, SERIES_DELTA_BASE, base_name);
+    crm_xml_add(delta, XML_ATTR_DIGEST, digest);
+    free(digest);
+
+    digest = calculate_on_disk_digest(base);
+    crm_xml_add(delta, SERIES_DELTA_BASE_SUM, digest);
+    free(digest);
+
+    add_node_nocopy(delta, NULL, patchset);
+    return delta;
+}
+
+/*!
+ * \internal
+ * \brief Apply a delta created by pcmk__series_delta() to its base
+ *
+ * \param[in,out] xml         Full XML of delta's base (will become result)
+ * \param[in]     delta       Delta to apply
+ * \param[in]     check_base  Whether to verify that \p xml is delta's base
+ *
+ * \return NULL on success, otherwise a description of the failure (in which
+ *         case \p xml is left in an undefined state)
+ */
+static const char *
+apply_series_delta(xmlNode *xml, xmlNode *delta, bool check_base)
+{
+    xmlNode *patchset = first_named_child(delta, XML_TAG_DIFF);
+    const char *failed = NULL;
+    char *digest = NULL;
+
+    if (check_base
+        && !crm_digest_verify(xml, crm_element_value(delta,
+                                                     SERIES_DELTA_BASE_SUM))) {
+        return "base was overwritten";
+
+    } else if ((patchset == NULL)
+               || (xml_apply_patchset(xml, patchset, FALSE) != pcmk_ok)) {
+        return "patchset could not be applied";
+    }
+
+    digest = calculate_on_disk_digest(xml);
+    if (safe_str_neq(digest, crm_element_value(delta, XML_ATTR_DIGEST))) {
+        failed = "result does not match digest";
+    }
+    free(digest);
+    return failed;
+}
+
+/*!
+ * \internal
+ * \brief Read a member of a file series, reconstructing it if delta-encoded
+ *
+ * If the file contains a delta created by pcmk__series_delta(), the chain of
+ * deltas is followed back to the nearest full copy in the same directory, and
+ * each patchset is applied in turn. Otherwise, the file contents are returned
+ * as-is, so this can be used in place of filename2xml() for any series file.
+ *
+ * \param[in] filename  Path of file to read
+ *
+ * \return Newly allocated XML of series member, or NULL on error
+ * \note The caller is responsible for freeing the result with free_xml().
+ */
+xmlNode *
+pcmk__series_file2xml(const char *filename)
+{
+    char *directory = NULL;
+    const char *slash = NULL;
+    const char *failed = NULL;
+    xmlNode *xml = NULL;
+    GListPtr deltas = NULL;
+    GHashTable *seen = NULL;
+
+    CRM_CHECK(filename != NULL, return NULL);
+
+    xml = filename2xml(filename);
+    if (safe_str_neq(crm_element_name(xml), SERIES_DELTA_TAG)) {
+        return xml;
+    }
+
+    slash = strrchr(filename, '/');
+    if (slash == NULL) {
+        directory = strdup(".");
+    } else {
+        directory = strndup(filename, slash - filename);
+    }
+    seen = crm_str_table_new();
+
+    // Collect deltas until we reach a full copy (most recent delta last)
+    while (safe_str_eq(crm_element_name(xml), SERIES_DELTA_TAG)) {
+        const char *base = crm_element_value(xml, SERIES_DELTA_BASE);
+        char *base_path = NULL;
+
+        if ((base == NULL) || (strchr(base, '/') != NULL)
+            || g_hash_table_lookup(seen, base)) {
+            crm_err("Could not reconstruct %s: invalid delta base %s",
+                    filename, crm_str(base));
+            free_xml(xml);
+            xml = NULL;
+            break;
+        }
+        g_hash_table_insert(seen, strdup(base), strdup(base));
+        deltas = g_list_prepend(deltas, xml);
+
+        base_path = crm_strdup_printf("%s/%s", directory, base);
+        xml = filename2xml(base_path);
+        if (xml == NULL) {
+            crm_err("Could not reconstruct %s: %s is missing or unreadable",
+                    filename, base_path);
+        }
+        free(base_path);
+    }
+
+    for (GListPtr iter = deltas; (xml != NULL) && (iter != NULL);
+         iter = iter->next) {
+        xmlNode *delta = iter->data;
+
+        failed = apply_series_delta(xml, delta, (iter == deltas));
+        if (failed != NULL) {
+            crm_err("Could not reconstruct %s from %s: %s", filename,
+                    crm_element_value(delta, SERIES_DELTA_BASE), failed);
+            free_xml(xml);
+            xml = NULL;
+        }
+    }
+
+    g_list_free_full(deltas, crm_destroy_xml);
+    g_hash_table_destroy(seen);
+    free(directory);
+    return xml;
+}
+
+/*!
+ * \internal
+ * \brief Prepare a member of a file series to be overwritten
+ *
+ * When a series wraps, the file about to be overwritten may be the base of
+ * the delta saved after it (the oldest one that will remain). Rewrite that
+ * member as a full copy first, so it (and anything saved as a delta against
+ * it) can still be reconstructed once its base is gone.
+ *
+ * The caller can keep a rolling base: the full XML of the member about to be
+ * overwritten, which this replaces with the full XML of the member after it.
+ * The next member can then be rebuilt by applying its one delta in memory,
+ * rather than by reading its whole delta chain back from disk.
+ *
+ * \param[in]     filename   Path of series member about to be overwritten
+ * \param[in]     next_file  Path of the member saved after \p filename
+ * \param[in,out] base       If not NULL, full XML of \p filename if known
+ *                           (otherwise NULL), which will be replaced with
+ *                           full XML of \p next_file if known
+ *
+ * \return pcmk_ok on success (including when nothing needed to be done),
+ *         otherwise -errno
+ */
+int
+pcmk__series_release(const char *filename, const char *next_file,
+                     xmlNode **base)
+{
+    int rc = pcmk_ok;
+    const char *base_name = NULL;
+    xmlNode *xml = NULL;
+    xmlNode *delta = NULL;
+
+    CRM_CHECK((filename != NULL) && (next_file != NULL), return -EINVAL);
+
+    if (safe_str_eq(filename, next_file) || (access(next_file, F_OK) < 0)
+        || (access(filename, F_OK) < 0)) {
+        goto done;
+    }
+
+    delta = filename2xml(next_file);
+    if (safe_str_neq(crm_element_name(delta), SERIES_DELTA_TAG)) {
+        // Saved in full already, so it is the next base as it is
+        xml = delta;
+        delta = NULL;
+        goto done;
+    }
+
+    base_name = strrchr(filename, '/');
+    base_name = (base_name == NULL)? filename : (base_name + 1);
+    if (safe_str_neq(crm_element_value(delta, SERIES_DELTA_BASE), base_name)) {
+        goto done;
+    }
+
+    if ((base != NULL) && (*base != NULL)) {
+        xml = *base;
+        *base = NULL;
+        if (apply_series_delta(xml, delta, TRUE) != NULL) {
+            // Not the base we thought, so go by what is on disk
+            free_xml(xml);
+            xml = NULL;
+        }
+    }
+    if (xml == NULL) {
+        xml = pcmk__series_file2xml(next_file);
+    }
+
+    if (xml == NULL) {
+        rc = -ENODATA;
+    } else {
+        rc = write_xml_file(xml, next_file, crm_ends_with_ext(next_file, ".bz2"));
+        rc = (rc < 0)? rc : pcmk_ok;
+    }
+
+    if (rc == pcmk_ok) {
+        crm_trace("Saved %s in full before overwriting %s",
+                  next_file, filename);
+    } else {
+        crm_warn("Could not save %s in full before overwriting %s: %s "
+                 CRM_XS " rc=%d",
+                 next_file, filename, pcmk_strerror(rc), rc);
+    }
+
+done:
+    free_xml(delta);
+    if (base != NULL) {
+        free_xml(*base);
+        *base = xml;
+    } else {
+        free_xml(xml);
+    }
+    return rc;
+}
+
+/*!
+ * \internal
+ * \brief Release the series member that the next save will overwrite
+ *
+ * \param[in,out] state  Series state
+ *
+ * \note pcmk__series_save() does this itself if needed, but callers can call
+ *       this beforehand (for example, while idle) to keep it off the path of
+ *       the next save.
+ */
+void
+pcmk__series_release_pending(pcmk__series_state_t *state)
+{
+    if ((state->release_file != NULL) && !state->released) {
+        pcmk__series_release(state->release_file, state->release_next,
+                             &(state->base));
+        state->released = TRUE;
+    }
+}
+
+/*!
+ * \internal
+ * \brief Note which member of a file series the next save will overwrite
+ *
+ * \param[in,out] state      Series state
+ * \param[in]     directory  Directory that contains the file series
+ * \param[in]     series     Start of file name
+ * \param[in]     sequence   Sequence number of member to release
+ * \param[in]     max        Number of members to keep (or -1 for no limit)
+ */
+static void
+set_series_release(pcmk__series_state_t *state, const char *directory,
+                   const char *series, int sequence, int max)
+{
+    free(state->release_file);
+    state->release_file = NULL;
+    free(state->release_next);
+    state->release_next = NULL;
+    state->released = FALSE;
+
+    if (max > 0) {
+        state->release_file = generate_series_filename(directory, series,
+                                                       sequence, TRUE);
+        sequence = ((sequence + 1) < max)? (sequence + 1) : 0;
+        state->release_next = generate_series_filename(directory, series,
+                                                       sequence, TRUE);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Save a member of a file series, as a delta if allowed
+ *
+ * \param[in,out] state      Series state (initially zeroed)
+ * \param[in]     directory  Directory that contains the file series
+ * \param[in]     series     Start of file name
+ * \param[in]     sequence   Sequence number of member to save
+ * \param[in]     max        Number of members to keep (or -1 for no limit)
+ * \param[in]     input      XML to save
+ * \param[in]     interval   Save a full copy at least this often (values
+ *                           less than 2 disable deltas)
+ *
+ * \return pcmk_ok on success, otherwise -errno
+ * \note Afterward, the member that the next save will overwrite is pending
+ *       release (see pcmk__series_release_pending()).
+ */
+int
+pcmk__series_save(pcmk__series_state_t *state, const char *directory,
+                  const char *series, int sequence, int max, xmlNode *input,
+                  int interval)
+{
+    int rc = pcmk_ok;
+    char *filename = generate_series_filename(directory, series, sequence,
+                                              TRUE);
+    xmlNode *delta = NULL;
+
+    if (max > 0) {
+        if (safe_str_neq(state->release_file, filename)) {
+            // First save since start-up, or the series size changed
+            set_series_release(state, directory, series, sequence, max);
+            free_xml(state->base);
+            state->base = NULL;
+        }
+        pcmk__series_release_pending(state);
+    }
+    unlink(filename);
+
+    if ((interval > 1) && (state->last_input != NULL)
+        && ((state->deltas + 1) < interval)
+        && safe_str_neq(state->last_file, filename)) {
+        delta = pcmk__series_delta(state->last_input, state->last_file, input);
+    }
+
+    if (delta != NULL) {
+        crm_trace("Saving %s as delta against %s", filename, state->last_file);
+        rc = write_xml_file(delta, filename, TRUE);
+        free_xml(delta);
+        state->deltas++;
+
+    } else {
+        rc = write_xml_file(input, filename, TRUE);
+        state->deltas = 0;
+    }
+
+    free_xml(state->last_input);
+    free(state->last_file);
+    if ((rc < 0) || (interval < 2)) {
+        // Start the next delta chain from a fresh full input
+        state->last_input = NULL;
+        state->last_file = NULL;
+        free(filename);
+    } else {
+        state->last_input = copy_xml(input);
+        state->last_file = filename;
+    }
+
+    set_series_release(state, directory, series,
+                       ((sequence + 1) < max)? (sequence + 1) : 0, max);
+    return (rc < 0)? rc : pcmk_ok;
+}
+
+/*!
+ * \internal
+ * \brief Free everything held by a series state (leaving it zeroed)
+ *
+ * \param[in,out] state  Series state
+ */
+void
+pcmk__series_reset(pcmk__series_state_t *state)
+{
+    free_xml(state->last_input);
+    free(state->last_file);
+    free_xml(state->base);
+    free(state->release_file);
+    free(state->release_next);
+    memset(state, 0, sizeof(pcmk__series_state_t));
+}
+
 static bool
 pcmk__daemon_user_can_write(const char *target_name, struct stat *target_stat)
 {
@@ -30,7 +30,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
-#include <bzlib.h>
+#include <time.h>
 
 #include <crm/crm.h>   /* indirectly: pcmk_err_generic */
 #include <crm/msg_xml.h>
@@ -38,23 +38,123 @@
 #include <crm/common/ipcs.h>
 
 #include <crm/common/ipc_internal.h>  /* PCMK__SPECIAL_PID* */
+#include <crm/common/xml_internal.h>
+#include "crmcommon_private.h"
 
 #define PCMK_IPC_VERSION 1
 
+/* Header flags advertising what encodings the sender can receive, and
+ * whether it can answer requests with events
+ */
+#define PCMK__IPC_ACCEPT_FLAGS \
+    (crm_ipc_binary_ok|crm_ipc_lz4_ok|crm_ipc_zstd_ok|crm_ipc_multipart_ok \
+     |crm_ipc_async_ok)
+
+/* Header flags describing a message's own encoding, which must not be copied
+ * from caller-supplied flags (proxies, for example, relay flags they received)
+ */
+#define PCMK__IPC_ENCODING_FLAGS \
+    (crm_ipc_binary|crm_ipc_lz4|crm_ipc_zstd|crm_ipc_multipart \
+     |PCMK__IPC_ACCEPT_FLAGS)
+
+/* How long a server waits for a client to make room for the next fragment of
+ * a response before giving up on it (in seconds)
+ */
+#define PCMK__IPC_FRAGMENT_TIMEOUT 5
+
+/* Send at most this many queued events to a client before letting the main
+ * loop handle other sources
+ */
+#define PCMK__IPC_FLUSH_MAX_EVENTS 100
+
+/* While a client is not reading its events, retry flushing its queue after a
+ * delay that starts at the minimum and doubles up to the maximum (in ms)
+ */
+#define PCMK__IPC_FLUSH_MIN_DELAY 10
+#define PCMK__IPC_FLUSH_MAX_DELAY 1500
+
+/* Evict a client whose event queue is over its limit and has not shrunk for
+ * this long (in seconds)
+ */
+#define PCMK__IPC_EVICT_TIMEOUT 5
+
+/* Compression codecs to try for oversized messages, in order of preference.
+ * zstd and LZ4 are far faster than bzip2 but may compress less, so fall back
+ * to bzip2 (which every peer supports) if a message does not fit otherwise.
+ */
+static const struct {
+    enum pcmk__codec codec;
+    uint32_t flag;      // Header flag marking a message compressed this way
+    uint32_t ok_flag;   // Header flag advertising support for this codec
+} ipc_codecs[] = {
+    { pcmk__codec_zstd, crm_ipc_zstd, crm_ipc_zstd_ok },
+    { pcmk__codec_lz4, crm_ipc_lz4, crm_ipc_lz4_ok },
+    { pcmk__codec_bzip2, 0, 0 },
+};
+
+/*!
+ * \internal
+ * \brief Get header flags advertising the compression codecs we support
+ *
+ * \return Header flags for each codec (other than bzip2) in this build
+ */
+static uint32_t
+local_codec_flags(void)
+{
+    uint32_t flags = 0;
+
+    for (int lpc = 0; lpc < DIMOF(ipc_codecs); lpc++) {
+        if (pcmk__codec_supported(ipc_codecs[lpc].codec)) {
+            flags |= ipc_codecs[lpc].ok_flag;
+        }
+    }
+    return flags;
+}
+
+/*!
+ * \internal
+ * \brief Get the codec used to compress an IPC message
+ *
+ * \param[in] flags  Header flags of compressed message
+ *
+ * \return Compression codec indicated by \p flags
+ */
+static enum pcmk__codec
+header_codec(uint32_t flags)
+{
+    for (int lpc = 0; lpc < DIMOF(ipc_codecs); lpc++) {
+        if ((ipc_codecs[lpc].flag != 0) && is_set(flags, ipc_codecs[lpc].flag)) {
+            return ipc_codecs[lpc].codec;
+        }
+    }
+    return pcmk__codec_bzip2;
+}
+
 /* Evict clients whose event queue grows this large (by default) */
 #define PCMK_IPC_DEFAULT_QUEUE_MAX 500
 
-struct crm_ipc_response_header {
-    struct qb_ipc_response_header qb;
-    uint32_t size_uncompressed;
-    uint32_t size_compressed;
-    uint32_t flags;
-    uint8_t  version; /* Protect against version changes for anyone that might bother to statically link us */
+/* An event waiting in a client's queue */
+struct crm_ipc_event_s {
+    struct iovec *iov;
+    long long queued;   /* When event was queued (see ipc_now_ms()) */
+};
+
+/* A multipart message being reassembled */
+struct crm_ipc_parts_s {
+    char *buffer;       /* Message header and payload received so far */
+    unsigned int size;  /* Allocated size of buffer */
+    unsigned int len;   /* Bytes of payload received so far */
+    unsigned int total; /* Bytes of payload in whole message */
+    unsigned int chunk; /* Bytes of payload in each fragment but the last */
+    uint32_t id;        /* Identifier of message being reassembled */
+    uint32_t next;      /* Index of next expected fragment */
+    uint32_t count;     /* Total number of fragments in message */
 };
 
 static int hdr_offset = 0;
 static unsigned int ipc_buffer_max = 0;
 static unsigned int pick_ipc_buffer(unsigned int max);
+static struct pcmk__ipc_stats_s *client_stats(crm_client_t *c);
 
 static inline void
 crm_ipc_init(void)
@@ -326,6 +426,7 @@ client_from_connection(qb_ipcs_connection_t *c, void *key, uid_t uid_client)
         client->ipcs = c;
         client->kind = CRM_CLIENT_IPC;
         client->pid = crm_ipcs_client_pid(c);
+        client_stats(client); // Records connection time
         if (key == NULL) {
             key = c;
         }
@@ -437,13 +538,327 @@ free_event(gpointer data)
     pcmk_free_ipc_event((struct iovec *) data);
 }
 
+/*!
+ * \internal
+ * \brief Get the current time for measuring intervals
+ *
+ * \return Milliseconds since an arbitrary point in the past
+ */
+static long long
+ipc_now_ms(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &now) == 0) {
+        return (now.tv_sec * 1000LL) + (now.tv_nsec / 1000000);
+    }
+#endif
+    return time(NULL) * 1000LL;
+}
+
+static void
+free_queued_event(gpointer data)
+{
+    struct crm_ipc_event_s *event = data;
+
+    pcmk_free_ipc_event(event->iov);
+    free(event);
+}
+
+/*!
+ * \internal
+ * \brief Get a client's IPC statistics, allocating them if needed
+ *
+ * \param[in,out] c  Client to get statistics for
+ *
+ * \return Client's statistics
+ */
+static struct pcmk__ipc_stats_s *
+client_stats(crm_client_t *c)
+{
+    if (c->ipc_stats == NULL) {
+        c->ipc_stats = calloc(1, sizeof(struct pcmk__ipc_stats_s));
+        CRM_ASSERT(c->ipc_stats != NULL);
+        c->ipc_stats->connected = time(NULL);
+    }
+    return c->ipc_stats;
+}
+
+/*!
+ * \internal
+ * \brief Record how long an event waited in a client's queue
+ *
+ * \param[in,out] stats    Client's statistics
+ * \param[in]     latency  Milliseconds event spent queued
+ */
+static void
+record_latency(struct pcmk__ipc_stats_s *stats, long long latency)
+{
+    int bucket = 0;
+
+    // Buckets are powers of 10 milliseconds, with the last open-ended
+    for (long long limit = 1; (latency >= limit)
+         && (bucket < (PCMK__IPC_LATENCY_BUCKETS - 1)); limit *= 10) {
+        bucket++;
+    }
+    stats->latency[bucket]++;
+    stats->events_sent++;
+    stats->total_latency_ms += latency;
+    stats->max_latency_ms = QB_MAX(latency, stats->max_latency_ms);
+}
+
 static void
 add_event(crm_client_t *c, struct iovec *iov)
 {
+    struct pcmk__ipc_stats_s *stats = client_stats(c);
+    struct crm_ipc_event_s *event = malloc(sizeof(struct crm_ipc_event_s));
+
+    CRM_ASSERT(event != NULL);
+    event->iov = iov;
+    event->queued = ipc_now_ms();
+
     if (c->event_queue == NULL) {
         c->event_queue = g_queue_new();
     }
-    g_queue_push_tail(c->event_queue, iov);
+    g_queue_push_tail(c->event_queue, event);
+
+    stats->events_queued++;
+    stats->max_depth = QB_MAX(stats->max_depth,
+                              g_queue_get_length(c->event_queue));
+}
+
+/*!
+ * \internal
+ * \brief Split a prepared IPC message into fragments that fit a buffer
+ *
+ * \param[in] iov       Prepared message to split
+ * \param[in] max_size  Size of IPC buffer that each fragment must fit in
+ *
+ * \return Newly allocated list of fragments (as I/O vectors), in order
+ * \note The caller is responsible for freeing the result with
+ *       g_list_free_full(result, free_event). Only the last fragment keeps the
+ *       crm_ipc_client_response flag, so that the recipient acknowledges the
+ *       message just once.
+ */
+static GList *
+split_ipc_message(struct iovec *iov, unsigned int max_size)
+{
+    static uint32_t multipart_id = 0;
+
+    GList *fragments = NULL;
+    struct crm_ipc_response_header *header = iov[0].iov_base;
+    struct crm_ipc_fragment_header part;
+    unsigned int chunk = 0;
+    unsigned int offset = 0;
+
+    // Like any other message, a fragment must be smaller than the buffer
+    CRM_ASSERT(max_size > (hdr_offset + sizeof(part) + 1));
+    chunk = max_size - hdr_offset - sizeof(part) - 1;
+
+    part.id = ++multipart_id;
+    part.index = 0;
+    part.count = (iov[1].iov_len + chunk - 1) / chunk;
+
+    for (; offset < iov[1].iov_len; offset += chunk, part.index++) {
+        struct iovec *fragment = pcmk__new_ipc_event();
+        struct crm_ipc_response_header *frag_header = NULL;
+        unsigned int len = QB_MIN(chunk, iov[1].iov_len - offset);
+
+        frag_header = malloc(hdr_offset);
+        CRM_ASSERT(frag_header != NULL);
+        memcpy(frag_header, header, hdr_offset);
+        frag_header->flags |= crm_ipc_multipart;
+        if (part.index + 1 < part.count) {
+            clear_bit(frag_header->flags, crm_ipc_client_response);
+        }
+        frag_header->qb.size = hdr_offset + sizeof(part) + len;
+        fragment[0].iov_base = frag_header;
+        fragment[0].iov_len = hdr_offset;
+
+        fragment[1].iov_base = malloc(sizeof(part) + len);
+        CRM_ASSERT(fragment[1].iov_base != NULL);
+        memcpy(fragment[1].iov_base, &part, sizeof(part));
+        memcpy((char *) fragment[1].iov_base + sizeof(part),
+               (char *) iov[1].iov_base + offset, len);
+        fragment[1].iov_len = sizeof(part) + len;
+
+        fragments = g_list_append(fragments, fragment);
+    }
+
+    crm_trace("Split %u-byte IPC message %d into %u fragments of up to %u bytes",
+              header->qb.size, header->qb.id, part.count, max_size);
+    return fragments;
+}
+
+/*!
+ * \internal
+ * \brief Free a multipart message being reassembled
+ *
+ * \param[in] parts  Multipart message to free
+ */
+static void
+free_parts(struct crm_ipc_parts_s *parts)
+{
+    if (parts != NULL) {
+        free(parts->buffer);
+        free(parts);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Get the most payload a peer may send as one multipart message
+ *
+ * \param[in] buffer_size  Recipient's IPC buffer size
+ *
+ * \return Maximum size of reassembled payload
+ */
+static unsigned int
+multipart_max(unsigned int buffer_size)
+{
+    unsigned long long max = buffer_size * (unsigned long long) PCMK__IPC_MULTIPART_MAX;
+
+    return (unsigned int) QB_MIN(max, UINT_MAX - hdr_offset - 1);
+}
+
+/*!
+ * \internal
+ * \brief Add a received fragment to a multipart message
+ *
+ * \param[in,out] parts     Message being reassembled (created as needed)
+ * \param[in]     data      Received fragment (including IPC header)
+ * \param[in]     size      Size of \p data
+ * \param[in]     min_size  Allocate at least this much for the whole message
+ * \param[in]     max_size  Reject messages with more payload than this
+ * \param[out]    message   Where to store whole message, once complete
+ * \param[out]    msg_size  Where to store allocated size of \p message
+ *
+ * \return pcmk_ok if the message is complete, -EAGAIN if more fragments are
+ *         needed, otherwise -errno (-EMSGSIZE if the message is too big,
+ *         -EPROTO if the fragment is invalid or inconsistent with the others),
+ *         in which case any partial message is discarded
+ * \note On success, the caller is responsible for freeing \p message. The
+ *       header of the whole message is that of its last fragment, without
+ *       crm_ipc_multipart, so it reflects any per-fragment flags correctly.
+ * \note The sizes in a fragment come from the peer, so nothing is allocated
+ *       until they have been checked against \p max_size and each other.
+ */
+static int
+add_fragment(struct crm_ipc_parts_s **parts, const char *data, size_t size,
+             unsigned int min_size, unsigned int max_size, char **message,
+             unsigned int *msg_size)
+{
+    const struct crm_ipc_response_header *header = (const void *) data;
+    struct crm_ipc_fragment_header part;
+    struct crm_ipc_response_header *whole = NULL;
+    unsigned int len = 0;
+    int rc = -EPROTO;
+
+    if (size < (hdr_offset + sizeof(part))) {
+        crm_err("Discarding truncated IPC message fragment (%llu bytes)",
+                (unsigned long long) size);
+        goto bail;
+    }
+    memcpy(&part, data + hdr_offset, sizeof(part));
+    len = size - hdr_offset - sizeof(part);
+
+    if (part.index == 0) {
+        unsigned int total = header->size_compressed?
+                             header->size_compressed : header->size_uncompressed;
+
+        if (*parts != NULL) {
+            crm_warn("Discarding incomplete IPC message %u (received %u of %u "
+                     "fragments)", (*parts)->id, (*parts)->next, (*parts)->count);
+            free_parts(*parts);
+            *parts = NULL;
+        }
+        if (total > max_size) {
+            crm_err("Discarding IPC message %u with %u bytes of payload "
+                    "(limit is %u)", part.id, total, max_size);
+            rc = -EMSGSIZE;
+            goto bail;
+        }
+
+        /* Every fragment but the last carries the same amount of payload, so
+         * the first one's size and the total determine the fragment count
+         */
+        if ((len == 0) || (len > total) || (part.count == 0)
+            || (part.count != ((total - 1) / len) + 1)) {
+            crm_err("Discarding IPC message %u with inconsistent size (%u "
+                    "bytes in %u fragments of %u)",
+                    part.id, total, part.count, len);
+            goto bail;
+        }
+
+        *parts = calloc(1, sizeof(struct crm_ipc_parts_s));
+        if (*parts == NULL) {
+            rc = -ENOMEM;
+            goto bail;
+        }
+        (*parts)->id = part.id;
+        (*parts)->count = part.count;
+        (*parts)->chunk = len;
+        (*parts)->total = total;
+        (*parts)->size = QB_MAX(hdr_offset + total + 1, min_size);
+        (*parts)->buffer = calloc(1, (*parts)->size);
+        if ((*parts)->buffer == NULL) {
+            crm_err("Could not allocate %u bytes for IPC message %u",
+                    (*parts)->size, part.id);
+            rc = -ENOMEM;
+            goto bail;
+        }
+
+    } else if ((*parts == NULL) || (part.id != (*parts)->id)
+               || (part.index != (*parts)->next)) {
+        crm_err("Discarding out-of-sequence IPC message fragment %u of "
+                "message %u", part.index, part.id);
+        goto bail;
+    }
+
+    if ((part.count != (*parts)->count) || (part.index >= part.count)
+        || (len > ((*parts)->total - (*parts)->len))
+        || (((part.index + 1) < part.count) && (len != (*parts)->chunk))) {
+        crm_err("Discarding invalid IPC message fragment %u of message %u",
+                part.index, part.id);
+        goto bail;
+    }
+
+    memcpy((*parts)->buffer + hdr_offset + (*parts)->len,
+           data + hdr_offset + sizeof(part), len);
+    (*parts)->len += len;
+    (*parts)->next++;
+
+    if ((*parts)->next < (*parts)->count) {
+        crm_trace("Received fragment %u/%u of IPC message %u",
+                  (*parts)->next, (*parts)->count, (*parts)->id);
+        return -EAGAIN;
+    }
+
+    if ((*parts)->len != (*parts)->total) {
+        crm_err("Discarding IPC message %u with only %u of %u bytes",
+                (*parts)->id, (*parts)->len, (*parts)->total);
+        goto bail;
+    }
+
+    whole = (struct crm_ipc_response_header *)(void*)(*parts)->buffer;
+    memcpy(whole, header, hdr_offset);
+    clear_bit(whole->flags, crm_ipc_multipart);
+    whole->qb.size = hdr_offset + (*parts)->len;
+
+    crm_trace("Reassembled %u-byte IPC message %u from %u fragments",
+              whole->qb.size, (*parts)->id, (*parts)->count);
+    *message = (*parts)->buffer;
+    *msg_size = (*parts)->size;
+    (*parts)->buffer = NULL;
+    free_parts(*parts);
+    *parts = NULL;
+    return pcmk_ok;
+
+  bail:
+    free_parts(*parts);
+    *parts = NULL;
+    return rc;
 }
 
 void
@@ -472,9 +887,39 @@ crm_client_destroy(crm_client_t * c)
 
     if (c->event_queue) {
         crm_debug("Destroying %d events", g_queue_get_length(c->event_queue));
-        g_queue_free_full(c->event_queue, free_event);
+        g_queue_free_full(c->event_queue, free_queued_event);
+    }
+
+    if (c->response_timer) {
+        g_source_remove(c->response_timer);
+    }
+
+    if (c->response_queue) {
+        crm_debug("Destroying %d response fragments",
+                  g_queue_get_length(c->response_queue));
+        g_queue_free_full(c->response_queue, free_queued_event);
     }
 
+    if (c->ipc_stats) {
+        struct pcmk__ipc_stats_s *stats = c->ipc_stats;
+
+        crm_debug("Client %s made %llu requests (%llu bytes) and was sent "
+                  "%llu responses and %llu of %llu events (%llu bytes, "
+                  "%llu in batches, max queue %u, max latency %lldms, "
+                  "average %lldms)",
+                  crm_client_name(c), stats->requests, stats->bytes_in,
+                  stats->responses, stats->events_sent, stats->events_queued,
+                  stats->bytes_out, stats->batches_sent, stats->max_depth,
+                  stats->max_latency_ms,
+                  stats->events_sent?
+                  (stats->total_latency_ms / (long long) stats->events_sent) : 0);
+        free(c->ipc_stats);
+    }
+
+    free_parts(c->ipc_parts);
+    if (c->async_requests != NULL) {
+        g_hash_table_destroy(c->async_requests);
+    }
     free(c->id);
     free(c->name);
     free(c->user);
@@ -525,15 +970,20 @@ crm_ipcs_recv(crm_client_t * c, void *data, size_t size, uint32_t * id, uint32_t
 {
     xmlNode *xml = NULL;
     char *uncompressed = NULL;
+    char *assembled = NULL;
     char *text = ((char *)data) + sizeof(struct crm_ipc_response_header);
     struct crm_ipc_response_header *header = data;
+    uint32_t request_id = ((struct qb_ipc_response_header *)data)->id;
+    bool async = is_set(header->flags, crm_ipc_async);
 
     if (id) {
-        *id = ((struct qb_ipc_response_header *)data)->id;
+        *id = request_id;
     }
     if (flags) {
         *flags = header->flags;
     }
+    crm_ipc_init();
+    client_stats(c)->bytes_in += size;
 
     if (is_set(header->flags, crm_ipc_proxied)) {
         /* Mark this client as being the endpoint of a proxy connection.
@@ -543,12 +993,55 @@ crm_ipcs_recv(crm_client_t * c, void *data, size_t size, uint32_t * id, uint32_t
         c->flags |= crm_client_flag_ipc_proxied;
     }
 
+    // Use whatever encodings the client understands for anything sent to it
+    if (is_set(header->flags, crm_ipc_binary_ok)) {
+        c->flags |= crm_client_flag_ipc_binary;
+    }
+    if (is_set(header->flags, crm_ipc_lz4_ok)) {
+        c->flags |= crm_client_flag_ipc_lz4;
+    }
+    if (is_set(header->flags, crm_ipc_zstd_ok)) {
+        c->flags |= crm_client_flag_ipc_zstd;
+    }
+    if (is_set(header->flags, crm_ipc_multipart_ok)) {
+        c->flags |= crm_client_flag_ipc_multipart;
+    }
+    if (is_set(header->flags, crm_ipc_batch_ok)) {
+        c->flags |= crm_client_flag_ipc_batch;
+    }
+
     if(header->version > PCMK_IPC_VERSION) {
         crm_err("Filtering incompatible v%d IPC message, we only support versions <= %d",
                 header->version, PCMK_IPC_VERSION);
         return NULL;
     }
 
+    if (is_set(header->flags, crm_ipc_multipart)) {
+        unsigned int assembled_size = 0;
+        int rc = add_fragment(&(c->ipc_parts), data, size, 0,
+                              multipart_max(ipc_buffer_max), &assembled,
+                              &assembled_size);
+
+        /* Callers get nothing until the last fragment arrives, and only that
+         * one asks for a response, so they don't acknowledge the others
+         */
+        if (rc == -EAGAIN) {
+            return NULL;
+
+        } else if (rc != pcmk_ok) {
+            // Fragments only go astray if the client is broken or malicious
+            crm_err("Disconnecting client %s after invalid multipart "
+                    "message: %s " CRM_XS " rc=%d",
+                    crm_client_name(c), pcmk_strerror(rc), rc);
+            if (c->ipcs != NULL) {
+                qb_ipcs_disconnect(c->ipcs);
+            }
+            return NULL;
+        }
+        header = (struct crm_ipc_response_header *)(void*)assembled;
+        text = assembled + sizeof(struct crm_ipc_response_header);
+    }
+
     if (header->size_compressed) {
         int rc = 0;
         unsigned int size_u = 1 + header->size_uncompressed;
@@ -557,23 +1050,151 @@ crm_ipcs_recv(crm_client_t * c, void *data, size_t size, uint32_t * id, uint32_t
         crm_trace("Decompressing message data %u bytes into %u bytes",
                   header->size_compressed, size_u);
 
-        rc = BZ2_bzBuffToBuffDecompress(uncompressed, &size_u, text, header->size_compressed, 1, 0);
+        rc = pcmk__decompress(header_codec(header->flags), text,
+                              header->size_compressed, uncompressed, &size_u);
         text = uncompressed;
 
-        if (rc != BZ_OK) {
-            crm_err("Decompression failed: %s " CRM_XS " bzerror=%d",
-                    bz2_strerror(rc), rc);
+        if ((rc != pcmk_ok) || (size_u != header->size_uncompressed)) {
             free(uncompressed);
+            free(assembled);
             return NULL;
         }
     }
 
     CRM_ASSERT(text[header->size_uncompressed - 1] == 0);
 
-    crm_trace("Received %.200s", text);
-    xml = string2xml(text);
+    if (is_set(header->flags, crm_ipc_binary)) {
+        crm_trace("Received %u bytes of binary XML", header->size_uncompressed);
+        xml = pcmk__binary2xml(text, header->size_uncompressed);
+
+    } else {
+        crm_trace("Received %.200s", text);
+        xml = string2xml(text);
+    }
 
     free(uncompressed);
+    free(assembled);
+
+    if (xml != NULL) {
+        client_stats(c)->requests++;
+    }
+
+    if ((xml != NULL) && async) {
+        // Answer this request with an event (see crm_ipcs_sendv())
+        if (c->async_requests == NULL) {
+            c->async_requests = g_hash_table_new(g_direct_hash, g_direct_equal);
+        }
+        g_hash_table_insert(c->async_requests, GUINT_TO_POINTER(request_id),
+                            GUINT_TO_POINTER(request_id));
+    }
+
+    if ((xml != NULL) && crm_str_eq(crm_element_name(xml),
+                                    PCMK__XE_IPC_STATS, TRUE)) {
+        /* Any server can answer this, so do it here. Clearing the response
+         * flag keeps the caller from acknowledging the request as well.
+         * The reply describes every client of the process, so only
+         * privileged clients may have it.
+         */
+        struct crm_ipc_response_header *request = data;
+
+        if (is_set(request->flags, crm_ipc_client_response)) {
+            xmlNode *reply = NULL;
+
+            if (is_set(c->flags, crm_client_flag_ipc_privileged)) {
+                reply = pcmk__ipc_stats_xml();
+                crm_debug("Sending IPC statistics to %s", crm_client_name(c));
+            } else {
+                reply = create_xml_node(NULL, PCMK__XE_IPC_STATS);
+                crm_xml_add_int(reply, PCMK__XA_IPC_STATS_RC, -EACCES);
+                crm_notice("Refusing IPC statistics to unprivileged client %s",
+                           crm_client_name(c));
+            }
+            crm_ipcs_send(c, request->qb.id, reply, crm_ipc_flags_none);
+            free_xml(reply);
+        }
+        free_xml(xml);
+        if (flags) {
+            clear_bit(*flags, crm_ipc_client_response);
+        }
+        return NULL;
+    }
+    return xml;
+}
+
+/*!
+ * \internal
+ * \brief Add an unsigned 64-bit statistic to XML as an attribute
+ *
+ * \param[in,out] xml    XML to add attribute to
+ * \param[in]     name   Attribute name
+ * \param[in]     value  Attribute value
+ */
+static void
+add_stat(xmlNode *xml, const char *name, unsigned long long value)
+{
+    char *text = crm_strdup_printf("%llu", value);
+
+    crm_xml_add(xml, name, text);
+    free(text);
+}
+
+/*!
+ * \internal
+ * \brief Describe the IPC traffic of every client of this process's servers
+ *
+ * \return Newly allocated XML (which the caller must free) with a \c client
+ *         child for each IPC client connection
+ */
+xmlNode *
+pcmk__ipc_stats_xml(void)
+{
+    static const char *latency_names[PCMK__IPC_LATENCY_BUCKETS] = {
+        "latency-lt-1ms", "latency-lt-10ms", "latency-lt-100ms",
+        "latency-lt-1s", "latency-ge-1s",
+    };
+    xmlNode *xml = create_xml_node(NULL, PCMK__XE_IPC_STATS);
+    GHashTableIter iter;
+    crm_client_t *c = NULL;
+
+    crm_xml_add(xml, "daemon", crm_system_name);
+    crm_xml_add_int(xml, "pid", getpid());
+    if (client_connections == NULL) {
+        return xml;
+    }
+
+    g_hash_table_iter_init(&iter, client_connections);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &c)) {
+        struct pcmk__ipc_stats_s *stats = c->ipc_stats;
+        xmlNode *child = NULL;
+
+        if ((c->kind != CRM_CLIENT_IPC) || (stats == NULL)) {
+            continue;
+        }
+
+        child = create_xml_node(xml, "client");
+        crm_xml_add(child, "id", c->id);
+        crm_xml_add(child, "name", crm_client_name(c));
+        crm_xml_add_int(child, "pid", c->pid);
+        crm_xml_add(child, "user", c->user);
+        add_stat(child, "connected", (unsigned long long) stats->connected);
+        add_stat(child, "requests", stats->requests);
+        add_stat(child, "bytes-in", stats->bytes_in);
+        add_stat(child, "responses", stats->responses);
+        add_stat(child, "events-queued", stats->events_queued);
+        add_stat(child, "events-sent", stats->events_sent);
+        add_stat(child, "batches-sent", stats->batches_sent);
+        add_stat(child, "bytes-out", stats->bytes_out);
+        add_stat(child, "raw-bytes-out", stats->raw_bytes_out);
+        add_stat(child, "send-blocked", stats->send_blocked);
+        add_stat(child, "queue-depth",
+                 c->event_queue? g_queue_get_length(c->event_queue) : 0);
+        add_stat(child, "max-queue-depth", stats->max_depth);
+        add_stat(child, "max-latency-ms", stats->max_latency_ms);
+        add_stat(child, "total-latency-ms", stats->total_latency_ms);
+        for (int lpc = 0; lpc < PCMK__IPC_LATENCY_BUCKETS; lpc++) {
+            add_stat(child, latency_names[lpc], stats->latency[lpc]);
+        }
+    }
     return xml;
 }
 
@@ -591,18 +1212,99 @@ crm_ipcs_flush_events_cb(gpointer data)
 
 /*!
  * \internal
- * \brief Add progressive delay before next event queue flush
+ * \brief Schedule the next event queue flush
+ *
+ * \param[in,out] c        Client connection to schedule flush for
+ * \param[in]     sent     Number of events sent by the last flush
+ * \param[in]     blocked  Whether the last flush stopped because the client's
+ *                         event channel was full
  *
- * \param[in,out] c          Client connection to add delay to
- * \param[in]     queue_len  Current event queue length
+ * \note libqb offers no way to be told when the client reads an event, so a
+ *       blocked client is polled, backing off while it makes no progress. A
+ *       client that is merely behind is retried as soon as the main loop has
+ *       handled other sources.
  */
 static inline void
-delay_next_flush(crm_client_t *c, unsigned int queue_len)
+delay_next_flush(crm_client_t *c, unsigned int sent, bool blocked)
+{
+    if (!blocked) {
+        c->flush_delay = 0;
+
+    } else if ((sent > 0) || (c->flush_delay == 0)) {
+        c->flush_delay = PCMK__IPC_FLUSH_MIN_DELAY;
+
+    } else {
+        c->flush_delay = QB_MIN(2 * c->flush_delay, PCMK__IPC_FLUSH_MAX_DELAY);
+    }
+    c->event_timer = g_timeout_add(c->flush_delay, crm_ipcs_flush_events_cb, c);
+}
+
+/*!
+ * \internal
+ * \brief Combine events at the head of a client's queue into one message
+ *
+ * \param[in]  c      Client whose queue should be used
+ * \param[out] count  Where to store number of events combined
+ *
+ * \return Newly allocated I/O vector for combined message, or NULL if fewer
+ *         than two events at the head of the queue fit in one message
+ * \note A batch is an ordinary message header with crm_ipc_batch set,
+ *       followed by each event's header and payload in turn.
+ */
+static struct iovec *
+batch_events(crm_client_t *c, unsigned int *count)
 {
-    /* Delay a maximum of 1.5 seconds */
-    guint delay = (queue_len < 5)? (1000 + 100 * queue_len) : 1500;
+    struct iovec *iov = NULL;
+    struct crm_ipc_response_header *header = NULL;
+    struct crm_ipc_event_s *first = g_queue_peek_head(c->event_queue);
+    unsigned int len = 0;
+    unsigned int n = 0;
+    char *payload = NULL;
+    GList *iter = NULL;
+
+    for (iter = c->event_queue->head; iter != NULL; iter = iter->next) {
+        struct crm_ipc_event_s *event = iter->data;
+        unsigned int size = event->iov[0].iov_len + event->iov[1].iov_len;
+
+        if ((hdr_offset + len + size) >= ipc_buffer_max) {
+            break;
+        }
+        len += size;
+        n++;
+    }
+    if (n < 2) {
+        return NULL;
+    }
+
+    payload = malloc(len);
+    CRM_ASSERT(payload != NULL);
+    len = 0;
+    iter = c->event_queue->head;
+    for (unsigned int lpc = 0; lpc < n; lpc++, iter = iter->next) {
+        struct crm_ipc_event_s *event = iter->data;
+
+        memcpy(payload + len, event->iov[0].iov_base, event->iov[0].iov_len);
+        len += event->iov[0].iov_len;
+        memcpy(payload + len, event->iov[1].iov_base, event->iov[1].iov_len);
+        len += event->iov[1].iov_len;
+    }
+
+    header = calloc(1, sizeof(struct crm_ipc_response_header));
+    CRM_ASSERT(header != NULL);
+    header->version = PCMK_IPC_VERSION;
+    header->flags = crm_ipc_batch;
+    header->size_uncompressed = len;
+    header->qb.id = ((struct crm_ipc_response_header *) first->iov[0].iov_base)->qb.id;
+    header->qb.size = hdr_offset + len;
+
+    iov = pcmk__new_ipc_event();
+    iov[0].iov_base = header;
+    iov[0].iov_len = hdr_offset;
+    iov[1].iov_base = payload;
+    iov[1].iov_len = len;
 
-    c->event_timer = g_timeout_add(delay, crm_ipcs_flush_events_cb, c);
+    *count = n;
+    return iov;
 }
 
 ssize_t
@@ -611,6 +1313,7 @@ crm_ipcs_flush_events(crm_client_t * c)
     ssize_t rc = 0;
     unsigned int sent = 0;
     unsigned int queue_len = 0;
+    long long now = ipc_now_ms();
 
     if (c == NULL) {
         return pcmk_ok;
@@ -621,41 +1324,62 @@ crm_ipcs_flush_events(crm_client_t * c)
         return pcmk_ok;
     }
 
-    if (c->event_queue) {
-        queue_len = g_queue_get_length(c->event_queue);
-    }
-    while (sent < 100) {
-        struct crm_ipc_response_header *header = NULL;
-        struct iovec *event = NULL;
+    while (sent < PCMK__IPC_FLUSH_MAX_EVENTS) {
+        struct iovec *batch = NULL;
+        unsigned int count = 1;
 
-        if (c->event_queue) {
-            // We don't pop unless send is successful
-            event = g_queue_peek_head(c->event_queue);
-        }
-        if (event == NULL) { // Queue is empty
+        if ((c->event_queue == NULL) || g_queue_is_empty(c->event_queue)) {
             break;
         }
 
-        rc = qb_ipcs_event_sendv(c->ipcs, event, 2);
-        if (rc < 0) {
-            break;
+        // Catch up on a backlog with fewer, bigger messages where possible
+        if (is_set(c->flags, crm_client_flag_ipc_batch)
+            && (g_queue_get_length(c->event_queue) > 1)) {
+            batch = batch_events(c, &count);
         }
-        event = g_queue_pop_head(c->event_queue);
 
-        sent++;
-        header = event[0].iov_base;
-        if (header->size_compressed) {
-            crm_trace("Event %d to %p[%d] (%lld compressed bytes) sent",
-                      header->qb.id, c->ipcs, c->pid, (long long) rc);
+        // We don't pop unless send is successful
+        if (batch != NULL) {
+            rc = qb_ipcs_event_sendv(c->ipcs, batch, 2);
+            pcmk_free_ipc_event(batch);
         } else {
-            crm_trace("Event %d to %p[%d] (%lld bytes) sent: %.120s",
-                      header->qb.id, c->ipcs, c->pid, (long long) rc,
-                      (char *) (event[1].iov_base));
+            struct crm_ipc_event_s *event = g_queue_peek_head(c->event_queue);
+
+            rc = qb_ipcs_event_sendv(c->ipcs, event->iov, 2);
+        }
+        if (rc < 0) {
+            client_stats(c)->send_blocked++;
+            break;
+        }
+        if (batch != NULL) {
+            client_stats(c)->batches_sent++;
         }
-        pcmk_free_ipc_event(event);
-    }
 
-    queue_len -= sent;
+        for (unsigned int lpc = 0; lpc < count; lpc++) {
+            struct crm_ipc_event_s *event = g_queue_pop_head(c->event_queue);
+            struct crm_ipc_response_header *header = event->iov[0].iov_base;
+
+            record_latency(client_stats(c), now - event->queued);
+
+            if (is_set(header->flags, crm_ipc_multipart)) {
+                crm_trace("Event %d fragment to %p[%d] (%u bytes) sent",
+                          header->qb.id, c->ipcs, c->pid, header->qb.size);
+            } else if (header->size_compressed) {
+                crm_trace("Event %d to %p[%d] (%u compressed bytes) sent",
+                          header->qb.id, c->ipcs, c->pid, header->qb.size);
+            } else {
+                crm_trace("Event %d to %p[%d] (%u bytes) sent: %.120s",
+                          header->qb.id, c->ipcs, c->pid, header->qb.size,
+                          (char *) (event->iov[1].iov_base));
+            }
+            free_queued_event(event);
+        }
+        sent += count;
+    }
+
+    if (c->event_queue) {
+        queue_len = g_queue_get_length(c->event_queue);
+    }
     if (sent > 0 || queue_len) {
         crm_trace("Sent %d events (%d remaining) for %p[%d]: %s (%lld)",
                   sent, queue_len, c->ipcs, c->pid,
@@ -663,17 +1387,23 @@ crm_ipcs_flush_events(crm_client_t * c)
     }
 
     if (queue_len) {
+        unsigned int limit = QB_MAX(c->queue_max, PCMK_IPC_DEFAULT_QUEUE_MAX);
 
-        /* Allow clients to briefly fall behind on processing incoming messages,
-         * but drop completely unresponsive clients so the connection doesn't
+        /* Allow clients to fall behind on processing incoming messages during
+         * bursts, but drop unresponsive clients so the connection doesn't
          * consume resources indefinitely.
          */
-        if (queue_len > QB_MAX(c->queue_max, PCMK_IPC_DEFAULT_QUEUE_MAX)) {
-            if ((c->queue_backlog <= 1) || (queue_len < c->queue_backlog)) {
-                /* Don't evict for a new or shrinking backlog */
+        if (queue_len > limit) {
+            if (c->queue_backlog <= limit) {
                 crm_warn("Client with process ID %u has a backlog of %u messages "
                          CRM_XS " %p", c->pid, queue_len, c->ipcs);
-            } else {
+                c->backlog_since = time(NULL);
+
+            } else if (queue_len < c->queue_backlog) {
+                /* Don't evict a client that is catching up */
+                c->backlog_since = time(NULL);
+
+            } else if ((time(NULL) - c->backlog_since) >= PCMK__IPC_EVICT_TIMEOUT) {
                 crm_err("Evicting client with process ID %u due to backlog of %u messages "
                          CRM_XS " %p", c->pid, queue_len, c->ipcs);
                 c->queue_backlog = 0;
@@ -683,24 +1413,42 @@ crm_ipcs_flush_events(crm_client_t * c)
         }
 
         c->queue_backlog = queue_len;
-        delay_next_flush(c, queue_len);
+        delay_next_flush(c, sent, (rc < 0));
 
     } else {
         /* Event queue is empty, there is no backlog */
         c->queue_backlog = 0;
+        c->flush_delay = 0;
     }
 
     return rc;
 }
 
+/*!
+ * \internal
+ * \brief Create an I/O vector for sending an IPC XML message
+ *
+ * \param[in]  request        Identifier for libqb response header
+ * \param[in]  message        XML message to send
+ * \param[out] result         Where to store prepared I/O vector
+ * \param[in]  max_send_size  Maximum message size to allow (or 0 for default)
+ * \param[in]  peer_flags     Header flags advertised by the recipient (the
+ *                            crm_ipc_*_ok flags determine what encodings may
+ *                            be used, with text and bzip2 always allowed)
+ *
+ * \return Size of prepared message on success, otherwise -errno
+ * \note If \p peer_flags includes crm_ipc_multipart_ok, the result may exceed
+ *       \p max_send_size, and will be sent in fragments.
+ */
 ssize_t
-crm_ipc_prepare(uint32_t request, xmlNode * message, struct iovec ** result, uint32_t max_send_size)
+pcmk__ipc_prepare(uint32_t request, xmlNode *message, struct iovec **result,
+                  uint32_t max_send_size, uint32_t peer_flags)
 {
     static unsigned int biggest = 0;
     struct iovec *iov;
     unsigned int total = 0;
     char *compressed = NULL;
-    char *buffer = dump_xml_unformatted(message);
+    char *buffer = NULL;
     struct crm_ipc_response_header *header = calloc(1, sizeof(struct crm_ipc_response_header));
 
     CRM_ASSERT(result != NULL);
@@ -719,7 +1467,16 @@ crm_ipc_prepare(uint32_t request, xmlNode * message, struct iovec ** result, uin
     iov[0].iov_base = header;
 
     header->version = PCMK_IPC_VERSION;
-    header->size_uncompressed = 1 + strlen(buffer);
+    if (is_set(peer_flags, crm_ipc_binary_ok)) {
+        // This fails for content only the text encoding can represent
+        buffer = pcmk__xml2binary(message, &(header->size_uncompressed));
+    }
+    if (buffer != NULL) {
+        header->flags |= crm_ipc_binary;
+    } else {
+        buffer = dump_xml_unformatted(message);
+        header->size_uncompressed = 1 + strlen(buffer);
+    }
     total = iov[0].iov_len + header->size_uncompressed;
 
     if (total < max_send_size) {
@@ -728,10 +1485,29 @@ crm_ipc_prepare(uint32_t request, xmlNode * message, struct iovec ** result, uin
 
     } else {
         unsigned int new_size = 0;
+        int rc = -EMSGSIZE;
 
-        if (crm_compress_string
-            (buffer, header->size_uncompressed, max_send_size, &compressed, &new_size)) {
+        /* Compressed output must fit in the buffer, unless the recipient can
+         * reassemble fragments, in which case the preferred codec is enough
+         */
+        unsigned int limit = is_set(peer_flags, crm_ipc_multipart_ok)?
+                             0 : max_send_size;
+
+        for (int lpc = 0; (rc != pcmk_ok) && (lpc < DIMOF(ipc_codecs)); lpc++) {
+            if ((ipc_codecs[lpc].ok_flag == 0)
+                || (is_set(peer_flags, ipc_codecs[lpc].ok_flag)
+                    && pcmk__codec_supported(ipc_codecs[lpc].codec))) {
+
+                rc = pcmk__compress(ipc_codecs[lpc].codec, buffer,
+                                    header->size_uncompressed, limit,
+                                    &compressed, &new_size);
+                if (rc == pcmk_ok) {
+                    header->flags |= ipc_codecs[lpc].flag;
+                }
+            }
+        }
 
+        if (rc == pcmk_ok) {
             header->flags |= crm_ipc_compressed;
             header->size_compressed = new_size;
 
@@ -741,6 +1517,11 @@ crm_ipc_prepare(uint32_t request, xmlNode * message, struct iovec ** result, uin
             free(buffer);
 
             biggest = QB_MAX(header->size_compressed, biggest);
+            if ((iov[0].iov_len + new_size) >= max_send_size) {
+                crm_trace("Compressed message (%u bytes) will be sent in "
+                          "fragments of up to %u bytes",
+                          new_size, max_send_size);
+            }
 
         } else {
             ssize_t rc = -EMSGSIZE;
@@ -767,6 +1548,178 @@ crm_ipc_prepare(uint32_t request, xmlNode * message, struct iovec ** result, uin
     return header->qb.size;
 }
 
+ssize_t
+crm_ipc_prepare(uint32_t request, xmlNode * message, struct iovec ** result, uint32_t max_send_size)
+{
+    return pcmk__ipc_prepare(request, message, result, max_send_size, 0);
+}
+
+static ssize_t flush_responses(crm_client_t *c);
+
+static gboolean
+flush_responses_cb(gpointer data)
+{
+    crm_client_t *c = data;
+
+    c->response_timer = 0;
+    flush_responses(c);
+    return FALSE;
+}
+
+/*!
+ * \internal
+ * \brief Drop any response fragments queued for a client
+ *
+ * \param[in,out] c  Client whose queued responses should be dropped
+ */
+static void
+drop_responses(crm_client_t *c)
+{
+    if (c->response_timer) {
+        g_source_remove(c->response_timer);
+        c->response_timer = 0;
+    }
+    if (c->response_queue) {
+        g_queue_free_full(c->response_queue, free_queued_event);
+        c->response_queue = NULL;
+    }
+}
+
+/*!
+ * \internal
+ * \brief Send a client as many queued response fragments as it has room for
+ *
+ * \param[in,out] c  Client to send queued responses to
+ *
+ * \return Bytes sent by the last attempt, otherwise -errno
+ * \note The response channel only has room for about one fragment, so usually
+ *       one is sent per call, and the rest are retried from the main loop
+ *       once the client has had a chance to read it. The client is given up on
+ *       if it disconnects, or stops reading for PCMK__IPC_FRAGMENT_TIMEOUT.
+ */
+static ssize_t
+flush_responses(crm_client_t *c)
+{
+    struct crm_ipc_event_s *response = NULL;
+    ssize_t rc = 0;
+
+    if ((c->response_queue == NULL) || (c->response_timer != 0)) {
+        return pcmk_ok;
+    }
+
+    while ((response = g_queue_peek_head(c->response_queue)) != NULL) {
+        struct crm_ipc_response_header *header = response->iov[0].iov_base;
+
+        rc = qb_ipcs_response_sendv(c->ipcs, response->iov, 2);
+        if (rc < 0) {
+            break;
+        }
+        crm_trace("Response %d fragment to %p[%d] (%u bytes) sent",
+                  header->qb.id, c->ipcs, c->pid, header->qb.size);
+        free_queued_event(g_queue_pop_head(c->response_queue));
+
+        // The next fragment starts waiting for room now
+        response = g_queue_peek_head(c->response_queue);
+        if (response != NULL) {
+            response->queued = ipc_now_ms();
+        }
+    }
+
+    if (response == NULL) {
+        g_queue_free(c->response_queue);
+        c->response_queue = NULL;
+
+    } else if ((rc == -EAGAIN)
+               && ((ipc_now_ms() - response->queued)
+                   < (PCMK__IPC_FRAGMENT_TIMEOUT * 1000LL))) {
+        client_stats(c)->send_blocked++;
+        c->response_timer = g_timeout_add(PCMK__IPC_FLUSH_MIN_DELAY,
+                                          flush_responses_cb, c);
+
+    } else {
+        crm_notice("Dropping %u response fragments for client with process "
+                   "ID %u: %s " CRM_XS " rc=%lld ipcs=%p",
+                   g_queue_get_length(c->response_queue), c->pid,
+                   pcmk_strerror((rc == -EAGAIN)? -ETIMEDOUT : rc),
+                   (long long) rc, c->ipcs);
+        drop_responses(c);
+    }
+    return rc;
+}
+
+/*!
+ * \internal
+ * \brief Queue a prepared response to be sent to a client
+ *
+ * \param[in,out] c    Client to send response to
+ * \param[in]     iov  Prepared response (which the queue takes ownership of)
+ */
+static void
+add_response(crm_client_t *c, struct iovec *iov)
+{
+    struct crm_ipc_event_s *response = malloc(sizeof(struct crm_ipc_event_s));
+
+    CRM_ASSERT(response != NULL);
+    response->iov = iov;
+    response->queued = ipc_now_ms();
+
+    if (c->response_queue == NULL) {
+        c->response_queue = g_queue_new();
+    }
+    g_queue_push_tail(c->response_queue, response);
+}
+
+/*!
+ * \internal
+ * \brief Send a message too big for the IPC buffer to a client in fragments
+ *
+ * \param[in] c      Client to send message to
+ * \param[in] iov    Prepared message to send
+ * \param[in] flags  Group of enum crm_ipc_flags
+ *
+ * \return Total bytes queued on success, otherwise -errno
+ * \note Fragments of an event go on the client's event queue, and fragments of
+ *       a response on its response queue, so that neither blocks the server.
+ */
+static ssize_t
+send_multipart(crm_client_t *c, struct iovec *iov, uint32_t flags)
+{
+    struct crm_ipc_response_header *header = iov[0].iov_base;
+    GList *fragments = NULL;
+    ssize_t total = 0;
+
+    if (is_not_set(c->flags, crm_client_flag_ipc_multipart)) {
+        crm_err("Could not send %u-byte message to client with process ID %u "
+                "because it exceeds the configured ipc limit (%u bytes) "
+                CRM_XS " ipcs=%p", header->qb.size, c->pid, ipc_buffer_max,
+                c->ipcs);
+        return -EMSGSIZE;
+    }
+
+    fragments = split_ipc_message(iov, ipc_buffer_max);
+    for (GList *iter = fragments; iter != NULL; iter = iter->next) {
+        struct iovec *fragment = iter->data;
+
+        // The queue takes ownership of the fragment
+        if (is_set(flags, crm_ipc_server_event)) {
+            add_event(c, fragment);
+        } else {
+            add_response(c, fragment);
+        }
+        total += fragment[0].iov_len + fragment[1].iov_len;
+    }
+    g_list_free(fragments);
+
+    if (is_not_set(flags, crm_ipc_server_event)) {
+        ssize_t rc = flush_responses(c);
+
+        if ((rc < 0) && (rc != -EAGAIN)) {
+            return rc;
+        }
+    }
+    return total;
+}
+
 ssize_t
 crm_ipcs_sendv(crm_client_t * c, struct iovec * iov, enum crm_ipc_flags flags)
 {
@@ -774,7 +1727,19 @@ crm_ipcs_sendv(crm_client_t * c, struct iovec * iov, enum crm_ipc_flags flags)
     static uint32_t id = 1;
     struct crm_ipc_response_header *header = iov[0].iov_base;
 
-    if (c->flags & crm_client_flag_ipc_proxied) {
+    crm_ipc_init();
+
+    if (is_not_set(flags, crm_ipc_server_event)
+        && (c->async_requests != NULL)
+        && g_hash_table_remove(c->async_requests,
+                               GUINT_TO_POINTER(header->qb.id))) {
+        /* The client asked for the reply to this request as an event, which
+         * keeps the request ID so the client can match it (see
+         * pcmk__ipc_send_async())
+         */
+        flags |= crm_ipc_server_event|crm_ipc_async;
+
+    } else if (c->flags & crm_client_flag_ipc_proxied) {
         /* _ALL_ replies to proxied connections need to be sent as events */
         if (is_not_set(flags, crm_ipc_server_event)) {
             flags |= crm_ipc_server_event;
@@ -784,11 +1749,31 @@ crm_ipcs_sendv(crm_client_t * c, struct iovec * iov, enum crm_ipc_flags flags)
         }
     }
 
-    header->flags |= flags;
+    /* Let the client know what servers can receive. The encoding of this
+     * message itself was decided when it was prepared.
+     */
+    header->flags |= (flags & ~PCMK__IPC_ENCODING_FLAGS) | crm_ipc_binary_ok
+                     | crm_ipc_multipart_ok | crm_ipc_async_ok
+                     | local_codec_flags();
+
+    client_stats(c)->bytes_out += header->qb.size;
+    client_stats(c)->raw_bytes_out += hdr_offset + header->size_uncompressed;
+
     if (flags & crm_ipc_server_event) {
-        header->qb.id = id++;   /* We don't really use it, but doesn't hurt to set one */
+        if (is_not_set(flags, crm_ipc_async)) {
+            header->qb.id = id++;   /* We don't really use it, but doesn't hurt to set one */
+        }
 
-        if (flags & crm_ipc_server_free) {
+        if (header->qb.size >= ipc_buffer_max) {
+            rc = send_multipart(c, iov, flags);
+            if (flags & crm_ipc_server_free) {
+                pcmk_free_ipc_event(iov);
+            }
+            if (rc < 0) {
+                return rc;
+            }
+
+        } else if (flags & crm_ipc_server_free) {
             crm_trace("Sending the original to %p[%d]", c->ipcs, c->pid);
             add_event(c, iov);
 
@@ -810,7 +1795,27 @@ crm_ipcs_sendv(crm_client_t * c, struct iovec * iov, enum crm_ipc_flags flags)
     } else {
         CRM_LOG_ASSERT(header->qb.id != 0);     /* Replying to a specific request */
 
-        rc = qb_ipcs_response_sendv(c->ipcs, iov, 2);
+        if (header->qb.size >= ipc_buffer_max) {
+            rc = send_multipart(c, iov, flags);
+
+        } else if (c->response_queue != NULL) {
+            // Don't let this overtake an earlier response still being sent
+            struct iovec *iov_copy = pcmk__new_ipc_event();
+
+            iov_copy[0].iov_len = iov[0].iov_len;
+            iov_copy[0].iov_base = malloc(iov[0].iov_len);
+            memcpy(iov_copy[0].iov_base, iov[0].iov_base, iov[0].iov_len);
+
+            iov_copy[1].iov_len = iov[1].iov_len;
+            iov_copy[1].iov_base = malloc(iov[1].iov_len);
+            memcpy(iov_copy[1].iov_base, iov[1].iov_base, iov[1].iov_len);
+
+            add_response(c, iov_copy);
+            rc = header->qb.size;
+
+        } else {
+            rc = qb_ipcs_response_sendv(c->ipcs, iov, 2);
+        }
         if (rc < header->qb.size) {
             crm_notice("Response %d to pid %d failed: %s "
                        CRM_XS " bytes=%u rc=%lld ipcs=%p",
@@ -820,6 +1825,7 @@ crm_ipcs_sendv(crm_client_t * c, struct iovec * iov, enum crm_ipc_flags flags)
         } else {
             crm_trace("Response %d sent, %lld bytes to %p[%d]",
                       header->qb.id, (long long) rc, c->ipcs, c->pid);
+            client_stats(c)->responses++;
         }
 
         if (flags & crm_ipc_server_free) {
@@ -852,7 +1858,8 @@ crm_ipcs_send(crm_client_t * c, uint32_t request, xmlNode * message,
     }
     crm_ipc_init();
 
-    rc = crm_ipc_prepare(request, message, &iov, ipc_buffer_max);
+    rc = pcmk__ipc_prepare(request, message, &iov, ipc_buffer_max,
+                           pcmk__ipc_client_accepts(c));
     if (rc > 0) {
         rc = crm_ipcs_sendv(c, iov, flags | crm_ipc_server_free);
     } else {
@@ -863,6 +1870,36 @@ crm_ipcs_send(crm_client_t * c, uint32_t request, xmlNode * message,
     return rc;
 }
 
+/*!
+ * \internal
+ * \brief Get the encodings an IPC client has said it can receive
+ *
+ * \param[in] c  IPC client
+ *
+ * \return crm_ipc_*_ok header flags for encodings \p c has advertised
+ */
+uint32_t
+pcmk__ipc_client_accepts(crm_client_t *c)
+{
+    uint32_t flags = 0;
+
+    CRM_CHECK(c != NULL, return 0);
+
+    if (is_set(c->flags, crm_client_flag_ipc_binary)) {
+        flags |= crm_ipc_binary_ok;
+    }
+    if (is_set(c->flags, crm_client_flag_ipc_lz4)) {
+        flags |= crm_ipc_lz4_ok;
+    }
+    if (is_set(c->flags, crm_client_flag_ipc_zstd)) {
+        flags |= crm_ipc_zstd_ok;
+    }
+    if (is_set(c->flags, crm_client_flag_ipc_multipart)) {
+        flags |= crm_ipc_multipart_ok;
+    }
+    return flags;
+}
+
 void
 crm_ipcs_send_ack(crm_client_t * c, uint32_t request, uint32_t flags, const char *tag, const char *function,
                   int line)
@@ -896,10 +1933,38 @@ struct crm_ipc_s {
     char *buffer;
     char *name;
 
+    uint32_t peer_flags; /* crm_ipc_*_ok flags advertised by server */
+    bool accept_binary; /* caller reads messages with pcmk__ipc_buffer_xml() */
+    bool accept_batch;  /* caller reads events until no batch is pending */
+    char *text;         /* text form of binary message, for crm_ipc_buffer() */
+
+    struct crm_ipc_parts_s *event_parts;  /* multipart event being received */
+    struct crm_ipc_parts_s *reply_parts;  /* multipart reply being received */
+
+    char *batch;                /* batch of events being read */
+    unsigned int batch_len;     /* size of batch */
+    unsigned int batch_offset;  /* where next event in batch starts */
+
+    GHashTable *pending;        /* asynchronous requests awaiting a reply */
+
     qb_ipcc_connection_t *ipc;
 
 };
 
+/* An asynchronous request awaiting its reply */
+struct crm_ipc_request_s {
+    crm_ipc_t *client;              /* Connection request was sent on */
+    uint32_t id;                    /* Request ID (and so, reply ID) */
+    long long deadline;             /* When to give up (see ipc_now_ms()) */
+    guint timer;                    /* Main loop source for timeout */
+    pcmk__ipc_reply_fn callback;    /* What to do with the reply */
+    void *user_data;                /* Caller data for callback */
+};
+
+static uint32_t ipc_request_id = 0; /* Last request ID used by this process */
+
+static void fail_async_requests(crm_ipc_t *client, int rc);
+
 static unsigned int
 pick_ipc_buffer(unsigned int max)
 {
@@ -956,6 +2021,31 @@ crm_ipc_connect(crm_ipc_t * client)
 {
     static uid_t cl_uid = 0;
     static gid_t cl_gid = 0;
+    int rv;
+
+    if (!cl_uid && !cl_gid
+            && (rv = crm_user_lookup(CRM_DAEMON_USER, &cl_uid, &cl_gid)) < 0) {
+        errno = -rv;
+        return FALSE;
+    }
+    return pcmk__connect_ipc(client, cl_uid, cl_gid);
+}
+
+/*!
+ * \internal
+ * \brief Establish an IPC connection to a server run by a given user
+ *
+ * \param[in] client      Connection instance obtained from crm_ipc_new()
+ * \param[in] server_uid  Server must run as root or this user ...
+ * \param[in] server_gid  ... or this group
+ *
+ * \return As for crm_ipc_connect()
+ * \note crm_ipc_connect() connects to servers run by the cluster user, but
+ *       this allows testing with servers run by any user.
+ */
+bool
+pcmk__connect_ipc(crm_ipc_t *client, uid_t server_uid, gid_t server_gid)
+{
     pid_t found_pid = 0; uid_t found_uid = 0; gid_t found_gid = 0;
     int rv;
 
@@ -976,16 +2066,8 @@ crm_ipc_connect(crm_ipc_t * client)
         return FALSE;
     }
 
-    if (!cl_uid && !cl_gid
-            && (rv = crm_user_lookup(CRM_DAEMON_USER, &cl_uid, &cl_gid)) < 0) {
-        errno = -rv;
-        /* message already omitted */
-        crm_ipc_close(client);
-        errno = -rv;
-        return FALSE;
-    }
-
-    if (!(rv = crm_ipc_is_authentic_process(client->pfd.fd, cl_uid, cl_gid,
+    if (!(rv = crm_ipc_is_authentic_process(client->pfd.fd, server_uid,
+                                            server_gid,
                                             &found_pid, &found_uid,
                                             &found_gid))) {
         crm_err("Daemon (IPC %s) is not authentic:"
@@ -1031,6 +2113,7 @@ crm_ipc_close(crm_ipc_t * client)
             client->ipc = NULL;
             qb_ipcc_disconnect(ipc);
         }
+        fail_async_requests(client, -ENOTCONN);
     }
 }
 
@@ -1051,8 +2134,16 @@ crm_ipc_destroy(crm_ipc_t * client)
             /* crm_ipc_close(client); */
         }
         crm_trace("Destroying IPC connection to %s: %p", client->name, client);
+        fail_async_requests(client, -ENOTCONN);
+        if (client->pending != NULL) {
+            g_hash_table_destroy(client->pending);
+        }
         free(client->buffer);
         free(client->name);
+        free(client->text);
+        free_parts(client->event_parts);
+        free_parts(client->reply_parts);
+        free(client->batch);
         free(client);
     }
 }
@@ -1112,6 +2203,9 @@ crm_ipc_ready(crm_ipc_t *client)
 
     if (crm_ipc_connected(client) == FALSE) {
         return -ENOTCONN;
+
+    } else if (client->batch != NULL) {
+        return 1;
     }
 
     client->pfd.revents = 0;
@@ -1119,6 +2213,149 @@ crm_ipc_ready(crm_ipc_t *client)
     return (rc < 0)? -errno : rc;
 }
 
+/*!
+ * \internal
+ * \brief Update connection state after receiving a message into its buffer
+ *
+ * \param[in] client  Connection that received a message
+ */
+static void
+ipc_message_received(crm_ipc_t *client)
+{
+    struct crm_ipc_response_header *header = (struct crm_ipc_response_header *)(void*)client->buffer;
+
+    free(client->text);
+    client->text = NULL;
+
+    // Use whatever encodings the server understands for anything we send
+    client->peer_flags |= header->flags & PCMK__IPC_ACCEPT_FLAGS;
+}
+
+/*!
+ * \internal
+ * \brief Add a received message to any multipart message it is part of
+ *
+ * \param[in,out] client  Connection whose buffer has a new message
+ * \param[in,out] parts   Multipart message being received on that channel
+ * \param[in]     size    Size of new message
+ *
+ * \return pcmk_ok if the buffer now has a whole message, -EAGAIN if it was a
+ *         fragment and more are needed, otherwise -errno
+ */
+static int
+crm_ipc_reassemble(crm_ipc_t *client, struct crm_ipc_parts_s **parts,
+                   size_t size)
+{
+    struct crm_ipc_response_header *header = (struct crm_ipc_response_header *)(void*)client->buffer;
+    char *whole = NULL;
+    unsigned int whole_size = 0;
+    int rc = pcmk_ok;
+
+    if (is_not_set(header->flags, crm_ipc_multipart)) {
+        return pcmk_ok;
+    }
+
+    /* never let buf size fall below our max size required for ipc reads. */
+    rc = add_fragment(parts, client->buffer, size, client->max_buf_size,
+                      multipart_max(client->max_buf_size), &whole, &whole_size);
+    if (rc == pcmk_ok) {
+        free(client->buffer);
+        client->buffer = whole;
+        client->buf_size = whole_size;
+    }
+    return rc;
+}
+
+/*!
+ * \internal
+ * \brief Check whether a connection has events left from a received batch
+ *
+ * \param[in] client  Connection to check
+ *
+ * \return true if crm_ipc_read() will return an event without reading from
+ *         the connection, otherwise false
+ * \note Such events do not make the connection's file descriptor readable, so
+ *       callers that wait for that must check this first.
+ */
+bool
+pcmk__ipc_batch_pending(crm_ipc_t *client)
+{
+    return (client != NULL) && (client->batch != NULL);
+}
+
+/*!
+ * \internal
+ * \brief Move the next event of a received batch into a connection's buffer
+ *
+ * \param[in,out] client  Connection with a batch of events
+ *
+ * \return Size of event now in buffer, or -EBADMSG if the batch is invalid
+ *         (in which case the rest of it is discarded)
+ */
+static int
+next_batched_event(crm_ipc_t *client)
+{
+    struct crm_ipc_response_header header;
+    unsigned int remaining = client->batch_len - client->batch_offset;
+    int size = -EBADMSG;
+
+    CRM_ASSERT(client->batch != NULL);
+
+    // Events within a batch are not aligned, so copy the header out first
+    if (remaining >= hdr_offset) {
+        memcpy(&header, client->batch + client->batch_offset, hdr_offset);
+        if ((header.qb.size >= hdr_offset) && (header.qb.size <= remaining)
+            && (header.qb.size <= client->buf_size)
+            && is_not_set(header.flags, crm_ipc_batch)) {
+
+            size = header.qb.size;
+            memcpy(client->buffer, client->batch + client->batch_offset, size);
+            client->batch_offset += size;
+        }
+    }
+    if (size < 0) {
+        crm_err("Discarding invalid batch of IPC events from %s", client->name);
+    }
+
+    if ((size < 0) || (client->batch_offset >= client->batch_len)) {
+        free(client->batch);
+        client->batch = NULL;
+    }
+    return size;
+}
+
+/*!
+ * \internal
+ * \brief Start reading events from a batch received in a connection's buffer
+ *
+ * \param[in,out] client  Connection that received a batch
+ *
+ * \return Size of first event (now in buffer), or -EBADMSG if batch is invalid
+ */
+static int
+start_batch(crm_ipc_t *client)
+{
+    struct crm_ipc_response_header *header = (struct crm_ipc_response_header *)(void*)client->buffer;
+
+    if ((client->msg_size < hdr_offset)
+        || (header->size_uncompressed > (client->msg_size - hdr_offset))) {
+        crm_err("Discarding truncated batch of IPC events from %s",
+                client->name);
+        return -EBADMSG;
+    }
+
+    // The batch keeps the received buffer, and the events get a new one
+    client->batch = client->buffer;
+    client->batch_offset = hdr_offset;
+    client->batch_len = hdr_offset + header->size_uncompressed;
+    client->buffer = malloc(client->buf_size);
+    CRM_ASSERT(client->buffer != NULL);
+
+    crm_trace("Received batch of %u bytes of events from %s",
+              header->size_uncompressed, client->name);
+    return next_batched_event(client);
+}
+
 static int
 crm_ipc_decompress(crm_ipc_t * client)
 {
@@ -1134,12 +2371,11 @@ crm_ipc_decompress(crm_ipc_t * client)
         crm_trace("Decompressing message data %u bytes into %u bytes",
                  header->size_compressed, size_u);
 
-        rc = BZ2_bzBuffToBuffDecompress(uncompressed + hdr_offset, &size_u,
-                                        client->buffer + hdr_offset, header->size_compressed, 1, 0);
-
-        if (rc != BZ_OK) {
-            crm_err("Decompression failed: %s " CRM_XS " bzerror=%d",
-                    bz2_strerror(rc), rc);
+        rc = pcmk__decompress(header_codec(header->flags),
+                              client->buffer + hdr_offset,
+                              header->size_compressed,
+                              uncompressed + hdr_offset, &size_u);
+        if (rc != pcmk_ok) {
             free(uncompressed);
             return -EILSEQ;
         }
@@ -1178,13 +2414,31 @@ crm_ipc_read(crm_ipc_t * client)
     crm_ipc_init();
 
     client->buffer[0] = 0;
-    client->msg_size = qb_ipcc_event_recv(client->ipc, client->buffer,
-                                          client->buf_size, 0);
-    if (client->msg_size >= 0) {
-        int rc = crm_ipc_decompress(client);
+    if (client->batch != NULL) {
+        client->msg_size = next_batched_event(client);
 
-        if (rc != pcmk_ok) {
-            return rc;
+    } else {
+        client->msg_size = qb_ipcc_event_recv(client->ipc, client->buffer,
+                                              client->buf_size, 0);
+        if ((client->msg_size > 0)
+            && is_set(((struct crm_ipc_response_header *)(void*)client->buffer)->flags,
+                      crm_ipc_batch)) {
+            client->msg_size = start_batch(client);
+        }
+    }
+    if (client->msg_size >= 0) {
+        int rc = 0;
+
+        ipc_message_received(client);
+        rc = crm_ipc_reassemble(client, &(client->event_parts),
+                                client->msg_size);
+        if (rc != pcmk_ok) {
+            return rc;
+        }
+
+        rc = crm_ipc_decompress(client);
+        if (rc != pcmk_ok) {
+            return rc;
         }
 
         header = (struct crm_ipc_response_header *)(void*)client->buffer;
@@ -1196,7 +2450,8 @@ crm_ipc_read(crm_ipc_t * client)
 
         crm_trace("Received %s event %d, size=%u, rc=%d, text: %.100s",
                   client->name, header->qb.id, header->qb.size, client->msg_size,
-                  client->buffer + hdr_offset);
+                  is_set(header->flags, crm_ipc_binary)? "(binary)"
+                  : client->buffer + hdr_offset);
 
     } else {
         crm_trace("No message from %s received: %s", client->name, pcmk_strerror(client->msg_size));
@@ -1216,10 +2471,90 @@ crm_ipc_read(crm_ipc_t * client)
 const char *
 crm_ipc_buffer(crm_ipc_t * client)
 {
+    struct crm_ipc_response_header *header = NULL;
+
     CRM_ASSERT(client != NULL);
+    header = (struct crm_ipc_response_header *)(void*)client->buffer;
+
+    if (is_set(header->flags, crm_ipc_binary)) {
+        /* Callers of this function expect text, so convert the message (it is
+         * cheaper for callers to use pcmk__ipc_buffer_xml() instead).
+         */
+        if (client->text == NULL) {
+            xmlNode *xml = pcmk__binary2xml(client->buffer + hdr_offset,
+                                            header->size_uncompressed);
+
+            client->text = xml? dump_xml_unformatted(xml) : strdup("");
+            free_xml(xml);
+        }
+        return client->text;
+    }
     return client->buffer + sizeof(struct crm_ipc_response_header);
 }
 
+/*!
+ * \internal
+ * \brief Get XML from the most recently received IPC message
+ *
+ * \param[in] client  Connection that received the message
+ *
+ * \return Newly allocated XML from message buffer (or NULL on error)
+ * \note Unlike string2xml(crm_ipc_buffer()), this decodes binary messages
+ *       directly to XML. The caller is responsible for freeing the result
+ *       with free_xml().
+ */
+xmlNode *
+pcmk__ipc_buffer_xml(crm_ipc_t *client)
+{
+    struct crm_ipc_response_header *header = NULL;
+
+    CRM_ASSERT(client != NULL);
+    header = (struct crm_ipc_response_header *)(void*)client->buffer;
+
+    if (is_set(header->flags, crm_ipc_binary)) {
+        return pcmk__binary2xml(client->buffer + hdr_offset,
+                                header->size_uncompressed);
+    }
+    return string2xml(client->buffer + hdr_offset);
+}
+
+/*!
+ * \internal
+ * \brief Ask the server to send binary XML on an IPC connection
+ *
+ * \param[in] client  Connection to update
+ *
+ * \note The server will start using binary XML after receiving the next
+ *       request on this connection. The caller should get incoming messages
+ *       with pcmk__ipc_buffer_xml(), as crm_ipc_buffer() would have to convert
+ *       binary messages back to text.
+ */
+void
+pcmk__ipc_accept_binary(crm_ipc_t *client)
+{
+    CRM_ASSERT(client != NULL);
+    client->accept_binary = true;
+}
+
+/*!
+ * \internal
+ * \brief Ask the server to send backlogged events in batches on a connection
+ *
+ * \param[in] client  Connection to update
+ *
+ * \note The server will start batching events after receiving the next
+ *       request on this connection. Events left in a received batch do not
+ *       make the connection's file descriptor readable, so this is only for
+ *       connections whose reader keeps calling crm_ipc_read() while
+ *       pcmk__ipc_batch_pending() is true, as the main loop IPC source does.
+ */
+void
+pcmk__ipc_accept_batch(crm_ipc_t *client)
+{
+    CRM_ASSERT(client != NULL);
+    client->accept_batch = true;
+}
+
 uint32_t
 crm_ipc_buffer_flags(crm_ipc_t * client)
 {
@@ -1266,6 +2601,36 @@ internal_ipc_send_request(crm_ipc_t * client, const void *iov, int ms_timeout)
     return rc;
 }
 
+/*!
+ * \internal
+ * \brief Send a request too big for the IPC buffer in fragments
+ *
+ * \param[in] client      Connection to send request on
+ * \param[in] iov         Prepared request to send
+ * \param[in] ms_timeout  How long to wait for room to send each fragment
+ *
+ * \return Total bytes sent on success, otherwise -errno
+ */
+static int
+internal_ipc_send_multipart(crm_ipc_t *client, struct iovec *iov,
+                            int ms_timeout)
+{
+    GList *fragments = split_ipc_message(iov, client->max_buf_size);
+    int total = 0;
+
+    for (GList *iter = fragments; iter != NULL; iter = iter->next) {
+        int rc = internal_ipc_send_request(client, iter->data, ms_timeout);
+
+        if (rc <= 0) {
+            total = rc;
+            break;
+        }
+        total += rc;
+    }
+    g_list_free_full(fragments, free_event);
+    return total;
+}
+
 static int
 internal_ipc_get_reply(crm_ipc_t * client, int request_id, int ms_timeout)
 {
@@ -1281,8 +2646,21 @@ internal_ipc_get_reply(crm_ipc_t * client, int request_id, int ms_timeout)
         rc = qb_ipcc_recv(client->ipc, client->buffer, client->buf_size, 1000);
         if (rc > 0) {
             struct crm_ipc_response_header *hdr = NULL;
+            size_t size = rc;
+            int rc = 0;
+
+            ipc_message_received(client);
+            rc = crm_ipc_reassemble(client, &(client->reply_parts), size);
+            if (rc == -EAGAIN) {
+                // Keep waiting as long as fragments keep arriving
+                timeout = time(NULL) + 1 + (ms_timeout / 1000);
+                continue;
+
+            } else if (rc != pcmk_ok) {
+                continue;
+            }
 
-            int rc = crm_ipc_decompress(client);
+            rc = crm_ipc_decompress(client);
 
             if (rc != pcmk_ok) {
                 return rc;
@@ -1293,13 +2671,13 @@ internal_ipc_get_reply(crm_ipc_t * client, int request_id, int ms_timeout)
                 /* Got it */
                 break;
             } else if (hdr->qb.id < request_id) {
-                xmlNode *bad = string2xml(crm_ipc_buffer(client));
+                xmlNode *bad = pcmk__ipc_buffer_xml(client);
 
                 crm_err("Discarding old reply %d (need %d)", hdr->qb.id, request_id);
                 crm_log_xml_notice(bad, "OldIpcReply");
 
             } else {
-                xmlNode *bad = string2xml(crm_ipc_buffer(client));
+                xmlNode *bad = pcmk__ipc_buffer_xml(client);
 
                 crm_err("Discarding newer reply %d (need %d)", hdr->qb.id, request_id);
                 crm_log_xml_notice(bad, "ImpossibleReply");
@@ -1313,16 +2691,87 @@ internal_ipc_get_reply(crm_ipc_t * client, int request_id, int ms_timeout)
 
     } while (time(NULL) < timeout);
 
+    if ((rc > 0) && (client->reply_parts != NULL)) {
+        // Timed out partway through a multipart reply
+        rc = -ETIMEDOUT;
+    }
+    return rc;
+}
+
+/*!
+ * \internal
+ * \brief Prepare a request for sending on an IPC connection
+ *
+ * \param[in]  client   Connection request will be sent on
+ * \param[in]  message  Request XML
+ * \param[in]  flags    Bitmask of crm_ipc_flags for request header
+ * \param[out] iov      Where to store prepared request
+ *
+ * \return Bytes prepared on success, otherwise -errno
+ * \note The request gets the next request ID, which callers can find in the
+ *       header. The caller is responsible for freeing *iov with
+ *       pcmk_free_ipc_event().
+ */
+static ssize_t
+prepare_request(crm_ipc_t *client, xmlNode *message, uint32_t flags,
+                struct iovec **iov)
+{
+    struct crm_ipc_response_header *header = NULL;
+    ssize_t rc = 0;
+
+    ipc_request_id++;
+    CRM_LOG_ASSERT(ipc_request_id != 0); /* Crude wrap-around detection */
+    rc = pcmk__ipc_prepare(ipc_request_id, message, iov, client->max_buf_size,
+                           client->peer_flags);
+    if (rc < 0) {
+        return rc;
+    }
+
+    /* Only pcmk__ipc_send_async() may ask for the reply as an event (proxies
+     * relay flags they received, but not the replies to them)
+     */
+    header = (*iov)[0].iov_base;
+    header->flags |= (flags & ~(PCMK__IPC_ENCODING_FLAGS|crm_ipc_async))
+                     | crm_ipc_multipart_ok | local_codec_flags();
+    if (client->accept_binary) {
+        header->flags |= crm_ipc_binary_ok;
+    }
+    if (client->accept_batch) {
+        header->flags |= crm_ipc_batch_ok;
+    }
     return rc;
 }
 
+/*!
+ * \internal
+ * \brief Send a prepared request without waiting for a reply
+ *
+ * \param[in] client      Connection to send request on
+ * \param[in] iov         Request prepared by prepare_request()
+ * \param[in] ms_timeout  How long to wait for room to send
+ *
+ * \return Bytes sent on success, otherwise -errno
+ */
+static int
+send_prepared_request(crm_ipc_t *client, struct iovec *iov, int ms_timeout)
+{
+    struct crm_ipc_response_header *header = iov[0].iov_base;
+
+    if (header->qb.size >= client->max_buf_size) {
+        /* pcmk__ipc_prepare() allows this only if the server can
+         * reassemble fragments
+         */
+        return internal_ipc_send_multipart(client, iov, ms_timeout);
+    }
+    return internal_ipc_send_request(client, iov, ms_timeout);
+}
+
 int
 crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, int32_t ms_timeout,
              xmlNode ** reply)
 {
     long rc = 0;
     struct iovec *iov;
-    static uint32_t id = 0;
     static int factor = 8;
     struct crm_ipc_response_header *header;
 
@@ -1353,26 +2802,24 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
         } else {
             crm_notice("Lost reply from %s (%p) finally arrived, sending re-enabled", client->name,
                        client->ipc);
+            ipc_message_received(client);
             client->need_reply = FALSE;
         }
     }
 
-    id++;
-    CRM_LOG_ASSERT(id != 0); /* Crude wrap-around detection */
-    rc = crm_ipc_prepare(id, message, &iov, client->max_buf_size);
+    rc = prepare_request(client, message, flags, &iov);
     if(rc < 0) {
         return rc;
     }
-
     header = iov[0].iov_base;
-    header->flags |= flags;
 
     if(is_set(flags, crm_ipc_proxied)) {
         /* Don't look for a synchronous response */
         clear_bit(flags, crm_ipc_client_response);
     }
 
-    if(header->size_compressed) {
+    if (header->size_compressed
+        && is_not_set(client->peer_flags, crm_ipc_multipart_ok)) {
         if(factor < 10 && (client->max_buf_size / 10) < (rc / factor)) {
             crm_notice("Compressed message exceeds %d0%% of the configured ipc limit (%u bytes), "
                        "consider setting PCMK_ipc_buffer to %u or higher",
@@ -1384,10 +2831,10 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
     crm_trace("Sending from client: %s request id: %d bytes: %u timeout:%d msg...",
               client->name, header->qb.id, header->qb.size, ms_timeout);
 
-    if (ms_timeout > 0 || is_not_set(flags, crm_ipc_client_response)) {
-
-        rc = internal_ipc_send_request(client, iov, ms_timeout);
+    if (ms_timeout > 0 || is_not_set(flags, crm_ipc_client_response)
+        || (header->qb.size >= client->max_buf_size)) {
 
+        rc = send_prepared_request(client, iov, ms_timeout);
         if (rc <= 0) {
             crm_trace("Failed to send from client %s request %d with %u bytes...",
                       client->name, header->qb.id, header->qb.size);
@@ -1414,6 +2861,20 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
 
     } else {
         rc = internal_ipc_send_recv(client, iov);
+        if (rc > 0) {
+            int reassembled = 0;
+
+            ipc_message_received(client);
+            reassembled = crm_ipc_reassemble(client, &(client->reply_parts),
+                                             rc);
+            if (reassembled == -EAGAIN) {
+                // The reply was the first of several fragments
+                rc = internal_ipc_get_reply(client, header->qb.id, 5000);
+
+            } else if (reassembled != pcmk_ok) {
+                rc = reassembled;
+            }
+        }
     }
 
     if (rc > 0) {
@@ -1423,7 +2884,7 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
                   rc, crm_ipc_buffer(client));
 
         if (reply) {
-            *reply = string2xml(crm_ipc_buffer(client));
+            *reply = pcmk__ipc_buffer_xml(client);
         }
 
     } else {
@@ -1448,6 +2909,392 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
     return rc;
 }
 
+static gint
+compare_async_requests(gconstpointer a, gconstpointer b)
+{
+    uint32_t id_a = ((const struct crm_ipc_request_s *) a)->id;
+    uint32_t id_b = ((const struct crm_ipc_request_s *) b)->id;
+
+    return (id_a < id_b)? -1 : (id_a > id_b);
+}
+
+/*!
+ * \internal
+ * \brief Remove asynchronous requests from a connection's pending table
+ *
+ * \param[in,out] client        Connection with pending requests
+ * \param[in]     expired_only  If true, take only requests past their deadline
+ *
+ * \return List of requests taken, in the order they were sent
+ */
+static GList *
+take_async_requests(crm_ipc_t *client, bool expired_only)
+{
+    GHashTableIter iter;
+    struct crm_ipc_request_s *request = NULL;
+    long long now = ipc_now_ms();
+    GList *taken = NULL;
+
+    if (client->pending == NULL) {
+        return NULL;
+    }
+
+    g_hash_table_iter_init(&iter, client->pending);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &request)) {
+        if (!expired_only
+            || ((request->deadline > 0) && (request->deadline <= now))) {
+            taken = g_list_prepend(taken, request);
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+    return g_list_sort(taken, compare_async_requests);
+}
+
+/*!
+ * \internal
+ * \brief Report the outcome of an asynchronous request and free it
+ *
+ * \param[in] request  Request no longer in its connection's pending table
+ * \param[in] rc       pcmk_ok if a reply was received, otherwise -errno
+ * \param[in] reply    Reply received, if any
+ */
+static void
+finish_async_request(struct crm_ipc_request_s *request, int rc,
+                     xmlNode *reply)
+{
+    if (request->timer != 0) {
+        g_source_remove(request->timer);
+        request->timer = 0;
+    }
+    if (request->callback != NULL) {
+        request->callback(request->client, request->id, rc, reply,
+                          request->user_data);
+    }
+    free(request);
+}
+
+/*!
+ * \internal
+ * \brief Report a failure for (some) pending asynchronous requests
+ *
+ * \param[in,out] client        Connection with pending requests
+ * \param[in]     rc            Failure to report (-errno)
+ * \param[in]     expired_only  If true, fail only requests past their deadline
+ */
+static void
+fail_requests(crm_ipc_t *client, int rc, bool expired_only)
+{
+    GList *failed = take_async_requests(client, expired_only);
+
+    for (GList *iter = failed; iter != NULL; iter = iter->next) {
+        struct crm_ipc_request_s *request = iter->data;
+
+        crm_warn("Request %u to %s failed: %s " CRM_XS " rc=%d",
+                 request->id, client->name, pcmk_strerror(rc), rc);
+        finish_async_request(request, rc, NULL);
+    }
+    g_list_free(failed);
+}
+
+/*!
+ * \internal
+ * \brief Report a failure for all pending asynchronous requests
+ *
+ * \param[in,out] client  Connection with pending requests
+ * \param[in]     rc      Failure to report (-errno)
+ */
+static void
+fail_async_requests(crm_ipc_t *client, int rc)
+{
+    fail_requests(client, rc, false);
+}
+
+// Main loop timer callback for an asynchronous request's timeout
+static gboolean
+async_request_timeout(gpointer data)
+{
+    struct crm_ipc_request_s *request = data;
+    crm_ipc_t *client = request->client;
+
+    request->timer = 0;
+    g_hash_table_remove(client->pending, GUINT_TO_POINTER(request->id));
+    crm_warn("Request %u to %s failed: %s " CRM_XS " rc=%d",
+             request->id, client->name, pcmk_strerror(-ETIMEDOUT), -ETIMEDOUT);
+    finish_async_request(request, -ETIMEDOUT, NULL);
+    return FALSE;
+}
+
+/*!
+ * \internal
+ * \brief Send a request and wait for its reply, then pass that to a callback
+ *
+ * \param[in]  client      Connection to send request on
+ * \param[in]  message     Request XML
+ * \param[in]  flags       Bitmask of crm_ipc_flags for request header
+ * \param[in]  ms_timeout  As for crm_ipc_send()
+ * \param[in]  callback    Function to call with the reply
+ * \param[in]  user_data   Caller data to pass to \p callback
+ * \param[out] request_id  If not NULL, where to store ID of request
+ *
+ * \return pcmk_ok if a reply was received, otherwise -errno (in which case
+ *         \p callback will not be called)
+ */
+static int
+send_sync_request(crm_ipc_t *client, xmlNode *message,
+                  enum crm_ipc_flags flags, int32_t ms_timeout,
+                  pcmk__ipc_reply_fn callback, void *user_data,
+                  uint32_t *request_id)
+{
+    xmlNode *reply = NULL;
+    uint32_t id = 0;
+    int rc = crm_ipc_send(client, message, flags | crm_ipc_client_response,
+                          ms_timeout, &reply);
+
+    if (rc <= 0) {
+        return (rc < 0)? rc : -ECOMM;
+    }
+
+    // crm_ipc_send() used the latest request ID
+    id = ipc_request_id;
+    crm_trace("Received reply %u from %s synchronously", id, client->name);
+    if (request_id != NULL) {
+        *request_id = id;
+    }
+    if (callback != NULL) {
+        callback(client, id, ((reply == NULL)? -EBADMSG : pcmk_ok), reply,
+                 user_data);
+    }
+    free_xml(reply);
+    return pcmk_ok;
+}
+
+/*!
+ * \internal
+ * \brief Send an IPC request without waiting for its reply
+ *
+ * Any number of requests may be in flight on a connection at once. Replies
+ * arrive as events, and are matched to their request by ID when read (with
+ * crm_ipc_read() followed by pcmk__ipc_dispatch_reply(), which the main loop
+ * IPC source does automatically, or with pcmk__ipc_wait_async()).
+ *
+ * Servers advertise crm_ipc_async_ok in every message they send once they
+ * can answer requests with events. Until one has been received from the
+ * server on this connection (for example, on the first request), the request
+ * is sent synchronously and \p callback is called before this returns.
+ *
+ * \param[in]  client      Connection to send request on
+ * \param[in]  message     Request XML
+ * \param[in]  flags       Bitmask of crm_ipc_flags for request header
+ * \param[in]  ms_timeout  Give up on reply after this many milliseconds
+ *                         (0 means 5 seconds, and negative means never)
+ * \param[in]  callback    Function to call with the reply or failure
+ * \param[in]  user_data   Caller data to pass to \p callback
+ * \param[out] request_id  If not NULL, where to store ID of request
+ *
+ * \return pcmk_ok if request was sent, otherwise -errno (in which case
+ *         \p callback will not be called)
+ * \note Only replies to these requests are sent as events, so crm_ipc_send()
+ *       may still be used on the same connection.
+ */
+int
+pcmk__ipc_send_async(crm_ipc_t *client, xmlNode *message,
+                     enum crm_ipc_flags flags, int32_t ms_timeout,
+                     pcmk__ipc_reply_fn callback, void *user_data,
+                     uint32_t *request_id)
+{
+    int rc = 0;
+    struct iovec *iov = NULL;
+    struct crm_ipc_response_header *header = NULL;
+    struct crm_ipc_request_s *request = NULL;
+
+    crm_ipc_init();
+
+    if ((client == NULL) || (crm_ipc_connected(client) == FALSE)) {
+        crm_notice("Cannot send request: Connection %s",
+                   ((client == NULL)? "invalid" : "closed"));
+        return -ENOTCONN;
+    }
+
+    if (is_not_set(client->peer_flags, crm_ipc_async_ok)) {
+        /* Older servers would send the reply as an ordinary response, which
+         * nothing would read
+         */
+        return send_sync_request(client, message, flags, ms_timeout,
+                                 callback, user_data, request_id);
+    }
+
+    if (ms_timeout == 0) {
+        ms_timeout = 5000;
+    }
+
+    rc = prepare_request(client, message, flags | crm_ipc_client_response,
+                         &iov);
+    if (rc < 0) {
+        return rc;
+    }
+
+    // Ask for the reply as an event that keeps this request's ID
+    header = iov[0].iov_base;
+    header->flags |= crm_ipc_async;
+
+    if (client->pending == NULL) {
+        client->pending = g_hash_table_new(g_direct_hash, g_direct_equal);
+    }
+
+    rc = send_prepared_request(client, iov, ((ms_timeout > 0)? ms_timeout : 5000));
+    if (rc <= 0) {
+        rc = (rc < 0)? rc : -ECOMM;
+        crm_warn("Request %u to %s failed: %s " CRM_XS " rc=%d",
+                 header->qb.id, client->name, pcmk_strerror(rc), rc);
+        pcmk_free_ipc_event(iov);
+        return rc;
+    }
+
+    request = calloc(1, sizeof(struct crm_ipc_request_s));
+    CRM_ASSERT(request != NULL);
+    request->client = client;
+    request->id = header->qb.id;
+    request->callback = callback;
+    request->user_data = user_data;
+    if (ms_timeout > 0) {
+        request->deadline = ipc_now_ms() + ms_timeout;
+        request->timer = g_timeout_add(ms_timeout, async_request_timeout,
+                                       request);
+    }
+    g_hash_table_insert(client->pending, GUINT_TO_POINTER(request->id),
+                        request);
+
+    crm_trace("Sent request %u to %s (%u bytes, %u in flight)",
+              request->id, client->name, header->qb.size,
+              g_hash_table_size(client->pending));
+    if (request_id != NULL) {
+        *request_id = request->id;
+    }
+    pcmk_free_ipc_event(iov);
+    return pcmk_ok;
+}
+
+/*!
+ * \internal
+ * \brief Pass a message just read to the asynchronous request it answers
+ *
+ * \param[in] client  Connection that crm_ipc_read() just read a message on
+ *
+ * \return true if the message was a reply to an asynchronous request (which
+ *         has now been handled or discarded), otherwise false (the message
+ *         should be handled as an ordinary event)
+ */
+bool
+pcmk__ipc_dispatch_reply(crm_ipc_t *client)
+{
+    struct crm_ipc_response_header *header = NULL;
+    struct crm_ipc_request_s *request = NULL;
+    xmlNode *reply = NULL;
+
+    if ((client == NULL) || (client->pending == NULL)) {
+        return false;
+    }
+
+    header = (struct crm_ipc_response_header *)(void*)client->buffer;
+    if (is_not_set(header->flags, crm_ipc_async)) {
+        return false;
+    }
+
+    request = g_hash_table_lookup(client->pending,
+                                  GUINT_TO_POINTER(header->qb.id));
+    if (request == NULL) {
+        crm_info("Discarding reply %u from %s: no such request pending "
+                 "(it may have timed out)", header->qb.id, client->name);
+        return true;
+    }
+    g_hash_table_remove(client->pending, GUINT_TO_POINTER(request->id));
+
+    reply = pcmk__ipc_buffer_xml(client);
+    crm_trace("Received reply %u from %s (%u still in flight)",
+              request->id, client->name, g_hash_table_size(client->pending));
+    finish_async_request(request, ((reply == NULL)? -EBADMSG : pcmk_ok),
+                         reply);
+    free_xml(reply);
+    return true;
+}
+
+/*!
+ * \internal
+ * \brief Count asynchronous requests awaiting a reply on a connection
+ *
+ * \param[in] client  Connection to check
+ *
+ * \return Number of requests sent with pcmk__ipc_send_async() whose callback
+ *         has not yet been called
+ */
+guint
+pcmk__ipc_async_pending(crm_ipc_t *client)
+{
+    if ((client == NULL) || (client->pending == NULL)) {
+        return 0;
+    }
+    return g_hash_table_size(client->pending);
+}
+
+/*!
+ * \internal
+ * \brief Block until all asynchronous requests on a connection are finished
+ *
+ * This is intended for command-line tools without a main loop, which can send
+ * a number of requests with pcmk__ipc_send_async() and then collect all the
+ * replies at once. Any other events received meanwhile are discarded.
+ *
+ * \param[in] client      Connection with requests in flight
+ * \param[in] ms_timeout  Give up after this many milliseconds (or if
+ *                        negative, wait only for requests' own timeouts)
+ *
+ * \return pcmk_ok if every request's callback has been called, otherwise
+ *         -errno (-ETIMEDOUT if \p ms_timeout expired first)
+ */
+int
+pcmk__ipc_wait_async(crm_ipc_t *client, int32_t ms_timeout)
+{
+    long long deadline = 0;
+
+    if (ms_timeout >= 0) {
+        deadline = ipc_now_ms() + ms_timeout;
+    }
+
+    while (pcmk__ipc_async_pending(client) > 0) {
+        long rc = 0;
+
+        fail_requests(client, -ETIMEDOUT, true);
+        if (pcmk__ipc_async_pending(client) == 0) {
+            break;
+        }
+        if ((deadline > 0) && (ipc_now_ms() >= deadline)) {
+            return -ETIMEDOUT;
+        }
+
+        if (crm_ipc_connected(client) == FALSE) {
+            fail_async_requests(client, -ENOTCONN);
+            return -ENOTCONN;
+
+        } else if (client->batch == NULL) {
+            // Wake up at least every 100ms to check deadlines
+            client->pfd.revents = 0;
+            rc = poll(&(client->pfd), 1, 100);
+            if ((rc < 0) && (errno != EINTR)) {
+                return -errno;
+            } else if (rc <= 0) {
+                continue;
+            }
+        }
+
+        rc = crm_ipc_read(client);
+        if ((rc > 0) && !pcmk__ipc_dispatch_reply(client)) {
+            crm_trace("Ignoring event from %s while waiting for replies",
+                      client->name);
+        }
+    }
+    return pcmk_ok;
+}
+
 int
 crm_ipc_is_authentic_process(int sock, uid_t refuid, gid_t refgid,
                              pid_t *gotpid, uid_t *gotuid, gid_t *gotgid) {
@@ -23,6 +23,7 @@
 #include <crm/common/xml.h>
 #include <crm/common/mainloop.h>
 #include <crm/common/ipcs.h>
+#include <crm/common/ipc_internal.h>
 
 #include <qb/qbarray.h>
 
@@ -762,6 +763,7 @@ struct mainloop_io_s {
     GIOChannel *channel;
 
     int (*dispatch_fn_ipc) (const char *buffer, ssize_t length, gpointer userdata);
+    int (*dispatch_fn_xml) (xmlNode *msg, gpointer userdata);
     int (*dispatch_fn_io) (gpointer userdata);
     void (*destroy_fn) (gpointer userdata);
 
@@ -780,12 +782,35 @@ mainloop_gio_callback(GIOChannel * gio, GIOCondition condition, gpointer data)
             long rc = 0;
             int max = 10;
 
+            /* Read up to max messages, plus any left from a batch of events
+             * (which won't make the descriptor readable again)
+             */
             do {
                 rc = crm_ipc_read(client->ipc);
-                if (rc <= 0) {
+                if (rc == -EAGAIN) {
+                    crm_trace("Partial message from %s[%p], waiting for the rest",
+                              client->name, client);
+
+                } else if (rc <= 0) {
                     crm_trace("Message acquisition from %s[%p] failed: %s (%ld)",
                               client->name, client, pcmk_strerror(rc), rc);
 
+                } else if (pcmk__ipc_dispatch_reply(client->ipc)) {
+                    crm_trace("Reply from %s[%p] passed to its request",
+                              client->name, client);
+
+                } else if (client->dispatch_fn_xml) {
+                    xmlNode *msg = pcmk__ipc_buffer_xml(client->ipc);
+                    int dispatch_rc = 0;
+
+                    crm_trace("New message from %s[%p] = %ld (I/O condition=%d)", client->name, client, rc, condition);
+                    dispatch_rc = client->dispatch_fn_xml(msg, client->userdata);
+                    free_xml(msg);
+                    if (dispatch_rc < 0) {
+                        crm_trace("Connection to %s no longer required", client->name);
+                        keep = FALSE;
+                    }
+
                 } else if (client->dispatch_fn_ipc) {
                     const char *buffer = crm_ipc_buffer(client->ipc);
 
@@ -795,8 +820,8 @@ mainloop_gio_callback(GIOChannel * gio, GIOCondition condition, gpointer data)
                         keep = FALSE;
                     }
                 }
-
-            } while (keep && rc > 0 && --max > 0);
+            } while (keep && (rc > 0 || rc == -EAGAIN)
+                     && ((--max > 0) || pcmk__ipc_batch_pending(client->ipc)));
 
         } else {
             crm_trace("New message from %s[%p] %u", client->name, client, condition);
@@ -893,6 +918,41 @@ mainloop_gio_destroy(gpointer c)
     free(c_name);
 }
 
+/*!
+ * \internal
+ * \brief Add an already connected IPC client to the main loop
+ *
+ * \param[in] ipc        Connected IPC client (which the main loop source will
+ *                       own if this succeeds)
+ * \param[in] priority   As for mainloop_add_ipc_client()
+ * \param[in] userdata   As for mainloop_add_ipc_client()
+ * \param[in] callbacks  As for mainloop_add_ipc_client()
+ *
+ * \return Main loop source for \p ipc on success, otherwise NULL
+ */
+mainloop_io_t *
+pcmk__add_mainloop_ipc(crm_ipc_t *ipc, int priority, void *userdata,
+                       struct ipc_client_callbacks *callbacks)
+{
+    mainloop_io_t *client = NULL;
+
+    CRM_CHECK((ipc != NULL) && (callbacks != NULL), return NULL);
+
+    client = mainloop_add_fd(crm_ipc_name(ipc), priority, crm_ipc_get_fd(ipc),
+                             userdata, NULL);
+    if (client == NULL) {
+        return NULL;
+    }
+
+    client->ipc = ipc;
+    client->destroy_fn = callbacks->destroy;
+    client->dispatch_fn_ipc = callbacks->dispatch;
+
+    // mainloop_gio_callback() reads every event in a batch
+    pcmk__ipc_accept_batch(ipc);
+    return client;
+}
+
 mainloop_io_t *
 mainloop_add_ipc_client(const char *name, int priority, size_t max_size, void *userdata,
                         struct ipc_client_callbacks *callbacks)
@@ -901,9 +961,7 @@ mainloop_add_ipc_client(const char *name, int priority, size_t max_size, void *u
     crm_ipc_t *conn = crm_ipc_new(name, max_size);
 
     if (conn && crm_ipc_connect(conn)) {
-        int32_t fd = crm_ipc_get_fd(conn);
-
-        client = mainloop_add_fd(name, priority, fd, userdata, NULL);
+        client = pcmk__add_mainloop_ipc(conn, priority, userdata, callbacks);
     }
 
     if (client == NULL) {
@@ -914,13 +972,30 @@ mainloop_add_ipc_client(const char *name, int priority, size_t max_size, void *u
         }
         return NULL;
     }
-
-    client->ipc = conn;
-    client->destroy_fn = callbacks->destroy;
-    client->dispatch_fn_ipc = callbacks->dispatch;
     return client;
 }
 
+/*!
+ * \internal
+ * \brief Dispatch messages on a mainloop IPC client as XML rather than text
+ *
+ * \param[in] client    Mainloop IPC client to update
+ * \param[in] dispatch  Function to call for each message received (which
+ *                      must not free or keep the message)
+ *
+ * \note This also asks the server to use binary XML on the connection, which
+ *       can then be decoded without an intermediate string.
+ */
+void
+pcmk__mainloop_ipc_xml_dispatch(mainloop_io_t *client,
+                                int (*dispatch)(xmlNode *msg,
+                                                gpointer userdata))
+{
+    CRM_CHECK((client != NULL) && (client->ipc != NULL), return);
+    client->dispatch_fn_xml = dispatch;
+    pcmk__ipc_accept_binary(client->ipc);
+}
+
 void
 mainloop_del_ipc_client(mainloop_io_t * client)
 {
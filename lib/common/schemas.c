@@ -67,6 +67,60 @@ static struct schema_s *known_schemas = NULL;
 static int xml_schema_max = 0;
 static bool silent_logging = FALSE;
 
+/* Result of the most recent internal upgrade done by cli_config_update(), so
+ * that inputs differing only in their status section (such as successive
+ * scheduler inputs) need not be validated and transformed again
+ */
+static struct {
+    char *schema;       // original validate-with value
+    char *digest;       // digest of original configuration section
+    xmlNode *config;    // upgraded configuration section
+    int version;        // index of schema configuration was upgraded to
+} last_upgrade = { NULL, NULL, NULL, -1 };
+
+/*!
+ * \internal
+ * \brief Discard any remembered upgraded configuration
+ */
+static void
+forget_upgrade(void)
+{
+    free(last_upgrade.schema);
+    free(last_upgrade.digest);
+    free_xml(last_upgrade.config);
+    last_upgrade.schema = NULL;
+    last_upgrade.digest = NULL;
+    last_upgrade.config = NULL;
+    last_upgrade.version = -1;
+}
+
+#if HAVE_LIBXSLT
+/* Parsed upgrade stylesheets, indexed by transform file name, kept for the
+ * life of the process since the same chain is walked for every older-schema
+ * CIB that gets loaded, replaced, or upgraded
+ */
+static GHashTable *stylesheets = NULL;
+
+static void
+free_stylesheet(gpointer data)
+{
+    xsltFreeStylesheet((xsltStylesheet *) data);
+}
+
+/*!
+ * \internal
+ * \brief Free all cached upgrade stylesheets
+ */
+static void
+forget_stylesheets(void)
+{
+    if (stylesheets != NULL) {
+        g_hash_table_destroy(stylesheets);
+        stylesheets = NULL;
+    }
+}
+#endif
+
 static void
 xml_log(int priority, const char *fmt, ...)
 G_GNUC_PRINTF(2, 3);
@@ -84,9 +138,26 @@ xml_log(int priority, const char *fmt, ...)
     va_end(ap);
 }
 
+/*!
+ * \internal
+ * \brief Load the known schemas if they have not been loaded yet
+ *
+ * Scanning the schema directory is deferred until a schema is actually needed,
+ * so that processes (especially command-line tools) that never validate or
+ * look up a schema do not pay for it.
+ */
+static inline void
+ensure_schemas(void)
+{
+    if (known_schemas == NULL) {
+        crm_schema_init();
+    }
+}
+
 static int
 xml_latest_schema_index(void)
 {
+    ensure_schemas();
     return xml_schema_max - 3; // index from 0, ignore "pacemaker-next"/"none"
 }
 
@@ -369,15 +440,25 @@ add_schema_by_version(const schema_version_t *version, int next,
 /*!
  * \internal
  * \brief Load pacemaker schemas into cache
+ *
+ * \note This is done on demand by anything needing the known schemas, so it
+ *       need not be called explicitly. It does nothing if they are loaded.
+ *       RelaxNG grammars are not compiled here, but only when a document is
+ *       first validated against a particular schema.
  */
 void
 crm_schema_init(void)
 {
     int lpc, max;
-    const char *base = get_schema_root();
+    const char *base = NULL;
     struct dirent **namelist = NULL;
     const schema_version_t zero = SCHEMA_ZERO;
 
+    if (known_schemas != NULL) {
+        return;
+    }
+
+    base = get_schema_root();
     max = scandir(base, &namelist, schema_filter, schema_sort);
     if (max < 0) {
         crm_notice("scandir(%s) failed: %s (%d)", base, strerror(errno), errno);
@@ -578,6 +659,11 @@ crm_schema_cleanup(void)
     }
     free(known_schemas);
     known_schemas = NULL;
+    xml_schema_max = 0;
+    forget_upgrade();
+#if HAVE_LIBXSLT
+    forget_stylesheets();
+#endif
 
     xsltCleanupGlobals();  /* XXX proper, explicit reshaking regarding
                                   init/fini routines is pending (pair
@@ -697,6 +783,7 @@ validate_xml(xmlNode *xml_blob, const char *validation, gboolean to_logs)
 {
     int version = 0;
 
+    ensure_schemas();
     if (validation == NULL) {
         validation = crm_element_value(xml_blob, XML_ATTR_VALIDATION);
     }
@@ -894,10 +981,42 @@ cib_upgrade_err(void *ctx, const char *fmt, ...)
 #define PCMK_SCHEMAS_EMERGENCY_XSLT 1
 #endif
 
+/*!
+ * \internal
+ * \brief Get a parsed upgrade stylesheet, parsing it if not already cached
+ *
+ * \param[in] transform  File name of stylesheet (relative to schema directory)
+ *
+ * \return Parsed stylesheet (owned by the cache), or NULL on error
+ */
+static xsltStylesheet *
+get_stylesheet(const char *transform)
+{
+    char *xform = NULL;
+    xsltStylesheet *xslt = NULL;
+
+    if (stylesheets == NULL) {
+        stylesheets = g_hash_table_new_full(crm_str_hash, g_str_equal, free,
+                                            free_stylesheet);
+    }
+
+    xslt = g_hash_table_lookup(stylesheets, transform);
+    if (xslt != NULL) {
+        return xslt;
+    }
+
+    xform = get_schema_path(NULL, transform);
+    xslt = xsltParseStylesheetFile((pcmkXmlStr) xform);
+    free(xform);
+    if (xslt != NULL) {
+        g_hash_table_insert(stylesheets, strdup(transform), xslt);
+    }
+    return xslt;
+}
+
 static xmlNode *
 apply_transformation(xmlNode *xml, const char *transform, gboolean to_logs)
 {
-    char *xform = NULL;
     xmlNode *out = NULL;
     xmlDocPtr res = NULL;
     xmlDocPtr doc = NULL;
@@ -910,7 +1029,6 @@ apply_transformation(xmlNode *xml, const char *transform, gboolean to_logs)
 
     CRM_CHECK(xml != NULL, return FALSE);
     doc = getDocPtr(xml);
-    xform = get_schema_path(NULL, transform);
 
     xmlLoadExtDtdDefaultValue = 1;
     xmlSubstituteEntitiesDefault(1);
@@ -922,7 +1040,7 @@ apply_transformation(xmlNode *xml, const char *transform, gboolean to_logs)
         xsltSetGenericErrorFunc(&crm_log_level, cib_upgrade_err);
     }
 
-    xslt = xsltParseStylesheetFile((pcmkXmlStr) xform);
+    xslt = get_stylesheet(transform);
     CRM_CHECK(xslt != NULL, goto cleanup);
 
     res = xsltApplyStylesheet(xslt, doc, NULL);
@@ -943,12 +1061,6 @@ apply_transformation(xmlNode *xml, const char *transform, gboolean to_logs)
 #endif
 
   cleanup:
-    if (xslt) {
-        xsltFreeStylesheet(xslt);
-    }
-
-    free(xform);
-
     return out;
 }
 
@@ -1015,6 +1127,7 @@ apply_upgrade(xmlNode *xml, const struct schema_s *schema, gboolean to_logs)
 const char *
 get_schema_name(int version)
 {
+    ensure_schemas();
     if (version < 0 || version >= xml_schema_max) {
         return "unknown";
     }
@@ -1026,6 +1139,7 @@ get_schema_version(const char *name)
 {
     int lpc = 0;
 
+    ensure_schemas();
     if (name == NULL) {
         name = "none";
     }
@@ -1187,18 +1301,112 @@ update_validation(xmlNode **xml_blob, int *best, int max, gboolean transform,
     return rc;
 }
 
+/*!
+ * \internal
+ * \brief Digest the configuration section of a CIB
+ *
+ * \param[in] xml  CIB XML
+ *
+ * \return Newly allocated digest of configuration, or NULL if none
+ */
+static char *
+config_digest(xmlNode *xml)
+{
+    xmlNode *config = first_named_child(xml, XML_CIB_TAG_CONFIGURATION);
+
+    return (config == NULL)? NULL : calculate_on_disk_digest(config);
+}
+
+/*!
+ * \internal
+ * \brief Remember an upgraded configuration for later reuse
+ *
+ * \param[in] schema     Original validate-with value
+ * \param[in] digest     Digest of original configuration section
+ * \param[in] converted  Upgraded CIB
+ * \param[in] version    Index of schema CIB was upgraded to
+ */
+static void
+remember_upgrade(const char *schema, const char *digest, xmlNode *converted,
+                 int version)
+{
+    xmlNode *config = first_named_child(converted, XML_CIB_TAG_CONFIGURATION);
+
+    forget_upgrade();
+    if ((digest == NULL) || (config == NULL)) {
+        return;
+    }
+    last_upgrade.schema = strdup(schema);
+    last_upgrade.digest = strdup(digest);
+    last_upgrade.config = copy_xml(config);
+    last_upgrade.version = version;
+}
+
+/*!
+ * \internal
+ * \brief Upgrade a CIB by reusing the last upgrade, if still applicable
+ *
+ * If the CIB's schema and configuration section are the same as those of the
+ * last CIB successfully upgraded, substitute the upgraded configuration
+ * section in place without validating or transforming anything.
+ *
+ * \param[in,out] xml      CIB XML to upgrade
+ * \param[in]     schema   CIB's current validate-with value
+ * \param[out]    digest   Where to store digest of configuration section
+ * \param[out]    version  Where to store index of schema upgraded to
+ *
+ * \return TRUE if CIB was upgraded, FALSE otherwise
+ * \note The caller is responsible for freeing *digest.
+ */
+static gboolean
+reuse_upgrade(xmlNode *xml, const char *schema, char **digest, int *version)
+{
+    xmlNode *config = NULL;
+    xmlNode *upgraded = NULL;
+
+    *digest = config_digest(xml);
+    if ((*digest == NULL) || (last_upgrade.config == NULL)
+        || safe_str_neq(schema, last_upgrade.schema)
+        || safe_str_neq(*digest, last_upgrade.digest)) {
+        return FALSE;
+    }
+
+    /* Swap in a copy of the upgraded section, then free the original. The
+     * copy is made within the CIB's document, so that any names it shares
+     * are taken from (and later freed via) that document's dictionary.
+     */
+    config = first_named_child(xml, XML_CIB_TAG_CONFIGURATION);
+    upgraded = xmlDocCopyNode(last_upgrade.config, xml->doc, 1);
+    CRM_CHECK(upgraded != NULL, return FALSE);
+    config = xmlReplaceNode(config, upgraded);
+    free_xml(config);
+
+    *version = last_upgrade.version;
+    crm_xml_add(xml, XML_ATTR_VALIDATION, known_schemas[*version].name);
+    crm_trace("Configuration unchanged since last upgrade from %s to %s",
+              schema, known_schemas[*version].name);
+    return TRUE;
+}
+
 gboolean
 cli_config_update(xmlNode **xml, int *best_version, gboolean to_logs)
 {
     gboolean rc = TRUE;
     const char *value = crm_element_value(*xml, XML_ATTR_VALIDATION);
     char *const orig_value = strdup(value == NULL ? "(none)" : value);
+    char *digest = NULL;
 
     int version = get_schema_version(value);
     int orig_version = version;
     int min_version = xml_minimum_schema_index();
 
-    if (version < min_version) {
+    if ((version < min_version)
+        && reuse_upgrade(*xml, orig_value, &digest, &version)) {
+        /* Only the status section has changed since the last upgrade, and
+         * that is not affected by transformations
+         */
+
+    } else if (version < min_version) {
         xmlNode *converted = NULL;
 
         converted = copy_xml(*xml);
@@ -1241,6 +1449,7 @@ cli_config_update(xmlNode **xml, int *best_version, gboolean to_logs)
         } else {
             free_xml(*xml);
             *xml = converted;
+            remember_upgrade(orig_value, digest, converted, version);
 
             if (version < xml_latest_schema_index()) {
                 crm_config_warn("Your configuration was internally updated to %s... "
@@ -1268,6 +1477,7 @@ cli_config_update(xmlNode **xml, int *best_version, gboolean to_logs)
         *best_version = version;
     }
 
+    free(digest);
     free(orig_value);
     return rc;
 }
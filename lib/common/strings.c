@@ -20,6 +20,19 @@
 #include <bzlib.h>
 #include <sys/types.h>
 
+#ifdef HAVE_LIBLZ4
+#  include <lz4.h>
+#endif
+#ifdef HAVE_LIBZSTD
+#  include <zstd.h>
+#  include <zstd_errors.h>     // ZSTD_getErrorCode()
+#endif
+
+/* zstd's fastest level still compresses CIB XML far better than LZ4, at a
+ * small fraction of bzip2's cost
+ */
+#define PCMK__ZSTD_LEVEL 1
+
 char *
 crm_itoa_stack(int an_int, char *buffer, size_t len)
 {
@@ -427,55 +440,289 @@ add_list_element(char *list, const char *value)
     return list;
 }
 
+/*!
+ * \internal
+ * \brief Get a human-friendly name for a compression codec
+ *
+ * \param[in] codec  Compression codec
+ *
+ * \return Name of \p codec
+ */
+const char *
+pcmk__codec_text(enum pcmk__codec codec)
+{
+    switch (codec) {
+        case pcmk__codec_bzip2:
+            return "bzip2";
+        case pcmk__codec_lz4:
+            return "LZ4";
+        case pcmk__codec_zstd:
+            return "zstd";
+    }
+    return "unknown";
+}
+
+/*!
+ * \internal
+ * \brief Check whether a compression codec is available in this build
+ *
+ * \param[in] codec  Compression codec to check
+ *
+ * \return true if \p codec can be used for compression and decompression
+ */
 bool
-crm_compress_string(const char *data, int length, int max, char **result, unsigned int *result_len)
+pcmk__codec_supported(enum pcmk__codec codec)
+{
+    switch (codec) {
+        case pcmk__codec_bzip2:
+            return true;
+#ifdef HAVE_LIBLZ4
+        case pcmk__codec_lz4:
+            return true;
+#endif
+#ifdef HAVE_LIBZSTD
+        case pcmk__codec_zstd:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+static unsigned int
+compress_bound(enum pcmk__codec codec, unsigned int length)
+{
+    switch (codec) {
+#ifdef HAVE_LIBLZ4
+        case pcmk__codec_lz4:
+            return (unsigned int) LZ4_compressBound((int) length);
+#endif
+#ifdef HAVE_LIBZSTD
+        case pcmk__codec_zstd:
+            return (unsigned int) ZSTD_compressBound(length);
+#endif
+        default:
+            return (length * 1.1) + 600; /* recommended size for bzip2 */
+    }
+}
+
+/*!
+ * \internal
+ * \brief Compress data with a given codec
+ *
+ * \param[in]  codec       Compression codec to use
+ * \param[in]  data        Data to compress (which need not be a string)
+ * \param[in]  length      Number of bytes of \p data to compress
+ * \param[in]  max         Maximum size of result (or 0 for no limit)
+ * \param[out] result      Where to store newly allocated compressed data
+ * \param[out] result_len  Where to store size of \p result
+ *
+ * \return pcmk_ok on success, -EMSGSIZE if the result would be larger than
+ *         \p max, -EOPNOTSUPP if \p codec is unavailable, otherwise -EIO
+ */
+int
+pcmk__compress(enum pcmk__codec codec, const char *data, unsigned int length,
+               unsigned int max, char **result, unsigned int *result_len)
 {
-    int rc;
+    int rc = pcmk_ok;
     char *compressed = NULL;
-    char *uncompressed = strdup(data);
+    unsigned int bound = compress_bound(codec, length);
 #ifdef CLOCK_MONOTONIC
     struct timespec after_t;
     struct timespec before_t;
 #endif
 
-    if(max == 0) {
-        max = (length * 1.1) + 600; /* recommended size */
+    CRM_ASSERT((data != NULL) && (result != NULL) && (result_len != NULL));
+    *result = NULL;
+    *result_len = 0;
+
+    if (!pcmk__codec_supported(codec)) {
+        return -EOPNOTSUPP;
     }
 
+    if ((max == 0) || (max > bound)) {
+        max = bound;
+    }
+    compressed = calloc(max, sizeof(char));
+    CRM_ASSERT(compressed);
+
 #ifdef CLOCK_MONOTONIC
     clock_gettime(CLOCK_MONOTONIC, &before_t);
 #endif
 
-    compressed = calloc(max, sizeof(char));
-    CRM_ASSERT(compressed);
+    switch (codec) {
+        case pcmk__codec_bzip2:
+            {
+                // libbz2 takes non-const input, so give it a copy
+                char *uncompressed = malloc(length);
+                int bz_rc = BZ_OK;
+
+                CRM_ASSERT(uncompressed != NULL);
+                memcpy(uncompressed, data, length);
+
+                *result_len = max;
+                bz_rc = BZ2_bzBuffToBuffCompress(compressed, result_len,
+                                                 uncompressed, length,
+                                                 CRM_BZ2_BLOCKS, 0,
+                                                 CRM_BZ2_WORK);
+                free(uncompressed);
+
+                if (bz_rc == BZ_OUTBUFF_FULL) {
+                    rc = -EMSGSIZE;
+                } else if (bz_rc != BZ_OK) {
+                    crm_err("Compression of %u bytes failed: %s "
+                            CRM_XS " bzerror=%d",
+                            length, bz2_strerror(bz_rc), bz_rc);
+                    rc = -EIO;
+                }
+            }
+            break;
+
+#ifdef HAVE_LIBLZ4
+        case pcmk__codec_lz4:
+            {
+                int lz4_rc = LZ4_compress_default(data, compressed, (int) length,
+                                                  (int) max);
+
+                // LZ4 returns 0 only if the result would not fit
+                if (lz4_rc <= 0) {
+                    rc = -EMSGSIZE;
+                } else {
+                    *result_len = (unsigned int) lz4_rc;
+                }
+            }
+            break;
+#endif
 
-    *result_len = max;
-    rc = BZ2_bzBuffToBuffCompress(compressed, result_len, uncompressed, length, CRM_BZ2_BLOCKS, 0,
-                                  CRM_BZ2_WORK);
+#ifdef HAVE_LIBZSTD
+        case pcmk__codec_zstd:
+            {
+                size_t zstd_rc = ZSTD_compress(compressed, max, data, length,
+                                               PCMK__ZSTD_LEVEL);
+
+                if (!ZSTD_isError(zstd_rc)) {
+                    *result_len = (unsigned int) zstd_rc;
+                } else if (ZSTD_getErrorCode(zstd_rc) == ZSTD_error_dstSize_tooSmall) {
+                    rc = -EMSGSIZE;
+                } else {
+                    crm_err("Compression of %u bytes failed: %s",
+                            length, ZSTD_getErrorName(zstd_rc));
+                    rc = -EIO;
+                }
+            }
+            break;
+#endif
 
-    free(uncompressed);
+        default:
+            rc = -EOPNOTSUPP;
+            break;
+    }
 
-    if (rc != BZ_OK) {
-        crm_err("Compression of %d bytes failed: %s " CRM_XS " bzerror=%d",
-                length, bz2_strerror(rc), rc);
+    if (rc != pcmk_ok) {
+        if (rc == -EMSGSIZE) {
+            crm_trace("Could not %s-compress %u bytes into %u or fewer",
+                      pcmk__codec_text(codec), length, max);
+        }
         free(compressed);
-        return FALSE;
+        *result_len = 0;
+        return rc;
     }
 
 #ifdef CLOCK_MONOTONIC
     clock_gettime(CLOCK_MONOTONIC, &after_t);
 
-    crm_trace("Compressed %d bytes into %d (ratio %d:1) in %.0fms",
-             length, *result_len, length / (*result_len),
-             difftime (after_t.tv_sec, before_t.tv_sec) * 1000 +
-             (after_t.tv_nsec - before_t.tv_nsec) / 1e6);
+    crm_trace("%s-compressed %u bytes into %u (ratio %u:1) in %.0fms",
+              pcmk__codec_text(codec), length, *result_len,
+              length / (*result_len),
+              difftime (after_t.tv_sec, before_t.tv_sec) * 1000 +
+              (after_t.tv_nsec - before_t.tv_nsec) / 1e6);
 #else
-    crm_trace("Compressed %d bytes into %d (ratio %d:1)",
-             length, *result_len, length / (*result_len));
+    crm_trace("%s-compressed %u bytes into %u (ratio %u:1)",
+              pcmk__codec_text(codec), length, *result_len,
+              length / (*result_len));
 #endif
 
     *result = compressed;
-    return TRUE;
+    return pcmk_ok;
+}
+
+/*!
+ * \internal
+ * \brief Decompress data with a given codec
+ *
+ * \param[in]     codec       Compression codec that was used
+ * \param[in]     data        Compressed data
+ * \param[in]     length      Number of bytes of \p data
+ * \param[out]    result      Where to decompress data to
+ * \param[in,out] result_len  Size of \p result on input, size of
+ *                            decompressed data on output
+ *
+ * \return pcmk_ok on success, -EOPNOTSUPP if \p codec is unavailable,
+ *         otherwise -EILSEQ
+ */
+int
+pcmk__decompress(enum pcmk__codec codec, const char *data, unsigned int length,
+                 char *result, unsigned int *result_len)
+{
+    CRM_ASSERT((data != NULL) && (result != NULL) && (result_len != NULL));
+
+    switch (codec) {
+        case pcmk__codec_bzip2:
+            {
+                int rc = BZ2_bzBuffToBuffDecompress(result, result_len,
+                                                    (char *) data, length,
+                                                    1, 0);
+
+                if (rc != BZ_OK) {
+                    crm_err("Decompression failed: %s " CRM_XS " bzerror=%d",
+                            bz2_strerror(rc), rc);
+                    return -EILSEQ;
+                }
+            }
+            return pcmk_ok;
+
+#ifdef HAVE_LIBLZ4
+        case pcmk__codec_lz4:
+            {
+                int rc = LZ4_decompress_safe(data, result, (int) length,
+                                             (int) *result_len);
+
+                if (rc < 0) {
+                    crm_err("LZ4 decompression failed " CRM_XS " rc=%d", rc);
+                    return -EILSEQ;
+                }
+                *result_len = (unsigned int) rc;
+            }
+            return pcmk_ok;
+#endif
+
+#ifdef HAVE_LIBZSTD
+        case pcmk__codec_zstd:
+            {
+                size_t rc = ZSTD_decompress(result, *result_len, data, length);
+
+                if (ZSTD_isError(rc)) {
+                    crm_err("zstd decompression failed: %s",
+                            ZSTD_getErrorName(rc));
+                    return -EILSEQ;
+                }
+                *result_len = (unsigned int) rc;
+            }
+            return pcmk_ok;
+#endif
+
+        default:
+            crm_err("Cannot decompress %s data: not supported by this build",
+                    pcmk__codec_text(codec));
+            return -EOPNOTSUPP;
+    }
+}
+
+bool
+crm_compress_string(const char *data, int length, int max, char **result, unsigned int *result_len)
+{
+    return pcmk__compress(pcmk__codec_bzip2, data, (unsigned int) length,
+                          (unsigned int) max, result, result_len) == pcmk_ok;
 }
 
 /*!
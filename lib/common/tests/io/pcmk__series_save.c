@@ -0,0 +1,260 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+
+#define SERIES          "pe-input"
+#define SERIES_WRAP     5
+#define SNAPSHOT_EVERY  3
+
+typedef struct series_test_s {
+    char *directory;
+    int interval;           // Save a full input at least this often
+    bool idle_release;      // Release between saves, as the scheduler does
+    pcmk__series_state_t state;
+} series_test_t;
+
+static xmlNode *
+make_input(int n)
+{
+    xmlNode *cib = create_xml_node(NULL, XML_TAG_CIB);
+    xmlNode *status = NULL;
+    xmlNode *node_state = NULL;
+
+    crm_xml_add_int(cib, XML_ATTR_GENERATION_ADMIN, 0);
+    crm_xml_add_int(cib, XML_ATTR_GENERATION, 1);
+    crm_xml_add_int(cib, XML_ATTR_NUMUPDATES, n);
+    create_xml_node(create_xml_node(cib, XML_CIB_TAG_CONFIGURATION),
+                    XML_CIB_TAG_NODES);
+    status = create_xml_node(cib, XML_CIB_TAG_STATUS);
+    node_state = create_xml_node(status, XML_CIB_TAG_STATE);
+    crm_xml_add(node_state, XML_ATTR_ID, "1");
+    crm_xml_add_int(node_state, "input", n);
+    return cib;
+}
+
+static char *
+series_file(series_test_t *test, int n)
+{
+    return generate_series_filename(test->directory, SERIES, n % SERIES_WRAP,
+                                    TRUE);
+}
+
+// Save input n as the scheduler does
+static void
+save_series(series_test_t *test, int n)
+{
+    xmlNode *input = make_input(n);
+
+    g_assert_cmpint(pcmk__series_save(&(test->state), test->directory, SERIES,
+                                      n % SERIES_WRAP, SERIES_WRAP, input,
+                                      test->interval), ==, pcmk_ok);
+    free_xml(input);
+    if (test->idle_release) {
+        pcmk__series_release_pending(&(test->state));
+    }
+}
+
+static int
+input_number(xmlNode *xml)
+{
+    xmlNode *node_state = get_xpath_object("//" XML_CIB_TAG_STATE, xml,
+                                           LOG_DEBUG);
+    int value = -1;
+
+    g_assert(node_state != NULL);
+    crm_element_value_int(node_state, "input", &value);
+    return value;
+}
+
+static int
+saved_input_number(series_test_t *test, int n)
+{
+    char *filename = series_file(test, n);
+    xmlNode *xml = pcmk__series_file2xml(filename);
+    int value = -1;
+
+    free(filename);
+    g_assert(xml != NULL);
+    value = input_number(xml);
+    free_xml(xml);
+    return value;
+}
+
+static int
+count_deltas(series_test_t *test)
+{
+    int count = 0;
+
+    for (int n = 0; n < SERIES_WRAP; n++) {
+        char *filename = series_file(test, n);
+        xmlNode *xml = filename2xml(filename);
+
+        if (crm_str_eq(crm_element_name(xml), "series_delta", TRUE)) {
+            count++;
+        }
+        free_xml(xml);
+        free(filename);
+    }
+    return count;
+}
+
+static void
+cleanup_series(series_test_t *test)
+{
+    for (int n = 0; n < SERIES_WRAP; n++) {
+        char *filename = series_file(test, n);
+
+        unlink(filename);
+        free(filename);
+    }
+    rmdir(test->directory);
+    free(test->directory);
+    pcmk__series_reset(&(test->state));
+}
+
+static void
+setup_series(series_test_t *test, int interval, bool idle_release)
+{
+    memset(test, 0, sizeof(series_test_t));
+    test->interval = interval;
+    test->idle_release = idle_release;
+    test->directory = crm_strdup_printf("%s/pcmk-series-XXXXXX",
+                                        (getenv("TMPDIR")? getenv("TMPDIR") : "/tmp"));
+    g_assert(mkdtemp(test->directory) != NULL);
+}
+
+static void
+unwrapped_series(void)
+{
+    series_test_t test;
+
+    setup_series(&test, SNAPSHOT_EVERY, TRUE);
+    for (int n = 0; n < SERIES_WRAP; n++) {
+        save_series(&test, n);
+    }
+    g_assert_cmpint(count_deltas(&test), >, 0);
+    for (int n = 0; n < SERIES_WRAP; n++) {
+        g_assert_cmpint(saved_input_number(&test, n), ==, n);
+    }
+    cleanup_series(&test);
+}
+
+static void
+check_wrapped_series(int interval, bool idle_release)
+{
+    series_test_t test;
+    int total = (3 * SERIES_WRAP) + 1;
+
+    /* Wrap several times, so that the oldest remaining input is at each
+     * position of a delta chain at some point
+     */
+    setup_series(&test, interval, idle_release);
+    for (int n = 0; n < total; n++) {
+        save_series(&test, n);
+        if (n >= SERIES_WRAP) {
+            // Oldest remaining input
+            g_assert_cmpint(saved_input_number(&test, n - SERIES_WRAP + 1),
+                            ==, n - SERIES_WRAP + 1);
+
+            // Deltas continue across the wrap
+            g_assert_cmpint(count_deltas(&test), >, 0);
+        }
+    }
+    for (int n = total - SERIES_WRAP; n < total; n++) {
+        g_assert_cmpint(saved_input_number(&test, n), ==, n);
+    }
+    cleanup_series(&test);
+}
+
+static void
+wrapped_series(void)
+{
+    check_wrapped_series(SNAPSHOT_EVERY, TRUE);
+}
+
+static void
+wrapped_series_no_idle(void)
+{
+    // Without an idle release, each save releases what it overwrites itself
+    check_wrapped_series(SNAPSHOT_EVERY, FALSE);
+}
+
+static void
+long_chain(void)
+{
+    // Full inputs less often than the series wraps
+    check_wrapped_series(4 * SERIES_WRAP, TRUE);
+}
+
+static void
+rolling_base(void)
+{
+    series_test_t test;
+
+    setup_series(&test, 4 * SERIES_WRAP, TRUE);
+    for (int n = 0; n < (3 * SERIES_WRAP); n++) {
+        save_series(&test, n);
+
+        /* Once wrapped, the full input that will be oldest after the next
+         * save is kept, for the release after that
+         */
+        if (n >= (SERIES_WRAP - 1)) {
+            g_assert(test.state.base != NULL);
+            g_assert_cmpint(input_number(test.state.base),
+                            ==, n - SERIES_WRAP + 2);
+        }
+    }
+    cleanup_series(&test);
+}
+
+static void
+restart(void)
+{
+    series_test_t test;
+
+    setup_series(&test, 4 * SERIES_WRAP, TRUE);
+    for (int n = 0; n < (2 * SERIES_WRAP) + 2; n++) {
+        save_series(&test, n);
+    }
+
+    // A restarted scheduler has no state, but must not break existing chains
+    pcmk__series_reset(&(test.state));
+    for (int n = (2 * SERIES_WRAP) + 2; n < (4 * SERIES_WRAP); n++) {
+        save_series(&test, n);
+        g_assert_cmpint(saved_input_number(&test, n - SERIES_WRAP + 1),
+                        ==, n - SERIES_WRAP + 1);
+    }
+    cleanup_series(&test);
+}
+
+int
+main(int argc, char **argv)
+{
+    crm_xml_init();
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/common/io/series/unwrapped", unwrapped_series);
+    g_test_add_func("/common/io/series/wrapped", wrapped_series);
+    g_test_add_func("/common/io/series/wrapped_no_idle",
+                    wrapped_series_no_idle);
+    g_test_add_func("/common/io/series/long_chain", long_chain);
+    g_test_add_func("/common/io/series/rolling_base", rolling_base);
+    g_test_add_func("/common/io/series/restart", restart);
+    return g_test_run();
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/common/ipc.h>
+#include <crm/common/ipcs.h>
+#include <crm/common/ipc_internal.h>
+
+#define HDR_SIZE        sizeof(struct crm_ipc_response_header)
+#define PART_SIZE       sizeof(struct crm_ipc_fragment_header)
+#define MAX_FRAGMENTS   100
+
+/* A request split into fragments the way a client would send it */
+typedef struct fragments_s {
+    char *text;                         // Whole request, unformatted
+    unsigned int count;                 // Number of fragments
+    char *data[MAX_FRAGMENTS];          // Fragments with headers and payload
+    unsigned int sizes[MAX_FRAGMENTS];  // Size of each fragment
+} fragments_t;
+
+static xmlNode *
+make_request(void)
+{
+    xmlNode *request = create_xml_node(NULL, "request");
+
+    for (int n = 0; n < 50; n++) {
+        xmlNode *child = create_xml_node(request, "child");
+
+        crm_xml_set_id(child, "child-%d", n);
+        crm_xml_add(child, "value", "some text that makes the request longer");
+    }
+    return request;
+}
+
+// Fill in one fragment of a message, given the whole message's header
+static char *
+make_fragment(const struct crm_ipc_response_header *whole, uint32_t id,
+              uint32_t index, uint32_t count, const char *payload,
+              unsigned int len, unsigned int *size)
+{
+    struct crm_ipc_fragment_header part = { id, index, count };
+    struct crm_ipc_response_header header = *whole;
+    char *data = NULL;
+
+    *size = HDR_SIZE + PART_SIZE + len;
+    header.flags |= crm_ipc_multipart;
+    header.qb.size = *size;
+
+    data = calloc(1, *size);
+    g_assert(data != NULL);
+    memcpy(data, &header, HDR_SIZE);
+    memcpy(data + HDR_SIZE, &part, PART_SIZE);
+    memcpy(data + HDR_SIZE + PART_SIZE, payload, len);
+    return data;
+}
+
+static void
+split_request(xmlNode *request, uint32_t id, unsigned int chunk,
+              fragments_t *fragments)
+{
+    struct iovec *iov = NULL;
+    struct crm_ipc_response_header *header = NULL;
+    const char *payload = NULL;
+    unsigned int len = 0;
+    uint32_t count = 0;
+
+    g_assert_cmpint(pcmk__ipc_prepare(1, request, &iov, 0, 0), >, 0);
+    header = iov[0].iov_base;
+    payload = iov[1].iov_base;
+    len = iov[1].iov_len;
+    count = (len + chunk - 1) / chunk;
+    g_assert_cmpint(count, <=, MAX_FRAGMENTS);
+
+    fragments->text = dump_xml_unformatted(request);
+    fragments->count = count;
+    for (uint32_t index = 0; index < count; index++) {
+        unsigned int offset = index * chunk;
+
+        fragments->data[index] = make_fragment(header, id, index, count,
+                                               payload + offset,
+                                               QB_MIN(chunk, len - offset),
+                                               &(fragments->sizes[index]));
+    }
+    pcmk_free_ipc_event(iov);
+}
+
+static void
+free_fragments(fragments_t *fragments)
+{
+    for (unsigned int n = 0; n < fragments->count; n++) {
+        free(fragments->data[n]);
+    }
+    free(fragments->text);
+}
+
+// Pass one fragment to the server side, returning any whole request
+static xmlNode *
+receive(crm_client_t *client, fragments_t *fragments, unsigned int n)
+{
+    return crm_ipcs_recv(client, fragments->data[n], fragments->sizes[n],
+                         NULL, NULL);
+}
+
+static void
+check_reassembled(crm_client_t *client, fragments_t *fragments)
+{
+    xmlNode *xml = NULL;
+    char *text = NULL;
+
+    for (unsigned int n = 0; (n + 1) < fragments->count; n++) {
+        g_assert(receive(client, fragments, n) == NULL);
+        g_assert(client->ipc_parts != NULL);
+    }
+    xml = receive(client, fragments, fragments->count - 1);
+    g_assert(xml != NULL);
+    g_assert(client->ipc_parts == NULL);
+
+    text = dump_xml_unformatted(xml);
+    g_assert_cmpstr(text, ==, fragments->text);
+    free(text);
+    free_xml(xml);
+}
+
+static void
+valid_fragments(void)
+{
+    crm_client_t *client = crm_client_alloc(NULL);
+    xmlNode *request = make_request();
+    fragments_t fragments;
+    unsigned int len = 0;
+
+    split_request(request, 1, 300, &fragments);
+    g_assert_cmpint(fragments.count, >, 2);
+    check_reassembled(client, &fragments);
+    len = strlen(fragments.text) + 1;
+    free_fragments(&fragments);
+
+    // A request that fits exactly in one fragment
+    split_request(request, 2, len, &fragments);
+    g_assert_cmpint(fragments.count, ==, 1);
+    check_reassembled(client, &fragments);
+    free_fragments(&fragments);
+
+    free_xml(request);
+    crm_client_destroy(client);
+}
+
+static void
+forged_size(void)
+{
+    crm_client_t *client = crm_client_alloc(NULL);
+    struct crm_ipc_response_header header;
+    char payload[100];
+    unsigned int size = 0;
+    char *data = NULL;
+
+    memset(&header, 0, sizeof(header));
+    memset(payload, 'x', sizeof(payload));
+    header.version = 1;
+
+    /* A first fragment claiming almost 4GB of payload, with a fragment count
+     * consistent with that, must be rejected without allocating anything
+     */
+    header.size_uncompressed = UINT_MAX - 1000;
+    data = make_fragment(&header, 1, 0,
+                         ((header.size_uncompressed - 1) / sizeof(payload)) + 1,
+                         payload, sizeof(payload), &size);
+    g_assert(crm_ipcs_recv(client, data, size, NULL, NULL) == NULL);
+    g_assert(client->ipc_parts == NULL);
+    free(data);
+
+    // The same for a compressed message, which is sized by its compressed size
+    header.flags = crm_ipc_compressed;
+    header.size_uncompressed = 1000;
+    header.size_compressed = UINT_MAX - 1000;
+    data = make_fragment(&header, 2, 0,
+                         ((header.size_compressed - 1) / sizeof(payload)) + 1,
+                         payload, sizeof(payload), &size);
+    g_assert(crm_ipcs_recv(client, data, size, NULL, NULL) == NULL);
+    g_assert(client->ipc_parts == NULL);
+    free(data);
+
+    crm_client_destroy(client);
+}
+
+static void
+forged_count(void)
+{
+    crm_client_t *client = crm_client_alloc(NULL);
+    xmlNode *request = make_request();
+    struct crm_ipc_response_header header;
+    fragments_t fragments;
+    char payload[100];
+    unsigned int size = 0;
+    char *data = NULL;
+
+    memset(&header, 0, sizeof(header));
+    memset(payload, 'x', sizeof(payload));
+    header.version = 1;
+    header.size_uncompressed = 1000;
+
+    // 1000 bytes in 100-byte chunks must be 10 fragments, not 2 or 1000
+    data = make_fragment(&header, 1, 0, 2, payload, sizeof(payload), &size);
+    g_assert(crm_ipcs_recv(client, data, size, NULL, NULL) == NULL);
+    g_assert(client->ipc_parts == NULL);
+    free(data);
+
+    data = make_fragment(&header, 2, 0, 1000, payload, sizeof(payload), &size);
+    g_assert(crm_ipcs_recv(client, data, size, NULL, NULL) == NULL);
+    g_assert(client->ipc_parts == NULL);
+    free(data);
+
+    // A first fragment with no payload can't determine the count
+    data = make_fragment(&header, 3, 0, 10, payload, 0, &size);
+    g_assert(crm_ipcs_recv(client, data, size, NULL, NULL) == NULL);
+    g_assert(client->ipc_parts == NULL);
+    free(data);
+
+    // A later fragment must be the same size as the first unless it is last
+    split_request(request, 4, 300, &fragments);
+    g_assert_cmpint(fragments.count, >, 2);
+    g_assert(receive(client, &fragments, 0) == NULL);
+    g_assert(client->ipc_parts != NULL);
+    fragments.sizes[1] -= 10;
+    g_assert(receive(client, &fragments, 1) == NULL);
+    g_assert(client->ipc_parts == NULL);
+    free_fragments(&fragments);
+
+    // None of that gets in the way of a valid request
+    split_request(request, 5, 300, &fragments);
+    check_reassembled(client, &fragments);
+    free_fragments(&fragments);
+
+    free_xml(request);
+    crm_client_destroy(client);
+}
+
+int
+main(int argc, char **argv)
+{
+    crm_xml_init();
+    crm_client_init();
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/common/ipc/multipart/valid", valid_fragments);
+    g_test_add_func("/common/ipc/multipart/forged_size", forged_size);
+    g_test_add_func("/common/ipc/multipart/forged_count", forged_count);
+    return g_test_run();
+}
@@ -0,0 +1,467 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <glib.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/common/ipc.h>
+#include <crm/common/ipcs.h>
+#include <crm/common/ipc_internal.h>
+#include <crm/common/mainloop.h>
+
+#define TEST_OP         "test-op"
+#define TEST_N          "test-n"
+#define TEST_DELAY      "test-delay"
+
+#define OP_ECHO         "echo"          // Reply with TEST_N after TEST_DELAY ms
+#define OP_NOTIFY       "notify"        // Send an event, then reply as echo
+#define OP_IGNORE       "ignore"        // Never reply
+#define OP_DISCONNECT   "disconnect"    // Drop the connection
+
+#define NOT_FINISHED    1               // Not a valid callback rc
+
+/* Test server (run in a child process)
+ *
+ * Requests are answered with crm_ipcs_send() as an ordinary server would
+ * answer them, so this checks that the server side sends replies to
+ * asynchronous requests as events that keep the request ID.
+ */
+
+struct delayed_reply_s {
+    char *client_id;
+    uint32_t request_id;
+    xmlNode *reply;
+};
+
+static gboolean
+send_delayed_reply(gpointer data)
+{
+    struct delayed_reply_s *delayed = data;
+    crm_client_t *client = crm_client_get_by_id(delayed->client_id);
+
+    if (client != NULL) {
+        crm_ipcs_send(client, delayed->request_id, delayed->reply,
+                      crm_ipc_flags_none);
+    }
+    free(delayed->client_id);
+    free_xml(delayed->reply);
+    free(delayed);
+    return FALSE;
+}
+
+static int32_t
+server_accept(qb_ipcs_connection_t *c, uid_t uid, gid_t gid)
+{
+    return (crm_client_new(c, uid, gid) == NULL)? -EIO : 0;
+}
+
+static int32_t
+server_dispatch(qb_ipcs_connection_t *c, void *data, size_t size)
+{
+    uint32_t id = 0;
+    uint32_t flags = 0;
+    int delay = 0;
+    crm_client_t *client = crm_client_get(c);
+    xmlNode *msg = crm_ipcs_recv(client, data, size, &id, &flags);
+    const char *op = crm_element_value(msg, TEST_OP);
+    xmlNode *reply = NULL;
+
+    if (msg == NULL) {
+        return 0;
+    }
+
+    if (safe_str_eq(op, OP_DISCONNECT)) {
+        qb_ipcs_disconnect(client->ipcs);
+
+    } else if (safe_str_eq(op, OP_ECHO) || safe_str_eq(op, OP_NOTIFY)) {
+        if (safe_str_eq(op, OP_NOTIFY)) {
+            xmlNode *event = create_xml_node(NULL, "event");
+
+            crm_ipcs_send(client, 0, event, crm_ipc_server_event);
+            free_xml(event);
+        }
+
+        reply = create_xml_node(NULL, "reply");
+        crm_xml_add(reply, TEST_N, crm_element_value(msg, TEST_N));
+        crm_element_value_int(msg, TEST_DELAY, &delay);
+        if (delay > 0) {
+            struct delayed_reply_s *delayed = calloc(1, sizeof(*delayed));
+
+            delayed->client_id = strdup(client->id);
+            delayed->request_id = id;
+            delayed->reply = reply;
+            g_timeout_add(delay, send_delayed_reply, delayed);
+        } else {
+            crm_ipcs_send(client, id, reply, crm_ipc_flags_none);
+            free_xml(reply);
+        }
+    }
+    free_xml(msg);
+    return 0;
+}
+
+static int32_t
+server_closed(qb_ipcs_connection_t *c)
+{
+    crm_client_t *client = crm_client_get(c);
+
+    if (client != NULL) {
+        crm_client_destroy(client);
+    }
+    return 0;
+}
+
+static void
+server_destroy(qb_ipcs_connection_t *c)
+{
+    server_closed(c);
+}
+
+static struct qb_ipcs_service_handlers server_callbacks = {
+    .connection_accept = server_accept,
+    .connection_created = NULL,
+    .msg_process = server_dispatch,
+    .connection_closed = server_closed,
+    .connection_destroyed = server_destroy
+};
+
+/* Test client */
+
+typedef struct test_server_s {
+    char *name;
+    pid_t pid;
+} test_server_t;
+
+// What a request's callback was called with
+struct result_s {
+    int n;
+    int rc;
+    int reply_n;
+};
+
+static int events_received = 0;
+static GMainLoop *test_loop = NULL;
+static guint test_loop_timer = 0;
+
+static void
+start_server(test_server_t *server)
+{
+    crm_ipc_t *ipc = NULL;
+
+    server->name = crm_strdup_printf("pcmk-test-async-%lld",
+                                     (long long) getpid());
+    server->pid = fork();
+    g_assert(server->pid >= 0);
+
+    if (server->pid == 0) {
+        GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+
+        if (mainloop_add_ipc_server(server->name, QB_IPC_NATIVE,
+                                    &server_callbacks) == NULL) {
+            _exit(CRM_EX_ERROR);
+        }
+        g_main_loop_run(loop);
+        _exit(CRM_EX_OK);
+    }
+
+    /* Wait until the server is accepting connections (which, like the test,
+     * runs as the current user rather than the cluster user)
+     */
+    ipc = crm_ipc_new(server->name, 0);
+    for (int lpc = 0; !pcmk__connect_ipc(ipc, geteuid(), getegid()); lpc++) {
+        g_assert_cmpint(lpc, <, 100);
+        usleep(50000);
+    }
+    crm_ipc_close(ipc);
+    crm_ipc_destroy(ipc);
+}
+
+static void
+stop_server(test_server_t *server)
+{
+    int status = 0;
+
+    kill(server->pid, SIGTERM);
+    g_assert_cmpint(waitpid(server->pid, &status, 0), ==, server->pid);
+    free(server->name);
+}
+
+static void
+record_result(crm_ipc_t *client, uint32_t request_id, int rc, xmlNode *reply,
+              void *user_data)
+{
+    struct result_s *result = user_data;
+
+    g_assert_cmpint(result->rc, ==, NOT_FINISHED);
+    result->rc = rc;
+    if (reply != NULL) {
+        crm_element_value_int(reply, TEST_N, &(result->reply_n));
+    }
+
+    // The main loop test runs until every request has finished
+    if ((test_loop != NULL) && (pcmk__ipc_async_pending(client) == 0)) {
+        g_main_loop_quit(test_loop);
+    }
+}
+
+static void
+send_request(crm_ipc_t *ipc, const char *op, int n, int delay, int timeout,
+             struct result_s *result)
+{
+    xmlNode *request = create_xml_node(NULL, "request");
+
+    crm_xml_add(request, TEST_OP, op);
+    crm_xml_add_int(request, TEST_N, n);
+    crm_xml_add_int(request, TEST_DELAY, delay);
+
+    result->n = n;
+    result->rc = NOT_FINISHED;
+    result->reply_n = -1;
+    g_assert_cmpint(pcmk__ipc_send_async(ipc, request, crm_ipc_flags_none,
+                                         timeout, record_result, result, NULL),
+                    ==, pcmk_ok);
+    free_xml(request);
+}
+
+/* Until the server has sent something, the client can't know whether it
+ * answers requests with events, so the first request is synchronous
+ */
+static void
+negotiate(crm_ipc_t *ipc)
+{
+    struct result_s first;
+
+    send_request(ipc, OP_ECHO, 100, 0, 5000, &first);
+    g_assert_cmpint(first.rc, ==, pcmk_ok);
+    g_assert_cmpint(first.reply_n, ==, 100);
+    g_assert_cmpint(pcmk__ipc_async_pending(ipc), ==, 0);
+}
+
+static crm_ipc_t *
+connect_to_server(test_server_t *server)
+{
+    crm_ipc_t *ipc = crm_ipc_new(server->name, 0);
+
+    g_assert(pcmk__connect_ipc(ipc, geteuid(), getegid()));
+    negotiate(ipc);
+    return ipc;
+}
+
+static void
+several_in_flight(void)
+{
+    test_server_t server;
+    crm_ipc_t *ipc = NULL;
+    struct result_s results[8];
+    int max = DIMOF(results);
+
+    start_server(&server);
+    ipc = connect_to_server(&server);
+
+    // Later requests are answered sooner, so replies arrive out of order
+    for (int n = 0; n < max; n++) {
+        send_request(ipc, OP_ECHO, n, (max - n) * 20, 5000, &results[n]);
+    }
+    g_assert_cmpint(pcmk__ipc_async_pending(ipc), ==, max);
+
+    g_assert_cmpint(pcmk__ipc_wait_async(ipc, 10000), ==, pcmk_ok);
+    g_assert_cmpint(pcmk__ipc_async_pending(ipc), ==, 0);
+    for (int n = 0; n < max; n++) {
+        g_assert_cmpint(results[n].rc, ==, pcmk_ok);
+        g_assert_cmpint(results[n].reply_n, ==, n);
+    }
+
+    crm_ipc_close(ipc);
+    crm_ipc_destroy(ipc);
+    stop_server(&server);
+}
+
+static void
+mixed_with_sync(void)
+{
+    test_server_t server;
+    crm_ipc_t *ipc = NULL;
+    struct result_s slow;
+    xmlNode *request = create_xml_node(NULL, "request");
+    xmlNode *reply = NULL;
+    int reply_n = -1;
+
+    start_server(&server);
+    ipc = connect_to_server(&server);
+
+    // A synchronous request gets its own reply while another is in flight
+    send_request(ipc, OP_ECHO, 1, 500, 5000, &slow);
+    crm_xml_add(request, TEST_OP, OP_ECHO);
+    crm_xml_add_int(request, TEST_N, 2);
+    g_assert_cmpint(crm_ipc_send(ipc, request, crm_ipc_client_response, 5000,
+                                 &reply), >, 0);
+    g_assert(reply != NULL);
+    crm_element_value_int(reply, TEST_N, &reply_n);
+    g_assert_cmpint(reply_n, ==, 2);
+    g_assert_cmpint(slow.rc, ==, NOT_FINISHED);
+
+    g_assert_cmpint(pcmk__ipc_wait_async(ipc, 5000), ==, pcmk_ok);
+    g_assert_cmpint(slow.rc, ==, pcmk_ok);
+    g_assert_cmpint(slow.reply_n, ==, 1);
+
+    free_xml(reply);
+    free_xml(request);
+    crm_ipc_close(ipc);
+    crm_ipc_destroy(ipc);
+    stop_server(&server);
+}
+
+static void
+timed_out_requests(void)
+{
+    test_server_t server;
+    crm_ipc_t *ipc = NULL;
+    struct result_s ignored;
+    struct result_s late;
+    struct result_s prompt;
+    struct result_s after;
+
+    start_server(&server);
+    ipc = connect_to_server(&server);
+
+    send_request(ipc, OP_IGNORE, 1, 0, 200, &ignored);
+    send_request(ipc, OP_ECHO, 2, 600, 200, &late);
+    send_request(ipc, OP_ECHO, 3, 0, 5000, &prompt);
+    g_assert_cmpint(pcmk__ipc_wait_async(ipc, 5000), ==, pcmk_ok);
+
+    g_assert_cmpint(ignored.rc, ==, -ETIMEDOUT);
+    g_assert_cmpint(late.rc, ==, -ETIMEDOUT);
+    g_assert_cmpint(prompt.rc, ==, pcmk_ok);
+    g_assert_cmpint(prompt.reply_n, ==, 3);
+
+    /* The late reply arrives while this request is in flight, and must be
+     * discarded rather than passed to it
+     */
+    send_request(ipc, OP_ECHO, 4, 1000, 5000, &after);
+    g_assert_cmpint(pcmk__ipc_wait_async(ipc, 5000), ==, pcmk_ok);
+    g_assert_cmpint(after.rc, ==, pcmk_ok);
+    g_assert_cmpint(after.reply_n, ==, 4);
+    g_assert_cmpint(late.reply_n, ==, -1);
+
+    crm_ipc_close(ipc);
+    crm_ipc_destroy(ipc);
+    stop_server(&server);
+}
+
+static void
+server_disconnects(void)
+{
+    test_server_t server;
+    crm_ipc_t *ipc = NULL;
+    struct result_s results[3];
+
+    start_server(&server);
+    ipc = connect_to_server(&server);
+
+    send_request(ipc, OP_IGNORE, 0, 0, 5000, &results[0]);
+    send_request(ipc, OP_ECHO, 1, 2000, 5000, &results[1]);
+    send_request(ipc, OP_DISCONNECT, 2, 0, 5000, &results[2]);
+
+    g_assert_cmpint(pcmk__ipc_wait_async(ipc, 5000), ==, -ENOTCONN);
+    g_assert_cmpint(pcmk__ipc_async_pending(ipc), ==, 0);
+    for (int n = 0; n < DIMOF(results); n++) {
+        g_assert_cmpint(results[n].rc, ==, -ENOTCONN);
+    }
+    g_assert(!crm_ipc_connected(ipc));
+    g_assert_cmpint(pcmk__ipc_send_async(ipc, NULL, crm_ipc_flags_none, 0,
+                                         record_result, NULL, NULL),
+                    ==, -ENOTCONN);
+
+    crm_ipc_close(ipc);
+    crm_ipc_destroy(ipc);
+    stop_server(&server);
+}
+
+static int
+count_event(const char *buffer, ssize_t length, gpointer userdata)
+{
+    events_received++;
+    return 0;
+}
+
+static gboolean
+give_up(gpointer data)
+{
+    test_loop_timer = 0;
+    g_main_loop_quit(test_loop);
+    return FALSE;
+}
+
+static void
+main_loop_dispatch(void)
+{
+    test_server_t server;
+    struct ipc_client_callbacks callbacks = {
+        .dispatch = count_event,
+        .destroy = NULL
+    };
+    mainloop_io_t *source = NULL;
+    crm_ipc_t *ipc = NULL;
+    struct result_s results[4];
+
+    start_server(&server);
+    ipc = connect_to_server(&server);
+    source = pcmk__add_mainloop_ipc(ipc, G_PRIORITY_DEFAULT, NULL, &callbacks);
+    g_assert(source != NULL);
+
+    // The server sends an event before the first reply
+    send_request(ipc, OP_NOTIFY, 0, 100, 5000, &results[0]);
+    for (int n = 1; n < DIMOF(results); n++) {
+        send_request(ipc, OP_ECHO, n, 0, 5000, &results[n]);
+    }
+
+    test_loop = g_main_loop_new(NULL, FALSE);
+    test_loop_timer = g_timeout_add(10000, give_up, NULL);
+    g_main_loop_run(test_loop);
+    if (test_loop_timer != 0) {
+        g_source_remove(test_loop_timer);
+    }
+    g_main_loop_unref(test_loop);
+    test_loop = NULL;
+
+    // Replies go to their requests, and the event to the dispatch function
+    g_assert_cmpint(pcmk__ipc_async_pending(ipc), ==, 0);
+    for (int n = 0; n < DIMOF(results); n++) {
+        g_assert_cmpint(results[n].rc, ==, pcmk_ok);
+        g_assert_cmpint(results[n].reply_n, ==, n);
+    }
+    g_assert_cmpint(events_received, ==, 1);
+
+    mainloop_del_ipc_client(source);
+    stop_server(&server);
+}
+
+int
+main(int argc, char **argv)
+{
+    crm_xml_init();
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/common/ipc/async/several_in_flight", several_in_flight);
+    g_test_add_func("/common/ipc/async/mixed_with_sync", mixed_with_sync);
+    g_test_add_func("/common/ipc/async/timeout", timed_out_requests);
+    g_test_add_func("/common/ipc/async/disconnect", server_disconnects);
+    g_test_add_func("/common/ipc/async/main_loop", main_loop_dispatch);
+    return g_test_run();
+}
@@ -0,0 +1,239 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+
+#define V1_VERSION "3.0.4"
+
+#define INPUT "<cib " XML_ATTR_ORIGIN "=\"here\" epoch=\"1\">"                \
+                "<!-- a comment -->"                                          \
+                "<configuration><resources>"                                  \
+                  "<primitive id=\"rsc1\" class=\"ocf\" type=\"a&amp;b\"/>"   \
+                  "<primitive type=\"&lt;&quot;&apos;&gt;\" id=\"rsc2\"/>"    \
+                "</resources></configuration>"                                \
+                "<status " XML_CIB_ATTR_WRITTEN "=\"now\"/>"                  \
+              "</cib>"
+
+/* The digests as calculated before, by serializing the XML (after sorting it,
+ * for sorted digests) and hashing the result
+ */
+static char *
+serialized_digest_v1(xmlNode *input, bool sort)
+{
+    char *buffer = NULL;
+    char *digest = NULL;
+    int offset = 0;
+    int max = 0;
+    xmlNode *copy = NULL;
+
+    if (sort) {
+        copy = sorted_xml(input, NULL, TRUE);
+        input = copy;
+    }
+    crm_buffer_add_char(&buffer, &offset, &max, ' ');
+    crm_xml_dump(input, 0, &buffer, &offset, &max, 0);
+    crm_buffer_add_char(&buffer, &offset, &max, '\n');
+    digest = crm_md5sum(buffer);
+    free(buffer);
+    free_xml(copy);
+    return digest;
+}
+
+static char *
+serialized_digest_v2(xmlNode *input, bool filter)
+{
+    char *buffer = NULL;
+    char *digest = NULL;
+    int offset = 0;
+    int max = 0;
+
+    crm_xml_dump(input, (filter? xml_log_option_filtered : 0), &buffer,
+                 &offset, &max, 0);
+    digest = crm_md5sum(buffer);
+    free(buffer);
+    return digest;
+}
+
+static void
+check_digest(char *digest, char *expected)
+{
+    g_assert_cmpstr(digest, ==, expected);
+    free(digest);
+    free(expected);
+}
+
+// Check every kind of digest of an element and everything under it
+static void
+check_digests(xmlNode *xml)
+{
+    check_digest(calculate_on_disk_digest(xml),
+                 serialized_digest_v1(xml, FALSE));
+    check_digest(calculate_operation_digest(xml, CRM_FEATURE_SET),
+                 serialized_digest_v1(xml, TRUE));
+    check_digest(calculate_xml_versioned_digest(xml, FALSE, TRUE, V1_VERSION),
+                 serialized_digest_v1(xml, FALSE));
+    check_digest(calculate_xml_versioned_digest(xml, TRUE, TRUE, V1_VERSION),
+                 serialized_digest_v1(xml, TRUE));
+    check_digest(calculate_xml_versioned_digest(xml, FALSE, FALSE,
+                                                CRM_FEATURE_SET),
+                 serialized_digest_v2(xml, FALSE));
+    check_digest(calculate_xml_versioned_digest(xml, FALSE, TRUE,
+                                                CRM_FEATURE_SET),
+                 serialized_digest_v2(xml, TRUE));
+
+    for (xmlNode *child = __xml_first_child(xml); child != NULL;
+         child = __xml_next(child)) {
+        if (child->type == XML_ELEMENT_NODE) {
+            check_digests(child);
+        }
+    }
+}
+
+static void
+fixed_input(void)
+{
+    xmlNode *xml = string2xml(INPUT);
+
+    check_digests(xml);
+
+    // Text is not part of any digest
+    xmlAddChild(xml, xmlNewDocText(xml->doc, (const xmlChar *) "text"));
+    check_digests(xml);
+    free_xml(xml);
+}
+
+static void
+tracked_changes(void)
+{
+    xmlNode *xml = string2xml(INPUT);
+    xmlNode *rsc = get_xpath_object("//primitive[@id='rsc1']", xml, LOG_ERR);
+
+    // Deleted attributes are kept (and marked) until changes are accepted
+    xml_track_changes(xml, NULL, NULL, FALSE);
+    xml_remove_prop(rsc, XML_AGENT_ATTR_CLASS);
+    xml_remove_prop(xml, XML_ATTR_ORIGIN);
+    crm_xml_add(rsc, XML_ATTR_TYPE, "changed");
+    free_xml(get_xpath_object("//status", xml, LOG_ERR));
+    check_digests(xml);
+
+    xml_accept_changes(xml);
+    check_digests(xml);
+    free_xml(xml);
+}
+
+static void
+no_input(void)
+{
+    check_digest(calculate_on_disk_digest(NULL),
+                 serialized_digest_v1(NULL, FALSE));
+}
+
+static unsigned int
+next_random(unsigned int *seed, unsigned int limit)
+{
+    *seed = (*seed * 1103515245) + 12345;
+    return (*seed >> 16) % limit;
+}
+
+// A value with any byte but a terminator, so all kinds of escaping are used
+static char *
+random_value(unsigned int *seed)
+{
+    int length = next_random(seed, 12);
+    char *value = calloc(length + 1, sizeof(char));
+
+    for (int lpc = 0; lpc < length; lpc++) {
+        if (next_random(seed, 2)) {
+            value[lpc] = 'a' + next_random(seed, 26);
+        } else {
+            value[lpc] = 1 + next_random(seed, 255);
+        }
+    }
+    return value;
+}
+
+static void
+add_random_children(xmlNode *parent, int depth, unsigned int *seed)
+{
+    const char *names[] = {
+        "primitive", "op", "nvpair", "lrm_rsc_op", "zzz", "a"
+    };
+    const char *attrs[] = {
+        XML_ATTR_ID, XML_ATTR_TYPE, XML_NVPAIR_ATTR_VALUE, "b", "a",
+        XML_ATTR_ORIGIN, XML_CIB_ATTR_WRITTEN, XML_ATTR_UPDATE_ORIG,
+        XML_ATTR_UPDATE_CLIENT, XML_ATTR_UPDATE_USER
+    };
+    int children = next_random(seed, 5);
+
+    for (int lpc = 0; lpc < children; lpc++) {
+        xmlNode *child = NULL;
+        char *value = random_value(seed);
+
+        switch (next_random(seed, 5)) {
+            case 0:
+                child = xmlNewDocComment(parent->doc, (const xmlChar *) value);
+                xmlAddChild(parent, child);
+                break;
+
+            default:
+                child = create_xml_node(parent,
+                                        names[next_random(seed, DIMOF(names))]);
+                for (int attr = next_random(seed, 5); attr > 0; attr--) {
+                    char *attr_value = random_value(seed);
+
+                    crm_xml_add(child, attrs[next_random(seed, DIMOF(attrs))],
+                                attr_value);
+                    free(attr_value);
+                }
+                if (depth > 0) {
+                    add_random_children(child, depth - 1, seed);
+                }
+                break;
+        }
+        free(value);
+    }
+}
+
+// Compare the digests of a deterministic series of random documents
+static void
+random_input(void)
+{
+    unsigned int seed = 1;
+
+    for (int lpc = 0; lpc < 500; lpc++) {
+        xmlNode *xml = create_xml_node(NULL, XML_TAG_CIB);
+
+        add_random_children(xml, 3, &seed);
+        check_digests(xml);
+        free_xml(xml);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    crm_xml_init();
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/common/xml/versioned_digest/fixed_input", fixed_input);
+    g_test_add_func("/common/xml/versioned_digest/tracked_changes",
+                    tracked_changes);
+    g_test_add_func("/common/xml/versioned_digest/no_input", no_input);
+    g_test_add_func("/common/xml/versioned_digest/random_input", random_input);
+    return g_test_run();
+}
@@ -0,0 +1,249 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
+
+/* Hand-encoded messages, as string literals whose implicit nul is the
+ * terminating nul of the encoding (see xml_binary.c for the format)
+ */
+#define ENCODED(s)  (s), sizeof(s)
+
+#define ROOT        "\x01" "E" "\x00" "\x04" "root" "\x00"
+#define ID_X        "\x00" "\x02" "id" "\x00" "\x01" "x" "\x00"
+
+static const char *round_trip_inputs[] = {
+    "<cib/>",
+    "<cib epoch=\"1\" num_updates=\"2\"><configuration><nodes>"
+        "<node id=\"1\" uname=\"node1\"/><node id=\"2\" uname=\"node2\"/>"
+        "</nodes><resources/></configuration><status/></cib>",
+    "<a x=\"&lt;&gt;&amp;&quot;&apos;\" y=\"\" z=\"caf\xc3\xa9 \xe2\x82\xac "
+        "\xf0\x9f\x90\x98\"><b><c><d/></c></b><!-- a comment --><b/></a>",
+    "<a><![CDATA[some <data> & more]]><!----><b id=\"b\"/></a>",
+};
+
+static void
+check_round_trip(xmlNode *xml)
+{
+    unsigned int len = 0;
+    char *binary = pcmk__xml2binary(xml, &len);
+    xmlNode *decoded = NULL;
+    char *expected = dump_xml_unformatted(xml);
+    char *actual = NULL;
+
+    g_assert(binary != NULL);
+    g_assert_cmpint(len, >, 0);
+    decoded = pcmk__binary2xml(binary, len);
+    g_assert(decoded != NULL);
+
+    // The binary codec must be indistinguishable from the text one
+    actual = dump_xml_unformatted(decoded);
+    g_assert_cmpstr(actual, ==, expected);
+    free(actual);
+    free(expected);
+
+    expected = dump_xml_formatted_with_text(xml);
+    actual = dump_xml_formatted_with_text(decoded);
+    g_assert_cmpstr(actual, ==, expected);
+    free(actual);
+    free(expected);
+
+    free_xml(decoded);
+    free(binary);
+}
+
+static void
+round_trip(void)
+{
+    xmlNode *xml = NULL;
+
+    for (int lpc = 0; lpc < DIMOF(round_trip_inputs); lpc++) {
+        xml = string2xml(round_trip_inputs[lpc]);
+        g_assert(xml != NULL);
+        check_round_trip(xml);
+        free_xml(xml);
+    }
+
+    // Many repeated names, so most are sent as indexes
+    xml = create_xml_node(NULL, XML_TAG_CIB);
+    for (int lpc = 0; lpc < 1000; lpc++) {
+        xmlNode *child = create_xml_node(xml, XML_CIB_TAG_STATE);
+
+        crm_xml_set_id(child, "node-%d", lpc);
+        crm_xml_add_int(child, "value", lpc);
+        crm_xml_add(child, (lpc % 2)? "odd" : "even", "true");
+    }
+    check_round_trip(xml);
+    free_xml(xml);
+}
+
+static void
+unencodable(void)
+{
+    xmlNode *xml = create_xml_node(NULL, "root");
+    unsigned int len = 0;
+    char *binary = NULL;
+
+    // The text encoding escapes control characters, but binary can't
+    crm_xml_add(xml, "value", "a\001b");
+    binary = pcmk__xml2binary(xml, &len);
+    g_assert(binary == NULL);
+    g_assert_cmpint(len, ==, 0);
+
+    crm_xml_add(xml, "value", "a\tb\nc");
+    binary = pcmk__xml2binary(xml, &len);
+    g_assert(binary != NULL);
+    free(binary);
+
+    xmlAddChild(xml, xmlNewDocComment(xml->doc, (pcmkXmlStr) "a--b"));
+    binary = pcmk__xml2binary(xml, &len);
+    g_assert(binary == NULL);
+    free_xml(xml);
+}
+
+static void
+truncated(void)
+{
+    xmlNode *xml = string2xml(round_trip_inputs[2]);
+    unsigned int len = 0;
+    char *binary = pcmk__xml2binary(xml, &len);
+
+    g_assert(binary != NULL);
+
+    // Every prefix short of the terminating nul, plus a nul, is invalid
+    for (unsigned int prefix = 0; (prefix + 1) < len; prefix++) {
+        char *copy = malloc(prefix + 1);
+
+        // Keep a terminating nul, as a received message would have
+        memcpy(copy, binary, prefix);
+        copy[prefix] = '\0';
+        g_assert(pcmk__binary2xml(copy, prefix + 1) == NULL);
+        free(copy);
+    }
+    free(binary);
+    free_xml(xml);
+}
+
+static void
+check_decode(const char *buffer, unsigned int len, bool valid)
+{
+    xmlNode *xml = pcmk__binary2xml(buffer, len);
+
+    if (valid) {
+        g_assert(xml != NULL);
+        free_xml(xml);
+    } else {
+        g_assert(xml == NULL);
+    }
+}
+
+static void
+malformed(void)
+{
+    // The hand-encoded base message (<root id="x"/>) is valid
+    check_decode(ENCODED(ROOT "\x01" ID_X "\x00"), TRUE);
+    check_decode(ENCODED(ROOT "\x00" "\x00"), TRUE);
+
+    // Unsupported version, and trailing data
+    check_decode(ENCODED("\x02" "E" "\x00" "\x04" "root" "\x00" "\x00" "\x00"),
+                 FALSE);
+    check_decode(ENCODED(ROOT "\x00" "\x00" "x"), FALSE);
+
+    // Invalid element names
+    check_decode(ENCODED("\x01" "E" "\x00" "\x00" "\x00" "\x00" "\x00"), FALSE);
+    check_decode(ENCODED("\x01" "E" "\x00" "\x04" "1oot" "\x00" "\x00" "\x00"),
+                 FALSE);
+    check_decode(ENCODED("\x01" "E" "\x00" "\x04" "ro t" "\x00" "\x00" "\x00"),
+                 FALSE);
+    check_decode(ENCODED("\x01" "E" "\x00" "\x04" "ro<t" "\x00" "\x00" "\x00"),
+                 FALSE);
+
+    // Invalid attribute names, including an index not yet assigned
+    check_decode(ENCODED(ROOT "\x01" "\x00" "\x02" "i=" "\x00" "\x01" "x" "\x00"
+                         "\x00"), FALSE);
+    check_decode(ENCODED(ROOT "\x01" "\x05" "\x01" "x" "\x00" "\x00"), FALSE);
+
+    // Attribute values that are not XML characters or not UTF-8
+    check_decode(ENCODED(ROOT "\x01" "\x00" "\x02" "id" "\x00" "\x01" "\x01"
+                         "\x00" "\x00"), FALSE);
+    check_decode(ENCODED(ROOT "\x01" "\x00" "\x02" "id" "\x00" "\x01" "\x7f"
+                         "\x00" "\x00"), TRUE);
+    check_decode(ENCODED(ROOT "\x01" "\x00" "\x02" "id" "\x00" "\x01" "\xff"
+                         "\x00" "\x00"), FALSE);
+    check_decode(ENCODED(ROOT "\x01" "\x00" "\x02" "id" "\x00" "\x02" "\xc3"
+                         "x" "\x00" "\x00"), FALSE);
+    check_decode(ENCODED(ROOT "\x01" "\x00" "\x02" "id" "\x00" "\x03"
+                         "\xed\xa0\x80" "\x00" "\x00"), FALSE);
+    check_decode(ENCODED(ROOT "\x01" "\x00" "\x02" "id" "\x00" "\x03"
+                         "\xef\xbf\xbf" "\x00" "\x00"), FALSE);
+
+    // Duplicate attributes, by index and by name
+    check_decode(ENCODED(ROOT "\x02" ID_X "\x02" "\x01" "y" "\x00" "\x00"),
+                 FALSE);
+    check_decode(ENCODED(ROOT "\x02" ID_X ID_X "\x00"), FALSE);
+
+    // The same attribute on different elements is fine
+    check_decode(ENCODED(ROOT "\x01" ID_X "E" "\x01" "\x01" "\x02" "\x01" "y"
+                         "\x00" "\x00" "\x00"), TRUE);
+
+    // Comments and CDATA that could not be written as text
+    check_decode(ENCODED(ROOT "\x00" "C" "\x03" "a-b" "\x00" "\x00"), TRUE);
+    check_decode(ENCODED(ROOT "\x00" "C" "\x04" "a--b" "\x00" "\x00"), FALSE);
+    check_decode(ENCODED(ROOT "\x00" "C" "\x02" "a-" "\x00" "\x00"), FALSE);
+    check_decode(ENCODED(ROOT "\x00" "C" "\x02" "a" "\x01" "\x00" "\x00"),
+                 FALSE);
+    check_decode(ENCODED(ROOT "\x00" "D" "\x03" "]]x" "\x00" "\x00"), TRUE);
+    check_decode(ENCODED(ROOT "\x00" "D" "\x03" "]]>" "\x00" "\x00"), FALSE);
+
+    // Unknown node kinds, and lengths past the end of the message
+    check_decode(ENCODED(ROOT "\x00" "X" "\x00"), FALSE);
+    check_decode(ENCODED(ROOT "\x01" "\x00" "\x02" "id" "\x00" "\x7f" "x"
+                         "\x00" "\x00"), FALSE);
+}
+
+static void
+too_deep(void)
+{
+    xmlNode *xml = create_xml_node(NULL, "root");
+    xmlNode *parent = xml;
+    unsigned int len = 0;
+    char *binary = NULL;
+
+    for (int lpc = 0; lpc < 300; lpc++) {
+        parent = create_xml_node(parent, "child");
+    }
+    binary = pcmk__xml2binary(xml, &len);
+    g_assert(binary != NULL);
+    g_assert(pcmk__binary2xml(binary, len) == NULL);
+    free(binary);
+    free_xml(xml);
+}
+
+int
+main(int argc, char **argv)
+{
+    crm_xml_init();
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/common/xml/binary/round_trip", round_trip);
+    g_test_add_func("/common/xml/binary/unencodable", unencodable);
+    g_test_add_func("/common/xml/binary/truncated", truncated);
+    g_test_add_func("/common/xml/binary/malformed", malformed);
+    g_test_add_func("/common/xml/binary/too_deep", too_deep);
+    return g_test_run();
+}
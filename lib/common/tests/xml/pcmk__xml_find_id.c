@@ -0,0 +1,282 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
+
+#define INPUT "<cib><configuration><resources>"                 \
+                "<primitive id=\"rsc1\"/><primitive id=\"rsc2\"/>" \
+                "<group id=\"grp\"><primitive id=\"rsc3\"/></group>" \
+              "</resources><constraints/></configuration></cib>"
+
+// Find the only element with an ID the slow way, as the index should
+static void
+search_id(xmlNode *xml, const char *id, xmlNode **match, int *count)
+{
+    if (crm_str_eq(ID(xml), id, TRUE)) {
+        *match = xml;
+        (*count)++;
+    }
+    for (xmlNode *child = __xml_first_child_element(xml); child != NULL;
+         child = __xml_next_element(child)) {
+        search_id(child, id, match, count);
+    }
+}
+
+static void
+check_id(xmlNode *xml, const char *id)
+{
+    xmlNode *match = NULL;
+    int count = 0;
+
+    search_id(xmlDocGetRootElement(xml->doc), id, &match, &count);
+    g_assert(pcmk__xml_find_id(xml, id) == ((count == 1)? match : NULL));
+}
+
+static void
+lookup(void)
+{
+    xmlNode *xml = string2xml(INPUT);
+
+    g_assert(pcmk__xml_find_id(xml, "rsc1") != NULL);
+    check_id(xml, "rsc1");
+    check_id(xml, "rsc3");
+    check_id(xml, "grp");
+    check_id(xml, "none");
+    g_assert(pcmk__xml_find_id(xml, "none") == NULL);
+    g_assert(pcmk__xml_find_id(NULL, "rsc1") == NULL);
+    g_assert(pcmk__xml_find_id(xml, NULL) == NULL);
+    free_xml(xml);
+}
+
+static void
+create(void)
+{
+    xmlNode *xml = string2xml(INPUT);
+    xmlNode *resources = get_xpath_object("//resources", xml, LOG_ERR);
+    xmlNode *rsc = NULL;
+    xmlNode *dup = NULL;
+
+    check_id(xml, "rsc4");
+
+    // Elements created after the index is built are found
+    rsc = create_xml_node(resources, XML_CIB_TAG_RESOURCE);
+    crm_xml_add(rsc, XML_ATTR_ID, "rsc4");
+    g_assert(pcmk__xml_find_id(xml, "rsc4") == rsc);
+
+    // Duplicates are not, until only one is left
+    dup = create_xml_node(resources, XML_CIB_TAG_RESOURCE);
+    crm_xml_add(dup, XML_ATTR_ID, "rsc4");
+    g_assert(pcmk__xml_find_id(xml, "rsc4") == NULL);
+    free_xml(dup);
+    g_assert(pcmk__xml_find_id(xml, "rsc4") == rsc);
+
+    // Copies are indexed like any other new element
+    dup = add_node_copy(resources, rsc);
+    check_id(xml, "rsc4");
+    free_xml(rsc);
+    g_assert(pcmk__xml_find_id(xml, "rsc4") == dup);
+    free_xml(xml);
+}
+
+static void
+change_id(void)
+{
+    xmlNode *xml = string2xml(INPUT);
+    xmlNode *rsc = NULL;
+
+    rsc = pcmk__xml_find_id(xml, "rsc1");
+    g_assert(rsc != NULL);
+
+    // Changed in place
+    crm_xml_add(rsc, XML_ATTR_ID, "rsc9");
+    g_assert(pcmk__xml_find_id(xml, "rsc1") == NULL);
+    g_assert(pcmk__xml_find_id(xml, "rsc9") == rsc);
+
+    // Changed to an ID already in use, then back
+    crm_xml_add(rsc, XML_ATTR_ID, "rsc2");
+    check_id(xml, "rsc2");
+    g_assert(pcmk__xml_find_id(xml, "rsc2") == NULL);
+    crm_xml_add(rsc, XML_ATTR_ID, "rsc1");
+    g_assert(pcmk__xml_find_id(xml, "rsc1") == rsc);
+    check_id(xml, "rsc2");
+
+    // Removed
+    xml_remove_prop(rsc, XML_ATTR_ID);
+    g_assert(pcmk__xml_find_id(xml, "rsc1") == NULL);
+    free_xml(xml);
+}
+
+static void
+free_element(void)
+{
+    xmlNode *xml = string2xml(INPUT);
+    xmlNode *group = pcmk__xml_find_id(xml, "grp");
+
+    g_assert(group != NULL);
+    g_assert(pcmk__xml_find_id(xml, "rsc3") != NULL);
+
+    // Freeing a subtree removes all of it (ASan catches any dangling entry)
+    free_xml(group);
+    g_assert(pcmk__xml_find_id(xml, "grp") == NULL);
+    g_assert(pcmk__xml_find_id(xml, "rsc3") == NULL);
+    check_id(xml, "rsc1");
+
+    // Freeing an element queued but not yet indexed
+    group = create_xml_node(xml, "group");
+    crm_xml_add(group, XML_ATTR_ID, "grp");
+    free_xml(group);
+    g_assert(pcmk__xml_find_id(xml, "grp") == NULL);
+    free_xml(xml);
+}
+
+static void
+move(void)
+{
+    xmlNode *xml = string2xml(INPUT);
+    xmlNode *other = create_xml_node(NULL, "other");
+    xmlNode *constraints = get_xpath_object("//constraints", xml, LOG_ERR);
+    xmlNode *rsc = pcmk__xml_find_id(xml, "rsc1");
+    xmlNode *group = NULL;
+
+    // Within a document
+    g_assert(rsc != NULL);
+    xmlUnlinkNode(rsc);
+    g_assert(pcmk__xml_find_id(xml, "rsc1") == NULL);
+    xmlAddChild(constraints, rsc);
+    g_assert(pcmk__xml_find_id(xml, "rsc1") == rsc);
+
+    // To another indexed document, with children
+    check_id(other, "grp");
+    group = pcmk__xml_find_id(xml, "grp");
+    pcmk__xml_move(other, group);
+    g_assert(pcmk__xml_find_id(xml, "grp") == NULL);
+    g_assert(pcmk__xml_find_id(xml, "rsc3") == NULL);
+    g_assert(pcmk__xml_find_id(other, "grp") == group);
+    g_assert(pcmk__xml_find_id(other, "rsc3") != NULL);
+
+    // Freeing the original document leaves the moved elements alone
+    free_xml(xml);
+    g_assert(pcmk__xml_find_id(other, "rsc3") != NULL);
+
+    // The top-level element of a document, whose document goes with it
+    xml = string2xml(INPUT);
+    g_assert(pcmk__xml_find_id(xml, "rsc2") != NULL);
+    pcmk__xml_move(other, xml);
+    g_assert(pcmk__xml_find_id(other, "rsc2") != NULL);
+    g_assert(pcmk__xml_find_id(other, "rsc2")->doc == other->doc);
+
+    // Into a new document of its own
+    rsc = pcmk__xml_find_id(other, "rsc1");
+    g_assert(rsc != NULL);
+    pcmk__xml_move(NULL, rsc);
+    g_assert(rsc->doc != other->doc);
+    g_assert(xmlDocGetRootElement(rsc->doc) == rsc);
+    g_assert(pcmk__xml_find_id(other, "rsc1") == NULL);
+    g_assert(pcmk__xml_find_id(rsc, "rsc1") == rsc);
+    free_xml(rsc);
+
+    // Moves libxml2 can't tell us about are not found in the old document
+    xml = string2xml(INPUT);
+    rsc = pcmk__xml_find_id(xml, "rsc1");
+    xmlUnlinkNode(rsc);
+    xmlAddChild(other, rsc);
+    g_assert(pcmk__xml_find_id(xml, "rsc1") == NULL);
+    free_xml(other);
+    g_assert(pcmk__xml_find_id(xml, "rsc1") == NULL);
+    free_xml(xml);
+}
+
+// Apply a deterministic series of random changes, checking lookups after each
+static void
+random_changes(void)
+{
+    const char *ids[] = { "a", "b", "c", "d", "e", "f" };
+    GPtrArray *elements = g_ptr_array_new();
+    xmlNode *xml = create_xml_node(NULL, XML_TAG_CIB);
+    unsigned int seed = 1;
+
+    g_ptr_array_add(elements, xml);
+    for (int step = 0; step < 2000; step++) {
+        xmlNode *target = NULL;
+        xmlNode *iter = NULL;
+
+        seed = (seed * 1103515245) + 12345;
+        target = g_ptr_array_index(elements, (seed >> 8) % elements->len);
+
+        switch ((seed >> 4) % 5) {
+            case 0: // Create an element
+            case 1:
+                iter = create_xml_node(target, "element");
+                crm_xml_add(iter, XML_ATTR_ID, ids[(seed >> 16) % DIMOF(ids)]);
+                g_ptr_array_add(elements, iter);
+                break;
+
+            case 2: // Change or remove an ID
+                if ((seed >> 16) % 4) {
+                    crm_xml_add(target, XML_ATTR_ID,
+                                ids[(seed >> 16) % DIMOF(ids)]);
+                } else {
+                    xml_remove_prop(target, XML_ATTR_ID);
+                }
+                break;
+
+            case 3: // Free a subtree, forgetting everything in it
+                if (target != xml) {
+                    for (guint lpc = 0; lpc < elements->len; lpc++) {
+                        for (iter = g_ptr_array_index(elements, lpc);
+                             (iter != NULL) && (iter != target);
+                             iter = iter->parent);
+                        if (iter == target) {
+                            g_ptr_array_remove_index_fast(elements, lpc--);
+                        }
+                    }
+                    free_xml(target);
+                }
+                break;
+
+            case 4: // Move an element to the top, unless it is the top
+                if (target != xml) {
+                    xmlUnlinkNode(target);
+                    xmlAddChild(xml, target);
+                }
+                break;
+        }
+
+        for (int lpc = 0; lpc < DIMOF(ids); lpc++) {
+            check_id(xml, ids[lpc]);
+        }
+    }
+    g_ptr_array_free(elements, TRUE);
+    free_xml(xml);
+}
+
+int
+main(int argc, char **argv)
+{
+    crm_xml_init();
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/common/xml/find_id/lookup", lookup);
+    g_test_add_func("/common/xml/find_id/create", create);
+    g_test_add_func("/common/xml/find_id/change_id", change_id);
+    g_test_add_func("/common/xml/find_id/free", free_element);
+    g_test_add_func("/common/xml/find_id/move", move);
+    g_test_add_func("/common/xml/find_id/random_changes", random_changes);
+    return g_test_run();
+}
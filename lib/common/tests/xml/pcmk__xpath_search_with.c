@@ -0,0 +1,234 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
+
+#define NODES 50
+#define RESOURCES 20
+
+#define LRM_XPATH "//" XML_CIB_TAG_STATE "[@" XML_ATTR_UNAME "=$node]" \
+                  "//" XML_LRM_TAG_RESOURCE "[@" XML_ATTR_ID "=$rsc]"
+
+// A status section with a history entry for every resource on every node
+static xmlNode *
+create_status(void)
+{
+    xmlNode *status = create_xml_node(NULL, XML_CIB_TAG_STATUS);
+
+    for (int node = 0; node < NODES; node++) {
+        xmlNode *state = create_xml_node(status, XML_CIB_TAG_STATE);
+        xmlNode *lrm = NULL;
+        char uname[32];
+
+        snprintf(uname, sizeof(uname), "node%d", node);
+        crm_xml_set_id(state, "%d", node + 1);
+        crm_xml_add(state, XML_ATTR_UNAME, uname);
+        lrm = create_xml_node(create_xml_node(state, XML_CIB_TAG_LRM),
+                              XML_LRM_TAG_RESOURCES);
+        for (int rsc = 0; rsc < RESOURCES; rsc++) {
+            xmlNode *entry = create_xml_node(lrm, XML_LRM_TAG_RESOURCE);
+
+            crm_xml_set_id(entry, "rsc%d", rsc);
+        }
+    }
+    return status;
+}
+
+static xmlNode *
+find_one(xmlNode *xml, const char *node, const char *rsc)
+{
+    xmlXPathObjectPtr xpathObj = pcmk__xpath_search_with(xml, LRM_XPATH,
+                                                         "node", node,
+                                                         "rsc", rsc, NULL);
+    xmlNode *match = NULL;
+
+    g_assert_cmpint(numXpathResults(xpathObj), ==, 1);
+    match = getXpathResult(xpathObj, 0);
+    freeXpathObject(xpathObj);
+    return match;
+}
+
+// Check how the cache was used since the last check
+static void
+check_stats(unsigned int *hits, unsigned int *misses,
+            unsigned int expected_hits, unsigned int expected_misses)
+{
+    unsigned int new_hits = 0;
+    unsigned int new_misses = 0;
+
+    pcmk__xpath_cache_stats(&new_hits, &new_misses);
+    g_assert_cmpint(new_hits - *hits, ==, expected_hits);
+    g_assert_cmpint(new_misses - *misses, ==, expected_misses);
+    *hits = new_hits;
+    *misses = new_misses;
+}
+
+static void
+hit_rate(void)
+{
+    xmlNode *xml = create_status();
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+
+    find_one(xml, "node0", "rsc0");
+    pcmk__xpath_cache_stats(&hits, &misses);
+
+    // Every lookup of the scheduler's kind shares one compiled expression
+    for (int node = 0; node < NODES; node++) {
+        char *uname = crm_strdup_printf("node%d", node);
+
+        for (int rsc = 0; rsc < RESOURCES; rsc++) {
+            char *id = crm_strdup_printf("rsc%d", rsc);
+            xmlNode *match = find_one(xml, uname, id);
+
+            g_assert_cmpstr(ID(match), ==, id);
+            g_assert_cmpstr(crm_element_value(match->parent->parent->parent,
+                                              XML_ATTR_UNAME), ==, uname);
+            free(id);
+        }
+        free(uname);
+    }
+    check_stats(&hits, &misses, NODES * RESOURCES, 0);
+    free_xml(xml);
+}
+
+static void
+one_off(void)
+{
+    xmlNode *xml = create_status();
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+
+    find_one(xml, "node0", "rsc0");
+    pcmk__xpath_cache_stats(&hits, &misses);
+
+    // Expressions formatted for one search neither use nor evict cached ones
+    for (int node = 0; node < NODES; node++) {
+        char *xpath = crm_strdup_printf("//" XML_CIB_TAG_STATE "[@"
+                                        XML_ATTR_UNAME "='node%d']", node);
+        xmlXPathObjectPtr xpathObj = xpath_search(xml, xpath);
+
+        g_assert_cmpint(numXpathResults(xpathObj), ==, 1);
+        freeXpathObject(xpathObj);
+        free(xpath);
+    }
+    check_stats(&hits, &misses, 0, 0);
+
+    find_one(xml, "node1", "rsc1");
+    check_stats(&hits, &misses, 1, 0);
+    free_xml(xml);
+}
+
+static void
+constant(void)
+{
+    xmlNode *xml = create_status();
+    xmlXPathObjectPtr xpathObj = NULL;
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+
+    pcmk__xpath_cache_stats(&hits, &misses);
+
+    // A constant expression is compiled once, however often it is searched
+    for (int lpc = 0; lpc < 10; lpc++) {
+        xpathObj = pcmk__xpath_search_with(xml, "//" XML_LRM_TAG_RESOURCE
+                                           "[@" XML_ATTR_ID "='rsc0']", NULL);
+        g_assert_cmpint(numXpathResults(xpathObj), ==, NODES);
+        freeXpathObject(xpathObj);
+    }
+    check_stats(&hits, &misses, 9, 1);
+
+    // A search for a unique ID is answered from the ID index instead
+    xpathObj = pcmk__xpath_search_with(xml, "//" XML_CIB_TAG_STATE
+                                       "[@" XML_ATTR_ID "='7']", NULL);
+    g_assert_cmpint(numXpathResults(xpathObj), ==, 1);
+    g_assert_cmpstr(crm_element_value(getXpathResult(xpathObj, 0),
+                                      XML_ATTR_UNAME), ==, "node6");
+    freeXpathObject(xpathObj);
+    check_stats(&hits, &misses, 0, 0);
+    free_xml(xml);
+}
+
+static void
+quoted_values(void)
+{
+    xmlNode *xml = create_status();
+    xmlNode *state = get_xpath_object("//" XML_CIB_TAG_STATE "[@id='1']", xml,
+                                      LOG_ERR);
+    const char *uname = "it's a \"node\"";
+
+    // Values are never parsed as part of the expression
+    crm_xml_add(state, XML_ATTR_UNAME, uname);
+    g_assert(find_one(xml, uname, "rsc3")->parent->parent->parent == state);
+    free_xml(xml);
+}
+
+static void
+bounded(void)
+{
+    xmlNode *xml = create_status();
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+
+    find_one(xml, "node0", "rsc0");
+    pcmk__xpath_cache_stats(&hits, &misses);
+
+    // A frequently used expression outlasts a stream of unique ones
+    for (int lpc = 0; lpc < 200; lpc++) {
+        char *xpath = crm_strdup_printf("//" XML_LRM_TAG_RESOURCE
+                                        "[@" XML_ATTR_ID "=$rsc][%d]", lpc + 1);
+        xmlXPathObjectPtr xpathObj = pcmk__xpath_search_with(xml, xpath,
+                                                             "rsc", "rsc0",
+                                                             NULL);
+
+        freeXpathObject(xpathObj);
+        free(xpath);
+        find_one(xml, "node0", "rsc0");
+    }
+    check_stats(&hits, &misses, 200, 200);
+
+    // The least recently used ones are evicted
+    for (int lpc = 0; lpc < 200; lpc++) {
+        char *xpath = crm_strdup_printf("//" XML_LRM_TAG_RESOURCE
+                                        "[@" XML_ATTR_ID "=$rsc][%d]", lpc + 1);
+        xmlXPathObjectPtr xpathObj = pcmk__xpath_search_with(xml, xpath,
+                                                             "rsc", "rsc0",
+                                                             NULL);
+
+        freeXpathObject(xpathObj);
+        free(xpath);
+    }
+    check_stats(&hits, &misses, 0, 200);
+    free_xml(xml);
+}
+
+int
+main(int argc, char **argv)
+{
+    crm_xml_init();
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/common/xml/xpath_search_with/hit_rate", hit_rate);
+    g_test_add_func("/common/xml/xpath_search_with/one_off", one_off);
+    g_test_add_func("/common/xml/xpath_search_with/constant", constant);
+    g_test_add_func("/common/xml/xpath_search_with/quoted_values",
+                    quoted_values);
+    g_test_add_func("/common/xml/xpath_search_with/bounded", bounded);
+    return g_test_run();
+}
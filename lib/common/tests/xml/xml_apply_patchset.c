@@ -0,0 +1,398 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
+
+// Large enough for resolved paths to be indexed
+#define ENTRIES 50
+
+#define LRM_PATH "/" XML_TAG_CIB "/" XML_CIB_TAG_STATUS                  \
+                 "/" XML_CIB_TAG_STATE "[@" XML_ATTR_ID "='1']"          \
+                 "/" XML_CIB_TAG_LRM "[@" XML_ATTR_ID "='1']"            \
+                 "/" XML_LRM_TAG_RESOURCES
+
+static xmlNode *
+add_entry(xmlNode *lrm, const char *name, const char *id)
+{
+    xmlNode *entry = create_xml_node(lrm, name);
+    xmlNode *op = create_xml_node(entry, XML_LRM_TAG_RSC_OP);
+
+    crm_xml_add(entry, XML_ATTR_ID, id);
+    crm_xml_set_id(op, "%s_last_0", id);
+    return entry;
+}
+
+// A status section with a history entry for each of a number of resources
+static xmlNode *
+create_status(int entries)
+{
+    xmlNode *cib = create_xml_node(NULL, XML_TAG_CIB);
+    xmlNode *state = create_xml_node(create_xml_node(cib, XML_CIB_TAG_STATUS),
+                                     XML_CIB_TAG_STATE);
+    xmlNode *lrm = create_xml_node(state, XML_CIB_TAG_LRM);
+
+    crm_xml_add(state, XML_ATTR_ID, "1");
+    crm_xml_add(lrm, XML_ATTR_ID, "1");
+    lrm = create_xml_node(lrm, XML_LRM_TAG_RESOURCES);
+    for (int lpc = 0; lpc < entries; lpc++) {
+        char *id = crm_strdup_printf("rsc%d", lpc);
+
+        add_entry(lrm, XML_LRM_TAG_RESOURCE, id);
+        free(id);
+    }
+    return cib;
+}
+
+static xmlNode *
+add_change(xmlNode *patchset, const char *op, const char *format, ...)
+__attribute__ ((__format__ (__printf__, 3, 4)));
+
+static xmlNode *
+add_change(xmlNode *patchset, const char *op, const char *format, ...)
+{
+    xmlNode *change = create_xml_node(patchset, XML_DIFF_CHANGE);
+    char *path = NULL;
+    va_list ap;
+
+    va_start(ap, format);
+    CRM_ASSERT(vasprintf(&path, format, ap) >= 0);
+    va_end(ap);
+
+    crm_xml_add(change, XML_DIFF_OP, op);
+    crm_xml_add(change, XML_DIFF_PATH, path);
+    free(path);
+    return change;
+}
+
+// Add a "modify" change that replaces an element's attributes
+static void
+add_modify(xmlNode *patchset, const char *path, const char *id,
+           const char *value)
+{
+    xmlNode *change = add_change(patchset, "modify", "%s", path);
+    xmlNode *result = create_xml_node(create_xml_node(change, XML_DIFF_RESULT),
+                                      "result");
+
+    crm_xml_add(result, XML_ATTR_ID, id);
+    crm_xml_add(result, XML_NVPAIR_ATTR_VALUE, value);
+}
+
+/* Resolve a path the way patchset paths were resolved before they were
+ * indexed, by taking the first child that matches each component
+ */
+static xmlNode *
+first_match(xmlNode *top, const char *path)
+{
+    xmlNode *target = (xmlNode *) top->doc;
+    gchar **components = g_strsplit(path, "/", 0);
+
+    for (int lpc = 1; (components[lpc] != NULL) && (target != NULL); lpc++) {
+        char tag[64] = { '\0', };
+        char id[64] = { '\0', };
+        xmlNode *child = NULL;
+
+        sscanf(components[lpc], "%63[^[][@" XML_ATTR_ID "='%63[^']", tag, id);
+        for (child = __xml_first_child(target); child != NULL;
+             child = __xml_next(child)) {
+            if (crm_str_eq((const char *) child->name, tag, TRUE)
+                && ((id[0] == '\0') || crm_str_eq(ID(child), id, TRUE))) {
+                break;
+            }
+        }
+        target = child;
+    }
+    g_strfreev(components);
+    return target;
+}
+
+// Apply "modify" and "delete" changes using first_match()
+static int
+apply_first_match(xmlNode *xml, xmlNode *patchset)
+{
+    int rc = pcmk_ok;
+
+    for (xmlNode *change = __xml_first_child(patchset); change != NULL;
+         change = __xml_next(change)) {
+        const char *op = crm_element_value(change, XML_DIFF_OP);
+        xmlNode *match = first_match(xml,
+                                     crm_element_value(change, XML_DIFF_PATH));
+
+        if (match == NULL) {
+            if (strcmp(op, "delete") != 0) {
+                rc = -pcmk_err_diff_failed;
+            }
+
+        } else if (strcmp(op, "delete") == 0) {
+            free_xml(match);
+
+        } else {
+            xmlNode *result = first_named_child(change, XML_DIFF_RESULT);
+            xmlNode *attrs = __xml_first_child(result);
+
+            while (match->properties != NULL) {
+                xml_remove_prop(match, (const char *) match->properties->name);
+            }
+            for (xmlAttr *a = attrs->properties; a != NULL; a = a->next) {
+                crm_xml_add(match, (const char *) a->name,
+                            crm_element_value(attrs, (const char *) a->name));
+            }
+        }
+    }
+    return rc;
+}
+
+/* Check that a patchset applies as it would with first_match(), and return
+ * the result of applying it
+ */
+static int
+check_patchset(xmlNode *xml, xmlNode *patchset)
+{
+    xmlNode *expected = copy_xml(xml);
+    char *expected_s = NULL;
+    char *applied_s = NULL;
+    int rc = apply_first_match(expected, patchset);
+
+    g_assert_cmpint(xml_apply_patchset(xml, patchset, FALSE), ==, rc);
+
+    expected_s = dump_xml_unformatted(expected);
+    applied_s = dump_xml_unformatted(xml);
+    g_assert_cmpstr(applied_s, ==, expected_s);
+    free(expected_s);
+    free(applied_s);
+    free_xml(expected);
+    return rc;
+}
+
+static xmlNode *
+create_patchset(void)
+{
+    xmlNode *patchset = create_xml_node(NULL, XML_TAG_DIFF);
+
+    crm_xml_add(patchset, "format", "2");
+    return patchset;
+}
+
+static void
+unique_ids(void)
+{
+    xmlNode *xml = create_status(ENTRIES);
+    xmlNode *patchset = create_patchset();
+
+    add_modify(patchset, LRM_PATH "/lrm_resource[@id='rsc10']", "rsc10", "a");
+    add_modify(patchset,
+               LRM_PATH "/lrm_resource[@id='rsc30']"
+               "/lrm_rsc_op[@id='rsc30_last_0']", "rsc30_last_0", "b");
+    add_change(patchset, "delete", LRM_PATH "/lrm_resource[@id='rsc20']");
+    add_change(patchset, "delete", LRM_PATH "/lrm_resource[@id='rsc20']");
+    add_modify(patchset, LRM_PATH "/lrm_resource[@id='rsc49']", "rsc49", "c");
+    g_assert_cmpint(check_patchset(xml, patchset), ==, pcmk_ok);
+
+    g_assert_cmpstr(crm_element_value(pcmk__xml_find_id(xml, "rsc10"),
+                                      XML_NVPAIR_ATTR_VALUE), ==, "a");
+    g_assert(pcmk__xml_find_id(xml, "rsc20") == NULL);
+    free_xml(patchset);
+
+    // Deleted elements are not found again
+    patchset = create_patchset();
+    add_modify(patchset, LRM_PATH "/lrm_resource[@id='rsc20']", "rsc20", "d");
+    g_assert_cmpint(check_patchset(xml, patchset), ==,
+                    -pcmk_err_diff_failed);
+    free_xml(patchset);
+    free_xml(xml);
+}
+
+static void
+duplicate_ids(void)
+{
+    xmlNode *xml = create_status(ENTRIES);
+    xmlNode *lrm = get_xpath_object(LRM_PATH, xml, LOG_ERR);
+    xmlNode *patchset = create_patchset();
+    xmlNode *second = add_entry(lrm, XML_LRM_TAG_RESOURCE, "rsc5");
+
+    // The first of several siblings with an ID is used, until it is deleted
+    add_modify(patchset, LRM_PATH "/lrm_resource[@id='rsc5']", "rsc5", "a");
+    add_change(patchset, "delete", LRM_PATH "/lrm_resource[@id='rsc5']");
+    add_modify(patchset, LRM_PATH "/lrm_resource[@id='rsc5']", "rsc5", "b");
+    add_modify(patchset,
+               LRM_PATH "/lrm_resource[@id='rsc5']"
+               "/lrm_rsc_op[@id='rsc5_last_0']", "rsc5_last_0", "c");
+    g_assert_cmpint(check_patchset(xml, patchset), ==, pcmk_ok);
+    free_xml(patchset);
+
+    g_assert_cmpstr(crm_element_value(second, XML_NVPAIR_ATTR_VALUE), ==, "b");
+    g_assert(second == pcmk__xml_find_id(xml, "rsc5"));
+    free_xml(xml);
+}
+
+static void
+other_names(void)
+{
+    xmlNode *xml = create_status(ENTRIES);
+    xmlNode *lrm = get_xpath_object(LRM_PATH, xml, LOG_ERR);
+    xmlNode *patchset = create_patchset();
+
+    // A sibling with the same ID but another name comes first
+    xmlAddPrevSibling(__xml_first_child(lrm),
+                      add_entry(lrm, "other", "rsc7"));
+
+    add_modify(patchset, LRM_PATH "/lrm_resource[@id='rsc7']", "rsc7", "a");
+    add_modify(patchset, LRM_PATH "/other[@id='rsc7']", "rsc7", "b");
+    add_modify(patchset, LRM_PATH "/other[@id='rsc8']", "rsc8", "c");
+    g_assert_cmpint(check_patchset(xml, patchset), ==,
+                    -pcmk_err_diff_failed);
+    free_xml(patchset);
+    free_xml(xml);
+}
+
+static void
+changed_id(void)
+{
+    xmlNode *xml = create_status(ENTRIES);
+    xmlNode *patchset = create_patchset();
+
+    // An element is found by its new ID once a change sets it
+    add_modify(patchset, LRM_PATH "/lrm_resource[@id='rsc3']", "rsc99", "a");
+    add_modify(patchset, LRM_PATH "/lrm_resource[@id='rsc99']", "rsc99", "b");
+    add_modify(patchset, LRM_PATH "/lrm_resource[@id='rsc4']", "rsc3", "c");
+    add_modify(patchset, LRM_PATH "/lrm_resource[@id='rsc3']", "rsc3", "d");
+    add_modify(patchset, LRM_PATH "/lrm_resource[@id='rsc4']", "rsc4", "e");
+    g_assert_cmpint(check_patchset(xml, patchset), ==,
+                    -pcmk_err_diff_failed);
+
+    g_assert_cmpstr(crm_element_value(pcmk__xml_find_id(xml, "rsc99"),
+                                      XML_NVPAIR_ATTR_VALUE), ==, "b");
+    g_assert_cmpstr(crm_element_value(pcmk__xml_find_id(xml, "rsc3"),
+                                      XML_NVPAIR_ATTR_VALUE), ==, "d");
+    free_xml(patchset);
+    free_xml(xml);
+}
+
+static void
+unexpected_path(void)
+{
+    xmlNode *xml = create_status(ENTRIES);
+    xmlNode *patchset = create_patchset();
+
+    // Paths Pacemaker doesn't generate are resolved by XPath
+    add_change(patchset, "delete", LRM_PATH "/lrm_resource[@id='rsc1'][1]");
+    add_change(patchset, "delete", LRM_PATH "/lrm_resource[last()]");
+    g_assert_cmpint(xml_apply_patchset(xml, patchset, FALSE), ==, pcmk_ok);
+    g_assert(pcmk__xml_find_id(xml, "rsc1") == NULL);
+    g_assert(pcmk__xml_find_id(xml, "rsc49") == NULL);
+    g_assert(pcmk__xml_find_id(xml, "rsc48") != NULL);
+    free_xml(patchset);
+    free_xml(xml);
+}
+
+// Apply a deterministic series of random patchsets
+static void
+random_changes(void)
+{
+    const char *names[] = {
+        XML_LRM_TAG_RESOURCE, XML_LRM_TAG_RESOURCE, "other"
+    };
+    unsigned int seed = 1;
+
+    for (int lpc = 0; lpc < 500; lpc++) {
+        int entries = 0;
+        int changes = 0;
+        xmlNode *xml = NULL;
+        xmlNode *lrm = NULL;
+        xmlNode *patchset = create_patchset();
+
+        seed = (seed * 1103515245) + 12345;
+        entries = (seed >> 16) % 40;
+        xml = create_status(entries);
+        lrm = get_xpath_object(LRM_PATH, xml, LOG_ERR);
+
+        // Some duplicate IDs, with the same name or another one
+        for (int dup = (seed >> 8) % 6; dup > 0; dup--) {
+            char *id = NULL;
+
+            seed = (seed * 1103515245) + 12345;
+            id = crm_strdup_printf("rsc%d", (seed >> 16) % (entries + 1));
+            add_entry(lrm, names[(seed >> 8) % DIMOF(names)], id);
+            free(id);
+        }
+
+        seed = (seed * 1103515245) + 12345;
+        changes = 1 + (seed >> 16) % 20;
+        for (int change = 0; change < changes; change++) {
+            const char *name = NULL;
+            int id = 0;
+            char *path = NULL;
+            char *new_id = NULL;
+            xmlNode *match = NULL;
+
+            seed = (seed * 1103515245) + 12345;
+            name = names[(seed >> 8) % DIMOF(names)];
+            id = (seed >> 16) % (entries + 3);
+            if ((seed >> 12) % 3) {
+                path = crm_strdup_printf(LRM_PATH "/%s[@id='rsc%d']",
+                                         name, id);
+            } else {
+                path = crm_strdup_printf(LRM_PATH "/%s[@id='rsc%d']"
+                                         "/lrm_rsc_op[@id='rsc%d_last_0']",
+                                         name, id, id);
+            }
+
+            seed = (seed * 1103515245) + 12345;
+            switch ((seed >> 8) % 3) {
+                case 0:
+                    add_change(patchset, "delete", "%s", path);
+                    break;
+
+                case 1: // Possibly changing the ID
+                    new_id = crm_strdup_printf("rsc%d",
+                                               (seed >> 16) % (entries + 3));
+                    add_modify(patchset, path, new_id, "changed");
+                    free(new_id);
+                    break;
+
+                default: // Keeping the ID
+                    match = first_match(xml, path);
+                    add_modify(patchset, path, (match? ID(match) : NULL),
+                               "same");
+                    break;
+            }
+            free(path);
+        }
+
+        check_patchset(xml, patchset);
+        free_xml(patchset);
+        free_xml(xml);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    crm_xml_init();
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/common/xml/apply_patchset/unique_ids", unique_ids);
+    g_test_add_func("/common/xml/apply_patchset/duplicate_ids", duplicate_ids);
+    g_test_add_func("/common/xml/apply_patchset/other_names", other_names);
+    g_test_add_func("/common/xml/apply_patchset/changed_id", changed_id);
+    g_test_add_func("/common/xml/apply_patchset/unexpected_path",
+                    unexpected_path);
+    g_test_add_func("/common/xml/apply_patchset/random_changes",
+                    random_changes);
+    return g_test_run();
+}
@@ -0,0 +1,304 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+
+#define DOCUMENTS_PER_DIGEST 100
+
+/* MD5 sums of the v2 patchsets (and the results of applying them) for each run
+ * of DOCUMENTS_PER_DIGEST documents, as calculated before changes were
+ * calculated in linear time. Sibling lists of eight or more elements are
+ * diffed using an index instead of a search, so any difference in positions
+ * or matches would show up here.
+ */
+static const char *expected[] = {
+    "9732e8b336016f311462e5b138f2da66",
+    "ddea1143259f33f47b37082a50ce9c77",
+    "0b431a43474d8db3222c12c97dc99413",
+    "6f1534d626cb9451ba579cde007b062a",
+    "f78cb909e20f7104541e3936d25a30ae",
+    "fd08aa4a4cdd6fc78919f0e2360cb660",
+    "1743eddfb1131515e3aa529cf802aad7",
+    "cc226fb3d265ad88279e1a29332b2cc1",
+    "0f5e21127674e2d6d6766934f0e94414",
+    "6669b6aa321ab54b4ecc329855246067",
+    "8ae8b25d86b17979cbfbbeeb6f6ccaf2",
+    "c0c9f099b372740c403524e4c4ad29e3",
+    "8820dbd861097561d17a9ef404564729",
+    "2f4dcf568e8130d444f987a18d5b2d2a",
+    "c3d89c36a65f5adab7d915ad0fe770f3",
+    "02a27305185a8d387736113c45e62c51",
+    "842a71ebbb221c17816fdf8a76e1b723",
+    "959c55f358aa17cb3c9efa344499979e",
+    "bb4453897cdb623fd03e651712c007b5",
+    "e8718e11eeb51b0576440a8184a2de07",
+    "21fe347b644fb70c6a6fdc264c53117b",
+    "5b2464ff0cd90e9ad4c734cfb3f27005",
+    "ac9c1e749cc065d05b8eae244a3d648d",
+    "267628cfb98e3aa3b45fcaf96696c612",
+    "6279a99a9e8698d76f6935b241f9e293",
+    "4774f13c69de52c2c6e1999e03eb7e32",
+    "fd515f04c73650d169d64779dde2d6e9",
+    "7c51feda5a666f1629ee37f3855613ea",
+    "783434c85c7d1040278d500a0ac6eab1",
+    "de082ab3db5cd95f37b15af0823a4aae",
+    "4c9b8cbef7eebfb81a52059f7d8cfc46",
+    "6c943de5d42447d3d8146bd4279d88d5",
+    "3bbc98414a348d01fa95b0877a61341c",
+    "c17f32ed40719dee489b28885ec92af6",
+    "0b298cda2d26c07c5e0272a4452f5305",
+    "62faac765e5946163006c29b811fcce2",
+    "63dca483fb96d54f8c47ede658fe0582",
+    "80ce7927612d76b1afa86cd08db0540a",
+    "5da087312d347cabd8676cff0c60b6e9",
+    "ffa064276e04e3753697179ce5235879",
+    "b2129cc230b860f09fd39c0646b63d37",
+    "6c90b70b684499774512dcdce214e3f4",
+    "62397ceeb9aef252338a4380f870085b",
+    "b6bfea1047bc0f3fb843668d9ea75d2a",
+    "aecced36097e05e29a9f22fd3acdd435",
+};
+
+static unsigned int
+next_random(unsigned int *seed, unsigned int limit)
+{
+    *seed = (*seed * 1103515245) + 12345;
+    return (*seed >> 16) % limit;
+}
+
+// A CIB with short and long sibling lists, and some duplicate IDs
+static xmlNode *
+create_cib(unsigned int *seed)
+{
+    xmlNode *cib = create_xml_node(NULL, XML_TAG_CIB);
+    xmlNode *config = create_xml_node(cib, XML_CIB_TAG_CONFIGURATION);
+    xmlNode *resources = create_xml_node(config, XML_CIB_TAG_RESOURCES);
+    xmlNode *status = create_xml_node(cib, XML_CIB_TAG_STATUS);
+    int rscs = 1 + next_random(seed, 20);
+    int nodes = 1 + next_random(seed, 4);
+
+    crm_xml_add(cib, XML_ATTR_GENERATION_ADMIN, "0");
+    crm_xml_add(cib, XML_ATTR_GENERATION, "1");
+    crm_xml_add(cib, XML_ATTR_NUMUPDATES, "1");
+    create_xml_node(config, XML_CIB_TAG_CONSTRAINTS);
+
+    for (int rsc = 0; rsc < rscs; rsc++) {
+        xmlNode *primitive = create_xml_node(resources, XML_CIB_TAG_RESOURCE);
+
+        crm_xml_set_id(primitive, "rsc%d", next_random(seed, rscs + 2));
+        crm_xml_add(primitive, XML_AGENT_ATTR_CLASS, "ocf");
+    }
+
+    for (int node = 0; node < nodes; node++) {
+        xmlNode *state = create_xml_node(status, XML_CIB_TAG_STATE);
+        xmlNode *lrm = create_xml_node(state, XML_CIB_TAG_LRM);
+        int entries = next_random(seed, 24);
+
+        crm_xml_set_id(state, "%d", node + 1);
+        crm_xml_set_id(lrm, "%d", node + 1);
+        lrm = create_xml_node(lrm, XML_LRM_TAG_RESOURCES);
+
+        for (int entry = 0; entry < entries; entry++) {
+            xmlNode *history = create_xml_node(lrm, XML_LRM_TAG_RESOURCE);
+            int ops = 1 + next_random(seed, 3);
+
+            crm_xml_set_id(history, "rsc%d", entry);
+            for (int op = 0; op < ops; op++) {
+                xmlNode *rsc_op = create_xml_node(history, XML_LRM_TAG_RSC_OP);
+
+                crm_xml_set_id(rsc_op, "rsc%d_op%d", entry, op);
+                crm_xml_add_int(rsc_op, XML_LRM_ATTR_CALLID,
+                                next_random(seed, 100));
+            }
+        }
+    }
+    return cib;
+}
+
+static void
+list_elements(xmlNode *xml, GPtrArray *elements)
+{
+    for (xmlNode *child = __xml_first_child_element(xml); child != NULL;
+         child = __xml_next_element(child)) {
+        g_ptr_array_add(elements, child);
+        list_elements(child, elements);
+    }
+}
+
+static xmlNode *
+nth_child(xmlNode *xml, unsigned int n)
+{
+    xmlNode *child = __xml_first_child(xml);
+
+    while ((n-- > 0) && (child != NULL)) {
+        child = __xml_next(child);
+    }
+    return child;
+}
+
+// Add a node as a child of an element, at a random position
+static void
+insert_child(xmlNode *parent, xmlNode *child, unsigned int *seed)
+{
+    xmlNode *sibling = nth_child(parent,
+                                 next_random(seed, xmlChildElementCount(parent)
+                                                   + 2));
+
+    if (sibling == NULL) {
+        xmlAddChild(parent, child);
+    } else {
+        xmlAddPrevSibling(sibling, child);
+    }
+}
+
+// Make a few random changes of the kinds the cluster makes
+static void
+mutate(xmlNode *cib, unsigned int *seed)
+{
+    int changes = 1 + next_random(seed, 6);
+
+    for (int lpc = 0; lpc < changes; lpc++) {
+        GPtrArray *elements = g_ptr_array_new();
+        xmlNode *target = NULL;
+        xmlNode *child = NULL;
+
+        list_elements(cib, elements);
+        if (elements->len == 0) {
+            g_ptr_array_free(elements, TRUE);
+            return;
+        }
+        target = g_ptr_array_index(elements,
+                                   next_random(seed, elements->len));
+        g_ptr_array_free(elements, TRUE);
+
+        switch (next_random(seed, 6)) {
+            case 0: // Delete an element
+                free_xml(target);
+                break;
+
+            case 1: // Move an element among its siblings
+                child = target;
+                target = target->parent;
+                xmlUnlinkNode(child);
+                insert_child(target, child, seed);
+                break;
+
+            case 2: // Create an element, possibly with a sibling's ID
+                child = create_xml_node(target->parent,
+                                        crm_element_name(target));
+                xmlUnlinkNode(child);
+                if (next_random(seed, 2)) {
+                    crm_xml_add(child, XML_ATTR_ID, ID(target));
+                } else {
+                    crm_xml_set_id(child, "new%d", next_random(seed, 1000));
+                }
+                if (next_random(seed, 4) == 0) {
+                    // An ID shared by differently named siblings
+                    xmlNodeSetName(child, (const xmlChar *) "other");
+                }
+                insert_child(target->parent, child, seed);
+                break;
+
+            case 3: // Change an attribute
+                crm_xml_add_int(target, XML_LRM_ATTR_CALLID,
+                                next_random(seed, 100));
+                break;
+
+            case 4: // Reshuffle an element's children
+                elements = g_ptr_array_new();
+                while ((child = __xml_first_child(target)) != NULL) {
+                    xmlUnlinkNode(child);
+                    g_ptr_array_add(elements, child);
+                }
+                while (elements->len > 0) {
+                    guint n = next_random(seed, elements->len);
+
+                    xmlAddChild(target, g_ptr_array_index(elements, n));
+                    g_ptr_array_remove_index(elements, n);
+                }
+                g_ptr_array_free(elements, TRUE);
+                break;
+
+            case 5: // Add a comment
+                child = xmlNewDocComment(target->doc, (const xmlChar *) "note");
+                insert_child(target, child, seed);
+                break;
+        }
+    }
+}
+
+/* Diff a random CIB against a changed copy, recording the patchset and the
+ * result of applying it (which may fail where IDs are duplicated)
+ */
+static void
+diff_document(unsigned int seed, GString *patchsets)
+{
+    xmlNode *old_xml = create_cib(&seed);
+    xmlNode *new_xml = copy_xml(old_xml);
+    xmlNode *patchset = NULL;
+    char *buffer = NULL;
+
+    mutate(new_xml, &seed);
+    xml_track_changes(new_xml, NULL, new_xml, FALSE);
+    xml_calculate_changes(old_xml, new_xml);
+    patchset = xml_create_patchset(2, old_xml, new_xml, NULL, FALSE);
+
+    if (patchset != NULL) {
+        int rc = xml_apply_patchset(old_xml, patchset, FALSE);
+
+        buffer = dump_xml_unformatted(patchset);
+        g_string_append(patchsets, buffer);
+        free(buffer);
+
+        buffer = dump_xml_unformatted(old_xml);
+        g_string_append_printf(patchsets, "\n%d %s", rc, buffer);
+        free(buffer);
+        free_xml(patchset);
+    }
+    g_string_append_c(patchsets, '\n');
+    free_xml(old_xml);
+    free_xml(new_xml);
+}
+
+static void
+random_changes(void)
+{
+    for (int lpc = 0; lpc < DIMOF(expected); lpc++) {
+        GString *patchsets = g_string_sized_new(1024);
+        char *digest = NULL;
+
+        for (int doc = 0; doc < DOCUMENTS_PER_DIGEST; doc++) {
+            diff_document((lpc * DOCUMENTS_PER_DIGEST) + doc + 1, patchsets);
+        }
+        digest = crm_md5sum(patchsets->str);
+        g_assert_cmpstr(digest, ==, expected[lpc]);
+        free(digest);
+        g_string_free(patchsets, TRUE);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    crm_xml_init();
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/common/xml/calculate_changes/random_changes",
+                    random_changes);
+    return g_test_run();
+}
@@ -16,6 +16,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <bzlib.h>
 
 #include <libxml/parser.h>
@@ -104,6 +105,52 @@ pcmk__tracking_xml_changes(xmlNode *xml, bool lazy)
         }                                                               \
     } while(1);
 
+/*!
+ * \internal
+ * \brief Ensure a dump buffer has room for a given number of additional bytes
+ *
+ * \param[in,out] buffer  Buffer to grow (may be NULL)
+ * \param[in]     offset  Current end of text in \p buffer
+ * \param[in,out] max     Current size of \p buffer
+ * \param[in]     len     Number of bytes (excluding terminator) to make room for
+ */
+static inline void
+buffer_reserve(char **buffer, int offset, int *max, size_t len)
+{
+    if ((*buffer == NULL) || ((offset + len) >= (size_t) *max)) {
+        int new_max = QB_MAX(CHUNK_SIZE, (*max) * 2);
+
+        // Grow geometrically, so repeated appends are amortized constant time
+        while ((offset + len) >= (size_t) new_max) {
+            new_max *= 2;
+        }
+        *max = new_max;
+        *buffer = realloc_safe(*buffer, *max);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Append text to a dump buffer without going through snprintf()
+ *
+ * \param[in,out] buffer  Buffer to append to (may be NULL)
+ * \param[in,out] offset  Current end of text in \p buffer
+ * \param[in,out] max     Current size of \p buffer
+ * \param[in]     text    Text to append
+ * \param[in]     len     Number of bytes of \p text to append
+ */
+static inline void
+buffer_add(char **buffer, int *offset, int *max, const char *text, size_t len)
+{
+    buffer_reserve(buffer, *offset, max, len);
+    memcpy(*buffer + *offset, text, len);
+    *offset += len;
+    (*buffer)[*offset] = '\0';
+}
+
+#define buffer_add_str(buffer, offset, max, text) \
+    buffer_add((buffer), (offset), (max), (text), strlen(text))
+
 static void
 insert_prefix(int options, char **buffer, int *offset, int *max, int depth)
 {
@@ -212,6 +259,123 @@ static int add_xml_object(xmlNode * parent, xmlNode * target, xmlNode * update,
 
 #define XML_PRIVATE_MAGIC (long) 0x81726354
 
+/* Private data for elements, attributes and comments (one per node, so
+ * hundreds of thousands for a large CIB) comes from slabs rather than a heap
+ * allocation each.
+ *
+ * Each slab is aligned to its own size, so a node's private data can find its
+ * slab from its address. Slabs with free slots are kept in a list; one that
+ * becomes entirely free is released, unless it is the only one with free
+ * slots (so that creating and freeing a few nodes repeatedly does not allocate
+ * a slab each time).
+ */
+#define XML_SLAB_SIZE 16384
+
+typedef union xml_slot_u {
+    xml_private_t p;
+    union xml_slot_u *next;     // If free, next free slot in the same slab
+} xml_slot_t;
+
+typedef struct xml_slab_s {
+    struct xml_slab_s *prev;    // Previous slab with free slots
+    struct xml_slab_s *next;    // Next slab with free slots
+    xml_slot_t *free_slots;
+    unsigned int used;          // Number of slots in use
+} xml_slab_t;
+
+#define XML_SLAB_SLOTS \
+    ((XML_SLAB_SIZE - sizeof(xml_slab_t)) / sizeof(xml_slot_t))
+
+#define xml_slab_of(p) \
+    ((xml_slab_t *) ((uintptr_t) (p) & ~((uintptr_t) XML_SLAB_SIZE - 1)))
+
+static xml_slab_t *xml_slabs_free = NULL;   // Slabs with free slots
+
+static void
+unlink_xml_slab(xml_slab_t *slab)
+{
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    } else {
+        xml_slabs_free = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+    slab->prev = slab->next = NULL;
+}
+
+static void
+link_xml_slab(xml_slab_t *slab)
+{
+    slab->prev = NULL;
+    slab->next = xml_slabs_free;
+    if (xml_slabs_free != NULL) {
+        xml_slabs_free->prev = slab;
+    }
+    xml_slabs_free = slab;
+}
+
+/*!
+ * \internal
+ * \brief Allocate zeroed private data for an element, attribute or comment
+ *
+ * \return Newly allocated private data (asserts on memory errors)
+ */
+static xml_private_t *
+new_xml_private(void)
+{
+    xml_slab_t *slab = xml_slabs_free;
+    xml_slot_t *slot = NULL;
+
+    if (slab == NULL) {
+        xml_slot_t *slots = NULL;
+        int rc = posix_memalign((void **) &slab, XML_SLAB_SIZE, XML_SLAB_SIZE);
+
+        CRM_ASSERT(rc == 0);
+        slab->used = 0;
+        slots = (xml_slot_t *) (slab + 1);
+        for (size_t lpc = 0; lpc < (XML_SLAB_SLOTS - 1); lpc++) {
+            slots[lpc].next = &(slots[lpc + 1]);
+        }
+        slots[XML_SLAB_SLOTS - 1].next = NULL;
+        slab->free_slots = slots;
+        link_xml_slab(slab);
+    }
+
+    slot = slab->free_slots;
+    slab->free_slots = slot->next;
+    if (++(slab->used) == XML_SLAB_SLOTS) {
+        unlink_xml_slab(slab);
+    }
+    memset(slot, 0, sizeof(xml_slot_t));
+    return &(slot->p);
+}
+
+/*!
+ * \internal
+ * \brief Free private data allocated by new_xml_private()
+ *
+ * \param[in,out] p  Private data to free
+ */
+static void
+free_xml_private(xml_private_t *p)
+{
+    xml_slab_t *slab = xml_slab_of(p);
+    xml_slot_t *slot = (xml_slot_t *) p;
+
+    if (slab->used == XML_SLAB_SLOTS) {
+        link_xml_slab(slab);
+    }
+    slot->next = slab->free_slots;
+    slab->free_slots = slot;
+    if ((--(slab->used) == 0)
+        && ((slab->prev != NULL) || (slab->next != NULL))) {
+        unlink_xml_slab(slab);
+        free(slab);
+    }
+}
+
 static void
 __xml_deleted_obj_free(void *data)
 {
@@ -224,37 +388,428 @@ __xml_deleted_obj_free(void *data)
 }
 
 static void
-__xml_private_clean(xml_private_t *p)
+__xml_private_clean(xml_doc_private_t *docp)
 {
-    if(p) {
-        CRM_ASSERT(p->check == XML_PRIVATE_MAGIC);
+    if(docp) {
+        CRM_ASSERT(docp->node.check == XML_PRIVATE_MAGIC);
 
-        free(p->user);
-        p->user = NULL;
+        free(docp->user);
+        docp->user = NULL;
 
-        if(p->acls) {
-            pcmk__free_acls(p->acls);
-            p->acls = NULL;
+        if(docp->acls) {
+            pcmk__free_acls(docp->acls);
+            docp->acls = NULL;
         }
 
-        if(p->deleted_objs) {
-            g_list_free_full(p->deleted_objs, __xml_deleted_obj_free);
-            p->deleted_objs = NULL;
+        if(docp->deleted_objs) {
+            g_list_free_full(docp->deleted_objs, __xml_deleted_obj_free);
+            docp->deleted_objs = NULL;
+        }
+    }
+}
+
+static void free_doc_ids(xml_doc_private_t *docp);
+
+static void
+__xml_private_free(xmlNode *node)
+{
+    xml_private_t *p = node->_private;
+
+    if (p == NULL) {
+        return;
+    }
+    CRM_ASSERT(p->check == XML_PRIVATE_MAGIC);
+    if (node->type == XML_DOCUMENT_NODE) {
+        free_doc_ids((xml_doc_private_t *) p);
+        __xml_private_clean((xml_doc_private_t *) p);
+        free(p);
+    } else {
+        free_xml_private(p);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Get a document's private data, if it is ours
+ *
+ * \param[in] doc  Document to check (may be NULL)
+ *
+ * \return Private data of \p doc, or NULL if none or owned by XSLT
+ */
+static xml_doc_private_t *
+doc_private(xmlDoc *doc)
+{
+    /* XSLT result tree fragments carry their own data in _private (see
+     * pcmkDeregisterNode())
+     */
+    if ((doc == NULL) || ((doc->name != NULL) && (doc->name[0] == ' '))) {
+        return NULL;
+    }
+    return doc->_private;
+}
+
+/* Document ID indexes (see pcmk__xml_find_id())
+ *
+ * A document has no index until it is first searched by ID, and until then
+ * the node registration hooks only check for one. Once it is built, the hooks
+ * keep it up to date:
+ * - A new element is queued, because its attributes are not set yet, and
+ *   indexed at the next lookup.
+ * - A freed element is removed.
+ * - An element whose ID is added, or changed in place, is removed and queued.
+ * - An element whose ID is removed is queued explicitly, because an attribute
+ *   is unlinked from its element before it is freed (see xml_remove_prop()).
+ * - Elements moved in from another document are queued by pcmk__xml_move()
+ *   and replace_xml_child(), because libxml2 has no hook for that.
+ *
+ * Each indexed or queued element points back to the document tracking it, and
+ * the document maps each indexed element to the ID it was indexed under, so an
+ * element can be removed directly even after its ID changed or it was moved to
+ * another document. An ID shared by several elements is indexed as the
+ * document itself, with the elements kept in id_dups, so the last one left
+ * can be indexed again.
+ */
+
+/*!
+ * \internal
+ * \brief Check whether an element has an ID and is attached to a document
+ *
+ * \param[in] xml  Element to check
+ * \param[in] doc  Document to check
+ * \param[in] id   ID to check
+ *
+ * \return TRUE if \p xml is attached to \p doc with \p id, otherwise FALSE
+ */
+static bool
+has_doc_id(xmlNode *xml, xmlDoc *doc, const char *id)
+{
+    xmlNode *iter = NULL;
+
+    if ((xml->doc != doc) || !crm_str_eq(ID(xml), id, TRUE)) {
+        return FALSE;
+    }
+    for (iter = xml; iter->parent != NULL; iter = iter->parent);
+    return (iter == (xmlNode *) doc);
+}
+
+/*!
+ * \internal
+ * \brief Remove an element from a document's ID index under a given ID
+ *
+ * If only one element is left with a duplicated ID, it becomes the indexed
+ * element for that ID.
+ *
+ * \param[in,out] docp  Private data of document with an ID index
+ * \param[in]     id    ID that \p xml is indexed under
+ * \param[in]     xml   Element to remove
+ */
+static void
+remove_indexed(xml_doc_private_t *docp, const char *id, xmlNode *xml)
+{
+    GQueue *dups = NULL;
+
+    if (g_hash_table_lookup(docp->id_index, id) == xml) {
+        g_hash_table_remove(docp->id_index, id);
+        return;
+    }
+    if ((docp->id_dups == NULL)
+        || ((dups = g_hash_table_lookup(docp->id_dups, id)) == NULL)
+        || !g_queue_remove(dups, xml)) {
+        return;
+    }
+
+    if (g_queue_get_length(dups) == 1) {
+        g_hash_table_replace(docp->id_index, strdup(id), g_queue_peek_head(dups));
+        g_hash_table_remove(docp->id_dups, id);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Stop tracking an element in whichever document's ID index has it
+ *
+ * \param[in,out] xml  Element to remove
+ */
+static void
+unindex_element(xmlNode *xml)
+{
+    xml_private_t *p = xml->_private;
+    xml_doc_private_t *docp = NULL;
+    char *id = NULL;
+
+    if ((p == NULL) || (p->id_doc == NULL)) {
+        return;
+    }
+    docp = p->id_doc;
+    p->id_doc = NULL;
+
+    if ((docp->id_pending != NULL)
+        && g_hash_table_remove(docp->id_pending, xml)) {
+        return;
+    }
+
+    // The element's current ID may differ from the one it was indexed under
+    id = g_hash_table_lookup(docp->id_elements, xml);
+    if (id != NULL) {
+        g_hash_table_steal(docp->id_elements, xml);
+        remove_indexed(docp, id, xml);
+        free(id);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Queue an element to be (re-)indexed at the next lookup
+ *
+ * \param[in,out] docp  Private data of document with an ID index
+ * \param[in,out] xml   Element to queue
+ */
+static void
+queue_element(xml_doc_private_t *docp, xmlNode *xml)
+{
+    unindex_element(xml);
+    if (docp->id_pending == NULL) {
+        docp->id_pending = g_hash_table_new(NULL, NULL);
+    }
+    g_hash_table_insert(docp->id_pending, xml, xml);
+    ((xml_private_t *) xml->_private)->id_doc = docp;
+}
+
+/*!
+ * \internal
+ * \brief Add an element to its document's ID index
+ *
+ * \param[in,out] docp  Private data of \p xml's document
+ * \param[in,out] xml   Element to add
+ */
+static void
+index_element(xml_doc_private_t *docp, xmlNode *xml)
+{
+    const char *id = ID(xml);
+    xmlNode *indexed = NULL;
+    GQueue *dups = NULL;
+
+    unindex_element(xml);
+    if (id == NULL) {
+        return;
+    }
+
+    indexed = g_hash_table_lookup(docp->id_index, id);
+    if (indexed == (xmlNode *) xml->doc) {
+        // Duplicated IDs are marked with the document itself
+        dups = g_hash_table_lookup(docp->id_dups, id);
+        g_queue_push_tail(dups, xml);
+
+    } else if ((indexed != NULL) && (indexed->doc == xml->doc)
+               && crm_str_eq(ID(indexed), id, TRUE)) {
+        /* The other element may be unlinked for now, but it is still a
+         * duplicate if it is added back (lookups check which are attached)
+         */
+        if (docp->id_dups == NULL) {
+            docp->id_dups = g_hash_table_new_full(crm_str_hash, g_str_equal,
+                                                  free,
+                                                  (GDestroyNotify) g_queue_free);
+        }
+        dups = g_queue_new();
+        g_queue_push_tail(dups, indexed);
+        g_queue_push_tail(dups, xml);
+        g_hash_table_insert(docp->id_dups, strdup(id), dups);
+        g_hash_table_replace(docp->id_index, strdup(id), xml->doc);
+
+    } else {
+        if (indexed != NULL) {
+            // It was moved away or its ID changed in a way the hooks can't see
+            unindex_element(indexed);
+        }
+        g_hash_table_replace(docp->id_index, strdup(id), xml);
+    }
+    g_hash_table_insert(docp->id_elements, xml, strdup(id));
+    ((xml_private_t *) xml->_private)->id_doc = docp;
+}
+
+/*!
+ * \internal
+ * \brief Stop tracking the elements in a table of a document's ID index
+ *
+ * \param[in]     docp   Private data of document that owns \p table
+ * \param[in,out] table  Table keyed by element to free
+ */
+static void
+free_doc_id_table(xml_doc_private_t *docp, GHashTable *table)
+{
+    GHashTableIter iter;
+    xmlNode *xml = NULL;
+
+    if (table == NULL) {
+        return;
+    }
+    g_hash_table_iter_init(&iter, table);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &xml, NULL)) {
+        xml_private_t *p = xml->_private;
+
+        if ((p != NULL) && (p->id_doc == docp)) {
+            p->id_doc = NULL;
+        }
+    }
+    g_hash_table_destroy(table);
+}
+
+/*!
+ * \internal
+ * \brief Free a document's ID index
+ *
+ * \param[in,out] docp  Private data of document
+ */
+static void
+free_doc_ids(xml_doc_private_t *docp)
+{
+    if (docp->id_index == NULL) {
+        return;
+    }
+    free_doc_id_table(docp, docp->id_pending);
+    docp->id_pending = NULL;
+    free_doc_id_table(docp, docp->id_elements);
+    docp->id_elements = NULL;
+    if (docp->id_dups != NULL) {
+        g_hash_table_destroy(docp->id_dups);
+        docp->id_dups = NULL;
+    }
+    g_hash_table_destroy(docp->id_index);
+    docp->id_index = NULL;
+}
+
+/*!
+ * \internal
+ * \brief Note that an element's ID is changing
+ *
+ * \param[in,out] xml  Element whose ID is being added, changed or removed
+ */
+static void
+requeue_element(xmlNode *xml)
+{
+    xml_doc_private_t *docp = doc_private(xml->doc);
+
+    if ((docp != NULL) && (docp->id_index != NULL)) {
+        queue_element(docp, xml);
+    } else {
+        unindex_element(xml);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Note that a document is changing
+ *
+ * Count the change, and update the document's ID index if it has one.
+ *
+ * \param[in] node     Node being created or freed
+ * \param[in] created  Whether \p node is being created (rather than freed)
+ */
+static void
+update_doc_ids(xmlNode *node, bool created)
+{
+    xml_doc_private_t *docp = doc_private(node->doc);
+    xmlNode *element = NULL;
+
+    if (node->type == XML_DOCUMENT_NODE) {
+        return;
+    }
+    if (docp != NULL) {
+        docp->changes++;
+    }
+
+    if (node->type == XML_ELEMENT_NODE) {
+        if (!created) {
+            // It may be tracked by a document it was moved away from
+            unindex_element(node);
+        } else if ((docp != NULL) && (docp->id_index != NULL)) {
+            queue_element(docp, node);
         }
+        return;
+    }
+
+    /* Attribute changes matter only to an index of the element's current
+     * document; any other index checks its matches at lookup
+     */
+    if ((docp == NULL) || (docp->id_index == NULL)) {
+        return;
+    }
+    switch (node->type) {
+        case XML_ATTRIBUTE_NODE:
+            // An ID is being added to an element
+            if (created && (node->parent != NULL)
+                && crm_str_eq((const char *) node->name, XML_ATTR_ID, TRUE)) {
+                element = node->parent;
+            }
+            break;
+
+        case XML_TEXT_NODE:
+            // An ID is being changed in place (the old value is freed first)
+            if (!created && (node->parent != NULL)
+                && (node->parent->type == XML_ATTRIBUTE_NODE)
+                && (node->parent->_private != NULL)
+                && crm_str_eq((const char *) node->parent->name, XML_ATTR_ID,
+                              TRUE)) {
+                element = node->parent->parent;
+            }
+            break;
+
+        default:
+            return;
+    }
+
+    // An element being freed has already been removed
+    if ((element != NULL) && (element->_private != NULL)) {
+        queue_element(docp, element);
     }
 }
 
+/*!
+ * \internal
+ * \brief Queue every element of a subtree to be (re-)indexed
+ *
+ * \param[in,out] docp  Private data of document with an ID index
+ * \param[in,out] xml   Root of subtree to queue
+ */
+static void
+queue_subtree(xml_doc_private_t *docp, xmlNode *xml)
+{
+    xmlNode *child = NULL;
+
+    queue_element(docp, xml);
+    for (child = __xml_first_child(xml); child != NULL;
+         child = __xml_next(child)) {
+        if (child->type == XML_ELEMENT_NODE) {
+            queue_subtree(docp, child);
+        }
+    }
+}
 
+/*!
+ * \internal
+ * \brief Note that a subtree was moved into a document
+ *
+ * \param[in,out] xml  Root of moved subtree
+ */
 static void
-__xml_private_free(xml_private_t *p)
+adopt_doc_ids(xmlNode *xml)
 {
-    __xml_private_clean(p);
-    free(p);
+    xml_doc_private_t *docp = doc_private(xml->doc);
+
+    if (docp == NULL) {
+        return;
+    }
+    docp->changes++;
+    if ((xml->type == XML_ELEMENT_NODE) && (docp->id_index != NULL)) {
+        queue_subtree(docp, xml);
+    }
 }
 
 static void
 pcmkDeregisterNode(xmlNodePtr node)
 {
+    update_doc_ids(node, FALSE);
+
     /* need to explicitly avoid our custom _private field cleanup when
        called from internal XSLT cleanup (xsltApplyStylesheetInternal
        -> xsltFreeTransformContext -> xsltFreeRVTs -> xmlFreeDoc)
@@ -264,7 +819,12 @@ pcmkDeregisterNode(xmlNodePtr node)
        field -- later assert on the XML_PRIVATE_MAGIC would explode */
     if (node->type != XML_DOCUMENT_NODE || node->name == NULL
             || node->name[0] != ' ') {
-        __xml_private_free(node->_private);
+        __xml_private_free(node);
+
+        /* A document's children are freed after the document's private data,
+         * so make sure they don't find it
+         */
+        node->_private = NULL;
     }
 }
 
@@ -274,15 +834,21 @@ pcmkRegisterNode(xmlNodePtr node)
     xml_private_t *p = NULL;
 
     switch(node->type) {
-        case XML_ELEMENT_NODE:
         case XML_DOCUMENT_NODE:
+            {
+                // Lets caches tell a new document at a reused address apart
+                static unsigned long long doc_serial = 0;
+                xml_doc_private_t *docp = calloc(1, sizeof(xml_doc_private_t));
+
+                CRM_ASSERT(docp != NULL);
+                docp->serial = ++doc_serial;
+                p = &(docp->node);
+            }
+            break;
+        case XML_ELEMENT_NODE:
         case XML_ATTRIBUTE_NODE:
         case XML_COMMENT_NODE:
-            p = calloc(1, sizeof(xml_private_t));
-            p->check = XML_PRIVATE_MAGIC;
-            /* Flags will be reset if necessary when tracking is enabled */
-            p->flags |= (xpf_dirty|xpf_created);
-            node->_private = p;
+            p = new_xml_private();
             break;
         case XML_TEXT_NODE:
         case XML_DTD_NODE:
@@ -295,6 +861,15 @@ pcmkRegisterNode(xmlNodePtr node)
             break;
     }
 
+    if (p != NULL) {
+        p->check = XML_PRIVATE_MAGIC;
+        /* Flags will be reset if necessary when tracking is enabled */
+        p->flags |= (xpf_dirty|xpf_created);
+        node->_private = p;
+    }
+
+    update_doc_ids(node, TRUE);
+
     if(p && pcmk__tracking_xml_changes(node, FALSE)) {
         /* XML_ELEMENT_NODE doesn't get picked up here, node->doc is
          * not hooked up at the point we are called
@@ -421,9 +996,21 @@ static int __xml_offset_no_deletions(xmlNode *xml)
     return position;
 }
 
+/*!
+ * \internal
+ * \brief Add changes to an XML element and its children to a v2 patchset
+ *
+ * \param[in]     xml       Element to check for changes
+ * \param[in,out] patchset  Patchset to add changes to
+ * \param[in]     position  Position of \p xml among its non-deleted siblings
+ *
+ * \note Passing the position down avoids walking each sibling list once per
+ *       created or moved child.
+ */
 static void
-__xml_build_changes(xmlNode * xml, xmlNode *patchset)
+__xml_build_changes(xmlNode * xml, xmlNode *patchset, int position)
 {
+    int child_position = 0;
     xmlNode *cIter = NULL;
     xmlAttr *pIter = NULL;
     xmlNode *change = NULL;
@@ -435,8 +1022,6 @@ __xml_build_changes(xmlNode * xml, xmlNode *patchset)
 
         if (pcmk__element_xpath(NULL, xml->parent, buffer, offset,
                                 sizeof(buffer)) > 0) {
-            int position = __xml_offset_no_deletions(xml);
-
             change = create_xml_node(patchset, XML_DIFF_CHANGE);
 
             crm_xml_add(change, XML_DIFF_OP, "create");
@@ -502,7 +1087,12 @@ __xml_build_changes(xmlNode * xml, xmlNode *patchset)
     }
 
     for (cIter = __xml_first_child(xml); cIter != NULL; cIter = __xml_next(cIter)) {
-        __xml_build_changes(cIter, patchset);
+        __xml_build_changes(cIter, patchset, child_position);
+
+        p = cIter->_private;
+        if (is_not_set(p->flags, xpf_deleted)) {
+            child_position++;
+        }
     }
 
     p = xml->_private;
@@ -517,7 +1107,7 @@ __xml_build_changes(xmlNode * xml, xmlNode *patchset)
 
             crm_xml_add(change, XML_DIFF_OP, "move");
             crm_xml_add(change, XML_DIFF_PATH, buffer);
-            crm_xml_add_int(change, XML_DIFF_POSITION, __xml_offset_no_deletions(xml));
+            crm_xml_add_int(change, XML_DIFF_POSITION, position);
         }
     }
 }
@@ -556,6 +1146,7 @@ is_config_change(xmlNode *xml)
 {
     GListPtr gIter = NULL;
     xml_private_t *p = NULL;
+    xml_doc_private_t *docp = NULL;
     xmlNode *config = first_named_child(xml, XML_CIB_TAG_CONFIGURATION);
 
     if(config) {
@@ -566,8 +1157,8 @@ is_config_change(xmlNode *xml)
     }
 
     if(xml->doc && xml->doc->_private) {
-        p = xml->doc->_private;
-        for(gIter = p->deleted_objs; gIter; gIter = gIter->next) {
+        docp = xml->doc->_private;
+        for(gIter = docp->deleted_objs; gIter; gIter = gIter->next) {
             xml_deleted_obj_t *deleted_obj = gIter->data;
 
             if(strstr(deleted_obj->path, "/"XML_TAG_CIB"/"XML_CIB_TAG_CONFIGURATION) != NULL) {
@@ -670,7 +1261,7 @@ xml_create_patchset_v2(xmlNode *source, xmlNode *target)
 {
     int lpc = 0;
     GListPtr gIter = NULL;
-    xml_private_t *doc = NULL;
+    xml_doc_private_t *doc = NULL;
 
     xmlNode *v = NULL;
     xmlNode *version = NULL;
@@ -725,7 +1316,7 @@ xml_create_patchset_v2(xmlNode *source, xmlNode *target)
         }
     }
 
-    __xml_build_changes(target, patchset);
+    __xml_build_changes(target, patchset, __xml_offset_no_deletions(target));
     return patchset;
 }
 
@@ -978,13 +1569,13 @@ void
 xml_log_changes(uint8_t log_level, const char *function, xmlNode * xml)
 {
     GListPtr gIter = NULL;
-    xml_private_t *doc = NULL;
+    xml_doc_private_t *doc = NULL;
 
     CRM_ASSERT(xml);
     CRM_ASSERT(xml->doc);
 
     doc = xml->doc->_private;
-    if(is_not_set(doc->flags, xpf_dirty)) {
+    if(is_not_set(doc->node.flags, xpf_dirty)) {
         return;
     }
 
@@ -1381,83 +1972,218 @@ __first_xml_child_match(xmlNode *parent, const char *name, const char *id, int p
     return NULL;
 }
 
+/* Minimum number of children for which patchset paths are resolved by ID
+ * index rather than by searching the children
+ */
+#define XML_PATH_INDEX_MIN 16
+
+static void
+free_path_index(gpointer data)
+{
+    if (data != NULL) {
+        g_hash_table_destroy((GHashTable *) data);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Index an element's children by ID, for resolving patchset paths
+ *
+ * \param[in] parent  Element whose children should be indexed
+ *
+ * \return Table mapping each ID to the only child with that ID (or to
+ *         \p parent itself if several children share it), or NULL if
+ *         \p parent has too few children to be worth indexing
+ */
+static GHashTable *
+index_path_children(xmlNode *parent)
+{
+    int count = 0;
+    xmlNode *child = NULL;
+    GHashTable *children = NULL;
+
+    for (child = __xml_first_child(parent); child != NULL;
+         child = __xml_next(child)) {
+        if (++count >= XML_PATH_INDEX_MIN) {
+            break;
+        }
+    }
+    if (count < XML_PATH_INDEX_MIN) {
+        return NULL;
+    }
+
+    // IDs are copied because "modify" changes replace attribute values
+    children = g_hash_table_new_full(crm_str_hash, g_str_equal, free, NULL);
+    for (child = __xml_first_child(parent); child != NULL;
+         child = __xml_next(child)) {
+        const char *id = ID(child);
+
+        if (id == NULL) {
+            continue;
+        } else if (g_hash_table_lookup(children, id) == NULL) {
+            g_hash_table_insert(children, strdup(id), child);
+        } else {
+            g_hash_table_replace(children, strdup(id), parent);
+        }
+    }
+    return children;
+}
+
+/*!
+ * \internal
+ * \brief Find the first child with a given name and ID
+ *
+ * \param[in]     parent    Element whose children should be searched
+ * \param[in]     name      Child name to match
+ * \param[in]     id        Child ID to match (or NULL to match name only)
+ * \param[in]     position  For comments, position to match (if nonnegative)
+ * \param[in,out] index     Child indexes by parent (or NULL to not use any)
+ *
+ * \return First matching child, or NULL if none
+ */
+static xmlNode *
+find_path_child(xmlNode *parent, const char *name, const char *id,
+                int position, GHashTable *index)
+{
+    GHashTable *children = NULL;
+    xmlNode *match = NULL;
+
+    if ((index == NULL) || (id == NULL)) {
+        return __first_xml_child_match(parent, name, id, position);
+    }
+
+    if (!g_hash_table_lookup_extended(index, parent, NULL,
+                                      (gpointer *) &children)) {
+        children = index_path_children(parent);
+        g_hash_table_insert(index, parent, children);
+    }
+    if (children == NULL) {
+        return __first_xml_child_match(parent, name, id, position);
+    }
+
+    match = g_hash_table_lookup(children, id);
+    if (match == parent) {
+        // Several children have this ID, so order matters
+        return __first_xml_child_match(parent, name, id, position);
+
+    } else if ((match != NULL)
+               && strcmp((const char *) match->name, name) != 0) {
+        match = NULL;
+    }
+    return match;
+}
+
+/*!
+ * \internal
+ * \brief Drop any path index entries for an element about to be freed
+ *
+ * \param[in,out] index  Child indexes by parent
+ * \param[in]     xml    Element that will be freed
+ */
+static void
+forget_path_element(GHashTable *index, xmlNode *xml)
+{
+    xmlNode *child = NULL;
+    GHashTable *siblings = NULL;
+    const char *id = ID(xml);
+
+    if ((index == NULL) || (g_hash_table_size(index) == 0)) {
+        return;
+    }
+
+    if ((id != NULL) && (xml->parent != NULL)) {
+        siblings = g_hash_table_lookup(index, xml->parent);
+        if ((siblings != NULL) && (g_hash_table_lookup(siblings, id) == xml)) {
+            g_hash_table_remove(siblings, id);
+        }
+    }
+
+    g_hash_table_remove(index, xml);
+    for (child = __xml_first_child(xml); child != NULL;
+         child = __xml_next(child)) {
+        forget_path_element(index, child);
+    }
+}
+
 /*!
  * \internal
  * \brief Simplified, more efficient alternative to get_xpath_object()
  *
- * \param[in] top              Root of XML to search
- * \param[in] key              Search xpath
- * \param[in] target_position  If deleting, where to delete
+ * \param[in]     top              Root of XML to search
+ * \param[in]     key              Search xpath
+ * \param[in]     target_position  If deleting, where to delete
+ * \param[in,out] index            Child indexes by parent (or NULL)
  *
  * \return XML child matching xpath if found, NULL otherwise
  *
- * \note This only works on simplified xpaths found in v2 patchset diffs,
- *       i.e. the only allowed search predicate is [@id='XXX'].
+ * \note This is optimized for the simplified xpaths found in v2 patchset
+ *       diffs, i.e. /TAG components whose only allowed search predicate is
+ *       [@id='XXX']. Anything else is handed to libxml2's XPath engine.
  */
 static xmlNode *
-__xml_find_path(xmlNode *top, const char *key, int target_position)
+__xml_find_path(xmlNode *top, const char *key, int target_position,
+                GHashTable *index)
 {
     xmlNode *target = (xmlNode*) top->doc;
-    const char *current = key;
-    char *section;
-    char *remainder;
-    char *id;
-    char *tag;
+    char *copy = NULL;
+    char *current = NULL;
     char *path = NULL;
-    int rc;
-    size_t key_len;
+    bool more = FALSE;
 
     CRM_CHECK(key != NULL, return NULL);
-    key_len = strlen(key);
-
-    /* These are scanned from key after a slash, so they can't be bigger
-     * than key_len - 1 characters plus a null terminator.
-     */
-
-    remainder = calloc(key_len, sizeof(char));
-    CRM_ASSERT(remainder != NULL);
 
-    section = calloc(key_len, sizeof(char));
-    CRM_ASSERT(section != NULL);
+    // Parse a copy in place, terminating each tag and ID as it is reached
+    copy = strdup(key);
+    CRM_ASSERT(copy != NULL);
+    current = copy;
+    more = (*current == '/');
+    if (!more) {
+        goto unexpected;
+    }
 
-    id = calloc(key_len, sizeof(char));
-    CRM_ASSERT(id != NULL);
+    while (more && target) {
+        char *tag = current + 1;
+        char *id = NULL;
+        char *end = tag + strcspn(tag, "/[");
+        int current_position = -1;
 
-    tag = calloc(key_len, sizeof(char));
-    CRM_ASSERT(tag != NULL);
+        if (end == tag) {
+            goto unexpected;
 
-    do {
-        // Look for /NEXT_COMPONENT/REMAINING_COMPONENTS
-        rc = sscanf(current, "/%[^/]%s", section, remainder);
-        if (rc > 0) {
-            // Separate FIRST_COMPONENT into TAG[@id='ID']
-            int f = sscanf(section, "%[^[][@id='%[^']", tag, id);
-            int current_position = -1;
-
-            /* The target position is for the final component tag, so only use
-             * it if there is nothing left to search after this component.
-             */
-            if ((rc == 1) && (target_position >= 0)) {
-                current_position = target_position;
+        } else if (*end == '[') {
+            *end = '\0';
+            if (strncmp(end + 1, "@id='", 5) != 0) {
+                goto unexpected;
             }
-
-            switch (f) {
-                case 1:
-                    target = __first_xml_child_match(target, tag, NULL, current_position);
-                    break;
-                case 2:
-                    target = __first_xml_child_match(target, tag, id, current_position);
-                    break;
-                default:
-                    // This should not be possible
-                    target = NULL;
-                    break;
+            id = end + 6;
+            end = strchr(id, '\'');
+            if ((end == NULL) || (end[1] != ']')) {
+                goto unexpected;
             }
-            current = remainder;
+            *end = '\0';
+            end += 2;
         }
 
-    // Continue if something remains to search, and we've matched so far
-    } while ((rc == 2) && target);
+        if ((*end != '\0') && (*end != '/')) {
+            goto unexpected;
+        }
+        more = (*end == '/');
+        *end = '\0';
+        current = end;
+
+        /* The target position is for the final component tag, so only use
+         * it if there is nothing left to search after this component.
+         */
+        if (!more && (target_position >= 0)) {
+            current_position = target_position;
+        }
+        target = find_path_child(target, tag, id, current_position, index);
+
+        if (more) {
+            // Restore the slash for the next component
+            *current = '/';
+        }
+    }
 
     if (target) {
         crm_trace("Found %s for %s",
@@ -1466,12 +2192,13 @@ __xml_find_path(xmlNode *top, const char *key, int target_position)
     } else {
         crm_debug("No match for %s", key);
     }
-
-    free(remainder);
-    free(section);
-    free(tag);
-    free(id);
+    free(copy);
     return target;
+
+unexpected:
+    free(copy);
+    crm_trace("Using XPath for unexpected patchset path %s", key);
+    return get_xpath_object(key, top, LOG_DEBUG);
 }
 
 typedef struct xml_change_obj_s {
@@ -1507,6 +2234,16 @@ xml_apply_patchset_v2(xmlNode *xml, xmlNode *patchset)
     xmlNode *change = NULL;
     GListPtr change_objs = NULL;
     GListPtr gIter = NULL;
+    GHashTable *index = NULL;
+
+    /* Index large sets of children so that changes to many siblings (such as
+     * the lrm_resources of a big cluster) are each resolved in constant time.
+     * ACLs may keep a deleted element in place, so don't index then.
+     */
+    if (!xml_acl_enabled(xml)) {
+        index = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                      free_path_index);
+    }
 
     for (change = __xml_first_child(patchset); change != NULL; change = __xml_next(change)) {
         xmlNode *match = NULL;
@@ -1524,7 +2261,7 @@ xml_apply_patchset_v2(xmlNode *xml, xmlNode *patchset)
         if(strcmp(op, "delete") == 0) {
             crm_element_value_int(change, XML_DIFF_POSITION, &position);
         }
-        match = __xml_find_path(xml, xpath, position);
+        match = __xml_find_path(xml, xpath, position, index);
         crm_trace("Performing %s on %s with %p", op, xpath, match);
 
         if(match == NULL && strcmp(op, "delete") == 0) {
@@ -1555,6 +2292,7 @@ xml_apply_patchset_v2(xmlNode *xml, xmlNode *patchset)
             }
 
         } else if(strcmp(op, "delete") == 0) {
+            forget_path_element(index, match);
             free_xml(match);
 
         } else if(strcmp(op, "modify") == 0) {
@@ -1565,6 +2303,11 @@ xml_apply_patchset_v2(xmlNode *xml, xmlNode *patchset)
                 rc = -ENOMSG;
                 continue;
             }
+            if ((index != NULL) && (match->parent != NULL)
+                && !crm_str_eq(ID(match), ID(attrs), TRUE)) {
+                // The ID is changing, so the siblings must be re-indexed
+                g_hash_table_remove(index, match->parent);
+            }
             while(pIter != NULL) {
                 const char *name = (const char *)pIter->name;
 
@@ -1673,6 +2416,9 @@ xml_apply_patchset_v2(xmlNode *xml, xmlNode *patchset)
     }
 
     g_list_free_full(change_objs, free);
+    if (index != NULL) {
+        g_hash_table_destroy(index);
+    }
     return rc;
 }
 
@@ -1915,16 +2661,77 @@ expand_plus_plus(xmlNode * target, const char *name, const char *value)
         int_value = (int)INFINITY;
     }
 
-    crm_xml_add_int(target, name, int_value);
-    return;
+    crm_xml_add_int(target, name, int_value);
+    return;
+
+  set_unexpanded:
+    if (old_value == value) {
+        /* the old value is already set, nothing to do */
+        return;
+    }
+    crm_xml_add(target, name, value);
+    return;
+}
+
+/* Dictionary shared by every document created or parsed here
+ *
+ * libxml2 stores element and attribute names in a document's dictionary (if
+ * it has one) rather than giving each node its own copy. Using a single
+ * dictionary for the whole process means each distinct name (id, operation,
+ * call-id, ...) is stored once no matter how many documents and copies use
+ * it, copies don't need to allocate names, and nodes can be moved between
+ * documents without their names being freed by the wrong owner.
+ */
+static xmlDictPtr xml_dict = NULL;
+
+static xmlDictPtr
+shared_xml_dict(void)
+{
+    if (xml_dict == NULL) {
+        xml_dict = xmlDictCreate();
+        CRM_ASSERT(xml_dict != NULL);
+    }
+    return xml_dict;
+}
+
+/*!
+ * \internal
+ * \brief Create a new XML document using the shared dictionary
+ *
+ * \return Newly allocated XML document (guaranteed not to be NULL)
+ */
+static xmlDoc *
+new_xml_doc(void)
+{
+    xmlDoc *doc = xmlNewDoc((pcmkXmlStr) "1.0");
+
+    CRM_ASSERT(doc != NULL);
+    doc->dict = shared_xml_dict();
+    xmlDictReference(doc->dict);
+    return doc;
+}
+
+/*!
+ * \internal
+ * \brief Create a new XML parser context using the shared dictionary
+ *
+ * \return Newly allocated parser context, or NULL on error
+ * \note Documents parsed with the context will use the shared dictionary.
+ */
+static xmlParserCtxtPtr
+new_parser_ctxt(void)
+{
+    xmlParserCtxtPtr ctxt = xmlNewParserCtxt();
 
-  set_unexpanded:
-    if (old_value == value) {
-        /* the old value is already set, nothing to do */
-        return;
+    if (ctxt != NULL) {
+        /* The xmlCtxtRead*() functions reset the context, which looks up the
+         * context's predefined names in the new dictionary
+         */
+        xmlDictFree(ctxt->dict);
+        ctxt->dict = shared_xml_dict();
+        xmlDictReference(ctxt->dict);
     }
-    crm_xml_add(target, name, value);
-    return;
+    return ctxt;
 }
 
 xmlDoc *
@@ -1936,7 +2743,7 @@ getDocPtr(xmlNode * node)
 
     doc = node->doc;
     if (doc == NULL) {
-        doc = xmlNewDoc((pcmkXmlStr) "1.0");
+        doc = new_xml_doc();
         xmlDocSetRootElement(doc, node);
         xmlSetTreeDoc(node, doc);
     }
@@ -1965,6 +2772,50 @@ add_node_nocopy(xmlNode * parent, const char *name, xmlNode * child)
     return 1;
 }
 
+/*!
+ * \internal
+ * \brief Move an element to a new parent, without copying it
+ *
+ * \param[in,out] parent  Element to add \p child to (or NULL to make \p child
+ *                        the top-level element of a new document)
+ * \param[in,out] child   Element to move (with its children)
+ *
+ * \note If \p child was the top-level element of another document, that
+ *       document is freed. Elements must be moved between documents this way,
+ *       rather than with libxml2 directly, for ID lookups (see
+ *       pcmk__xml_find_id()) in the new document to find them.
+ */
+void
+pcmk__xml_move(xmlNode *parent, xmlNode *child)
+{
+    xmlDoc *old_doc = NULL;
+    xml_doc_private_t *old_docp = NULL;
+    bool was_root = FALSE;
+
+    CRM_CHECK((child != NULL) && (child->type == XML_ELEMENT_NODE), return);
+
+    old_doc = child->doc;
+    old_docp = doc_private(old_doc);
+    was_root = (old_doc != NULL) && (xmlDocGetRootElement(old_doc) == child);
+    if ((parent == NULL) && was_root) {
+        return;
+    }
+    if (old_docp != NULL) {
+        old_docp->changes++;
+    }
+
+    xmlUnlinkNode(child);
+    if (parent == NULL) {
+        xmlDocSetRootElement(new_xml_doc(), child);
+    } else {
+        xmlAddChild(parent, child);
+    }
+    adopt_doc_ids(child);
+    if (was_root && (old_doc != child->doc)) {
+        xmlFreeDoc(old_doc);
+    }
+}
+
 xmlNode *
 create_xml_node(xmlNode * parent, const char *name)
 {
@@ -1977,7 +2828,7 @@ create_xml_node(xmlNode * parent, const char *name)
     }
 
     if (parent == NULL) {
-        doc = xmlNewDoc((pcmkXmlStr) "1.0");
+        doc = new_xml_doc();
         node = xmlNewDocRawNode(doc, NULL, (pcmkXmlStr) name, NULL);
         xmlDocSetRootElement(doc, node);
 
@@ -2072,6 +2923,7 @@ free_xml_with_position(xmlNode * child, int position)
         xmlNode *top = NULL;
         xmlDoc *doc = child->doc;
         xml_private_t *p = child->_private;
+        xml_doc_private_t *docp = NULL;
 
         if (doc != NULL) {
             top = xmlDocGetRootElement(doc);
@@ -2114,8 +2966,9 @@ free_xml_with_position(xmlNode * child, int position)
                         }
                     }
 
-                    p = doc->_private;
-                    p->deleted_objs = g_list_append(p->deleted_objs, deleted_obj);
+                    docp = doc->_private;
+                    docp->deleted_objs = g_list_append(docp->deleted_objs,
+                                                       deleted_obj);
                     pcmk__set_xml_flag(child, xpf_dirty);
                 }
             }
@@ -2134,7 +2987,7 @@ free_xml(xmlNode * child)
 xmlNode *
 copy_xml(xmlNode * src)
 {
-    xmlDoc *doc = xmlNewDoc((pcmkXmlStr) "1.0");
+    xmlDoc *doc = new_xml_doc();
     xmlNode *copy = xmlDocCopyNode(src, doc, 1);
 
     xmlDocSetRootElement(doc, copy);
@@ -2183,7 +3036,7 @@ string2xml(const char *input)
     }
 
     /* create a parser context */
-    ctxt = xmlNewParserCtxt();
+    ctxt = new_parser_ctxt();
     CRM_CHECK(ctxt != NULL, return NULL);
 
     xmlCtxtResetLastError(ctxt);
@@ -2353,7 +3206,7 @@ filename2xml(const char *filename)
     xmlErrorPtr last_error = NULL;
 
     /* create a parser context */
-    ctxt = xmlNewParserCtxt();
+    ctxt = new_parser_ctxt();
     CRM_CHECK(ctxt != NULL, return NULL);
 
     xmlCtxtResetLastError(ctxt);
@@ -2622,30 +3475,111 @@ add_message_xml(xmlNode * msg, const char *field, xmlNode * xml)
     return TRUE;
 }
 
-static char *
-crm_xml_escape_shuffle(char *text, int start, int *length, const char *replace)
+/*!
+ * \internal
+ * \brief Get the escape sequence to use for a character in XML output
+ *
+ * \param[in]  c      Character to check
+ * \param[out] octal  Where to format octal escapes (at least 16 bytes)
+ *
+ * \return Replacement text for \p c, or NULL if it does not need escaping
+ */
+const char *
+pcmk__xml_escape_char(char c, char *octal)
 {
-    int lpc;
-    int offset = strlen(replace) - 1;   /* We have space for 1 char already */
+    switch (c) {
+        case '<':
+            return "&lt;";
+        case '>':
+            return "&gt;";
+        case '"':
+            return "&quot;";
+        case '\'':
+            return "&apos;";
+        case '&':
+            return "&amp;";
+        case '\t':
+            /* Might as well just expand to a few spaces... */
+            return "    ";
+        case '\n':
+            return "\\n";
+        case '\r':
+            return "\\r";
+        default:
+            /* Check for and replace non-printing characters with their octal equivalent */
+            if ((c < ' ') || (c > '~')) {
+                snprintf(octal, 16, "\\%.3o", c);
+                return octal;
+            }
+            return NULL;
+    }
+}
+
+/*!
+ * \internal
+ * \brief Calculate the length of text after XML escaping
+ *
+ * \param[in]  text     Text to check
+ * \param[out] changes  Where to store number of characters needing escapes
+ *
+ * \return Length of escaped \p text (excluding terminator)
+ */
+static size_t
+xml_escaped_len(const char *text, int *changes)
+{
+    char octal[16];
+    size_t length = 0;
 
-    *length += offset;
-    text = realloc_safe(text, *length);
+    *changes = 0;
+    for (const char *c = text; *c != '\0'; c++) {
+        const char *replace = pcmk__xml_escape_char(*c, octal);
 
-    for (lpc = (*length) - 1; lpc > (start + offset); lpc--) {
-        text[lpc] = text[lpc - offset];
+        if (replace == NULL) {
+            length++;
+        } else {
+            length += strlen(replace);
+            (*changes)++;
+        }
     }
+    return length;
+}
+
+/*!
+ * \internal
+ * \brief Write XML-escaped text to a preallocated location
+ *
+ * \param[out] dest  Where to write (must have room for escaped text)
+ * \param[in]  text  Text to escape
+ *
+ * \return Number of bytes written (no terminator is added)
+ */
+static size_t
+xml_escape_into(char *dest, const char *text)
+{
+    char octal[16];
+    char *d = dest;
+
+    for (const char *c = text; *c != '\0'; c++) {
+        const char *replace = pcmk__xml_escape_char(*c, octal);
+
+        if (replace == NULL) {
+            *d++ = *c;
+        } else {
+            size_t len = strlen(replace);
 
-    memcpy(text + start, replace, offset + 1);
-    return text;
+            memcpy(d, replace, len);
+            d += len;
+        }
+    }
+    return d - dest;
 }
 
 char *
 crm_xml_escape(const char *text)
 {
-    int index;
     int changes = 0;
-    int length = 1 + strlen(text);
-    char *copy = strdup(text);
+    size_t length = xml_escaped_len(text, &changes);
+    char *copy = malloc(length + 1);
 
     /*
      * When xmlCtxtReadDoc() parses &lt; and friends in a
@@ -2660,63 +3594,13 @@ crm_xml_escape(const char *text)
      * input. So we need to replicate the escaping in our custom
      * version so that the result can be re-parsed by xmlCtxtReadDoc()
      * when necessary.
+     *
+     * The escaped length is calculated first, so the result can be
+     * written in a single pass without any reallocation.
      */
 
-    for (index = 0; index < length; index++) {
-        switch (copy[index]) {
-            case 0:
-                break;
-            case '<':
-                copy = crm_xml_escape_shuffle(copy, index, &length, "&lt;");
-                changes++;
-                break;
-            case '>':
-                copy = crm_xml_escape_shuffle(copy, index, &length, "&gt;");
-                changes++;
-                break;
-            case '"':
-                copy = crm_xml_escape_shuffle(copy, index, &length, "&quot;");
-                changes++;
-                break;
-            case '\'':
-                copy = crm_xml_escape_shuffle(copy, index, &length, "&apos;");
-                changes++;
-                break;
-            case '&':
-                copy = crm_xml_escape_shuffle(copy, index, &length, "&amp;");
-                changes++;
-                break;
-            case '\t':
-                /* Might as well just expand to a few spaces... */
-                copy = crm_xml_escape_shuffle(copy, index, &length, "    ");
-                changes++;
-                break;
-            case '\n':
-                /* crm_trace("Convert: \\%.3o", copy[index]); */
-                copy = crm_xml_escape_shuffle(copy, index, &length, "\\n");
-                changes++;
-                break;
-            case '\r':
-                copy = crm_xml_escape_shuffle(copy, index, &length, "\\r");
-                changes++;
-                break;
-                /* For debugging...
-            case '\\':
-                crm_trace("Passthrough: \\%c", copy[index+1]);
-                break;
-                */
-            default:
-                /* Check for and replace non-printing characters with their octal equivalent */
-                if(copy[index] < ' ' || copy[index] > '~') {
-                    char *replace = crm_strdup_printf("\\%.3o", copy[index]);
-
-                    /* crm_trace("Convert to octal: \\%.3o", copy[index]); */
-                    copy = crm_xml_escape_shuffle(copy, index, &length, replace);
-                    free(replace);
-                    changes++;
-                }
-        }
-    }
+    CRM_ASSERT(copy != NULL);
+    copy[xml_escape_into(copy, text)] = '\0';
 
     if (changes) {
         crm_trace("Dumped '%s'", copy);
@@ -2727,7 +3611,9 @@ crm_xml_escape(const char *text)
 static inline void
 dump_xml_attr(xmlAttrPtr attr, int options, char **buffer, int *offset, int *max)
 {
-    char *p_value = NULL;
+    int changes = 0;
+    size_t len = 0;
+    const char *p_value = NULL;
     const char *p_name = NULL;
     xml_private_t *p = NULL;
 
@@ -2742,9 +3628,16 @@ dump_xml_attr(xmlAttrPtr attr, int options, char **buffer, int *offset, int *max
     }
 
     p_name = (const char *)attr->name;
-    p_value = crm_xml_escape((const char *)attr->children->content);
-    buffer_print(*buffer, *max, *offset, " %s=\"%s\"", p_name, p_value);
-    free(p_value);
+    p_value = (const char *)attr->children->content;
+
+    // Escape the value directly into the buffer, with no temporary copy
+    len = xml_escaped_len(p_value, &changes);
+    buffer_add(buffer, offset, max, " ", 1);
+    buffer_add_str(buffer, offset, max, p_name);
+    buffer_add(buffer, offset, max, "=\"", 2);
+    buffer_reserve(buffer, *offset, max, len);
+    *offset += xml_escape_into(*buffer + *offset, p_value);
+    buffer_add(buffer, offset, max, "\"", 1);
 }
 
 static void
@@ -2992,6 +3885,28 @@ log_data_element(int log_level, const char *file, const char *function, int line
     free(prefix_m);
 }
 
+/*!
+ * \internal
+ * \brief Check whether an attribute is omitted from filtered XML output
+ *
+ * \param[in] name  Name of attribute to check
+ *
+ * \return true if \p name is skipped when dumping with
+ *         xml_log_option_filtered, false otherwise
+ */
+bool
+pcmk__xml_attr_filtered(const char *name)
+{
+    int lpc;
+
+    for (lpc = 0; lpc < DIMOF(filter); lpc++) {
+        if (strcmp(name, filter[lpc].string) == 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
 static void
 dump_filtered_xml(xmlNode * data, int options, char **buffer, int *offset, int *max)
 {
@@ -3044,7 +3959,8 @@ dump_xml_element(xmlNode * data, int options, char **buffer, int *offset, int *m
     CRM_ASSERT(name != NULL);
 
     insert_prefix(options, buffer, offset, max, depth);
-    buffer_print(*buffer, *max, *offset, "<%s", name);
+    buffer_add(buffer, offset, max, "<", 1);
+    buffer_add_str(buffer, offset, max, name);
 
     if (options & xml_log_option_filtered) {
         dump_filtered_xml(data, options, buffer, offset, max);
@@ -3058,14 +3974,14 @@ dump_xml_element(xmlNode * data, int options, char **buffer, int *offset, int *m
     }
 
     if (data->children == NULL) {
-        buffer_print(*buffer, *max, *offset, "/>");
+        buffer_add(buffer, offset, max, "/>", 2);
 
     } else {
-        buffer_print(*buffer, *max, *offset, ">");
+        buffer_add(buffer, offset, max, ">", 1);
     }
 
     if (options & xml_log_option_formatted) {
-        buffer_print(*buffer, *max, *offset, "\n");
+        buffer_add(buffer, offset, max, "\n", 1);
     }
 
     if (data->children) {
@@ -3075,10 +3991,12 @@ dump_xml_element(xmlNode * data, int options, char **buffer, int *offset, int *m
         }
 
         insert_prefix(options, buffer, offset, max, depth);
-        buffer_print(*buffer, *max, *offset, "</%s>", name);
+        buffer_add(buffer, offset, max, "</", 2);
+        buffer_add_str(buffer, offset, max, name);
+        buffer_add(buffer, offset, max, ">", 1);
 
         if (options & xml_log_option_formatted) {
-            buffer_print(*buffer, *max, *offset, "\n");
+            buffer_add(buffer, offset, max, "\n", 1);
         }
     }
 }
@@ -3274,7 +4192,7 @@ crm_xml_dump(xmlNode * data, int options, char **buffer, int *offset, int *max,
 void
 crm_buffer_add_char(char **buffer, int *offset, int *max, char c)
 {
-    buffer_print(*buffer, *max, *offset, "%c", c);
+    buffer_add(buffer, offset, max, &c, 1);
 }
 
 char *
@@ -3333,6 +4251,9 @@ xml_remove_prop(xmlNode * obj, const char *name)
         /* crm_trace("Setting flag %x due to %s[@id=%s].%s", xpf_dirty, obj->name, ID(obj), name); */
 
     } else {
+        if (crm_str_eq(name, XML_ATTR_ID, TRUE)) {
+            requeue_element(obj);
+        }
         xmlUnsetProp(obj, (pcmkXmlStr) name);
     }
 }
@@ -3616,6 +4537,9 @@ mark_created_attrs(xmlNode *new_xml)
                 pcmk__mark_xml_attr_dirty(new_attr);
             } else {
                 // Creation was not allowed, so remove the attribute
+                if (crm_str_eq(attr_name, XML_ATTR_ID, TRUE)) {
+                    requeue_element(new_xml);
+                }
                 xmlUnsetProp(new_xml, new_attr->name);
             }
         }
@@ -3644,8 +4568,10 @@ xml_diff_attrs(xmlNode *old_xml, xmlNode *new_xml)
  * been calculated.
  */
 static void
-mark_child_deleted(xmlNode *old_child, xmlNode *new_parent)
+mark_child_deleted(xmlNode *old_child, xmlNode *new_parent, int position)
 {
+    xmlNode *last = new_parent->last;
+
     // Re-create the child element so we can check ACLs
     xmlNode *candidate = add_node_copy(new_parent, old_child);
 
@@ -3656,9 +4582,17 @@ mark_child_deleted(xmlNode *old_child, xmlNode *new_parent)
     pcmk__apply_acl(xmlDocGetRootElement(candidate->doc));
 
     // Remove the child again (which will track it in document's deleted_objs)
-    free_xml_with_position(candidate, __xml_offset(old_child));
+    free_xml_with_position(candidate, position);
+
+    if (old_child->type == XML_COMMENT_NODE) {
+        if (find_element(new_parent, old_child, TRUE) == NULL) {
+            ((xml_private_t *) (old_child->_private))->flags |= xpf_skip;
+        }
 
-    if (find_element(new_parent, old_child, TRUE) == NULL) {
+    } else if (new_parent->last == last) {
+        /* The caller found no match for old_child, so only the re-created
+         * candidate could have matched, and ACLs allowed its removal.
+         */
         ((xml_private_t *) (old_child->_private))->flags |= xpf_skip;
     }
 }
@@ -3683,11 +4617,196 @@ mark_child_moved(xmlNode *old_child, xmlNode *new_parent, xmlNode *new_child,
     p->flags |= xpf_skip;
 }
 
+/* Minimum number of children for which __xml_diff_object() indexes them,
+ * rather than searching the sibling list for each one
+ */
+#define XML_DIFF_INDEX_MIN 8
+
+/* Children of one element, indexed for matching and position lookups */
+typedef struct xml_child_index_s {
+    GHashTable *ids;        // ID => first child with that ID
+    GHashTable *names;      // Name => first child with that name
+    GHashTable *positions;  // Child => its 1-based index in counts
+    int *counts;            // Fenwick tree of children without xpf_skip
+    int length;             // Number of children
+} xml_child_index_t;
+
+/*!
+ * \internal
+ * \brief Index an element's children by ID and name, if it has enough of them
+ *
+ * \param[in]  parent  Element whose children should be indexed
+ * \param[out] index   Where to store index (left empty for few children)
+ */
+static void
+index_children(xmlNode *parent, xml_child_index_t *index)
+{
+    xmlNode *child = NULL;
+
+    memset(index, 0, sizeof(xml_child_index_t));
+    for (child = __xml_first_child(parent); child != NULL;
+         child = __xml_next(child)) {
+        index->length++;
+    }
+    if (index->length < XML_DIFF_INDEX_MIN) {
+        return;
+    }
+
+    /* IDs are copied because comparing a child may change its attributes,
+     * while names can't change
+     */
+    index->ids = g_hash_table_new_full(crm_str_hash, g_str_equal, free, NULL);
+    index->names = g_hash_table_new(crm_str_hash, g_str_equal);
+    for (child = __xml_first_child(parent); child != NULL;
+         child = __xml_next(child)) {
+        const char *id = ID(child);
+
+        if ((id != NULL) && (g_hash_table_lookup(index->ids, id) == NULL)) {
+            g_hash_table_insert(index->ids, strdup(id), child);
+        }
+        if (g_hash_table_lookup(index->names, child->name) == NULL) {
+            g_hash_table_insert(index->names, (gpointer) child->name, child);
+        }
+    }
+}
+
+/*!
+ * \internal
+ * \brief Add child positions to an index built by index_children()
+ *
+ * \param[in]     parent  Element whose children are indexed
+ * \param[in,out] index   Index to update
+ *
+ * \note Positions honor xpf_skip as it is set at this point; later changes
+ *       must be reported via skip_indexed_child().
+ */
+static void
+index_child_positions(xmlNode *parent, xml_child_index_t *index)
+{
+    int lpc = 0;
+    xmlNode *child = NULL;
+
+    if (index->ids == NULL) {
+        return;
+    }
+
+    index->positions = g_hash_table_new(g_direct_hash, g_direct_equal);
+    index->counts = calloc(index->length + 1, sizeof(int));
+    for (child = __xml_first_child(parent); child != NULL;
+         child = __xml_next(child)) {
+        xml_private_t *p = child->_private;
+
+        lpc++;
+        g_hash_table_insert(index->positions, child, GINT_TO_POINTER(lpc));
+        if (is_not_set(p->flags, xpf_skip)) {
+            int i;
+
+            for (i = lpc; i <= index->length; i += (i & -i)) {
+                index->counts[i]++;
+            }
+        }
+    }
+}
+
+/*!
+ * \internal
+ * \brief Get an indexed child's position, equivalent to __xml_offset()
+ */
+static int
+indexed_child_offset(xml_child_index_t *index, xmlNode *child)
+{
+    int i = 0;
+    int offset = 0;
+
+    if (index->counts == NULL) {
+        return __xml_offset(child);
+    }
+
+    // Sum the unskipped children before this one
+    i = GPOINTER_TO_INT(g_hash_table_lookup(index->positions, child)) - 1;
+    for (; i > 0; i -= (i & -i)) {
+        offset += index->counts[i];
+    }
+    return offset;
+}
+
+/*!
+ * \internal
+ * \brief Record that an indexed child has just been marked with xpf_skip
+ */
+static void
+skip_indexed_child(xml_child_index_t *index, xmlNode *child)
+{
+    int i = 0;
+
+    if (index->counts == NULL) {
+        return;
+    }
+
+    i = GPOINTER_TO_INT(g_hash_table_lookup(index->positions, child));
+    for (; (i > 0) && (i <= index->length); i += (i & -i)) {
+        index->counts[i]--;
+    }
+}
+
+static void
+free_child_index(xml_child_index_t *index)
+{
+    if (index->ids) {
+        g_hash_table_destroy(index->ids);
+    }
+    if (index->names) {
+        g_hash_table_destroy(index->names);
+    }
+    if (index->positions) {
+        g_hash_table_destroy(index->positions);
+    }
+    free(index->counts);
+}
+
+/*!
+ * \internal
+ * \brief Find a child matching a given node, equivalent to find_element()
+ *
+ * \param[in] parent  Element whose children should be searched
+ * \param[in] index   Index of \p parent's children
+ * \param[in] needle  Node to match (by name and ID)
+ *
+ * \return First child of \p parent matching \p needle, or NULL if none
+ */
+static xmlNode *
+find_indexed_element(xmlNode *parent, xml_child_index_t *index,
+                     xmlNode *needle)
+{
+    const char *id = NULL;
+    xmlNode *match = NULL;
+
+    if ((index->ids == NULL) || (needle->type == XML_COMMENT_NODE)) {
+        return find_element(parent, needle, TRUE);
+    }
+
+    id = ID(needle);
+    if (id == NULL) {
+        return g_hash_table_lookup(index->names, needle->name);
+    }
+
+    match = g_hash_table_lookup(index->ids, id);
+    if ((match == NULL) || !strcmp((const char *) match->name,
+                                   (const char *) needle->name)) {
+        return match;
+    }
+
+    // The first child with this ID has a different name, so do it the hard way
+    return find_element(parent, needle, TRUE);
+}
+
 static void
 __xml_diff_object(xmlNode *old_xml, xmlNode *new_xml, bool check_top)
 {
+    int position = 0;
     xmlNode *cIter = NULL;
     xml_private_t *p = NULL;
+    xml_child_index_t index;
 
     CRM_CHECK(new_xml != NULL, return);
     if (old_xml == NULL) {
@@ -3707,42 +4826,69 @@ __xml_diff_object(xmlNode *old_xml, xmlNode *new_xml, bool check_top)
 
     xml_diff_attrs(old_xml, new_xml);
 
+    /* Positions are tracked as we go rather than by walking the sibling list
+     * for each child, and large sets of children are indexed, so that a
+     * parent with thousands of children (such as a node's lrm_resources) is
+     * not compared in quadratic time.
+     */
+
     // Check for differences in the original children
+    index_children(new_xml, &index);
     for (cIter = __xml_first_child(old_xml); cIter != NULL; ) {
         xmlNode *old_child = cIter;
-        xmlNode *new_child = find_element(new_xml, cIter, TRUE);
+        xmlNode *new_child = find_indexed_element(new_xml, &index, cIter);
 
         cIter = __xml_next(cIter);
         if(new_child) {
             __xml_diff_object(old_child, new_child, TRUE);
 
         } else {
-            mark_child_deleted(old_child, new_xml);
+            mark_child_deleted(old_child, new_xml, position);
+        }
+
+        p = old_child->_private;
+        if (is_not_set(p->flags, xpf_skip)) {
+            position++;
         }
     }
+    free_child_index(&index);
 
     // Check for moved or created children
+    position = 0;
+    index_children(old_xml, &index);
+    index_child_positions(old_xml, &index);
     for (cIter = __xml_first_child(new_xml); cIter != NULL; ) {
         xmlNode *new_child = cIter;
-        xmlNode *old_child = find_element(old_xml, cIter, TRUE);
+        xmlNode *old_child = find_indexed_element(old_xml, &index, cIter);
 
         cIter = __xml_next(cIter);
         if(old_child == NULL) {
-            // This is a newly created child
+            // This is a newly created child (which ACLs might free)
             p = new_child->_private;
             p->flags |= xpf_skip;
             __xml_diff_object(old_child, new_child, TRUE);
+            continue;
 
         } else {
             /* Check for movement, we already checked for differences */
-            int p_new = __xml_offset(new_child);
-            int p_old = __xml_offset(old_child);
+            int p_new = position;
+            int p_old = indexed_child_offset(&index, old_child);
 
             if(p_old != p_new) {
+                p = old_child->_private;
+                if (is_not_set(p->flags, xpf_skip) && (p_old > p_new)) {
+                    skip_indexed_child(&index, old_child);
+                }
                 mark_child_moved(old_child, new_xml, new_child, p_old, p_new);
             }
         }
+
+        p = new_child->_private;
+        if (is_not_set(p->flags, xpf_skip)) {
+            position++;
+        }
     }
+    free_child_index(&index);
 }
 
 void
@@ -4308,6 +5454,7 @@ replace_xml_child(xmlNode * parent, xmlNode * child, xmlNode * update, gboolean
 
             xml_accept_changes(tmp);
             old = xmlReplaceNode(child, tmp);
+            adopt_doc_ids(tmp);
 
             if(xml_tracking_changes(tmp)) {
                 /* Replaced sections may have included relevant ACLs */
@@ -4434,7 +5581,7 @@ crm_xml_init(void)
         xmlDeregisterNodeDefault(pcmkDeregisterNode);
         xmlRegisterNodeDefault(pcmkRegisterNode);
 
-        crm_schema_init();
+        // Schemas are loaded on demand (see crm_schema_init())
     }
 }
 
@@ -4443,11 +5590,102 @@ crm_xml_cleanup(void)
 {
     crm_info("Cleaning up memory from libxml2");
     crm_schema_cleanup();
+    pcmk__xpath_cleanup();
+    pcmk__free_acl_views();
+    if ((xml_slabs_free != NULL) && (xml_slabs_free->used == 0)
+        && (xml_slabs_free->next == NULL)) {
+        free(xml_slabs_free);
+        xml_slabs_free = NULL;
+    }
+    if (xml_dict != NULL) {
+        // Documents still in use hold their own references
+        xmlDictFree(xml_dict);
+        xml_dict = NULL;
+    }
     xmlCleanupParser();
 }
 
 #define XPATH_MAX 512
 
+static void
+index_doc_ids(xml_doc_private_t *docp, xmlNode *xml)
+{
+    xmlNode *child = NULL;
+
+    index_element(docp, xml);
+    for (child = __xml_first_child(xml); child != NULL;
+         child = __xml_next(child)) {
+        if (child->type == XML_ELEMENT_NODE) {
+            index_doc_ids(docp, child);
+        }
+    }
+}
+
+/*!
+ * \internal
+ * \brief Find the element with a given ID, using the document's ID index
+ *
+ * The index is built on first use, then updated as elements are created in,
+ * freed from or moved into the document, so it is useful for documents that
+ * are searched many times (such as the scheduler's copy of the CIB, or the CIB
+ * manager's CIB). Documents that are never searched by ID have no index.
+ *
+ * \param[in] xml  Any node in the document to search
+ * \param[in] id   ID to search for
+ *
+ * \return The only element in \p xml's document with \p id, or NULL if there
+ *         is not exactly one such element that is known (in which case the
+ *         caller should fall back to an XPath search, which will also log
+ *         any duplicates)
+ */
+xmlNode *
+pcmk__xml_find_id(xmlNode *xml, const char *id)
+{
+    xmlNode *match = NULL;
+    xml_doc_private_t *docp = NULL;
+
+    if ((xml == NULL) || (id == NULL)
+        || ((docp = doc_private(xml->doc)) == NULL)) {
+        return NULL;
+    }
+
+    if (docp->id_index == NULL) {
+        xmlNode *root = xmlDocGetRootElement(xml->doc);
+
+        // IDs are copied because attribute values may be replaced in place
+        docp->id_index = g_hash_table_new_full(crm_str_hash, g_str_equal,
+                                               free, NULL);
+        docp->id_elements = g_hash_table_new_full(NULL, NULL, NULL, free);
+        if (root != NULL) {
+            index_doc_ids(docp, root);
+        }
+
+    } else if (docp->id_pending != NULL) {
+        GHashTable *pending = docp->id_pending;
+        GHashTableIter iter;
+
+        docp->id_pending = NULL;
+        g_hash_table_iter_init(&iter, pending);
+        while (g_hash_table_iter_next(&iter, (gpointer *) &match, NULL)) {
+            ((xml_private_t *) match->_private)->id_doc = NULL;
+            if (match->doc == xml->doc) {
+                index_element(docp, match);
+            }
+        }
+        g_hash_table_destroy(pending);
+    }
+
+    match = g_hash_table_lookup(docp->id_index, id);
+    if ((match == NULL) || (match == (xmlNode *) xml->doc)) {
+        return NULL;
+    }
+
+    /* Nodes can be moved without being created or freed, so make sure the
+     * match is still in the document with the same ID
+     */
+    return has_doc_id(match, xml->doc, id)? match : NULL;
+}
+
 xmlNode *
 expand_idref(xmlNode * input, xmlNode * top)
 {
@@ -4466,8 +5704,14 @@ expand_idref(xmlNode * input, xmlNode * top)
     ref = crm_element_value(result, XML_ATTR_IDREF);
 
     if (ref != NULL) {
-        char *xpath_string = crm_strdup_printf("//%s[@id='%s']", tag, ref);
+        char *xpath_string = NULL;
+
+        result = pcmk__xml_find_id(top, ref);
+        if ((result != NULL) && crm_str_eq(crm_element_name(result), tag, TRUE)) {
+            return result;
+        }
 
+        xpath_string = crm_strdup_printf("//%s[@id='%s']", tag, ref);
         result = get_xpath_object(xpath_string, top, LOG_ERR);
         if (result == NULL) {
             char *nodePath = (char *)xmlGetNodePath(top);
@@ -0,0 +1,550 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <glib.h>
+#include <libxml/tree.h>
+#include <libxml/chvalid.h>
+#include <libxml/xmlstring.h>
+
+#include <crm/crm.h>
+#include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
+#include "crmcommon_private.h"
+
+/* Compact binary encoding of XML, used for IPC with peers that support it
+ *
+ * An encoded message is a format version byte, the root element, and a
+ * terminating nul byte (so that it can be sanity-checked the same way as a
+ * text message). Each node begins with a byte giving its kind:
+ *
+ *   element  'E' name attr-count (name string)* node* 0
+ *   comment  'C' string
+ *   CDATA    'D' string
+ *
+ * Integers are unsigned base-128 varints, least significant group first. A
+ * string is its length, its bytes, and a nul byte, so that decoded values can
+ * be used in place without copying. A name is either the index (starting at 1)
+ * of a name already seen in the message, or 0 followed by a string that
+ * becomes the next name, so element and attribute names are sent only once.
+ *
+ * As with dump_xml_unformatted(), text nodes and deleted attributes are not
+ * encoded.
+ *
+ * The decoder accepts only what the text parser would accept, so that nothing
+ * received this way can make the CIB unparsable once written out as text:
+ * names must be valid XML names, strings may contain only XML characters
+ * (as UTF-8), an element may not have two attributes with the same name, and
+ * comments and CDATA sections must be representable as text.
+ */
+
+#define BINARY_XML_VERSION      1
+
+// Same as libxml2's default limit on nesting when parsing text
+#define BINARY_XML_MAX_DEPTH    256
+
+enum binary_xml_kind {
+    binary_xml_end      = 0,
+    binary_xml_element  = 'E',
+    binary_xml_comment  = 'C',
+    binary_xml_cdata    = 'D',
+};
+
+typedef struct {
+    char *buffer;
+    size_t len;
+    size_t max;
+    GHashTable *names;  // Name -> index (as pointer)
+    bool valid;         // Whether everything so far could be decoded
+} xml_encoder_t;
+
+typedef struct {
+    const char *buffer;
+    size_t len;
+    size_t offset;
+    GPtrArray *names;   // Index - 1 -> name
+    xmlDict *dict;      // Dictionary of document being built, once created
+} xml_decoder_t;
+
+/*!
+ * \internal
+ * \brief Check whether a string has only valid XML characters
+ *
+ * \param[in] s  Nul-terminated string to check
+ *
+ * \return true if \p s is valid UTF-8 consisting of XML characters only
+ */
+static bool
+valid_xml_chars(const char *s)
+{
+    const unsigned char *c = (const unsigned char *) s;
+
+    while (*c != '\0') {
+        if (*c < 0x80) {
+            // Of the ASCII control characters, only whitespace is allowed
+            if ((*c < 0x20) && (*c != '\t') && (*c != '\n') && (*c != '\r')) {
+                return FALSE;
+            }
+            c++;
+
+        } else {
+            // The nul terminator stops this at the end of a truncated sequence
+            int len = 4;
+            int ch = xmlGetUTF8Char(c, &len);
+
+            if ((ch < 0) || !xmlIsCharQ(ch)) {
+                return FALSE;
+            }
+            c += len;
+        }
+    }
+    return TRUE;
+}
+
+/*!
+ * \internal
+ * \brief Check whether a comment could be written as text
+ *
+ * \param[in] content  Comment text
+ *
+ * \return true if \p content is valid as the content of an XML comment
+ */
+static bool
+valid_comment(const char *content)
+{
+    size_t len = strlen(content);
+
+    return valid_xml_chars(content) && (strstr(content, "--") == NULL)
+           && ((len == 0) || (content[len - 1] != '-'));
+}
+
+/*!
+ * \internal
+ * \brief Check whether a CDATA section could be written as text
+ *
+ * \param[in] content  CDATA section text
+ *
+ * \return true if \p content is valid as the content of a CDATA section
+ */
+static bool
+valid_cdata(const char *content)
+{
+    return valid_xml_chars(content) && (strstr(content, "]]>") == NULL);
+}
+
+static void
+encode_reserve(xml_encoder_t *enc, size_t extra)
+{
+    if ((enc->len + extra) > enc->max) {
+        enc->max = MAX(2 * enc->max, enc->len + extra);
+        enc->buffer = realloc_safe(enc->buffer, enc->max);
+    }
+}
+
+static inline void
+encode_byte(xml_encoder_t *enc, uint8_t byte)
+{
+    encode_reserve(enc, 1);
+    enc->buffer[enc->len++] = (char) byte;
+}
+
+static void
+encode_uint(xml_encoder_t *enc, size_t value)
+{
+    encode_reserve(enc, 2 * sizeof(size_t));
+    do {
+        uint8_t byte = value & 0x7f;
+
+        value >>= 7;
+        if (value != 0) {
+            byte |= 0x80;
+        }
+        enc->buffer[enc->len++] = (char) byte;
+    } while (value != 0);
+}
+
+static void
+encode_string(xml_encoder_t *enc, const char *s)
+{
+    size_t len = (s == NULL)? 0 : strlen(s);
+
+    encode_uint(enc, len);
+    encode_reserve(enc, len + 1);
+    if (len > 0) {
+        memcpy(enc->buffer + enc->len, s, len);
+        enc->len += len;
+    }
+    enc->buffer[enc->len++] = '\0';
+}
+
+static void
+encode_name(xml_encoder_t *enc, const char *name)
+{
+    gpointer index = g_hash_table_lookup(enc->names, name);
+
+    if (index != NULL) {
+        encode_uint(enc, GPOINTER_TO_UINT(index));
+        return;
+    }
+    if (xmlValidateName((pcmkXmlStr) name, 0) != 0) {
+        enc->valid = FALSE;
+    }
+    encode_uint(enc, 0);
+    encode_string(enc, name);
+    g_hash_table_insert(enc->names, (gpointer) name,
+                        GUINT_TO_POINTER(g_hash_table_size(enc->names) + 1));
+}
+
+static inline bool
+encode_attr_wanted(xmlAttr *attr)
+{
+    xml_private_t *p = attr->_private;
+
+    return (attr->children != NULL)
+           && ((p == NULL) || is_not_set(p->flags, xpf_deleted));
+}
+
+static void
+encode_node(xml_encoder_t *enc, xmlNode *xml)
+{
+    switch (xml->type) {
+        case XML_ELEMENT_NODE:
+            {
+                xmlAttr *attr = NULL;
+                xmlNode *child = NULL;
+                size_t n_attrs = 0;
+
+                for (attr = pcmk__first_xml_attr(xml); attr != NULL;
+                     attr = attr->next) {
+                    if (encode_attr_wanted(attr)) {
+                        n_attrs++;
+                    }
+                }
+
+                encode_byte(enc, binary_xml_element);
+                encode_name(enc, (const char *) xml->name);
+                encode_uint(enc, n_attrs);
+                for (attr = pcmk__first_xml_attr(xml); attr != NULL;
+                     attr = attr->next) {
+                    if (encode_attr_wanted(attr)) {
+                        const char *value = pcmk__xml_attr_value(attr);
+
+                        if (!valid_xml_chars(value)) {
+                            enc->valid = FALSE;
+                        }
+                        encode_name(enc, (const char *) attr->name);
+                        encode_string(enc, value);
+                    }
+                }
+
+                for (child = xml->children; child != NULL;
+                     child = child->next) {
+                    encode_node(enc, child);
+                }
+                encode_byte(enc, binary_xml_end);
+            }
+            break;
+
+        case XML_COMMENT_NODE:
+            if (!valid_comment((const char *) xml->content)) {
+                enc->valid = FALSE;
+            }
+            encode_byte(enc, binary_xml_comment);
+            encode_string(enc, (const char *) xml->content);
+            break;
+
+        case XML_CDATA_SECTION_NODE:
+            if (!valid_cdata((const char *) xml->content)) {
+                enc->valid = FALSE;
+            }
+            encode_byte(enc, binary_xml_cdata);
+            encode_string(enc, (const char *) xml->content);
+            break;
+
+        default:
+            // Text nodes are not preserved by the text encoding either
+            break;
+    }
+}
+
+/*!
+ * \internal
+ * \brief Encode XML in binary form for IPC
+ *
+ * \param[in]  xml  XML element to encode
+ * \param[out] len  Where to store size of result (including terminating nul)
+ *
+ * \return Newly allocated encoded XML (or NULL if \p xml is not an element,
+ *         or has content that pcmk__binary2xml() would reject, such as control
+ *         characters in attribute values)
+ * \note Callers should fall back to the text encoding if this returns NULL,
+ *       since that escapes whatever it cannot represent.
+ */
+char *
+pcmk__xml2binary(xmlNode *xml, unsigned int *len)
+{
+    xml_encoder_t enc = { NULL, 0, 0, NULL, TRUE };
+
+    CRM_ASSERT(len != NULL);
+    *len = 0;
+    CRM_CHECK((xml != NULL) && (xml->type == XML_ELEMENT_NODE), return NULL);
+
+    enc.names = g_hash_table_new(crm_str_hash, g_str_equal);
+    encode_reserve(&enc, 1024);
+
+    encode_byte(&enc, BINARY_XML_VERSION);
+    encode_node(&enc, xml);
+    encode_byte(&enc, '\0');
+
+    g_hash_table_destroy(enc.names);
+    if (!enc.valid) {
+        crm_trace("Not encoding XML in binary: content is not valid XML");
+        free(enc.buffer);
+        return NULL;
+    }
+    *len = (unsigned int) enc.len;
+    return enc.buffer;
+}
+
+static bool
+decode_byte(xml_decoder_t *dec, uint8_t *byte)
+{
+    if (dec->offset >= dec->len) {
+        return FALSE;
+    }
+    *byte = (uint8_t) dec->buffer[dec->offset++];
+    return TRUE;
+}
+
+static bool
+decode_uint(xml_decoder_t *dec, size_t *value)
+{
+    unsigned int shift = 0;
+    uint8_t byte = 0;
+
+    *value = 0;
+    do {
+        if ((shift >= (8 * sizeof(size_t))) || !decode_byte(dec, &byte)) {
+            return FALSE;
+        }
+        *value |= ((size_t) (byte & 0x7f)) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return TRUE;
+}
+
+static const char *
+decode_string(xml_decoder_t *dec)
+{
+    size_t len = 0;
+    const char *s = NULL;
+
+    if (!decode_uint(dec, &len) || (len >= (dec->len - dec->offset))
+        || (dec->buffer[dec->offset + len] != '\0')) {
+        return NULL;
+    }
+    s = dec->buffer + dec->offset;
+    dec->offset += len + 1;
+    return s;
+}
+
+static const char *
+decode_value(xml_decoder_t *dec)
+{
+    const char *s = decode_string(dec);
+
+    return ((s != NULL) && valid_xml_chars(s))? s : NULL;
+}
+
+static const char *
+decode_name(xml_decoder_t *dec)
+{
+    size_t index = 0;
+    const char *name = NULL;
+
+    if (!decode_uint(dec, &index)) {
+        return NULL;
+    }
+    if (index > 0) {
+        return (index <= dec->names->len)?
+               g_ptr_array_index(dec->names, index - 1) : NULL;
+    }
+    name = decode_string(dec);
+    if ((name == NULL) || (xmlValidateName((pcmkXmlStr) name, 0) != 0)) {
+        return NULL;
+    }
+    if (dec->dict != NULL) {
+        /* Intern each name once, so nodes can use it without another lookup
+         * in the document's dictionary
+         */
+        name = (const char *) xmlDictLookup(dec->dict, (pcmkXmlStr) name, -1);
+        CRM_ASSERT(name != NULL);
+    }
+    g_ptr_array_add(dec->names, (gpointer) name);
+    return name;
+}
+
+static xmlNode *decode_children(xml_decoder_t *dec, xmlNode *parent,
+                                int depth);
+
+static xmlNode *
+decode_element(xml_decoder_t *dec, xmlNode *parent, int depth)
+{
+    size_t n_attrs = 0;
+    xmlNode *xml = NULL;
+    const char *name = decode_name(dec);
+
+    if ((name == NULL) || (depth > BINARY_XML_MAX_DEPTH)
+        || !decode_uint(dec, &n_attrs)) {
+        return NULL;
+    }
+
+    if (parent == NULL) {
+        xml = create_xml_node(NULL, name);
+        CRM_CHECK(xml != NULL, return NULL);
+
+        dec->dict = xml->doc->dict;
+        if (dec->dict != NULL) {
+            // Only the root's name has been seen so far
+            g_ptr_array_index(dec->names, 0) =
+                (gpointer) xmlDictLookup(dec->dict, (pcmkXmlStr) name, -1);
+        }
+
+    } else if (dec->dict != NULL) {
+        xml = xmlNewDocNodeEatName(parent->doc, NULL, (xmlChar *) name, NULL);
+        CRM_CHECK(xml != NULL, return NULL);
+        xmlAddChild(parent, xml);
+
+    } else {
+        xml = create_xml_node(parent, name);
+        CRM_CHECK(xml != NULL, return NULL);
+    }
+
+    for (; n_attrs > 0; n_attrs--) {
+        const char *attr_name = decode_name(dec);
+        const char *value = NULL;
+
+        if ((attr_name != NULL)
+            && (xmlHasProp(xml, (pcmkXmlStr) attr_name) == NULL)) {
+            value = decode_value(dec);
+        }
+        if (value == NULL) {
+            goto fail;
+        }
+        if (dec->dict != NULL) {
+            xmlNewNsPropEatName(xml, NULL, (xmlChar *) attr_name,
+                                (pcmkXmlStr) value);
+        } else {
+            xmlNewProp(xml, (pcmkXmlStr) attr_name, (pcmkXmlStr) value);
+        }
+    }
+
+    if (decode_children(dec, xml, depth + 1) != NULL) {
+        return xml;
+    }
+
+fail:
+    if (parent == NULL) {
+        free_xml(xml);
+    }
+    return NULL;
+}
+
+/* Decode the children of an element, returning the element on success.
+ * On failure, the caller frees the whole partial tree.
+ */
+static xmlNode *
+decode_children(xml_decoder_t *dec, xmlNode *parent, int depth)
+{
+    uint8_t kind = binary_xml_end;
+    const char *content = NULL;
+
+    while (decode_byte(dec, &kind)) {
+        switch (kind) {
+            case binary_xml_end:
+                return parent;
+
+            case binary_xml_element:
+                if (decode_element(dec, parent, depth) == NULL) {
+                    return NULL;
+                }
+                break;
+
+            case binary_xml_comment:
+                content = decode_string(dec);
+                if ((content == NULL) || !valid_comment(content)) {
+                    return NULL;
+                }
+                xmlAddChild(parent, xmlNewDocComment(parent->doc,
+                                                     (pcmkXmlStr) content));
+                break;
+
+            case binary_xml_cdata:
+                content = decode_string(dec);
+                if ((content == NULL) || !valid_cdata(content)) {
+                    return NULL;
+                }
+                xmlAddChild(parent,
+                            xmlNewCDataBlock(parent->doc, (pcmkXmlStr) content,
+                                             strlen(content)));
+                break;
+
+            default:
+                return NULL;
+        }
+    }
+    return NULL;
+}
+
+/*!
+ * \internal
+ * \brief Create XML from its binary encoding
+ *
+ * \param[in] buffer  Encoded XML, as created by pcmk__xml2binary()
+ * \param[in] len     Size of \p buffer (including terminating nul)
+ *
+ * \return Newly allocated XML (or NULL if \p buffer is not valid)
+ * \note The caller is responsible for freeing the result with free_xml().
+ */
+xmlNode *
+pcmk__binary2xml(const char *buffer, unsigned int len)
+{
+    xml_decoder_t dec = { buffer, len, 0, NULL, NULL };
+    xmlNode *xml = NULL;
+    uint8_t byte = 0;
+
+    CRM_CHECK(buffer != NULL, return NULL);
+
+    if (!decode_byte(&dec, &byte) || (byte != BINARY_XML_VERSION)) {
+        crm_err("Cannot decode binary XML: unsupported format version %d",
+                (int) byte);
+        return NULL;
+    }
+
+    dec.names = g_ptr_array_new();
+    if (decode_byte(&dec, &byte) && (byte == binary_xml_element)) {
+        xml = decode_element(&dec, NULL, 0);
+    }
+    g_ptr_array_free(dec.names, TRUE);
+
+    if ((xml != NULL)
+        && ((dec.offset + 1 != dec.len) || (buffer[dec.offset] != '\0'))) {
+        free_xml(xml);
+        xml = NULL;
+    }
+    if (xml == NULL) {
+        crm_err("Cannot decode binary XML: invalid data at offset %llu of %u",
+                (unsigned long long) dec.offset, len);
+    }
+    return xml;
+}
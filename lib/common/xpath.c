@@ -19,6 +19,11 @@
 #include <crm_internal.h>
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <libxml/xpathInternals.h>  // xmlXPathNewNodeSet()
+#include <crm/common/xml_internal.h>
+#include "crmcommon_private.h"
 
 /*
  * From xpath2.c
@@ -140,6 +145,186 @@ dedupXpathResults(xmlXPathObjectPtr xpathObj)
     }
 }
 
+/*!
+ * \internal
+ * \brief Answer a search for one element by ID without evaluating XPath
+ *
+ * \param[in] xml_top  XML to search
+ * \param[in] path     XPath search string
+ *
+ * \return Result set with the match if \p path is of the form
+ *         //NAME[@id='ID'] or //*[@id='ID'] and the document's ID index
+ *         knows the only element with that ID, otherwise NULL
+ */
+static xmlXPathObjectPtr
+search_by_id(xmlNode *xml_top, const char *path)
+{
+    size_t lpc = 0;
+    size_t name_len = 0;
+    char quote = '\0';
+    char *id = NULL;
+    const char *id_end = NULL;
+    const char *name = path + 2;
+    xmlNode *match = NULL;
+
+    if (strncmp(path, "//", 2) != 0) {
+        return NULL;
+    }
+
+    name_len = strcspn(name, "[");
+    if ((name_len == 0) || (strncmp(name + name_len, "[@id=", 5) != 0)) {
+        return NULL;
+    }
+    if ((name_len > 1) || (name[0] != '*')) {
+        for (lpc = 0; lpc < name_len; lpc++) {
+            if (!isalnum((unsigned char) name[lpc]) && (strchr("-_.", name[lpc]) == NULL)) {
+                return NULL;
+            }
+        }
+    }
+
+    quote = name[name_len + 5];
+    if ((quote != '\'') && (quote != '"')) {
+        return NULL;
+    }
+    id_end = strchr(name + name_len + 6, quote);
+    if ((id_end == NULL) || (strcmp(id_end + 1, "]") != 0)) {
+        return NULL;
+    }
+
+    id = strndup(name + name_len + 6, id_end - (name + name_len + 6));
+    match = pcmk__xml_find_id(xml_top, id);
+    free(id);
+
+    if ((match == NULL)
+        || (((name_len > 1) || (name[0] != '*'))
+            && ((strlen((const char *) match->name) != name_len)
+                || strncmp((const char *) match->name, name, name_len)))) {
+        return NULL;
+    }
+    return xmlXPathNewNodeSet(match);
+}
+
+/* Compiled XPath expressions, most recently used first
+ *
+ * Only pcmk__xpath_search_with() uses the cache, because its callers pass a
+ * fixed expression (with any values as variables), which keeps the set of
+ * expressions small. xpath_search() is mostly given expressions formatted for
+ * one search, which would only push the reusable ones out. The cache is
+ * bounded all the same, in case a caller does format a unique expression.
+ */
+#define XPATH_CACHE_MAX 64
+
+typedef struct xpath_cache_entry_s {
+    char *expression;
+    xmlXPathCompExprPtr compiled;
+    GList *link;    // This entry's position in xpath_lru
+} xpath_cache_entry_t;
+
+static GHashTable *xpath_cache = NULL;
+static GQueue *xpath_lru = NULL;
+static unsigned int xpath_cache_hits = 0;
+static unsigned int xpath_cache_misses = 0;
+
+static void
+free_xpath_cache_entry(gpointer data)
+{
+    xpath_cache_entry_t *entry = data;
+
+    xmlXPathFreeCompExpr(entry->compiled);
+    free(entry->expression);
+    free(entry);
+}
+
+/*!
+ * \internal
+ * \brief Get the compiled form of an XPath expression
+ *
+ * \param[in] path  XPath expression to compile
+ *
+ * \return Compiled expression (owned by the cache), or NULL if invalid
+ * \note The result is only valid until the next call, which may evict it.
+ */
+static xmlXPathCompExprPtr
+compile_xpath(const char *path)
+{
+    xpath_cache_entry_t *entry = NULL;
+    xmlXPathCompExprPtr compiled = NULL;
+
+    if (xpath_cache == NULL) {
+        xpath_cache = g_hash_table_new_full(crm_str_hash, g_str_equal, NULL,
+                                            free_xpath_cache_entry);
+        xpath_lru = g_queue_new();
+    }
+
+    entry = g_hash_table_lookup(xpath_cache, path);
+    if (entry != NULL) {
+        if (entry->link != xpath_lru->head) {
+            g_queue_unlink(xpath_lru, entry->link);
+            g_queue_push_head_link(xpath_lru, entry->link);
+        }
+        xpath_cache_hits++;
+        return entry->compiled;
+    }
+
+    xpath_cache_misses++;
+    compiled = xmlXPathCompile((pcmkXmlStr) path);
+    if (compiled == NULL) {
+        crm_trace("Could not compile XPath expression %s", path);
+        return NULL;
+    }
+
+    if (g_queue_get_length(xpath_lru) >= XPATH_CACHE_MAX) {
+        xpath_cache_entry_t *oldest = g_queue_pop_tail(xpath_lru);
+
+        g_hash_table_remove(xpath_cache, oldest->expression);
+    }
+
+    entry = calloc(1, sizeof(xpath_cache_entry_t));
+    CRM_ASSERT(entry != NULL);
+    entry->expression = strdup(path);
+    entry->compiled = compiled;
+    g_queue_push_head(xpath_lru, entry);
+    entry->link = xpath_lru->head;
+    g_hash_table_insert(xpath_cache, entry->expression, entry);
+    return compiled;
+}
+
+/*!
+ * \internal
+ * \brief Free all cached compiled XPath expressions
+ */
+void
+pcmk__xpath_cleanup(void)
+{
+    if (xpath_cache != NULL) {
+        g_queue_free(xpath_lru);
+        xpath_lru = NULL;
+        g_hash_table_destroy(xpath_cache);
+        xpath_cache = NULL;
+    }
+    xpath_cache_hits = 0;
+    xpath_cache_misses = 0;
+}
+
+/*!
+ * \internal
+ * \brief Get how often compiled XPath expressions were found in the cache
+ *
+ * \param[out] hits    Where to store number of searches that found theirs
+ * \param[out] misses  Where to store number of searches that compiled theirs
+ */
+void
+pcmk__xpath_cache_stats(unsigned int *hits, unsigned int *misses)
+{
+    if (hits != NULL) {
+        *hits = xpath_cache_hits;
+    }
+    if (misses != NULL) {
+        *misses = xpath_cache_misses;
+    }
+}
+
 /* the caller needs to check if the result contains a xmlDocPtr or xmlNodePtr */
 xmlXPathObjectPtr
 xpath_search(xmlNode * xml_top, const char *path)
@@ -147,18 +332,84 @@ xpath_search(xmlNode * xml_top, const char *path)
     xmlDocPtr doc = NULL;
     xmlXPathObjectPtr xpathObj = NULL;
     xmlXPathContextPtr xpathCtx = NULL;
-    const xmlChar *xpathExpr = (pcmkXmlStr) path;
 
     CRM_CHECK(path != NULL, return NULL);
     CRM_CHECK(xml_top != NULL, return NULL);
     CRM_CHECK(strlen(path) > 0, return NULL);
 
+    xpathObj = search_by_id(xml_top, path);
+    if (xpathObj != NULL) {
+        return xpathObj;
+    }
+
     doc = getDocPtr(xml_top);
 
     xpathCtx = xmlXPathNewContext(doc);
     CRM_ASSERT(xpathCtx != NULL);
 
-    xpathObj = xmlXPathEvalExpression(xpathExpr, xpathCtx);
+    xpathObj = xmlXPathEvalExpression((pcmkXmlStr) path, xpathCtx);
+    xmlXPathFreeContext(xpathCtx);
+    return xpathObj;
+}
+
+/*!
+ * \internal
+ * \brief Search XML using a reusable XPath expression with string variables
+ *
+ * Rather than formatting values such as node names or resource IDs into a new
+ * expression for every search, callers can refer to them as XPath variables
+ * (for example, "//node_state[@uname=$node]"), so that one compiled expression
+ * is reused for every search, and values containing quotes need no escaping.
+ * Expressions that are searched for repeatedly without any variables, such as
+ * constants or configured ACL paths, can be passed with an empty list.
+ *
+ * \param[in] xml_top  XML to search
+ * \param[in] path     XPath expression to evaluate
+ * \param[in] ...      NULL-terminated list of variable name/value pairs
+ *
+ * \return Search results (which the caller must free with freeXpathObject())
+ * \note Use xpath_search() instead for an expression formatted for one search,
+ *       so it does not push reusable expressions out of the cache.
+ */
+xmlXPathObjectPtr
+pcmk__xpath_search_with(xmlNode *xml_top, const char *path, ...)
+{
+    va_list ap;
+    const char *name = NULL;
+    xmlXPathObjectPtr xpathObj = NULL;
+    xmlXPathContextPtr xpathCtx = NULL;
+    xmlXPathCompExprPtr compiled = NULL;
+
+    CRM_CHECK(path != NULL, return NULL);
+    CRM_CHECK(xml_top != NULL, return NULL);
+    CRM_CHECK(strlen(path) > 0, return NULL);
+
+    va_start(ap, path);
+    name = va_arg(ap, const char *);
+    if (name == NULL) {
+        xpathObj = search_by_id(xml_top, path);
+        if (xpathObj != NULL) {
+            va_end(ap);
+            return xpathObj;
+        }
+    }
+
+    xpathCtx = xmlXPathNewContext(getDocPtr(xml_top));
+    CRM_ASSERT(xpathCtx != NULL);
+
+    for (; name != NULL; name = va_arg(ap, const char *)) {
+        const char *value = va_arg(ap, const char *);
+
+        // The context takes ownership of the new value object
+        xmlXPathRegisterVariable(xpathCtx, (pcmkXmlStr) name,
+                                 xmlXPathNewCString(value? value : ""));
+    }
+    va_end(ap);
+
+    compiled = compile_xpath(path);
+    if (compiled != NULL) {
+        xpathObj = xmlXPathCompiledEval(compiled, xpathCtx);
+    }
     xmlXPathFreeContext(xpathCtx);
     return xpathObj;
 }
@@ -25,6 +25,7 @@
 #include <crm/services.h>
 #include <crm/common/mainloop.h>
 #include <crm/common/ipcs.h>
+#include <crm/common/ipc_internal.h>
 #include <crm/common/remote_internal.h>
 #include <crm/msg_xml.h>
 
@@ -283,20 +284,24 @@ lrmd_dispatch_internal(lrmd_t * lrmd, xmlNode * msg)
 }
 
 static int
-lrmd_ipc_dispatch(const char *buffer, ssize_t length, gpointer userdata)
+lrmd_ipc_dispatch_xml(xmlNode *msg, gpointer userdata)
 {
     lrmd_t *lrmd = userdata;
     lrmd_private_t *native = lrmd->lrmd_private;
-    xmlNode *msg;
-    int rc;
 
     if (!native->callback) {
         /* no callback set */
         return 1;
     }
+    return lrmd_dispatch_internal(lrmd, msg);
+}
+
+static int
+lrmd_ipc_dispatch(const char *buffer, ssize_t length, gpointer userdata)
+{
+    xmlNode *msg = string2xml(buffer);
+    int rc = lrmd_ipc_dispatch_xml(msg, userdata);
 
-    msg = string2xml(buffer);
-    rc = lrmd_dispatch_internal(lrmd, msg);
     free_xml(msg);
     return rc;
 }
@@ -426,9 +431,10 @@ lrmd_dispatch(lrmd_t * lrmd)
         case CRM_CLIENT_IPC:
             while (crm_ipc_ready(private->ipc)) {
                 if (crm_ipc_read(private->ipc) > 0) {
-                    const char *msg = crm_ipc_buffer(private->ipc);
+                    xmlNode *msg = pcmk__ipc_buffer_xml(private->ipc);
 
-                    lrmd_ipc_dispatch(msg, strlen(msg), lrmd);
+                    lrmd_ipc_dispatch_xml(msg, lrmd);
+                    free_xml(msg);
                 }
             }
             break;
@@ -964,6 +970,7 @@ lrmd_ipc_connect(lrmd_t * lrmd, int *fd)
         native->ipc = crm_ipc_new(CRM_SYSTEM_LRMD, 0);
         if (native->ipc && crm_ipc_connect(native->ipc)) {
             *fd = crm_ipc_get_fd(native->ipc);
+            pcmk__ipc_accept_binary(native->ipc);
         } else if (native->ipc) {
             crm_perror(LOG_ERR, "Connection to executor failed");
             rc = -ENOTCONN;
@@ -971,6 +978,10 @@ lrmd_ipc_connect(lrmd_t * lrmd, int *fd)
     } else {
         native->source = mainloop_add_ipc_client(CRM_SYSTEM_LRMD, G_PRIORITY_HIGH, 0, lrmd, &lrmd_callbacks);
         native->ipc = mainloop_get_ipc_client(native->source);
+        if (native->source != NULL) {
+            pcmk__mainloop_ipc_xml_dispatch(native->source,
+                                            lrmd_ipc_dispatch_xml);
+        }
     }
 
     if (native->ipc == NULL) {
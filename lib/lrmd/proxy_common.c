@@ -14,6 +14,7 @@
 #include <crm/msg_xml.h>
 #include <crm/services.h>
 #include <crm/common/mainloop.h>
+#include <crm/common/ipc_internal.h>
 
 #include <crm/pengine/status.h>
 #include <crm/cib.h>
@@ -199,6 +200,42 @@ remote_proxy_new(lrmd_t *lrmd, struct ipc_client_callbacks *proxy_callbacks,
     return proxy;
 }
 
+/* A request relayed from a remote node, whose reply is relayed back */
+struct relayed_request_s {
+    char *session_id;   // Proxy session request arrived on
+    int msg_id;         // Remote node's ID for request
+};
+
+// Pass the reply to a relayed request back to the remote node
+static void
+relay_reply(crm_ipc_t *ipc, uint32_t request_id, int rc, xmlNode *reply,
+            void *user_data)
+{
+    struct relayed_request_s *relayed = user_data;
+    remote_proxy_t *proxy = NULL;
+
+    if (proxy_table != NULL) {
+        proxy = g_hash_table_lookup(proxy_table, relayed->session_id);
+    }
+
+    if ((proxy == NULL) || (proxy->ipc != ipc)) {
+        crm_debug("Discarding reply to request %d from %s: session ended",
+                  relayed->msg_id, crm_ipc_name(ipc));
+
+    } else if (rc != pcmk_ok) {
+        crm_err("Could not relay request %d from %s to %s: %s (%d)",
+                relayed->msg_id, proxy->node_name, crm_ipc_name(ipc),
+                pcmk_strerror(rc), rc);
+
+    } else {
+        crm_trace("Relaying reply to request %d from %s back to %s",
+                  relayed->msg_id, crm_ipc_name(ipc), proxy->node_name);
+        remote_proxy_relay_response(proxy, reply, relayed->msg_id);
+    }
+    free(relayed->session_id);
+    free(relayed);
+}
+
 void
 remote_proxy_cb(lrmd_t *lrmd, const char *node_name, xmlNode *msg)
 {
@@ -280,15 +317,35 @@ remote_proxy_cb(lrmd_t *lrmd, const char *node_name, xmlNode *msg)
                 proxy->last_request_id = msg_id;
             }
 
-        } else {
+        } else if (is_set(flags, crm_ipc_client_response)) {
             int rc = pcmk_ok;
-            xmlNode *op_reply = NULL;
+            struct relayed_request_s *relayed = NULL;
             // @COMPAT pacemaker_remoted <= 1.1.10
 
             crm_trace("Relaying %s request %d from %s to %s for %s",
                       op, msg_id, proxy->node_name, crm_ipc_name(proxy->ipc), name);
 
-            rc = crm_ipc_send(proxy->ipc, request, flags, 10000, &op_reply);
+            /* Relay the reply whenever it arrives, rather than blocking
+             * everything else the controller does until then
+             */
+            relayed = calloc(1, sizeof(struct relayed_request_s));
+            CRM_ASSERT(relayed != NULL);
+            relayed->session_id = strdup(proxy->session_id);
+            relayed->msg_id = msg_id;
+
+            rc = pcmk__ipc_send_async(proxy->ipc, request, flags, 10000,
+                                      relay_reply, relayed, NULL);
+            if(rc < 0) {
+                crm_err("Could not relay %s request %d from %s to %s for %s: %s (%d)",
+                         op, msg_id, proxy->node_name, crm_ipc_name(proxy->ipc), name, pcmk_strerror(rc), rc);
+                free(relayed->session_id);
+                free(relayed);
+            }
+
+        } else {
+            int rc = crm_ipc_send(proxy->ipc, request, flags, 10000, NULL);
+            // @COMPAT pacemaker_remoted <= 1.1.10
+
             if(rc < 0) {
                 crm_err("Could not relay %s request %d from %s to %s for %s: %s (%d)",
                          op, msg_id, proxy->node_name, crm_ipc_name(proxy->ipc), name, pcmk_strerror(rc), rc);
@@ -296,11 +353,6 @@ remote_proxy_cb(lrmd_t *lrmd, const char *node_name, xmlNode *msg)
                 crm_trace("Relayed %s request %d from %s to %s for %s",
                           op, msg_id, proxy->node_name, crm_ipc_name(proxy->ipc), name);
             }
-
-            if(op_reply) {
-                remote_proxy_relay_response(proxy, op_reply, msg_id);
-                free_xml(op_reply);
-            }
         }
     } else {
         crm_err("Unknown proxy operation: %s", op);
@@ -2394,9 +2394,20 @@ order_first_probes_imply_stops(pe_working_set_t * data_set)
     }
 }
 
+/*!
+ * \internal
+ * \brief Order a probe before restarts or re-promotes it would otherwise cause
+ *
+ * \param[in]     probe     Probe to order
+ * \param[in]     after     Action ordered after \p probe to proceed through
+ * \param[in,out] tracked   List of actions marked with pe_action_tracking
+ *                          (each action marked here will be prepended)
+ * \param[in]     data_set  Cluster working set
+ */
 static void
 order_first_probe_then_restart_repromote(pe_action_t * probe,
                                          pe_action_t * after,
+                                         GList **tracked,
                                          pe_working_set_t * data_set)
 {
     GListPtr gIter = NULL;
@@ -2420,6 +2431,7 @@ order_first_probe_then_restart_repromote(pe_action_t * probe,
     }
 
     pe_set_action_bit(after, pe_action_tracking);
+    *tracked = g_list_prepend(*tracked, after);
 
     crm_trace("Processing based on %s %s -> %s %s",
               probe->uuid,
@@ -2522,21 +2534,31 @@ order_first_probe_then_restart_repromote(pe_action_t * probe,
                   after_wrapper->action->node ? after_wrapper->action->node->details->uname : "",
                   after_wrapper->type);
 
-        order_first_probe_then_restart_repromote(probe, after_wrapper->action, data_set);
+        order_first_probe_then_restart_repromote(probe, after_wrapper->action,
+                                                 tracked, data_set);
     }
 }
 
-static void clear_actions_tracking_flag(pe_working_set_t * data_set)
+/*!
+ * \internal
+ * \brief Clear pe_action_tracking from a list of actions, and free the list
+ *
+ * \param[in] tracked  List of actions marked with pe_action_tracking
+ *
+ * \note Only the actions actually visited need to be cleared, which avoids
+ *       scanning every action in the working set for every probe ordering.
+ */
+static void
+clear_actions_tracking_flag(GList *tracked)
 {
     GListPtr gIter = NULL;
 
-    for (gIter = data_set->actions; gIter != NULL; gIter = gIter->next) {
+    for (gIter = tracked; gIter != NULL; gIter = gIter->next) {
         pe_action_t *action = (pe_action_t *) gIter->data;
 
-        if (is_set(action->flags, pe_action_tracking)) {
-            pe_clear_action_bit(action, pe_action_tracking);
-        }
+        pe_clear_action_bit(action, pe_action_tracking);
     }
+    g_list_free(tracked);
 }
 
 static void
@@ -2564,8 +2586,12 @@ order_first_rsc_probes(pe_resource_t * rsc, pe_working_set_t * data_set)
         for (aIter = probe->actions_after; aIter != NULL; aIter = aIter->next) {
             pe_action_wrapper_t *after_wrapper = (pe_action_wrapper_t *) aIter->data;
 
-            order_first_probe_then_restart_repromote(probe, after_wrapper->action, data_set);
-            clear_actions_tracking_flag(data_set);
+            GList *tracked = NULL;
+
+            order_first_probe_then_restart_repromote(probe,
+                                                     after_wrapper->action,
+                                                     &tracked, data_set);
+            clear_actions_tracking_flag(tracked);
         }
     }
 
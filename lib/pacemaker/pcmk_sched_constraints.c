@@ -1798,6 +1798,84 @@ unpack_order_set(xmlNode * set, enum pe_order_kind parent_kind, resource_t ** rs
     return TRUE;
 }
 
+#define ORDER_SET_HUB "order-set"
+
+/*!
+ * \internal
+ * \brief Check whether a resource or any of its descendants can migrate
+ *
+ * \param[in] rsc  Resource to check
+ *
+ * \return TRUE if \p rsc or a descendant allows live migration
+ */
+static gboolean
+rsc_can_migrate(resource_t *rsc)
+{
+    if (is_set(rsc->flags, pe_rsc_allow_migrate)) {
+        return TRUE;
+    }
+    for (GListPtr gIter = rsc->children; gIter != NULL; gIter = gIter->next) {
+        if (rsc_can_migrate((resource_t *) gIter->data)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*!
+ * \internal
+ * \brief Check whether a resource set may be ordered via a hub pseudo action
+ *
+ * \param[in] set       Resource set XML
+ * \param[in] data_set  Cluster working set
+ *
+ * \return TRUE if \p set has more than one member and none can migrate
+ * \note Migratable members are excluded because a migration does not make
+ *       the actions ordered after it required, but a pseudo action would.
+ */
+static gboolean
+set_can_use_hub(xmlNode *set, pe_working_set_t *data_set)
+{
+    int count = 0;
+
+    for (xmlNode *xml_rsc = __xml_first_child_element(set); xml_rsc != NULL;
+         xml_rsc = __xml_next_element(xml_rsc)) {
+
+        if (crm_str_eq((const char *)xml_rsc->name, XML_TAG_RESOURCE_REF, TRUE)) {
+            resource_t *rsc = pe_find_constraint_resource(data_set->resources,
+                                                          ID(xml_rsc));
+
+            if ((rsc == NULL) || rsc_can_migrate(rsc)) {
+                return FALSE;
+            }
+            count++;
+        }
+    }
+    return (count > 1);
+}
+
+/*!
+ * \internal
+ * \brief Check whether a set-to-set ordering can be routed through a hub
+ *
+ * \param[in] flags  Ordering flags that would be used between set members
+ *
+ * \return TRUE if ordering each set against a common pseudo action is
+ *         equivalent to ordering each pair of members directly
+ * \note This holds when the only effects are that a required "first" makes
+ *       "then" required, and an unrunnable "first" makes "then" unrunnable,
+ *       since both propagate through a pseudo action unchanged. Optional
+ *       orderings would lose the pseudo action from the graph, and
+ *       pe_order_implies_first treats a pseudo "first" specially.
+ */
+static gboolean
+order_sets_via_hub(enum pe_ordering flags)
+{
+    return is_set(flags, pe_order_implies_then)
+           && ((flags & ~(pe_order_optional|pe_order_implies_then
+                          |pe_order_runnable_left)) == 0);
+}
+
 static gboolean
 order_rsc_sets(const char *id, xmlNode * set1, xmlNode * set2, enum pe_order_kind kind,
                pe_working_set_t * data_set, gboolean invert, gboolean symmetrical)
@@ -1968,6 +2046,38 @@ order_rsc_sets(const char *id, xmlNode * set1, xmlNode * set2, enum pe_order_kin
             }
         }
 
+    } else if (order_sets_via_hub(flags)
+               && set_can_use_hub(set1, data_set)
+               && set_can_use_hub(set2, data_set)) {
+        /* Rather than ordering every member of set1 before every member of
+         * set2, which grows quadratically, order all of set1 before a pseudo
+         * action, and that pseudo action before all of set2.
+         */
+        char *task = crm_strdup_printf("%s:%s:%s-%s", ORDER_SET_HUB, id,
+                                       ID(set1), ID(set2));
+        action_t *hub = get_pseudo_op(task, data_set);
+
+        free(task);
+        for (xml_rsc = __xml_first_child_element(set1); xml_rsc != NULL;
+             xml_rsc = __xml_next_element(xml_rsc)) {
+
+            if (crm_str_eq((const char *)xml_rsc->name, XML_TAG_RESOURCE_REF, TRUE)) {
+                EXPAND_CONSTRAINT_IDREF(id, rsc_1, ID(xml_rsc));
+                custom_action_order(rsc_1, generate_op_key(rsc_1->id, action_1, 0), NULL,
+                                    NULL, NULL, hub, flags, data_set);
+            }
+        }
+        for (xml_rsc_2 = __xml_first_child_element(set2); xml_rsc_2 != NULL;
+             xml_rsc_2 = __xml_next_element(xml_rsc_2)) {
+
+            if (crm_str_eq((const char *)xml_rsc_2->name, XML_TAG_RESOURCE_REF, TRUE)) {
+                EXPAND_CONSTRAINT_IDREF(id, rsc_2, ID(xml_rsc_2));
+                custom_action_order(NULL, NULL, hub,
+                                    rsc_2, generate_op_key(rsc_2->id, action_2, 0), NULL,
+                                    flags, data_set);
+            }
+        }
+
     } else {
         for (xml_rsc = __xml_first_child_element(set1); xml_rsc != NULL;
              xml_rsc = __xml_next_element(xml_rsc)) {
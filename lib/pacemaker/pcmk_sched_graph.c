@@ -990,8 +990,22 @@ add_downed_nodes(xmlNode *xml, const action_t *action,
     }
 }
 
+/*!
+ * \internal
+ * \brief Add an action's XML to the transition graph
+ *
+ * \param[in] action    Action to add
+ * \param[in] as_input  Whether action is only being listed as an input
+ * \param[in] parent    Graph XML element to add action XML to
+ * \param[in] data_set  Cluster working set
+ *
+ * \return Newly created action XML (child of \p parent)
+ * \note The action XML is created in place, rather than as a separate
+ *       document that must then be copied into the (potentially huge) graph.
+ */
 static xmlNode *
-action2xml(action_t * action, gboolean as_input, pe_working_set_t *data_set)
+action2xml(action_t * action, gboolean as_input, xmlNode *parent,
+           pe_working_set_t *data_set)
 {
     gboolean needs_node_info = TRUE;
     gboolean needs_maintenance_info = FALSE;
@@ -1007,19 +1021,19 @@ action2xml(action_t * action, gboolean as_input, pe_working_set_t *data_set)
 
     if (safe_str_eq(action->task, CRM_OP_FENCE)) {
         /* All fences need node info; guest node fences are pseudo-events */
-        action_xml = create_xml_node(NULL,
+        action_xml = create_xml_node(parent,
                                      is_set(action->flags, pe_action_pseudo)?
                                      XML_GRAPH_TAG_PSEUDO_EVENT :
                                      XML_GRAPH_TAG_CRM_EVENT);
 
     } else if (safe_str_eq(action->task, CRM_OP_SHUTDOWN)) {
-        action_xml = create_xml_node(NULL, XML_GRAPH_TAG_CRM_EVENT);
+        action_xml = create_xml_node(parent, XML_GRAPH_TAG_CRM_EVENT);
 
     } else if (safe_str_eq(action->task, CRM_OP_CLEAR_FAILCOUNT)) {
-        action_xml = create_xml_node(NULL, XML_GRAPH_TAG_CRM_EVENT);
+        action_xml = create_xml_node(parent, XML_GRAPH_TAG_CRM_EVENT);
 
     } else if (safe_str_eq(action->task, CRM_OP_LRM_REFRESH)) {
-        action_xml = create_xml_node(NULL, XML_GRAPH_TAG_CRM_EVENT);
+        action_xml = create_xml_node(parent, XML_GRAPH_TAG_CRM_EVENT);
 
 /* 	} else if(safe_str_eq(action->task, RSC_PROBED)) { */
 /* 		action_xml = create_xml_node(NULL, XML_GRAPH_TAG_CRM_EVENT); */
@@ -1028,11 +1042,11 @@ action2xml(action_t * action, gboolean as_input, pe_working_set_t *data_set)
         if (safe_str_eq(action->task, CRM_OP_MAINTENANCE_NODES)) {
             needs_maintenance_info = TRUE;
         }
-        action_xml = create_xml_node(NULL, XML_GRAPH_TAG_PSEUDO_EVENT);
+        action_xml = create_xml_node(parent, XML_GRAPH_TAG_PSEUDO_EVENT);
         needs_node_info = FALSE;
 
     } else {
-        action_xml = create_xml_node(NULL, XML_GRAPH_TAG_RSC_OP);
+        action_xml = create_xml_node(parent, XML_GRAPH_TAG_RSC_OP);
 #if ENABLE_VERSIONED_ATTRS
         rsc_details = pe_rsc_action_details(action);
 #endif
@@ -1702,7 +1716,6 @@ graph_element_from_action(action_t * action, pe_working_set_t * data_set)
     xmlNode *set = NULL;
     xmlNode *in = NULL;
     xmlNode *input = NULL;
-    xmlNode *xml_action = NULL;
 
     if (should_dump_action(action) == FALSE) {
         return;
@@ -1727,8 +1740,7 @@ graph_element_from_action(action_t * action, pe_working_set_t * data_set)
         crm_xml_add_int(syn, XML_CIB_ATTR_PRIORITY, synapse_priority);
     }
 
-    xml_action = action2xml(action, FALSE, data_set);
-    add_node_nocopy(set, crm_element_name(xml_action), xml_action);
+    action2xml(action, FALSE, set, data_set);
 
     action->actions_before = g_list_sort(action->actions_before, sort_action_id);
 
@@ -1744,8 +1756,6 @@ graph_element_from_action(action_t * action, pe_working_set_t * data_set)
             );
         last_action = wrapper->action->id;
         input = create_xml_node(in, "trigger");
-
-        xml_action = action2xml(wrapper->action, TRUE, data_set);
-        add_node_nocopy(input, crm_element_name(xml_action), xml_action);
+        action2xml(wrapper->action, TRUE, input, data_set);
     }
 }
@@ -23,6 +23,7 @@
 #include <crm/cib.h>
 #include <crm/common/util.h>
 #include <crm/common/iso8601.h>
+#include <crm/common/xml_internal.h>
 #include <crm/pengine/status.h>
 #include <pacemaker-internal.h>
 
@@ -44,7 +45,7 @@ gboolean bringing_nodes_online = FALSE;
 
 #define NEW_NODE_TEMPLATE "//"XML_CIB_TAG_NODE"[@uname='%s']"
 #define NODE_TEMPLATE "//"XML_CIB_TAG_STATE"[@uname='%s']"
-#define RSC_TEMPLATE "//"XML_CIB_TAG_STATE"[@uname='%s']//"XML_LRM_TAG_RESOURCE"[@id='%s']"
+#define RSC_XPATH "//"XML_CIB_TAG_STATE"[@uname=$node]//"XML_LRM_TAG_RESOURCE"[@id=$rsc]"
 
 
 static void
@@ -243,10 +244,14 @@ find_resource_xml(xmlNode * cib_node, const char *resource)
 {
     xmlNode *match = NULL;
     const char *node = crm_element_value(cib_node, XML_ATTR_UNAME);
-    char *xpath = crm_strdup_printf(RSC_TEMPLATE, node, resource);
+    xmlXPathObjectPtr xpathObj = NULL;
 
-    match = get_xpath_object(xpath, cib_node, LOG_TRACE);
-    free(xpath);
+    xpathObj = pcmk__xpath_search_with(cib_node, RSC_XPATH,
+                                       "node", node, "rsc", resource, NULL);
+    if (numXpathResults(xpathObj) == 1) {
+        match = getXpathResult(xpathObj, 0);
+    }
+    freeXpathObject(xpathObj);
     return match;
 }
 
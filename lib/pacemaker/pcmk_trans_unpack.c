@@ -15,12 +15,13 @@
 #include <crm/crm.h>
 #include <crm/msg_xml.h>
 #include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
 #include <pacemaker-internal.h>
 
 CRM_TRACE_INIT_DATA(transitioner);
 
 static crm_action_t *
-unpack_action(synapse_t * parent, xmlNode * xml_action)
+unpack_action(synapse_t * parent, xmlNode * xml_action, bool consume)
 {
     crm_action_t *action = NULL;
     const char *value = crm_element_value(xml_action, XML_ATTR_ID);
@@ -40,7 +41,13 @@ unpack_action(synapse_t * parent, xmlNode * xml_action)
 
     action->id = crm_parse_int(value, NULL);
     action->type = action_type_rsc;
-    action->xml = copy_xml(xml_action);
+    if (consume) {
+        // Take the action out of the graph rather than copying it
+        pcmk__xml_move(NULL, xml_action);
+        action->xml = xml_action;
+    } else {
+        action->xml = copy_xml(xml_action);
+    }
     action->synapse = parent;
 
     if (safe_str_eq(crm_element_name(action->xml), XML_GRAPH_TAG_RSC_OP)) {
@@ -82,7 +89,7 @@ unpack_action(synapse_t * parent, xmlNode * xml_action)
 }
 
 static synapse_t *
-unpack_synapse(crm_graph_t * new_graph, xmlNode * xml_synapse)
+unpack_synapse(crm_graph_t * new_graph, xmlNode * xml_synapse, bool consume)
 {
     const char *value = NULL;
     xmlNode *inputs = NULL;
@@ -111,10 +118,14 @@ unpack_synapse(crm_graph_t * new_graph, xmlNode * xml_synapse)
          action_set = __xml_next(action_set)) {
         if (crm_str_eq((const char *)action_set->name, "action_set", TRUE)) {
             xmlNode *action = NULL;
+            xmlNode *next = NULL;
 
             for (action = __xml_first_child(action_set); action != NULL;
-                 action = __xml_next(action)) {
-                crm_action_t *new_action = unpack_action(new_synapse, action);
+                 action = next) {
+                crm_action_t *new_action = NULL;
+
+                next = __xml_next(action);
+                new_action = unpack_action(new_synapse, action, consume);
 
                 if (new_action == NULL) {
                     continue;
@@ -138,9 +149,14 @@ unpack_synapse(crm_graph_t * new_graph, xmlNode * xml_synapse)
             for (trigger = __xml_first_child(inputs); trigger != NULL;
                  trigger = __xml_next(trigger)) {
                 xmlNode *input = NULL;
+                xmlNode *next = NULL;
 
-                for (input = __xml_first_child(trigger); input != NULL; input = __xml_next(input)) {
-                    crm_action_t *new_input = unpack_action(new_synapse, input);
+                for (input = __xml_first_child(trigger); input != NULL;
+                     input = next) {
+                    crm_action_t *new_input = NULL;
+
+                    next = __xml_next(input);
+                    new_input = unpack_action(new_synapse, input, consume);
 
                     if (new_input == NULL) {
                         continue;
@@ -159,8 +175,8 @@ unpack_synapse(crm_graph_t * new_graph, xmlNode * xml_synapse)
 
 static void destroy_action(crm_action_t * action);
 
-crm_graph_t *
-unpack_graph(xmlNode * xml_graph, const char *reference)
+static crm_graph_t *
+unpack_graph_xml(xmlNode *xml_graph, const char *reference, bool consume)
 {
 /*
   <transition_graph>
@@ -176,6 +192,7 @@ unpack_graph(xmlNode * xml_graph, const char *reference)
     const char *t_id = NULL;
     const char *time = NULL;
     xmlNode *synapse = NULL;
+    xmlNode *next = NULL;
 
     new_graph = calloc(1, sizeof(crm_graph_t));
 
@@ -217,13 +234,20 @@ unpack_graph(xmlNode * xml_graph, const char *reference)
         new_graph->migration_limit = crm_parse_int(t_id, "-1");
     }
 
-    for (synapse = __xml_first_child(xml_graph); synapse != NULL; synapse = __xml_next(synapse)) {
+    for (synapse = __xml_first_child(xml_graph); synapse != NULL;
+         synapse = next) {
+        next = __xml_next(synapse);
         if (crm_str_eq((const char *)synapse->name, "synapse", TRUE)) {
-            synapse_t *new_synapse = unpack_synapse(new_graph, synapse);
+            synapse_t *new_synapse = unpack_synapse(new_graph, synapse,
+                                                    consume);
 
             if (new_synapse != NULL) {
                 new_graph->synapses = g_list_append(new_graph->synapses, new_synapse);
             }
+            if (consume) {
+                // Free what is left as we go, so the graph is never held twice
+                free_xml(synapse);
+            }
         }
     }
 
@@ -233,6 +257,33 @@ unpack_graph(xmlNode * xml_graph, const char *reference)
     return new_graph;
 }
 
+crm_graph_t *
+unpack_graph(xmlNode * xml_graph, const char *reference)
+{
+    return unpack_graph_xml(xml_graph, reference, FALSE);
+}
+
+/*!
+ * \internal
+ * \brief Unpack a transition graph, taking its XML rather than copying it
+ *
+ * This is like unpack_graph(), except that each action's XML is moved out of
+ * \p xml_graph (rather than copied), and each synapse is freed once unpacked,
+ * so a large graph is never held twice.
+ *
+ * \param[in,out] xml_graph  Transition graph XML (only the top-level element
+ *                           and its attributes will be left)
+ * \param[in]     reference  Where the graph came from (for logging)
+ *
+ * \return Newly allocated transition graph (or NULL if \p xml_graph is
+ *         invalid)
+ */
+crm_graph_t *
+pcmk__consume_graph(xmlNode *xml_graph, const char *reference)
+{
+    return unpack_graph_xml(xml_graph, reference, TRUE);
+}
+
 static void
 destroy_action(crm_action_t * action)
 {
@@ -144,6 +144,13 @@ static pe_cluster_option pe_opts[] = {
 	    "The number of other scheduler inputs to save",
         "Zero to disable, -1 to store unlimited"
     },
+	{
+        "pe-series-snapshot-interval", NULL, "integer", NULL, "0", &check_number,
+	    "How often to save a full copy of a scheduler input",
+        "Saved scheduler inputs in between full copies are stored as changes"
+        " relative to the previous input of the same series. Values less than"
+        " 2 disable this and always save full copies."
+    },
 
 	/* Node health */
 	{ "node-health-strategy", NULL, "enum", "none, migrate-on-red, only-green, progressive, custom", "none", &check_health,
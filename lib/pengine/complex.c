@@ -223,7 +223,7 @@ unpack_template(xmlNode * xml_obj, xmlNode ** expanded_xml, pe_working_set_t * d
         return FALSE;
     }
 
-    cib_resources = get_xpath_object("//"XML_CIB_TAG_RESOURCES, data_set->input, LOG_TRACE);
+    cib_resources = pe__cib_section(data_set->input, XML_CIB_TAG_RESOURCES);
     if (cib_resources == NULL) {
         pe_err("No resources configured");
         return FALSE;
@@ -15,6 +15,7 @@
 #include <crm/msg_xml.h>
 #include <crm/common/xml.h>
 #include <crm/common/util.h>
+#include <crm/common/xml_internal.h>
 #include <crm/pengine/internal.h>
 
 static gboolean
@@ -92,14 +93,11 @@ block_failure(node_t *node, resource_t *rsc, xmlNode *xml_op,
      * Ideally, we'd unpack the operation before this point, and pass in a
      * meta-attributes table that takes all that into consideration.
      */
-    char *xpath = crm_strdup_printf("//primitive[@id='%s']//op[@on-fail='block']",
-                                    xml_name);
-
-    xmlXPathObject *xpathObj = xpath_search(rsc->xml, xpath);
+    xmlXPathObject *xpathObj = pcmk__xpath_search_with(rsc->xml,
+                                   "//primitive[@id=$rsc]//op[@on-fail='block']",
+                                   "rsc", xml_name, NULL);
     gboolean should_block = FALSE;
 
-    free(xpath);
-
     if (xpathObj) {
         int max = numXpathResults(xpathObj);
         int lpc = 0;
@@ -117,7 +115,7 @@ block_failure(node_t *node, resource_t *rsc, xmlNode *xml_op,
                 const char *conf_op_name = NULL;
                 const char *conf_op_interval_spec = NULL;
                 guint conf_op_interval_ms = 0;
-                char *lrm_op_xpath = NULL;
+                char interval_s[32];
                 xmlXPathObject *lrm_op_xpathObj = NULL;
 
                 // Get name and interval from configured op
@@ -125,14 +123,15 @@ block_failure(node_t *node, resource_t *rsc, xmlNode *xml_op,
                 conf_op_interval_spec = crm_element_value(pref, XML_LRM_ATTR_INTERVAL);
                 conf_op_interval_ms = crm_parse_interval_spec(conf_op_interval_spec);
 
-                lrm_op_xpath = crm_strdup_printf("//node_state[@uname='%s']"
-                                               "//lrm_resource[@id='%s']"
-                                               "/lrm_rsc_op[@operation='%s'][@interval='%u']",
-                                               node->details->uname, xml_name,
-                                               conf_op_name, conf_op_interval_ms);
-                lrm_op_xpathObj = xpath_search(data_set->input, lrm_op_xpath);
-
-                free(lrm_op_xpath);
+                snprintf(interval_s, sizeof(interval_s), "%u",
+                         conf_op_interval_ms);
+                lrm_op_xpathObj = pcmk__xpath_search_with(data_set->input,
+                                      "//node_state[@uname=$node]"
+                                      "//lrm_resource[@id=$rsc]"
+                                      "/lrm_rsc_op[@operation=$op][@interval=$interval]",
+                                      "node", node->details->uname,
+                                      "rsc", xml_name, "op", conf_op_name,
+                                      "interval", interval_s, NULL);
 
                 if (lrm_op_xpathObj) {
                     int max2 = numXpathResults(lrm_op_xpathObj);
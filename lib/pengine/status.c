@@ -53,6 +53,46 @@ pe_free_working_set(pe_working_set_t *data_set)
     }
 }
 
+/*!
+ * \internal
+ * \brief Find a top-level section of a CIB without searching all of it
+ *
+ * The status section is typically much larger than the configuration, so
+ * rather than using a "//" XPath search (which traverses every node_state and
+ * its resource history), walk directly from the CIB root when possible.
+ *
+ * \param[in] cib   CIB XML to search
+ * \param[in] name  Element name of section (status, configuration, or an
+ *                  immediate child of configuration)
+ *
+ * \return Section of \p cib with \p name, or NULL if not found
+ */
+xmlNode *
+pe__cib_section(xmlNode *cib, const char *name)
+{
+    xmlNode *parent = cib;
+
+    CRM_CHECK(name != NULL, return NULL);
+    if (cib == NULL) {
+        return NULL;
+    }
+
+    if (!crm_str_eq(crm_element_name(cib), XML_TAG_CIB, TRUE)) {
+        // Not a complete CIB, so its layout is unknown
+        char *xpath = crm_strdup_printf("//%s", name);
+        xmlNode *section = get_xpath_object(xpath, cib, LOG_TRACE);
+
+        free(xpath);
+        return section;
+    }
+
+    if (strcmp(name, XML_CIB_TAG_STATUS)
+        && strcmp(name, XML_CIB_TAG_CONFIGURATION)) {
+        parent = first_named_child(cib, XML_CIB_TAG_CONFIGURATION);
+    }
+    return first_named_child(parent, name);
+}
+
 /*
  * Unpack everything
  * At the end you'll have:
@@ -67,11 +107,11 @@ pe_free_working_set(pe_working_set_t *data_set)
 gboolean
 cluster_status(pe_working_set_t * data_set)
 {
-    xmlNode *config = get_xpath_object("//"XML_CIB_TAG_CRMCONFIG, data_set->input, LOG_TRACE);
-    xmlNode *cib_nodes = get_xpath_object("//"XML_CIB_TAG_NODES, data_set->input, LOG_TRACE);
-    xmlNode *cib_resources = get_xpath_object("//"XML_CIB_TAG_RESOURCES, data_set->input, LOG_TRACE);
-    xmlNode *cib_status = get_xpath_object("//"XML_CIB_TAG_STATUS, data_set->input, LOG_TRACE);
-    xmlNode *cib_tags = get_xpath_object("//"XML_CIB_TAG_TAGS, data_set->input, LOG_TRACE);
+    xmlNode *config = pe__cib_section(data_set->input, XML_CIB_TAG_CRMCONFIG);
+    xmlNode *cib_nodes = pe__cib_section(data_set->input, XML_CIB_TAG_NODES);
+    xmlNode *cib_resources = pe__cib_section(data_set->input, XML_CIB_TAG_RESOURCES);
+    xmlNode *cib_status = pe__cib_section(data_set->input, XML_CIB_TAG_STATUS);
+    xmlNode *cib_tags = pe__cib_section(data_set->input, XML_CIB_TAG_TAGS);
     const char *value = crm_element_value(data_set->input, XML_ATTR_HAVE_QUORUM);
 
     crm_trace("Beginning unpack");
@@ -97,8 +137,8 @@ cluster_status(pe_working_set_t * data_set)
         set_bit(data_set->flags, pe_flag_have_quorum);
     }
 
-    data_set->op_defaults = get_xpath_object("//"XML_CIB_TAG_OPCONFIG, data_set->input, LOG_TRACE);
-    data_set->rsc_defaults = get_xpath_object("//"XML_CIB_TAG_RSCCONFIG, data_set->input, LOG_TRACE);
+    data_set->op_defaults = pe__cib_section(data_set->input, XML_CIB_TAG_OPCONFIG);
+    data_set->rsc_defaults = pe__cib_section(data_set->input, XML_CIB_TAG_RSCCONFIG);
 
     unpack_config(config, data_set);
 
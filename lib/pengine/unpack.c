@@ -17,6 +17,7 @@
 #include <crm/common/xml.h>
 
 #include <crm/common/util.h>
+#include <crm/common/xml_internal.h>
 #include <crm/pengine/rules.h>
 #include <crm/pengine/internal.h>
 #include <unpack.h>
@@ -2371,39 +2372,36 @@ set_node_score(gpointer key, gpointer value, gpointer user_data)
     node->weight = *score;
 }
 
-#define STATUS_PATH_MAX 1024
+#define XPATH_LRM_OP "//" XML_CIB_TAG_STATE "[@" XML_ATTR_UNAME "=$node]"   \
+                     "//" XML_LRM_TAG_RESOURCE "[@" XML_ATTR_ID "=$rsc]"     \
+                     "/" XML_LRM_TAG_RSC_OP "[@" XML_LRM_ATTR_TASK "=$op]"
+
 static xmlNode *
 find_lrm_op(const char *resource, const char *op, const char *node, const char *source,
             bool success_only, pe_working_set_t *data_set)
 {
-    int offset = 0;
-    char xpath[STATUS_PATH_MAX];
+    const char *xpath = XPATH_LRM_OP;
+    xmlXPathObjectPtr xpathObj = NULL;
     xmlNode *xml = NULL;
 
-    offset += snprintf(xpath + offset, STATUS_PATH_MAX - offset, "//node_state[@uname='%s']", node);
-    offset +=
-        snprintf(xpath + offset, STATUS_PATH_MAX - offset, "//" XML_LRM_TAG_RESOURCE "[@id='%s']",
-                 resource);
-
     /* Need to check against transition_magic too? */
     if (source && safe_str_eq(op, CRMD_ACTION_MIGRATE)) {
-        offset +=
-            snprintf(xpath + offset, STATUS_PATH_MAX - offset,
-                     "/" XML_LRM_TAG_RSC_OP "[@operation='%s' and @migrate_target='%s']", op,
-                     source);
+        xpath = XPATH_LRM_OP "[@" XML_LRM_ATTR_MIGRATE_TARGET "=$source]";
     } else if (source && safe_str_eq(op, CRMD_ACTION_MIGRATED)) {
-        offset +=
-            snprintf(xpath + offset, STATUS_PATH_MAX - offset,
-                     "/" XML_LRM_TAG_RSC_OP "[@operation='%s' and @migrate_source='%s']", op,
-                     source);
-    } else {
-        offset +=
-            snprintf(xpath + offset, STATUS_PATH_MAX - offset,
-                     "/" XML_LRM_TAG_RSC_OP "[@operation='%s']", op);
+        xpath = XPATH_LRM_OP "[@" XML_LRM_ATTR_MIGRATE_SOURCE "=$source]";
     }
 
-    CRM_LOG_ASSERT(offset > 0);
-    xml = get_xpath_object(xpath, data_set->input, LOG_DEBUG);
+    // One fixed expression per case, so each is compiled only once
+    xpathObj = pcmk__xpath_search_with(data_set->input, xpath,
+                                       "node", node, "rsc", resource,
+                                       "op", op, "source", source, NULL);
+    if (numXpathResults(xpathObj) == 1) {
+        xml = getXpathResult(xpathObj, 0);
+    } else {
+        crm_debug("Found %d %s history entries for %s on %s (expected 1)",
+                  numXpathResults(xpathObj), op, resource, node);
+    }
+    freeXpathObject(xpathObj);
 
     if (xml && success_only) {
         int rc = PCMK_OCF_UNKNOWN_ERROR;
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU General Public License version 2
+ * or later (GPLv2+) WITHOUT ANY WARRANTY.
+ */
+
+/* Compare the compression codecs available for IPC messages
+ *
+ * Usage: compressbench [-n ITERATIONS] FILE...
+ *
+ * Each file is parsed as XML and serialized the way an IPC message would be,
+ * then compressed and decompressed with each codec supported by this build.
+ * The CIBs used by the scheduler regression tests make a convenient corpus:
+ *
+ *   maint/compressbench cts/scheduler/*.xml
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <crm/crm.h>
+#include <crm/common/xml.h>
+
+static const enum pcmk__codec codecs[] = {
+    pcmk__codec_bzip2,
+    pcmk__codec_lz4,
+    pcmk__codec_zstd,
+};
+
+struct totals {
+    double in_bytes;
+    double out_bytes;
+    double compress_s;
+    double decompress_s;
+};
+
+static double
+elapsed(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void
+print_row(const char *name, const char *codec, const struct totals *t)
+{
+    printf("%-40.40s %-6s %10.0f %7.2f %10.1f %10.1f\n", name, codec,
+           t->in_bytes, t->in_bytes / t->out_bytes,
+           t->in_bytes / t->compress_s / 1e6,
+           t->in_bytes / t->decompress_s / 1e6);
+}
+
+/* Benchmark one codec on one buffer, adding the results to *t.
+ * Return FALSE if the codec failed.
+ */
+static bool
+bench_codec(enum pcmk__codec codec, const char *data, unsigned int len,
+            int iterations, struct totals *t)
+{
+    char *compressed = NULL;
+    char *decompressed = malloc(len);
+    unsigned int compressed_len = 0;
+    unsigned int decompressed_len = 0;
+    struct timespec start;
+
+    CRM_ASSERT(decompressed != NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int lpc = 0; lpc < iterations; lpc++) {
+        free(compressed);
+        if (pcmk__compress(codec, data, len, 0, &compressed,
+                           &compressed_len) != pcmk_ok) {
+            free(decompressed);
+            return FALSE;
+        }
+    }
+    t->compress_s += elapsed(&start) / iterations;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int lpc = 0; lpc < iterations; lpc++) {
+        decompressed_len = len;
+        if (pcmk__decompress(codec, compressed, compressed_len, decompressed,
+                             &decompressed_len) != pcmk_ok) {
+            break;
+        }
+    }
+    t->decompress_s += elapsed(&start) / iterations;
+
+    if ((decompressed_len != len) || memcmp(data, decompressed, len)) {
+        fprintf(stderr, "%s round trip failed\n", pcmk__codec_text(codec));
+        free(compressed);
+        free(decompressed);
+        return FALSE;
+    }
+
+    t->in_bytes += len;
+    t->out_bytes += compressed_len;
+    free(compressed);
+    free(decompressed);
+    return TRUE;
+}
+
+int
+main(int argc, char **argv)
+{
+    int iterations = 10;
+    int flag = 0;
+    struct totals totals[DIMOF(codecs)];
+
+    memset(totals, 0, sizeof(totals));
+
+    while ((flag = getopt(argc, argv, "n:")) != -1) {
+        if (flag == 'n') {
+            iterations = crm_parse_int(optarg, "10");
+        } else {
+            fprintf(stderr, "Usage: %s [-n ITERATIONS] FILE...\n", argv[0]);
+            return CRM_EX_USAGE;
+        }
+    }
+    if ((optind >= argc) || (iterations <= 0)) {
+        fprintf(stderr, "Usage: %s [-n ITERATIONS] FILE...\n", argv[0]);
+        return CRM_EX_USAGE;
+    }
+
+    printf("%-40s %-6s %10s %7s %10s %10s\n", "FILE", "CODEC", "BYTES",
+           "RATIO", "COMP MB/s", "DECOMP MB/s");
+
+    for (int arg = optind; arg < argc; arg++) {
+        xmlNode *xml = filename2xml(argv[arg]);
+        char *text = NULL;
+
+        if (xml == NULL) {
+            fprintf(stderr, "Could not parse %s\n", argv[arg]);
+            continue;
+        }
+        text = dump_xml_unformatted(xml);
+        free_xml(xml);
+
+        for (int lpc = 0; lpc < DIMOF(codecs); lpc++) {
+            struct totals t = { 0, };
+
+            if (pcmk__codec_supported(codecs[lpc])
+                && bench_codec(codecs[lpc], text, strlen(text) + 1,
+                               iterations, &t)) {
+                print_row(argv[arg], pcmk__codec_text(codecs[lpc]), &t);
+                totals[lpc].in_bytes += t.in_bytes;
+                totals[lpc].out_bytes += t.out_bytes;
+                totals[lpc].compress_s += t.compress_s;
+                totals[lpc].decompress_s += t.decompress_s;
+            }
+        }
+        free(text);
+    }
+
+    for (int lpc = 0; lpc < DIMOF(codecs); lpc++) {
+        if (totals[lpc].in_bytes > 0) {
+            print_row("TOTAL", pcmk__codec_text(codecs[lpc]), &totals[lpc]);
+        }
+    }
+    crm_xml_cleanup();
+    return CRM_EX_OK;
+}
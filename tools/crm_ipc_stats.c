@@ -0,0 +1,256 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU General Public License version 2
+ * or later (GPLv2+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/cib/internal.h>
+#include <crm/common/ipc.h>
+#include <crm/common/ipc_internal.h>
+
+/* IPC servers of the local daemons (one per daemon, since every server of a
+ * daemon reports all of its clients)
+ */
+static const char *servers[] = {
+    CRM_SYSTEM_MCP,
+    CIB_CHANNEL_RO,
+    CRM_SYSTEM_CRMD,
+    CRM_SYSTEM_LRMD,
+    T_ATTRD,
+    "stonith-ng",
+    CRM_SYSTEM_PENGINE,
+};
+
+static const char *latency_names[] = {
+    "latency-lt-1ms", "latency-lt-10ms", "latency-lt-100ms",
+    "latency-lt-1s", "latency-ge-1s",
+};
+
+static gboolean as_xml = FALSE;
+static int timeout_ms = 5000;
+
+/* *INDENT-OFF* */
+static struct crm_option long_options[] = {
+    /* Top-level Options */
+    {"help",       no_argument,       NULL, '?', "\tThis text"},
+    {"version",    no_argument,       NULL, '$', "\tVersion information"  },
+    {"verbose",    no_argument,       NULL, 'V', "\tIncrease debug output"},
+
+    {"-spacer-",   required_argument, NULL, '-', "\nAdditional options:" },
+    {"server",     required_argument, NULL, 's',
+     "\tQuery only this IPC server (for example, cib_ro or crmd)"},
+    {"timeout",    required_argument, NULL, 't',
+     "\tHow long to wait for each daemon to answer (default 5s)"},
+    {"xml",        no_argument,       NULL, 'X', "\tShow statistics as XML"},
+
+    {"-spacer-",   required_argument, NULL, '-', "\nColumns:", pcmk_option_paragraph},
+    {"-spacer-",   required_argument, NULL, '-',
+     "REQ and RESP count requests received from and responses sent to the "
+     "client, EVENTS counts events sent, and IN and OUT are the bytes "
+     "involved. RATIO is how much compression shrank what was sent. QUEUE "
+     "is the current and largest event queue length, BLOCKED counts "
+     "attempts to send events that found the client's buffer full, and "
+     "LATENCY is the average and longest time in milliseconds that events "
+     "spent queued. The last five columns count events sent after spending "
+     "less than 1ms, 10ms, 100ms, and 1s queued, and longer.",
+     pcmk_option_paragraph},
+
+    {0, 0, 0, 0}
+};
+/* *INDENT-ON* */
+
+static unsigned long long
+stat_value(xmlNode *xml, const char *name)
+{
+    const char *value = crm_element_value(xml, name);
+
+    return value? strtoull(value, NULL, 10) : 0;
+}
+
+static void
+print_stats(const char *server, xmlNode *reply)
+{
+    int pid = 0;
+
+    crm_element_value_int(reply, "pid", &pid);
+    printf("%s (pid %d, queried via %s)\n",
+           crm_str(crm_element_value(reply, "daemon")), pid, server);
+    printf("  %-20s %7s %8s %8s %8s %10s %10s %5s %11s %7s %11s"
+           " %6s %6s %6s %6s %6s\n",
+           "CLIENT", "PID", "REQ", "RESP", "EVENTS", "IN", "OUT", "RATIO",
+           "QUEUE", "BLOCKED", "LATENCY", "<1ms", "<10ms", "<100ms", "<1s",
+           ">=1s");
+
+    for (xmlNode *client = __xml_first_child(reply); client != NULL;
+         client = __xml_next(client)) {
+        unsigned long long sent = stat_value(client, "events-sent");
+        unsigned long long out = stat_value(client, "bytes-out");
+        char *queue = crm_strdup_printf("%llu/%llu",
+                                        stat_value(client, "queue-depth"),
+                                        stat_value(client, "max-queue-depth"));
+        char *latency = crm_strdup_printf("%llu/%llu",
+                                          sent? (stat_value(client, "total-latency-ms") / sent) : 0,
+                                          stat_value(client, "max-latency-ms"));
+
+        printf("  %-20.20s %7s %8llu %8llu %8llu %10llu %10llu %5.2f %11s"
+               " %7llu %11s",
+               crm_str(crm_element_value(client, "name")),
+               crm_str(crm_element_value(client, "pid")),
+               stat_value(client, "requests"), stat_value(client, "responses"),
+               sent, stat_value(client, "bytes-in"), out,
+               out? ((double) stat_value(client, "raw-bytes-out") / out) : 1.0,
+               queue, stat_value(client, "send-blocked"), latency);
+        for (int lpc = 0; lpc < DIMOF(latency_names); lpc++) {
+            printf(" %6llu", stat_value(client, latency_names[lpc]));
+        }
+        printf("\n");
+        free(queue);
+        free(latency);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Ask one IPC server for its clients' statistics and show them
+ *
+ * \param[in] server  Name of IPC server to query
+ * \param[in] quiet   Whether to skip mentioning a server that isn't running
+ *
+ * \return pcmk_ok on success, otherwise -errno
+ */
+static int
+query_server(const char *server, bool quiet)
+{
+    crm_ipc_t *ipc = crm_ipc_new(server, 0);
+    xmlNode *request = create_xml_node(NULL, PCMK__XE_IPC_STATS);
+    xmlNode *reply = NULL;
+    int rc = pcmk_ok;
+
+    if ((ipc == NULL) || !crm_ipc_connect(ipc)) {
+        if (!quiet) {
+            fprintf(stderr, "Could not connect to %s\n", server);
+        }
+        rc = -ENOTCONN;
+        goto done;
+    }
+
+    rc = crm_ipc_send(ipc, request, crm_ipc_client_response, timeout_ms,
+                      &reply);
+    if ((rc <= 0) || (reply == NULL)) {
+        fprintf(stderr, "No statistics from %s: %s\n", server,
+                pcmk_strerror((rc < 0)? rc : -ENOMSG));
+        rc = (rc < 0)? rc : -ENOMSG;
+
+    } else if (!crm_str_eq(crm_element_name(reply), PCMK__XE_IPC_STATS, TRUE)) {
+        // Servers that predate the request treat it as an unknown operation
+        fprintf(stderr, "%s does not support IPC statistics\n", server);
+        rc = -EPROTONOSUPPORT;
+
+    } else if (crm_element_value_int(reply, PCMK__XA_IPC_STATS_RC, &rc) == 0) {
+        fprintf(stderr, "No statistics from %s: %s\n", server,
+                pcmk_strerror(rc));
+
+    } else {
+        rc = pcmk_ok;
+        if (as_xml) {
+            char *text = dump_xml_formatted(reply);
+
+            printf("%s", text);
+            free(text);
+        } else {
+            print_stats(server, reply);
+        }
+    }
+
+  done:
+    if (ipc != NULL) {
+        crm_ipc_close(ipc);
+        crm_ipc_destroy(ipc);
+    }
+    free_xml(request);
+    free_xml(reply);
+    return rc;
+}
+
+int
+main(int argc, char **argv)
+{
+    int flag = 0;
+    int option_index = 0;
+    const char *server = NULL;
+    int found = 0;
+    int rc = pcmk_ok;
+
+    crm_log_cli_init("crm_ipc_stats");
+    crm_set_options(NULL, "[options]", long_options,
+                    "Show IPC traffic statistics for each client of the "
+                    "local Pacemaker daemons (which must be run as root "
+                    "or as the cluster user)");
+
+    while (flag >= 0) {
+        flag = crm_get_option(argc, argv, &option_index);
+        switch (flag) {
+            case -1:
+                break;
+
+            case 'V':
+                crm_bump_log_level(argc, argv);
+                break;
+
+            case '$':
+            case '?':
+                crm_help(flag, CRM_EX_OK);
+                break;
+
+            case 's':
+                server = optarg;
+                break;
+
+            case 't':
+                timeout_ms = crm_get_msec(optarg);
+                if (timeout_ms <= 0) {
+                    fprintf(stderr, "Invalid timeout: %s\n", optarg);
+                    crm_exit(CRM_EX_USAGE);
+                }
+                break;
+
+            case 'X':
+                as_xml = TRUE;
+                break;
+
+            default:
+                crm_help(flag, CRM_EX_USAGE);
+                break;
+        }
+    }
+
+    if (optind < argc) {
+        crm_help('?', CRM_EX_USAGE);
+    }
+
+    if (server != NULL) {
+        rc = query_server(server, FALSE);
+        crm_exit(crm_errno2exit(rc));
+    }
+
+    for (int lpc = 0; lpc < DIMOF(servers); lpc++) {
+        if (query_server(servers[lpc], TRUE) == pcmk_ok) {
+            found++;
+        }
+    }
+    if (found == 0) {
+        fprintf(stderr, "Could not get statistics from any local daemon\n");
+        crm_exit(CRM_EX_UNAVAILABLE);
+    }
+    crm_exit(CRM_EX_OK);
+}
@@ -404,7 +404,7 @@ setup_input(const char *input, const char *output)
         cib_object = filename2xml(NULL);
 
     } else {
-        cib_object = filename2xml(input);
+        cib_object = pcmk__series_file2xml(input);
     }
 
     if (get_object_root(XML_CIB_TAG_STATUS, cib_object) == NULL) {
@@ -512,7 +512,7 @@ profile_one(const char *xml_file, pe_working_set_t *data_set)
     xmlNode *cib_object = NULL;
 
     printf("* Testing %s\n", xml_file);
-    cib_object = filename2xml(xml_file);
+    cib_object = pcmk__series_file2xml(xml_file);
     if (get_object_root(XML_CIB_TAG_STATUS, cib_object) == NULL) {
         create_xml_node(cib_object, XML_CIB_TAG_STATUS);
     }